@@ -187,6 +187,7 @@ void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val);
 #include "WCharacter.h"
 #include "WString.h"
 #include "Stream.h"
+#include "StreamMatcher.h"
 #include "Printable.h"
 #include "Print.h"
 #include "IPAddress.h"
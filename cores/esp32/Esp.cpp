@@ -29,6 +29,8 @@ extern "C" {
 #include "esp_image_format.h"
 }
 #include <MD5Builder.h>
+#include <nvs.h>
+#include "mbedtls/sha256.h"
 
 #include "soc/spi_reg.h"
 #include "esp_system.h"
@@ -186,20 +188,33 @@ uint32_t EspClass::getMaxAllocPsram(void)
 	return 0;
 }
 
-static uint32_t sketchSize(sketchSize_t response) {
-    esp_image_metadata_t data;
+// Metadata of the running image, parsed from its headers without hashing the content
+static const esp_partition_t * runningImage(esp_image_metadata_t * data) {
     const esp_partition_t *running = esp_ota_get_running_partition();
-    if (!running) return 0;
+    if (!running) return NULL;
     const esp_partition_pos_t running_pos  = {
         .offset = running->address,
         .size = running->size,
     };
-    data.start_addr = running_pos.offset;
-    esp_image_verify(ESP_IMAGE_VERIFY, &running_pos, &data);
+    if (esp_image_get_metadata(&running_pos, data) != ESP_OK) {
+        return NULL;
+    }
+    return running;
+}
+
+static uint32_t sketchSize(sketchSize_t response) {
+    static uint32_t imageLen = 0;
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    if (!running) return 0;
+    if (!imageLen) {
+        esp_image_metadata_t data;
+        if (!runningImage(&data)) return 0;
+        imageLen = data.image_len;
+    }
     if (response) {
-        return running_pos.size - data.image_len;
+        return running->size - imageLen;
     } else {
-        return data.image_len;
+        return imageLen;
     }
 }
 
@@ -207,38 +222,105 @@ uint32_t EspClass::getSketchSize () {
     return sketchSize(SKETCH_SIZE_TOTAL);
 }
 
-String EspClass::getSketchMD5()
-{
-    static String result;
-    if (result.length()) {
-        return result;
+/*
+ * Digests of the running sketch. They are kept in NVS keyed by the partition,
+ * the image length and the SHA-256 the build appends to the image, so only the
+ * first boot of a new image has to read the whole partition.
+ */
+typedef struct {
+    uint32_t address;
+    uint32_t size;
+    uint8_t image[ESP_IMAGE_HASH_LEN];  // appended SHA-256, identifies the image
+    uint8_t md5[16];
+} sketch_hash_t;
+
+static sketch_hash_t s_sketchHash;
+static uint8_t s_sketchSHA256[ESP_IMAGE_HASH_LEN];
+static bool s_sketchHashValid = false;
+
+static String hexString(const uint8_t * data, size_t len) {
+    char buf[2 * len + 1];
+    for (size_t i = 0; i < len; i++) {
+        sprintf(buf + 2 * i, "%02x", data[i]);
     }
-    uint32_t lengthLeft = getSketchSize();
+    return String(buf);
+}
 
-    const esp_partition_t *running = esp_ota_get_running_partition();
+static bool loadSketchHash(const sketch_hash_t * hash) {
+    nvs_handle_t handle;
+    if (nvs_open(SKETCH_HASH_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+    sketch_hash_t stored;
+    size_t len = sizeof(stored);
+    bool found = nvs_get_blob(handle, "hash", &stored, &len) == ESP_OK && len == sizeof(stored)
+        && !memcmp(&stored, hash, offsetof(sketch_hash_t, md5));
+    nvs_close(handle);
+    if (found) {
+        memcpy(&s_sketchHash, &stored, sizeof(stored));
+    }
+    return found;
+}
+
+static void storeSketchHash() {
+    nvs_handle_t handle;
+    if (nvs_open(SKETCH_HASH_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return;
+    }
+    if (nvs_set_blob(handle, "hash", &s_sketchHash, sizeof(s_sketchHash)) != ESP_OK || nvs_commit(handle) != ESP_OK) {
+        log_w("Could not store sketch hash");
+    }
+    nvs_close(handle);
+}
+
+static bool computeSketchHash() {
+    esp_image_metadata_t data;
+    const esp_partition_t *running = runningImage(&data);
     if (!running) {
         log_e("Partition could not be found");
+        return false;
+    }
 
-        return String();
+    sketch_hash_t hash;
+    memset(&hash, 0, sizeof(hash));
+    hash.address = running->address;
+    hash.size = data.image_len;
+    bool appended = data.image.hash_appended;
+    if (appended) {
+        // the image SHA-256 is the digest appended to it, checked by the bootloader
+        memcpy(hash.image, data.image_digest, sizeof(hash.image));
+        memcpy(s_sketchSHA256, data.image_digest, sizeof(s_sketchSHA256));
+        if (loadSketchHash(&hash)) {
+            return true;
+        }
     }
+
     const size_t bufSize = SPI_FLASH_SEC_SIZE;
     std::unique_ptr<uint8_t[]> buf(new uint8_t[bufSize]);
-    uint32_t offset = 0;
     if(!buf.get()) {
         log_e("Not enough memory to allocate buffer");
 
-        return String();
+        return false;
     }
     MD5Builder md5;
     md5.begin();
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts_ret(&sha, 0);
+    uint32_t lengthLeft = data.image_len;
+    uint32_t offset = 0;
     while( lengthLeft > 0) {
         size_t readBytes = (lengthLeft < bufSize) ? lengthLeft : bufSize;
         if (!ESP.flashRead(running->address + offset, reinterpret_cast<uint32_t*>(buf.get()), (readBytes + 3) & ~3)) {
             log_e("Could not read buffer from flash");
+            mbedtls_sha256_free(&sha);
 
-            return String();
+            return false;
         }
         md5.add(buf.get(), readBytes);
+        if (!appended) {
+            mbedtls_sha256_update_ret(&sha, buf.get(), readBytes);
+        }
         lengthLeft -= readBytes;
         offset += readBytes;
 
@@ -247,8 +329,63 @@ String EspClass::getSketchMD5()
         #endif
     }
     md5.calculate();
-    result = md5.toString();
-    return result;
+    md5.getBytes(hash.md5);
+    if (!appended) {
+        mbedtls_sha256_finish_ret(&sha, s_sketchSHA256);
+    }
+    mbedtls_sha256_free(&sha);
+
+    memcpy(&s_sketchHash, &hash, sizeof(hash));
+    if (appended) {
+        storeSketchHash();
+    }
+    return true;
+}
+
+// Makes the digests available, waiting for a background hash that is already running
+static bool sketchHash() {
+    static SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    if (s_sketchHashValid) {
+        return true;
+    }
+    if (!lock) {
+        return false;
+    }
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (!s_sketchHashValid) {
+        s_sketchHashValid = computeSketchHash();
+    }
+    xSemaphoreGive(lock);
+    return s_sketchHashValid;
+}
+
+static void sketchHashTask(void *) {
+    sketchHash();
+    vTaskDelete(NULL);
+}
+
+bool EspClass::hashSketchInBackground()
+{
+    if (s_sketchHashValid) {
+        return true;
+    }
+    return xTaskCreate(sketchHashTask, "sketch_hash", SKETCH_HASH_TASK_STACK_SIZE, NULL, SKETCH_HASH_TASK_PRIORITY, NULL) == pdPASS;
+}
+
+String EspClass::getSketchMD5()
+{
+    if (!sketchHash()) {
+        return String();
+    }
+    return hexString(s_sketchHash.md5, sizeof(s_sketchHash.md5));
+}
+
+String EspClass::getSketchSHA256()
+{
+    if (!sketchHash()) {
+        return String();
+    }
+    return hexString(s_sketchSHA256, sizeof(s_sketchSHA256));
 }
 
 uint32_t EspClass::getFreeSketchSpace () {
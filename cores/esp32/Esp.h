@@ -57,6 +57,16 @@ typedef enum {
     SKETCH_SIZE_FREE = 1
 } sketchSize_t;
 
+#ifndef SKETCH_HASH_TASK_STACK_SIZE
+#define SKETCH_HASH_TASK_STACK_SIZE 4096
+#endif
+#ifndef SKETCH_HASH_TASK_PRIORITY
+#define SKETCH_HASH_TASK_PRIORITY 1
+#endif
+#ifndef SKETCH_HASH_NVS_NAMESPACE
+#define SKETCH_HASH_NVS_NAMESPACE "sketch_hash"
+#endif
+
 class EspClass
 {
 public:
@@ -95,6 +105,10 @@ public:
 
     uint32_t getSketchSize();
     String getSketchMD5();
+    String getSketchSHA256();
+    // Nothing hashes the sketch at boot: without this call, the first getSketchMD5/SHA256
+    // after an update hashes it in the caller. Call it early in setup() to have it done by then.
+    bool hashSketchInBackground();
     uint32_t getFreeSketchSpace();
 
     bool flashEraseSector(uint32_t sector);
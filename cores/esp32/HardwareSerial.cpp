@@ -76,7 +76,11 @@ _onReceiveErrorCB(NULL),
 _onReceiveTimeout(false),
 _rxTimeout(2),
 _rxFIFOFull(0),
-_eventTask(NULL)
+_eventTask(NULL),
+_frameBuf(NULL),
+_frameBufSize(ARDUINO_SERIAL_FRAME_BUFFER_SIZE),
+_frameHead(0),
+_frameTail(0)
 #if !CONFIG_DISABLE_HAL_LOCKS
     ,_lock(NULL)
 #endif
@@ -197,6 +201,14 @@ bool HardwareSerial::setRxTimeout(uint8_t symbols_timeout)
     return retCode;
 }
 
+bool HardwareSerial::setRxPatternDetect(char pattern, uint8_t count)
+{
+    HSERIAL_MUTEX_LOCK();
+    bool retCode = uartSetPatternDetect(_uart, pattern, count);
+    HSERIAL_MUTEX_UNLOCK();
+    return retCode;
+}
+
 void HardwareSerial::eventQueueReset()
 {
     QueueHandle_t uartEventQueue = NULL;
@@ -226,6 +238,9 @@ void HardwareSerial::_uartEventTask(void *args)
                             ((uart->_onReceiveTimeout && event.timeout_flag) || !uart->_onReceiveTimeout) )
                                 uart->_onReceiveCB();
                         break;
+                    case UART_PATTERN_DET:
+                        if(uart->_onReceiveCB && uart->available() > 0) uart->_onReceiveCB();
+                        break;
                     case UART_FIFO_OVF:
                         log_w("UART%d FIFO Overflow. Consider adding Hardware Flow Control to your Application.", uart->_uart_nr);
                         currentErr = UART_FIFO_OVF_ERROR;
@@ -390,6 +405,9 @@ void HardwareSerial::end()
         uartSetDebug(0);
     }
     _rxFIFOFull = 0;
+    free(_frameBuf);
+    _frameBuf = NULL;
+    _frameHead = _frameTail = 0;
     uartEnd(_uart_nr);  // fully detach all pins and delete the UART driver
     _destroyEventTask(); // when IDF uart driver is deleted, _eventTask must finish too
     _uart = NULL;
@@ -411,7 +429,7 @@ void HardwareSerial::setDebugOutput(bool en)
 
 int HardwareSerial::available(void)
 {
-    return uartAvailable(_uart);
+    return uartAvailable(_uart) + (_frameTail - _frameHead);
 }
 int HardwareSerial::availableForWrite(void)
 {
@@ -420,6 +438,9 @@ int HardwareSerial::availableForWrite(void)
 
 int HardwareSerial::peek(void)
 {
+    if (_frameHead < _frameTail) {
+        return _frameBuf[_frameHead];
+    }
     if (available()) {
         return uartPeek(_uart);
     }
@@ -429,6 +450,9 @@ int HardwareSerial::peek(void)
 int HardwareSerial::read(void)
 {
     uint8_t c = 0;
+    if (_frameHead < _frameTail) {
+        return _frameBuf[_frameHead++];
+    }
     if (uartReadBytes(_uart, &c, 1, 0) == 1) {
         return c;
     } else {
@@ -442,13 +466,176 @@ int HardwareSerial::read(void)
 // the buffer is NOT null terminated.
 size_t HardwareSerial::read(uint8_t *buffer, size_t size)
 {
-    return uartReadBytes(_uart, buffer, size, 0);
+    size_t pending = _readPending(buffer, size);
+    return pending + uartReadBytes(_uart, buffer + pending, size - pending, 0);
 }
 
 // Overrides Stream::readBytes() to be faster using IDF
 size_t HardwareSerial::readBytes(uint8_t *buffer, size_t length)
 {
-    return uartReadBytes(_uart, buffer, length, (uint32_t)getTimeout());
+    size_t pending = _readPending(buffer, length);
+    return pending + uartReadBytes(_uart, buffer + pending, length - pending, (uint32_t)getTimeout());
+}
+
+// copies data already drained into the frame buffer
+size_t HardwareSerial::_readPending(uint8_t *buffer, size_t size)
+{
+    size_t len = _frameTail - _frameHead;
+    if (len > size) {
+        len = size;
+    }
+    if (len) {
+        memcpy(buffer, _frameBuf + _frameHead, len);
+        _frameHead += len;
+    }
+    return len;
+}
+
+// moves all available UART data into the frame buffer with a single uartReadBytes()
+// when nothing is available, it waits up to timeout_ms for the next byte
+// returns the number of bytes added, 0 on timeout or when the frame buffer is full
+size_t HardwareSerial::_fillFrameBuffer(uint32_t timeout_ms)
+{
+    if (_frameBuf == NULL) {
+        _frameBuf = (uint8_t *)malloc(_frameBufSize);
+        if (_frameBuf == NULL) {
+            log_e("UART%d frame buffer allocation failed", _uart_nr);
+            return 0;
+        }
+    }
+    if (_frameHead == _frameTail) {
+        _frameHead = _frameTail = 0;
+    } else if (_frameHead > 0 && _frameTail == _frameBufSize) {
+        memmove(_frameBuf, _frameBuf + _frameHead, _frameTail - _frameHead);
+        _frameTail -= _frameHead;
+        _frameHead = 0;
+    }
+    size_t space = _frameBufSize - _frameTail;
+    if (space == 0) {
+        return 0;
+    }
+    size_t len = uartAvailable(_uart);
+    if (len == 0) {
+        len = uartReadBytes(_uart, _frameBuf + _frameTail, 1, timeout_ms);
+    } else {
+        len = uartReadBytes(_uart, _frameBuf + _frameTail, len < space ? len : space, 0);
+    }
+    _frameTail += len;
+    return len;
+}
+
+size_t HardwareSerial::setFrameBufferSize(size_t new_size)
+{
+    if (_frameHead != _frameTail) {
+        log_e("Frame Buffer can't be resized while it holds unread data.");
+        return 0;
+    }
+    if (new_size == 0) {
+        new_size = ARDUINO_SERIAL_FRAME_BUFFER_SIZE;
+    }
+    free(_frameBuf);
+    _frameBuf = NULL; // allocated again on first use
+    _frameHead = _frameTail = 0;
+    _frameBufSize = new_size;
+    return _frameBufSize;
+}
+
+const char *HardwareSerial::readFrame(char terminator, size_t *len)
+{
+    size_t scanned = 0;
+    do {
+        size_t pending = _frameTail - _frameHead;
+        if (pending > scanned) {
+            const uint8_t *frame = _frameBuf + _frameHead;
+            const uint8_t *end = (const uint8_t *)memchr(frame + scanned, terminator, pending - scanned);
+            if (end != NULL || pending == _frameBufSize) {
+                // terminator found or frame buffer full: hand out the frame and consume the terminator, if any
+                size_t frameLen = end != NULL ? (size_t)(end - frame) : pending;
+                _frameHead += end != NULL ? frameLen + 1 : frameLen;
+                if (len) {
+                    *len = frameLen;
+                }
+                return (const char *)frame;
+            }
+            scanned = pending;
+        }
+    } while (_fillFrameBuffer((uint32_t)getTimeout()));
+
+    if (len) {
+        *len = 0;
+    }
+    return NULL;
+}
+
+size_t HardwareSerial::readBytesUntil(char terminator, char *buffer, size_t length)
+{
+    size_t index = 0;
+    while (index < length) {
+        size_t pending = _frameTail - _frameHead;
+        if (pending == 0) {
+            if (!_fillFrameBuffer((uint32_t)getTimeout())) {
+                break;
+            }
+            continue;
+        }
+        if (pending > length - index) {
+            pending = length - index;
+        }
+        const uint8_t *src = _frameBuf + _frameHead;
+        const uint8_t *end = (const uint8_t *)memchr(src, terminator, pending);
+        size_t chunk = end != NULL ? (size_t)(end - src) : pending;
+        memcpy(buffer + index, src, chunk);
+        index += chunk;
+        _frameHead += chunk;
+        if (end != NULL) {
+            _frameHead++; // the terminator is consumed but not stored
+            break;
+        }
+    }
+    return index;
+}
+
+size_t HardwareSerial::peekAvailable()
+{
+    if (_frameHead == _frameTail) {
+        _fillFrameBuffer(0);
+    }
+    return _frameTail - _frameHead;
+}
+
+const char *HardwareSerial::peekBuffer()
+{
+    return (const char *)(_frameBuf + _frameHead);
+}
+
+void HardwareSerial::peekConsume(size_t consume)
+{
+    size_t pending = _frameTail - _frameHead;
+    _frameHead += consume < pending ? consume : pending;
+}
+
+String HardwareSerial::readStringUntil(char terminator)
+{
+    String ret;
+    for (;;) {
+        size_t pending = _frameTail - _frameHead;
+        if (pending == 0) {
+            if (!_fillFrameBuffer((uint32_t)getTimeout())) {
+                break;
+            }
+            continue;
+        }
+        const uint8_t *src = _frameBuf + _frameHead;
+        const uint8_t *end = (const uint8_t *)memchr(src, terminator, pending);
+        size_t chunk = end != NULL ? (size_t)(end - src) : pending;
+        ret.concat((const char *)src, chunk);
+        _frameHead += chunk;
+        if (end != NULL) {
+            _frameHead++;
+            break;
+        }
+    }
+    return ret;
 }
 
 void HardwareSerial::flush(void)
@@ -458,6 +645,9 @@ void HardwareSerial::flush(void)
 
 void HardwareSerial::flush(bool txOnly)
 {
+    if (!txOnly) {
+        _frameHead = _frameTail = 0;
+    }
     uartFlushTxOnly(_uart, txOnly);
 }
 
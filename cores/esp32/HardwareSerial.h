@@ -102,6 +102,10 @@ typedef enum {
   #define ARDUINO_SERIAL_EVENT_TASK_STACK_SIZE 2048
 #endif
 
+#ifndef ARDUINO_SERIAL_FRAME_BUFFER_SIZE
+  #define ARDUINO_SERIAL_FRAME_BUFFER_SIZE 256
+#endif
+
 #ifndef ARDUINO_SERIAL_EVENT_TASK_PRIORITY
   #define ARDUINO_SERIAL_EVENT_TASK_PRIORITY (configMAX_PRIORITIES-1)
 #endif
@@ -221,6 +225,39 @@ public:
 
     // eventQueueReset clears all events in the queue (the events that trigger onReceive and onReceiveError) - maybe usefull in some use cases
     void eventQueueReset();
+
+    // setRxPatternDetect enables the UART AT-pattern detection interrupt: onReceive callback will also be called
+    // as soon as 'count' consecutive 'pattern' characters are received, for instance '\n' for line protocols.
+    // count = 0 disables it. It shall be called after begin().
+    bool setRxPatternDetect(char pattern, uint8_t count = 1);
+
+    // The frame readers below drain the UART RX Ringbuffer in blocks into a reusable frame buffer and scan it
+    // for the terminator, instead of locking the UART for every byte as Stream::timedRead() does.
+    // Bytes read past a terminator are kept in the frame buffer and are seen by all other read functions.
+    // setFrameBufferSize() sets its size (default ARDUINO_SERIAL_FRAME_BUFFER_SIZE) and shall be called before any read.
+    size_t setFrameBufferSize(size_t new_size);
+
+    // readFrame returns a pointer to the next frame ended by terminator (not included, not NUL terminated) and its length.
+    // The pointer is valid until the next read operation. Returns NULL on timeout, keeping any partial frame for the next call.
+    // A frame longer than the frame buffer is returned truncated to the frame buffer size.
+    const char *readFrame(char terminator, size_t *len);
+
+    // Override Stream::readBytesUntil() and Stream::readStringUntil() to read in blocks
+    size_t readBytesUntil(char terminator, char *buffer, size_t length);
+    size_t readBytesUntil(char terminator, uint8_t *buffer, size_t length)
+    {
+        return readBytesUntil(terminator, (char *) buffer, length);
+    }
+    String readStringUntil(char terminator);
+
+    // Stream peek buffer API over the frame buffer, used by StreamMatcher and Stream::find()
+    bool hasPeekBufferAPI() const override
+    {
+        return true;
+    }
+    size_t peekAvailable() override;
+    const char *peekBuffer() override;
+    void peekConsume(size_t consume) override;
  
     // When pins are changed, it will detach the previous ones
     // if pin is negative, it won't be set/changed and will be kept as is
@@ -311,6 +348,10 @@ protected:
     bool _onReceiveTimeout;
     uint8_t _rxTimeout, _rxFIFOFull;
     TaskHandle_t _eventTask;
+    // frame buffer for block reads, pending data is in [_frameHead, _frameTail)
+    uint8_t *_frameBuf;
+    size_t _frameBufSize;
+    size_t _frameHead, _frameTail;
 #if !CONFIG_DISABLE_HAL_LOCKS
     SemaphoreHandle_t _lock;
 #endif
@@ -318,6 +359,8 @@ protected:
     void _createEventTask(void *args);
     void _destroyEventTask(void);
     static void _uartEventTask(void *args);
+    size_t _fillFrameBuffer(uint32_t timeout_ms);
+    size_t _readPending(uint8_t *buffer, size_t size);
 };
 
 extern void serialEventRun(void) __attribute__((weak));
@@ -28,6 +28,7 @@
 #include "Arduino.h"
 
 #include "Print.h"
+#include "numfmt.h"
 extern "C" {
     #include "time.h"
 }
@@ -59,6 +60,13 @@ size_t Print::printf(const char *format, ...)
         return 0;
     }
     if(len >= (int)sizeof(loc_buf)){  // comparation of same sign type for the compiler
+        char * dst = writeBuffer(len+1);
+        if(dst != NULL) {
+            len = vsnprintf(dst, len+1, format, arg);
+            va_end(arg);
+            writeCommit(len);
+            return len;
+        }
         temp = (char*) malloc(len+1);
         if(temp == NULL) {
             va_end(arg);
@@ -144,9 +152,25 @@ size_t Print::print(unsigned long long n, int base)
 
 size_t Print::print(double n, int digits)
 {
+    if(digits < 0) {
+        return printShortest(n);
+    }
+    return printFloat(n, digits);
+}
+
+size_t Print::print(float n, int digits)
+{
+    if(digits < 0) {
+        return printShortest(n);
+    }
     return printFloat(n, digits);
 }
 
+size_t Print::print(long double n, int digits)
+{
+    return print(static_cast<double>(n), digits);
+}
+
 size_t Print::print(const Printable& x)
 {
     return x.printTo(*this);
@@ -248,6 +272,20 @@ size_t Print::println(double num, int digits)
     return n;
 }
 
+size_t Print::println(float num, int digits)
+{
+    size_t n = print(num, digits);
+    n += println();
+    return n;
+}
+
+size_t Print::println(long double num, int digits)
+{
+    size_t n = print(num, digits);
+    n += println();
+    return n;
+}
+
 size_t Print::println(const Printable& x)
 {
     size_t n = print(x);
@@ -266,97 +304,42 @@ size_t Print::println(struct tm * timeinfo, const char * format)
 
 size_t Print::printNumber(unsigned long n, uint8_t base)
 {
-    char buf[8 * sizeof(n) + 1]; // Assumes 8-bit chars plus zero byte.
-    char *str = &buf[sizeof(buf) - 1];
-
-    *str = '\0';
-
-    // prevent crash if called with base == 1
-    if(base < 2) {
-        base = 10;
-    }
-
-    do {
-        char c = n % base;
-        n /= base;
-
-        *--str = c < 10 ? c + '0' : c + 'A' - 10;
-    } while (n);
-
-    return write(str);
+    return printNumber(static_cast<unsigned long long>(n), base);
 }
 
 size_t Print::printNumber(unsigned long long n, uint8_t base)
 {
-    char buf[8 * sizeof(n) + 1]; // Assumes 8-bit chars plus zero byte.
-    char* str = &buf[sizeof(buf) - 1];
-
-    *str = '\0';
-
-    // prevent crash if called with base == 1
-    if (base < 2) {
-        base = 10;
+    char *dst = writeBuffer(NUMFMT_BASE_SIZE);
+    if(dst) {
+        size_t len = numfmt_base(dst, n, base);
+        writeCommit(len);
+        return len;
     }
-
-    do {
-        auto m = n;
-        n /= base;
-        char c = m - base * n;
-
-        *--str = c < 10 ? c + '0' : c + 'A' - 10;
-    } while (n);
-
-    return write(str);
+    char buf[NUMFMT_BASE_SIZE];
+    return write(buf, numfmt_base(buf, n, base));
 }
 
 size_t Print::printFloat(double number, uint8_t digits)
 {
-    size_t n = 0;
-
-    if(isnan(number)) {
-        return print("nan");
-    }
-    if(isinf(number)) {
-        return print("inf");
-    }
-    if(number > 4294967040.0) {
-        return print("ovf");    // constant determined empirically
-    }
-    if(number < -4294967040.0) {
-        return print("ovf");    // constant determined empirically
-    }
-
-    // Handle negative numbers
-    if(number < 0.0) {
-        n += print('-');
-        number = -number;
-    }
-
-    // Round correctly so that print(1.999, 2) prints as "2.00"
-    double rounding = 0.5;
-    for(uint8_t i = 0; i < digits; ++i) {
-        rounding /= 10.0;
-    }
-
-    number += rounding;
-
-    // Extract the integer part of the number and print it
-    unsigned long int_part = (unsigned long) number;
-    double remainder = number - (double) int_part;
-    n += print(int_part);
-
-    // Print the decimal point, but only if there are digits beyond
-    if(digits > 0) {
-        n += print(".");
+    // the whole number goes out in one write instead of one print per digit
+    char *dst = writeBuffer(NUMFMT_FIXED_SIZE(digits));
+    if(dst) {
+        size_t len = numfmt_fixed(dst, number, digits);
+        writeCommit(len);
+        return len;
     }
+    char buf[NUMFMT_FIXED_SIZE(UINT8_MAX)];
+    return write(buf, numfmt_fixed(buf, number, digits));
+}
 
-    // Extract digits from the remainder one at a time
-    while(digits-- > 0) {
-        remainder *= 10.0;
-        int toPrint = int(remainder);
-        n += print(toPrint);
-        remainder -= toPrint;
-    }
+size_t Print::printShortest(double number)
+{
+    char buf[NUMFMT_SHORTEST_SIZE];
+    return write(buf, numfmt_shortest(buf, number));
+}
 
-    return n;
+size_t Print::printShortest(float number)
+{
+    char buf[NUMFMT_SHORTEST_SIZE];
+    return write(buf, numfmt_shortest_f(buf, number));
 }
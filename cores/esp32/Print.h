@@ -38,6 +38,8 @@ private:
     size_t printNumber(unsigned long, uint8_t);
     size_t printNumber(unsigned long long, uint8_t);
     size_t printFloat(double, uint8_t);
+    size_t printShortest(double);
+    size_t printShortest(float);
 protected:
     void setWriteError(int err = 1)
     {
@@ -78,6 +80,14 @@ public:
     // default to zero, meaning "a single write may block"
     // should be overriden by subclasses with buffering
     virtual int availableForWrite() { return 0; }
+
+    // Memory backed sinks can let numbers and printf() be formatted in place.
+    // writeBuffer() returns room for at least 'size' bytes after the current
+    // end, or NULL to make the caller format on the stack and call write().
+    // writeCommit() then appends the 'size' bytes that were actually written.
+    virtual char *writeBuffer(size_t /*size*/) { return NULL; }
+    virtual void writeCommit(size_t /*size*/) {}
+
     size_t print(const __FlashStringHelper *ifsh) { return print(reinterpret_cast<const char *>(ifsh)); }
     size_t print(const String &);
     size_t print(const char[]);
@@ -89,7 +99,10 @@ public:
     size_t print(unsigned long, int = DEC);
     size_t print(long long, int = DEC);
     size_t print(unsigned long long, int = DEC);
+    // a negative number of digits prints the shortest text that reads back as the same value
     size_t print(double, int = 2);
+    size_t print(float, int = 2);
+    size_t print(long double, int = 2);
     size_t print(const Printable&);
     size_t print(struct tm * timeinfo, const char * format = NULL);
 
@@ -105,6 +118,8 @@ public:
     size_t println(long long, int = DEC);
     size_t println(unsigned long long, int = DEC);
     size_t println(double, int = 2);
+    size_t println(float, int = 2);
+    size_t println(long double, int = 2);
     size_t println(const Printable&);
     size_t println(struct tm * timeinfo, const char * format = NULL);
     size_t println(void);
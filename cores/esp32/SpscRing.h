@@ -0,0 +1,341 @@
+/*
+ SpscRing.h - Lock-free single producer, single consumer ring buffer
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __spsc_ring_h
+#define __spsc_ring_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <type_traits>
+
+#ifdef ESP_PLATFORM
+#include "esp_heap_caps.h"
+#elif defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*
+ One side only writes (push, write, reserveWrite/commitWrite) and the other
+ only reads (pop, read, peekContiguous/commitRead), for example an ISR and
+ a task. The head is only advanced by the producer and the tail only by
+ the consumer, with acquire/release ordering, so neither side takes a lock
+ or disables interrupts. The indices run freely and are masked with the
+ power of two capacity, so the whole capacity is usable.
+
+ Storage is taken from internal RAM so the ring can be used from ISRs while
+ the flash cache is off. Everything but construction is inlined, so it
+ ends up in IRAM together with an IRAM_ATTR caller.
+
+ On a Linux host the storage can be mapped twice back to back (mirror), so
+ the spans returned by reserveWrite and peekContiguous are never cut at the
+ end of the buffer. It needs the size in bytes to be a multiple of the
+ page size and quietly falls back to a plain buffer otherwise.
+ */
+
+#define SPSC_RING_INLINE inline __attribute__((always_inline))
+
+template <typename T>
+class SpscRing
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SpscRing elements are copied with memcpy");
+
+public:
+    SpscRing(size_t capacity, bool mirror = false) :
+        _buf(NULL), _mask(0), _mirrored(false), _head(0), _tail(0)
+    {
+        size_t size = 1;
+        while(size < capacity) {
+            size <<= 1;
+        }
+        _buf = _allocate(size, mirror);
+        if(_buf) {
+            _mask = size - 1;
+        }
+    }
+
+    ~SpscRing()
+    {
+        _release();
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    SPSC_RING_INLINE bool valid() const
+    {
+        return _buf != NULL;
+    }
+
+    SPSC_RING_INLINE size_t capacity() const
+    {
+        return _buf ? _mask + 1 : 0;
+    }
+
+    SPSC_RING_INLINE bool mirrored() const
+    {
+        return _mirrored;
+    }
+
+    // what the consumer can read at least, more may arrive meanwhile
+    SPSC_RING_INLINE size_t available() const
+    {
+        return _load(&_head) - _load(&_tail);
+    }
+
+    // what the producer can write at least, more may be freed meanwhile
+    SPSC_RING_INLINE size_t room() const
+    {
+        return capacity() - available();
+    }
+
+    SPSC_RING_INLINE bool empty() const
+    {
+        return available() == 0;
+    }
+
+    SPSC_RING_INLINE bool full() const
+    {
+        return room() == 0;
+    }
+
+    /*
+     Producer
+     */
+
+    SPSC_RING_INLINE bool push(const T &value)
+    {
+        size_t head = _head;
+        if(!_buf || head - _load(&_tail) > _mask) {
+            return false;
+        }
+        _buf[head & _mask] = value;
+        _store(&_head, head + 1);
+        return true;
+    }
+
+    SPSC_RING_INLINE size_t write(const T *src, size_t count)
+    {
+        size_t head = _head;
+        size_t free = capacity() - (head - _load(&_tail));
+        if(count > free) {
+            count = free;
+        }
+        if(count) {
+            _copyIn(head & _mask, src, count);
+            _store(&_head, head + count);
+        }
+        return count;
+    }
+
+    // Returns the free space that can be filled in place, commitWrite publishes it
+    SPSC_RING_INLINE T *reserveWrite(size_t *count)
+    {
+        size_t head = _head;
+        size_t free = capacity() - (head - _load(&_tail));
+        *count = _span(head & _mask, free);
+        return _buf ? _buf + (head & _mask) : NULL;
+    }
+
+    SPSC_RING_INLINE void commitWrite(size_t count)
+    {
+        _store(&_head, _head + count);
+    }
+
+    /*
+     Consumer
+     */
+
+    SPSC_RING_INLINE bool pop(T &value)
+    {
+        size_t tail = _tail;
+        if(tail == _load(&_head)) {
+            return false;
+        }
+        value = _buf[tail & _mask];
+        _store(&_tail, tail + 1);
+        return true;
+    }
+
+    SPSC_RING_INLINE bool peek(T &value) const
+    {
+        size_t tail = _tail;
+        if(tail == _load(&_head)) {
+            return false;
+        }
+        value = _buf[tail & _mask];
+        return true;
+    }
+
+    SPSC_RING_INLINE size_t peek(T *dst, size_t count) const
+    {
+        size_t tail = _tail;
+        size_t used = _load(&_head) - tail;
+        if(count > used) {
+            count = used;
+        }
+        if(count) {
+            _copyOut(dst, tail & _mask, count);
+        }
+        return count;
+    }
+
+    SPSC_RING_INLINE size_t read(T *dst, size_t count)
+    {
+        count = peek(dst, count);
+        _store(&_tail, _tail + count);
+        return count;
+    }
+
+    // Returns the data that can be used in place, commitRead releases it
+    SPSC_RING_INLINE const T *peekContiguous(size_t *count) const
+    {
+        size_t tail = _tail;
+        *count = _span(tail & _mask, _load(&_head) - tail);
+        return _buf ? _buf + (tail & _mask) : NULL;
+    }
+
+    SPSC_RING_INLINE void commitRead(size_t count)
+    {
+        _store(&_tail, _tail + count);
+    }
+
+    // Drops up to count elements, returns how many were dropped
+    SPSC_RING_INLINE size_t remove(size_t count)
+    {
+        size_t tail = _tail;
+        size_t used = _load(&_head) - tail;
+        if(count > used) {
+            count = used;
+        }
+        _store(&_tail, tail + count);
+        return count;
+    }
+
+    SPSC_RING_INLINE void flush()
+    {
+        _store(&_tail, _load(&_head));
+    }
+
+    // Empties the ring and starts again at the beginning of the storage,
+    // only while neither side is using it
+    void clear()
+    {
+        _head = 0;
+        _tail = 0;
+    }
+
+protected:
+    static SPSC_RING_INLINE size_t _load(const volatile size_t *index)
+    {
+        return __atomic_load_n(index, __ATOMIC_ACQUIRE);
+    }
+
+    static SPSC_RING_INLINE void _store(volatile size_t *index, size_t value)
+    {
+        __atomic_store_n(index, value, __ATOMIC_RELEASE);
+    }
+
+    SPSC_RING_INLINE size_t _span(size_t offset, size_t count) const
+    {
+        if(!_mirrored && count > _mask + 1 - offset) {
+            count = _mask + 1 - offset;
+        }
+        return count;
+    }
+
+    // copies into the ring at offset, in two parts if it wraps
+    SPSC_RING_INLINE void _copyIn(size_t offset, const T *src, size_t count)
+    {
+        size_t first = _span(offset, count);
+        memcpy(_buf + offset, src, first * sizeof(T));
+        if(count > first) {
+            memcpy(_buf, src + first, (count - first) * sizeof(T));
+        }
+    }
+
+    SPSC_RING_INLINE void _copyOut(T *dst, size_t offset, size_t count) const
+    {
+        size_t first = _span(offset, count);
+        memcpy(dst, _buf + offset, first * sizeof(T));
+        if(count > first) {
+            memcpy(dst + first, _buf, (count - first) * sizeof(T));
+        }
+    }
+
+    T *_allocate(size_t size, bool mirror)
+    {
+        size_t bytes = size * sizeof(T);
+#if !defined(ESP_PLATFORM) && defined(__linux__) && defined(SYS_memfd_create)
+        long page = sysconf(_SC_PAGESIZE);
+        if(mirror && page > 0 && !(bytes % page)) {
+            int fd = syscall(SYS_memfd_create, "spsc_ring", 0);
+            if(fd >= 0) {
+                uint8_t *base = NULL;
+                if(!ftruncate(fd, bytes)) {
+                    void *area = mmap(NULL, 2 * bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                    if(area != MAP_FAILED) {
+                        base = (uint8_t *)area;
+                        if(mmap(base, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+                                || mmap(base + bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+                            munmap(base, 2 * bytes);
+                            base = NULL;
+                        }
+                    }
+                }
+                close(fd);
+                if(base) {
+                    _mirrored = true;
+                    return (T *)base;
+                }
+            }
+        }
+#else
+        (void)mirror;
+#endif
+#ifdef ESP_PLATFORM
+        return (T *)heap_caps_malloc(bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+#else
+        return (T *)malloc(bytes);
+#endif
+    }
+
+    void _release()
+    {
+#if !defined(ESP_PLATFORM) && defined(__linux__) && defined(SYS_memfd_create)
+        if(_mirrored) {
+            munmap(_buf, 2 * (_mask + 1) * sizeof(T));
+            _buf = NULL;
+            return;
+        }
+#endif
+        free(_buf);
+        _buf = NULL;
+    }
+
+    T *_buf;
+    size_t _mask;
+    bool _mirrored;
+    volatile size_t _head;  // written by the producer only
+    volatile size_t _tail;  // written by the consumer only
+};
+
+#endif//__spsc_ring_h
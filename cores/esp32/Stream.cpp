@@ -22,6 +22,7 @@
 
 #include "Arduino.h"
 #include "Stream.h"
+#include "StreamMatcher.h"
 #include "esp32-hal.h"
 
 #define PARSE_TIMEOUT 1000  // default number of milli-seconds to wait
@@ -120,68 +121,15 @@ bool Stream::findUntil(const char *target, size_t targetLen, const char *termina
 }
 
 int Stream::findMulti( struct Stream::MultiTarget *targets, int tCount) {
-  // any zero length target string automatically matches and would make
-  // a mess of the rest of the algorithm.
+  StreamMatcher matcher;
   for (struct MultiTarget *t = targets; t < targets+tCount; ++t) {
+    // any zero length target string automatically matches
     if (t->len <= 0)
       return t - targets;
-  }
-
-  while (1) {
-    int c = timedRead();
-    if (c < 0)
+    if (matcher.addTarget(t->str, t->len) < 0)
       return -1;
-
-    for (struct MultiTarget *t = targets; t < targets+tCount; ++t) {
-      // the simple case is if we match, deal with that first.
-      if (c == t->str[t->index]) {
-        if (++t->index == t->len)
-          return t - targets;
-        else
-          continue;
-      }
-
-      // if not we need to walk back and see if we could have matched further
-      // down the stream (ie '1112' doesn't match the first position in '11112'
-      // but it will match the second position so we can't just reset the current
-      // index to 0 when we find a mismatch.
-      if (t->index == 0)
-        continue;
-
-      int origIndex = t->index;
-      do {
-        --t->index;
-        // first check if current char works against the new current index
-        if (c != t->str[t->index])
-          continue;
-
-        // if it's the only char then we're good, nothing more to check
-        if (t->index == 0) {
-          t->index++;
-          break;
-        }
-
-        // otherwise we need to check the rest of the found string
-        int diff = origIndex - t->index;
-        size_t i;
-        for (i = 0; i < t->index; ++i) {
-          if (t->str[i] != t->str[i + diff])
-            break;
-        }
-
-        // if we successfully got through the previous loop then our current
-        // index is good.
-        if (i == t->index) {
-          t->index++;
-          break;
-        }
-
-        // otherwise we just try the next index
-      } while (t->index);
-    }
   }
-  // unreachable
-  return -1;
+  return matcher.find(*this);
 }
 
 // returns the first valid (long) integer value from the current position.
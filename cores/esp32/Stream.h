@@ -117,6 +117,26 @@ public:
     virtual String readString();
     String readStringUntil(char terminator);
 
+    // Streams that hold received data in memory can expose it, so that parsers
+    // can scan it in place instead of calling read() for every byte.
+    // peekAvailable() may fetch more data, but never waits for it.
+    virtual bool hasPeekBufferAPI() const
+    {
+        return false;
+    }
+    virtual size_t peekAvailable()   // number of bytes readable from peekBuffer()
+    {
+        return 0;
+    }
+    virtual const char *peekBuffer() // valid until the next read or peekConsume()
+    {
+        return nullptr;
+    }
+    virtual void peekConsume(size_t consume)
+    {
+        (void) consume;
+    }
+
 protected:
     long parseInt(char skipChar); // as above but the given skipChar is ignored
     // as above but the given skipChar is ignored
@@ -0,0 +1,251 @@
+/*
+ StreamMatcher.cpp - streaming multi-target substring search
+ Copyright (c) 2022 Espressif Systems (Shanghai) Co., Ltd.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdlib.h>
+#include "Arduino.h"
+#include "Stream.h"
+#include "StreamMatcher.h"
+
+StreamMatcher::StreamMatcher()
+    : _targets(_inlineTargets)
+    , _count(0)
+    , _capacity(INLINE_TARGETS)
+    , _pool(_inlinePool)
+    , _poolUsed(0)
+    , _poolSize(INLINE_POOL)
+{
+}
+
+StreamMatcher::StreamMatcher(const char *target)
+    : StreamMatcher()
+{
+    addTarget(target);
+}
+
+StreamMatcher::StreamMatcher(const char *target, const char *terminator)
+    : StreamMatcher()
+{
+    addTarget(target);
+    addTarget(terminator);
+}
+
+StreamMatcher::~StreamMatcher()
+{
+    clear();
+}
+
+void StreamMatcher::clear()
+{
+    if (_targets != _inlineTargets) {
+        free(_targets);
+        _targets = _inlineTargets;
+        _capacity = INLINE_TARGETS;
+    }
+    if (_pool != _inlinePool) {
+        free(_pool);
+        _pool = _inlinePool;
+        _poolSize = INLINE_POOL;
+    }
+    _count = 0;
+    _poolUsed = 0;
+}
+
+void StreamMatcher::reset()
+{
+    for (size_t i = 0; i < _count; i++) {
+        _targets[i].state = 0;
+    }
+}
+
+int StreamMatcher::addTarget(const char *target, size_t length)
+{
+    if (!target || length > UINT16_MAX) {
+        return -1;
+    }
+    // string, padded to keep the failure table aligned, then the table itself
+    size_t need = ((length + 1) & ~1) + length * sizeof(uint16_t);
+
+    if (_count == _capacity) {
+        size_t capacity = _capacity * 2;
+        Target *targets = (Target *)malloc(capacity * sizeof(Target));
+        if (!targets) {
+            return -1;
+        }
+        memcpy(targets, _targets, _count * sizeof(Target));
+        if (_targets != _inlineTargets) {
+            free(_targets);
+        }
+        _targets = targets;
+        _capacity = capacity;
+    }
+    if (_poolUsed + need > _poolSize) {
+        size_t size = _poolSize * 2;
+        while (size < _poolUsed + need) {
+            size *= 2;
+        }
+        uint8_t *pool = (uint8_t *)malloc(size);
+        if (!pool) {
+            return -1;
+        }
+        memcpy(pool, _pool, _poolUsed);
+        if (_pool != _inlinePool) {
+            free(_pool);
+        }
+        _pool = pool;
+        _poolSize = size;
+    }
+
+    Target &t = _targets[_count];
+    t.offset = _poolUsed;
+    t.length = length;
+    t.state = 0;
+    _poolUsed += need;
+
+    uint8_t *str = _pool + t.offset;
+    uint16_t *fail = (uint16_t *)(str + ((length + 1) & ~1));
+    memcpy(str, target, length);
+
+    // fail[i] is the length of the longest proper prefix of str[0..i] that is also its suffix
+    if (length) {
+        fail[0] = 0;
+    }
+    for (size_t i = 1, k = 0; i < length; i++) {
+        while (k > 0 && str[i] != str[k]) {
+            k = fail[k - 1];
+        }
+        if (str[i] == str[k]) {
+            k++;
+        }
+        fail[i] = k;
+    }
+    return _count++;
+}
+
+bool StreamMatcher::_step(Target &t, uint8_t c)
+{
+    const uint8_t *str = _pool + t.offset;
+    const uint16_t *fail = (const uint16_t *)(str + ((t.length + 1) & ~1));
+    size_t state = t.state;
+
+    // an empty target has no characters to compare, it matches anywhere
+    if (t.length == 0) {
+        return true;
+    }
+    while (state > 0 && c != str[state]) {
+        state = fail[state - 1];
+    }
+    if (c == str[state]) {
+        state++;
+    }
+    if (state == t.length) {
+        t.state = 0;
+        return true;
+    }
+    t.state = state;
+    return false;
+}
+
+int StreamMatcher::scan(uint8_t c)
+{
+    for (size_t i = 0; i < _count; i++) {
+        if (_step(_targets[i], c)) {
+            reset();
+            return i;
+        }
+    }
+    return -1;
+}
+
+int StreamMatcher::scan(const uint8_t *data, size_t length, size_t *consumed)
+{
+    // any zero length target matches before the first byte
+    for (size_t i = 0; i < _count; i++) {
+        if (_targets[i].length == 0) {
+            if (consumed) {
+                *consumed = 0;
+            }
+            reset();
+            return i;
+        }
+    }
+
+    // a single target skips straight to the next occurrence of its first character
+    const uint8_t *first = (_count == 1 && _targets[0].length) ? _pool + _targets[0].offset : NULL;
+
+    for (size_t pos = 0; pos < length; pos++) {
+        if (first && _targets[0].state == 0) {
+            const uint8_t *next = (const uint8_t *)memchr(data + pos, *first, length - pos);
+            if (!next) {
+                break;
+            }
+            pos = next - data;
+        }
+        int found = scan(data[pos]);
+        if (found >= 0) {
+            if (consumed) {
+                *consumed = pos + 1;
+            }
+            return found;
+        }
+    }
+    if (consumed) {
+        *consumed = length;
+    }
+    return -1;
+}
+
+int StreamMatcher::find(Stream &stream)
+{
+    // any zero length target matches right away
+    for (size_t i = 0; i < _count; i++) {
+        if (_targets[i].length == 0) {
+            return i;
+        }
+    }
+    if (!_count) {
+        return -1;
+    }
+
+    unsigned long timeout = stream.getTimeout();
+    unsigned long startMillis = millis();
+    do {
+        if (stream.hasPeekBufferAPI()) {
+            size_t available = stream.peekAvailable();
+            if (available) {
+                size_t consumed = 0;
+                int found = scan((const uint8_t *)stream.peekBuffer(), available, &consumed);
+                stream.peekConsume(consumed);
+                if (found >= 0) {
+                    return found;
+                }
+                startMillis = millis();
+            }
+        } else {
+            int c = stream.read();
+            if (c >= 0) {
+                int found = scan((uint8_t)c);
+                if (found >= 0) {
+                    return found;
+                }
+                startMillis = millis();
+            }
+        }
+    } while (millis() - startMillis < timeout);
+    return -1;
+}
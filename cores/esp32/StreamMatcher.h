@@ -0,0 +1,92 @@
+/*
+ StreamMatcher.h - streaming multi-target substring search
+ Copyright (c) 2022 Espressif Systems (Shanghai) Co., Ltd.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef StreamMatcher_h
+#define StreamMatcher_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+class Stream;
+
+// Searches a byte stream for one or more target strings at once.
+// The KMP failure table of every target is computed when it is added, so each
+// input byte costs one table step per target whatever the mismatch pattern.
+// A matcher can be built once and reused for many searches; Stream::find(),
+// findUntil() and findMulti() use a temporary one.
+class StreamMatcher
+{
+public:
+    StreamMatcher();
+    explicit StreamMatcher(const char *target);
+    StreamMatcher(const char *target, const char *terminator);
+    ~StreamMatcher();
+
+    StreamMatcher(const StreamMatcher &) = delete;
+    StreamMatcher &operator=(const StreamMatcher &) = delete;
+
+    // adds a target (copied), returns its index or -1 if out of memory
+    int addTarget(const char *target, size_t length);
+    int addTarget(const char *target)
+    {
+        return addTarget(target, strlen(target));
+    }
+    // removes all targets
+    void clear();
+    // forgets partial matches, targets are kept
+    void reset();
+    size_t targets() const
+    {
+        return _count;
+    }
+
+    // scans a block of data, returns the index of the first target completed or -1.
+    // 'consumed' receives the number of bytes scanned, up to and including the end of the match.
+    int scan(const uint8_t *data, size_t length, size_t *consumed);
+    int scan(uint8_t c);
+
+    // reads from the stream until one of the targets is found or the stream timeout expires.
+    // streams with a peek buffer are scanned in place, block by block.
+    // returns the index of the target found or -1 on timeout. Data after the match is not consumed.
+    int find(Stream &stream);
+
+protected:
+    struct Target {
+        size_t offset;      // of the string in _pool, the uint16_t failure table follows it
+        uint16_t length;
+        uint16_t state;     // number of characters currently matched
+    };
+
+    static const size_t INLINE_TARGETS = 2;
+    static const size_t INLINE_POOL = 96;
+
+    Target *_targets;
+    size_t _count;
+    size_t _capacity;
+    uint8_t *_pool;
+    size_t _poolUsed;
+    size_t _poolSize;
+    Target _inlineTargets[INLINE_TARGETS];
+    uint8_t _inlinePool[INLINE_POOL] __attribute__((aligned(2)));
+
+    bool _step(Target &t, uint8_t c);
+};
+
+#endif
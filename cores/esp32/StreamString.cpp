@@ -26,7 +26,7 @@
 size_t StreamString::write(const uint8_t *data, size_t size) {
     if(size && data) {
         const unsigned int newlen = length() + size;
-        if(reserve(newlen + 1)) {
+        if(grow(newlen + 1)) {
             memcpy((void *) (wbuffer() + len()), (const void *) data, size);
             setLen(newlen);
             *(wbuffer() + newlen) = 0x00; // add null for string end
@@ -40,6 +40,19 @@ size_t StreamString::write(uint8_t data) {
     return concat((char) data);
 }
 
+char *StreamString::writeBuffer(size_t size) {
+    if(!grow(length() + size)) {
+        return NULL;
+    }
+    return wbuffer() + len();
+}
+
+void StreamString::writeCommit(size_t size) {
+    const unsigned int newlen = length() + size;
+    setLen(newlen);
+    *(wbuffer() + newlen) = 0x00;
+}
+
 int StreamString::available() {
     return length();
 }
@@ -65,3 +78,15 @@ int StreamString::peek() {
 void StreamString::flush() {
 }
 
+size_t StreamString::peekAvailable() {
+    return length();
+}
+
+const char *StreamString::peekBuffer() {
+    return c_str();
+}
+
+void StreamString::peekConsume(size_t consume) {
+    remove(0, consume);
+}
+
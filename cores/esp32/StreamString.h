@@ -28,11 +28,21 @@ class StreamString: public Stream, public String
 public:
     size_t write(const uint8_t *buffer, size_t size) override;
     size_t write(uint8_t data) override;
+    char *writeBuffer(size_t size) override;
+    void writeCommit(size_t size) override;
 
     int available() override;
     int read() override;
     int peek() override;
     void flush() override;
+
+    bool hasPeekBufferAPI() const override
+    {
+        return true;
+    }
+    size_t peekAvailable() override;
+    const char *peekBuffer() override;
+    void peekConsume(size_t consume) override;
 };
 
 
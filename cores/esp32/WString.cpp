@@ -153,9 +153,21 @@ inline void String::init(void) {
     setLen(0);
 }
 
+#if WSTRING_ALLOC_STATS
+String::AllocStats & String::allocStats() {
+    static AllocStats stats;
+    return stats;
+}
+# define WSTRING_COUNT(counter) (allocStats().counter++)
+#else
+# define WSTRING_COUNT(counter)
+#endif
+
 void String::invalidate(void) {
-    if(!isSSO() && wbuffer())
+    if(!isSSO() && wbuffer()) {
         free(wbuffer());
+        WSTRING_COUNT(frees);
+    }
     init();
 }
 
@@ -175,7 +187,7 @@ bool String::changeBuffer(unsigned int maxStrLen) {
     if (maxStrLen < sizeof(sso.buff) - 1) {
         if (isSSO() || !buffer()) {
             // Already using SSO, nothing to do
-            uint16_t oldLen = len();
+            unsigned int oldLen = len();
             setSSO(true);
             setLen(oldLen);
         } else { // if bufptr && !isSSO()
@@ -183,7 +195,8 @@ bool String::changeBuffer(unsigned int maxStrLen) {
             char temp[sizeof(sso.buff)];
             memcpy(temp, buffer(), maxStrLen);
             free(wbuffer());
-            uint16_t oldLen = len();
+            WSTRING_COUNT(frees);
+            unsigned int oldLen = len();
             setSSO(true);
             memcpy(wbuffer(), temp, maxStrLen);
             setLen(oldLen);
@@ -196,9 +209,14 @@ bool String::changeBuffer(unsigned int maxStrLen) {
     if (newSize > CAPACITY_MAX) {
         return false;
     }
-    uint16_t oldLen = len();
+    unsigned int oldLen = len();
     char *newbuffer = (char *) realloc(isSSO() ? nullptr : wbuffer(), newSize);
     if (newbuffer) {
+        if (isSSO() || !buffer()) {
+            WSTRING_COUNT(allocs);
+        } else {
+            WSTRING_COUNT(reallocs);
+        }
         size_t oldSize = capacity() + 1; // include NULL.
         if (isSSO()) {
             // Copy the SSO buffer into allocated space
@@ -216,6 +234,20 @@ bool String::changeBuffer(unsigned int maxStrLen) {
     return false;
 }
 
+// Appending grows the buffer by half its size, so that building a string
+// piece by piece costs O(log n) reallocations instead of one per append.
+bool String::grow(unsigned int size) {
+    if(buffer() && capacity() >= size)
+        return true;
+    unsigned int cap = capacity() + (capacity() >> 1);
+    // changeBuffer() rounds up to 16 bytes, stay below the limit after that
+    if(cap > CAPACITY_MAX - 16)
+        cap = CAPACITY_MAX - 16;
+    if(cap > size && reserve(cap))
+        return true;
+    return reserve(size);
+}
+
 /*********************************************/
 /*  Copy and Move                            */
 /*********************************************/
@@ -306,7 +338,7 @@ bool String::concat(const String &s) {
             return false;
         if (s.len() == 0)
             return true;
-        if (!reserve(newlen))
+        if (!grow(newlen))
             return false;
         memmove(wbuffer() + len(), buffer(), len());
         setLen(newlen);
@@ -323,7 +355,13 @@ bool String::concat(const char *cstr, unsigned int length) {
         return false;
     if(length == 0)
         return true;
-    if(!reserve(newlen))
+    if (cstr >= wbuffer() && cstr < wbuffer() + len()) {
+        // "x += x.c_str()": keep the source valid across the reallocation
+        unsigned int offset = cstr - wbuffer();
+        if(!grow(newlen))
+            return false;
+        cstr = wbuffer() + offset;
+    } else if(!grow(newlen))
         return false;
     if (cstr >= wbuffer() && cstr < wbuffer() + len())
         // compatible with SSO in ram #6155 (case "x += x.c_str()")
@@ -400,6 +438,75 @@ bool String::concat(double num) {
     return concat(string, strlen(string));
 }
 
+/*********************************************/
+/*  join                                     */
+/*********************************************/
+
+String::JoinPart::JoinPart(unsigned char num) : _str(_buf) {
+    utoa(num, _buf, 10);
+    _len = strlen(_buf);
+}
+
+String::JoinPart::JoinPart(int num) : _str(_buf) {
+    itoa(num, _buf, 10);
+    _len = strlen(_buf);
+}
+
+String::JoinPart::JoinPart(unsigned int num) : _str(_buf) {
+    utoa(num, _buf, 10);
+    _len = strlen(_buf);
+}
+
+String::JoinPart::JoinPart(long num) : _str(_buf) {
+    ltoa(num, _buf, 10);
+    _len = strlen(_buf);
+}
+
+String::JoinPart::JoinPart(unsigned long num) : _str(_buf) {
+    ultoa(num, _buf, 10);
+    _len = strlen(_buf);
+}
+
+String::JoinPart::JoinPart(long long num) : _str(_buf) {
+    lltoa(num, _buf, 10);
+    _len = strlen(_buf);
+}
+
+String::JoinPart::JoinPart(unsigned long long num) : _str(_buf) {
+    ulltoa(num, _buf, 10);
+    _len = strlen(_buf);
+}
+
+String::JoinPart::JoinPart(float num) : JoinPart((double) num) {
+}
+
+String::JoinPart::JoinPart(double num) : _str(_buf) {
+    // same format as concat(double), truncated instead of overflowing for huge values
+    int len = snprintf(_buf, sizeof(_buf), "%4.2f", num);
+    _len = (len < 0) ? 0 : ((len >= (int) sizeof(_buf)) ? sizeof(_buf) - 1 : len);
+}
+
+void String::joinParts(const JoinPart *parts, size_t count) {
+    unsigned int total = 0;
+    for(size_t i = 0; i < count; i++) {
+        if(!parts[i].str()) {
+            invalidate();
+            return;
+        }
+        total += parts[i].len();
+    }
+    if(!reserve(total)) {
+        invalidate();
+        return;
+    }
+    char *dst = wbuffer();
+    for(size_t i = 0; i < count; i++) {
+        memcpy_P(dst, parts[i].str(), parts[i].len());
+        dst += parts[i].len();
+    }
+    setLen(total);
+}
+
 /*********************************************/
 /*  Concatenate                              */
 /*********************************************/
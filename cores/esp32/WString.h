@@ -37,6 +37,11 @@ class __FlashStringHelper;
 #define FPSTR(str_pointer) (reinterpret_cast<const __FlashStringHelper *>(str_pointer))
 #define F(string_literal) (FPSTR(PSTR(string_literal)))
 
+// Set to 1 to count heap operations made by String, see String::allocStats()
+#ifndef WSTRING_ALLOC_STATS
+#define WSTRING_ALLOC_STATS 0
+#endif
+
 // An inherited class for holding the result of a concatenation.  These
 // result objects are assumed to be writable by subsequent concatenations.
 class StringSumHelper;
@@ -130,6 +135,18 @@ class String {
         bool concat(unsigned long long num);
         bool concat(const __FlashStringHelper * str) {return concat(reinterpret_cast<const char*>(str));}
 
+        // builds a string out of all arguments with a single allocation, e.g.
+        // String::join("GET ", path, " HTTP/1.1\r\nHost: ", host, "\r\n")
+        // arguments may be Strings, C strings, F() strings, chars and numbers (formatted as with concat())
+        // returns an invalid string if the memory allocation fails
+        template<typename T, typename... Args>
+        static String join(const T &first, const Args &... rest) {
+            const JoinPart parts[] = { JoinPart(first), JoinPart(rest)... };
+            String s;
+            s.joinParts(parts, sizeof(parts) / sizeof(parts[0]));
+            return s;
+        }
+
         // if there's not enough memory for the concatenated value, the string
         // will be left unchanged (but this isn't signalled in any way)
         String & operator +=(const String &rhs) {
@@ -294,7 +311,44 @@ class String {
         float toFloat(void) const;
 	double toDouble(void) const;
 
+#if WSTRING_ALLOC_STATS
+        struct AllocStats {
+            uint32_t allocs;    // new heap buffers
+            uint32_t reallocs;  // heap buffers resized
+            uint32_t frees;     // heap buffers released
+        };
+        static AllocStats & allocStats();
+#endif
+
     protected:
+        // One argument of join(), numbers are formatted in the internal buffer
+        class JoinPart {
+            public:
+                JoinPart(const String &s) : _str(s.buffer()), _len(s.length()) {}
+                JoinPart(const char *cstr) : _str(cstr), _len(cstr ? strlen(cstr) : 0) {}
+                JoinPart(const __FlashStringHelper *pstr) : JoinPart(reinterpret_cast<const char*>(pstr)) {}
+                JoinPart(char c) : _str(_buf), _len(1) { _buf[0] = c; }
+                JoinPart(unsigned char num);
+                JoinPart(int num);
+                JoinPart(unsigned int num);
+                JoinPart(long num);
+                JoinPart(unsigned long num);
+                JoinPart(long long num);
+                JoinPart(unsigned long long num);
+                JoinPart(float num);
+                JoinPart(double num);
+                JoinPart(const JoinPart &other) : _str(other._str == other._buf ? _buf : other._str), _len(other._len) {
+                    memcpy(_buf, other._buf, sizeof(_buf));
+                }
+                const char *str() const { return _str; }
+                unsigned int len() const { return _len; }
+            private:
+                const char *_str;
+                unsigned int _len;
+                char _buf[24];
+        };
+        void joinParts(const JoinPart *parts, size_t count);
+
         // Contains the string info when we're not in SSO mode
         struct _ptr { 
             char *   buff;
@@ -343,6 +397,7 @@ class String {
         void init(void);
         void invalidate(void);
         bool changeBuffer(unsigned int maxStrLen);
+        bool grow(unsigned int size);
 
         // copy and move
         String & copy(const char *cstr, unsigned int length);
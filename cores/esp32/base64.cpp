@@ -23,12 +23,139 @@
  */
 
 #include "Arduino.h"
-extern "C" {
-#include "libb64/cdecode.h"
-#include "libb64/cencode.h"
-}
+#include "StreamString.h"
 #include "base64.h"
 
+static const char _encodeTable[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// value of each character, 0xFF for characters outside the alphabet
+static const uint8_t _decodeTable[256] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x3E, 0xFF, 0xFF, 0xFF, 0x3F,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E,
+    0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32, 0x33, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+#define ENCODE_GROUP(in, out) do { \
+        uint32_t v = ((uint32_t)(in)[0] << 16) | ((in)[1] << 8) | (in)[2]; \
+        (out)[0] = _encodeTable[v >> 18]; \
+        (out)[1] = _encodeTable[(v >> 12) & 0x3F]; \
+        (out)[2] = _encodeTable[(v >> 6) & 0x3F]; \
+        (out)[3] = _encodeTable[v & 0x3F]; \
+    } while(0)
+
+#define DECODE_QUAD(in, v, bad) do { \
+        uint32_t c0 = _decodeTable[(in)[0]], c1 = _decodeTable[(in)[1]]; \
+        uint32_t c2 = _decodeTable[(in)[2]], c3 = _decodeTable[(in)[3]]; \
+        bad |= c0 | c1 | c2 | c3; \
+        v = (c0 << 18) | (c1 << 12) | (c2 << 6) | c3; \
+    } while(0)
+
+#define STORE_QUAD(v, out) do { \
+        (out)[0] = (v) >> 16; \
+        (out)[1] = (v) >> 8; \
+        (out)[2] = (v); \
+    } while(0)
+
+/**
+ * encode whole groups of 3 bytes
+ * @return size_t characters written
+ */
+static size_t encodeGroups(const uint8_t * in, size_t groups, char * out)
+{
+    char * start = out;
+    // 12 bytes in and 16 characters out per iteration
+    for(; groups >= 4; groups -= 4, in += 12, out += 16) {
+        ENCODE_GROUP(in, out);
+        ENCODE_GROUP(in + 3, out + 4);
+        ENCODE_GROUP(in + 6, out + 8);
+        ENCODE_GROUP(in + 9, out + 12);
+    }
+    for(; groups; groups--, in += 3, out += 4) {
+        ENCODE_GROUP(in, out);
+    }
+    return out - start;
+}
+
+/**
+ * decode whole quads of characters, up to the first one outside the alphabet
+ * @param used size_t * characters consumed
+ * @return size_t bytes written
+ */
+static size_t decodeQuads(const char * text, size_t length, uint8_t * out, size_t * used)
+{
+    const uint8_t * in = (const uint8_t *) text;
+    const uint8_t * end = in + length;
+    uint8_t * start = out;
+    uint32_t a, b, c, d, bad;
+    // 16 characters in and 12 bytes out per iteration, invalid characters
+    // have the top bit set in the table so one test covers all of them
+    while(end - in >= 16) {
+        bad = 0;
+        DECODE_QUAD(in, a, bad);
+        DECODE_QUAD(in + 4, b, bad);
+        DECODE_QUAD(in + 8, c, bad);
+        DECODE_QUAD(in + 12, d, bad);
+        if(bad & 0x80) {
+            break;
+        }
+        STORE_QUAD(a, out);
+        STORE_QUAD(b, out + 3);
+        STORE_QUAD(c, out + 6);
+        STORE_QUAD(d, out + 9);
+        in += 16;
+        out += 12;
+    }
+    while(end - in >= 4) {
+        bad = 0;
+        DECODE_QUAD(in, a, bad);
+        if(bad & 0x80) {
+            break;
+        }
+        STORE_QUAD(a, out);
+        in += 4;
+        out += 3;
+    }
+    *used = (const char *) in - text;
+    return out - start;
+}
+
+/**
+ * convert input data to base64
+ * @param data const uint8_t *
+ * @param length size_t
+ * @param out char * encodedLength(length) characters
+ * @return size_t characters written
+ */
+size_t base64::encode(const uint8_t * data, size_t length, char * out)
+{
+    size_t groups = length / 3;
+    size_t len = encodeGroups(data, groups, out);
+    size_t rest = length - groups * 3;
+    if(rest) {
+        uint8_t last[3] = { data[groups * 3], (uint8_t)((rest > 1) ? data[groups * 3 + 1] : 0), 0 };
+        ENCODE_GROUP(last, out + len);
+        out[len + 3] = '=';
+        if(rest == 1) {
+            out[len + 2] = '=';
+        }
+        len += 4;
+    }
+    return len;
+}
+
 /**
  * convert input data to base64
  * @param data const uint8_t *
@@ -37,19 +164,17 @@ extern "C" {
  */
 String base64::encode(const uint8_t * data, size_t length)
 {
-    size_t size = base64_encode_expected_len(length) + 1;
-    char * buffer = (char *) malloc(size);
-    if(buffer) {
-        base64_encodestate _state;
-        base64_init_encodestate(&_state);
-        int len = base64_encode_block((const char *) &data[0], length, &buffer[0], &_state);
-        len = base64_encode_blockend((buffer + len), &_state);
-
-        String base64 = String(buffer);
-        free(buffer);
-        return base64;
+    StreamString base64;
+    if(!base64.reserve(encodedLength(length))) {
+        return String("-FAIL-");
     }
-    return String("-FAIL-");
+    Base64Encoder encoder(base64);
+    encoder.write(data, length);
+    if(!encoder.end()) {
+        return String("-FAIL-");
+    }
+    // hand the buffer over, returning the StreamString as a String would copy it
+    return static_cast<String &&>(base64);
 }
 
 /**
@@ -62,3 +187,264 @@ String base64::encode(const String& text)
     return base64::encode((uint8_t *) text.c_str(), text.length());
 }
 
+/**
+ * convert base64 to data
+ * @param data const char *
+ * @param length size_t
+ * @param out uint8_t * decodedLength(length) bytes
+ * @return int bytes written or -1 if data is not base64
+ */
+int base64::decode(const char * data, size_t length, uint8_t * out)
+{
+    size_t used;
+    size_t len = decodeQuads(data, length, out, &used);
+    const uint8_t * rest = (const uint8_t *) data + used;
+    size_t restLength = length - used;
+    if(!restLength) {
+        return len;
+    }
+
+    // the last quad: two or three characters, then padding or the end
+    if(restLength > 4) {
+        return -1;
+    }
+    size_t chars = 0;
+    while(chars < restLength && !(_decodeTable[rest[chars]] & 0x80)) {
+        chars++;
+    }
+    for(size_t i = chars; i < restLength; i++) {
+        if(rest[i] != '=') {
+            return -1;
+        }
+    }
+    if(chars < 2 || (chars < restLength && restLength != 4)) {
+        return -1;
+    }
+    uint32_t v = (_decodeTable[rest[0]] << 18) | (_decodeTable[rest[1]] << 12);
+    if(chars > 2) {
+        v |= _decodeTable[rest[2]] << 6;
+    }
+    out[len++] = v >> 16;
+    if(chars > 2) {
+        out[len++] = v >> 8;
+    }
+    return len;
+}
+
+/**
+ * convert base64 to data
+ * @param text const String&
+ * @return String empty if text is not base64
+ */
+String base64::decode(const String& text)
+{
+    StreamString data;
+    if(!data.reserve(decodedLength(text.length()))) {
+        return String();
+    }
+    int len = decode(text.c_str(), text.length(), (uint8_t *) data.writeBuffer(decodedLength(text.length())));
+    if(len < 0) {
+        return String();
+    }
+    data.writeCommit(len);
+    return static_cast<String &&>(data);
+}
+
+/**
+ * Base64Encoder
+ */
+
+Base64Encoder::Base64Encoder(Print &out)
+    : _out(out)
+    , _pendingLen(0)
+{
+}
+
+bool Base64Encoder::_emit(const char *text, size_t length)
+{
+    if(_out.write((const uint8_t *) text, length) != length) {
+        setWriteError();
+        return false;
+    }
+    return true;
+}
+
+size_t Base64Encoder::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t Base64Encoder::write(const uint8_t *buffer, size_t size)
+{
+    if(getWriteError()) {
+        return 0;
+    }
+    size_t left = size;
+
+    // complete the group left over by the last write
+    while(_pendingLen && left) {
+        _pending[_pendingLen++] = *buffer++;
+        left--;
+        if(_pendingLen == 3) {
+            char text[4];
+            ENCODE_GROUP(_pending, text);
+            _pendingLen = 0;
+            if(!_emit(text, 4)) {
+                return 0;
+            }
+        }
+    }
+
+    // whole groups go straight into the output when it has a buffer
+    size_t groups = left / 3;
+    char * dst = groups ? _out.writeBuffer(groups * 4) : NULL;
+    if(dst) {
+        encodeGroups(buffer, groups, dst);
+        _out.writeCommit(groups * 4);
+    } else {
+        char text[BASE64_STREAM_BUFFER_SIZE];
+        size_t chunk = sizeof(text) / 4;
+        for(size_t done = 0; done < groups; done += chunk) {
+            size_t n = (groups - done < chunk) ? groups - done : chunk;
+            encodeGroups(buffer + done * 3, n, text);
+            if(!_emit(text, n * 4)) {
+                return 0;
+            }
+        }
+    }
+    buffer += groups * 3;
+    left -= groups * 3;
+
+    if(left) {
+        memcpy(_pending, buffer, left);
+        _pendingLen = left;
+    }
+    return size;
+}
+
+bool Base64Encoder::end()
+{
+    if(_pendingLen) {
+        char text[4];
+        base64::encode(_pending, _pendingLen, text);
+        _pendingLen = 0;
+        if(!getWriteError()) {
+            _emit(text, 4);
+        }
+    }
+    return !getWriteError();
+}
+
+/**
+ * Base64Decoder
+ */
+
+Base64Decoder::Base64Decoder(Print &out)
+    : _out(out)
+    , _quadLen(0)
+    , _padded(false)
+    , _padLeft(0)
+{
+}
+
+bool Base64Decoder::_emit(const uint8_t *data, size_t length)
+{
+    if(_out.write(data, length) != length) {
+        setWriteError();
+        return false;
+    }
+    return true;
+}
+
+size_t Base64Decoder::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t Base64Decoder::write(const uint8_t *buffer, size_t size)
+{
+    if(getWriteError()) {
+        return 0;
+    }
+    const char * text = (const char *) buffer;
+    size_t left = size;
+
+    while(left) {
+        // whole quads go through the fast path, straight into the output when it has a buffer
+        size_t quads = left / 4;
+        if(!_quadLen && !_padded && quads) {
+            size_t used;
+            uint8_t * dst = (uint8_t *) _out.writeBuffer(quads * 3);
+            if(dst) {
+                _out.writeCommit(decodeQuads(text, quads * 4, dst, &used));
+            } else {
+                uint8_t data[BASE64_STREAM_BUFFER_SIZE / 4 * 3];
+                size_t chars = (quads * 4 < BASE64_STREAM_BUFFER_SIZE) ? quads * 4 : BASE64_STREAM_BUFFER_SIZE;
+                size_t len = decodeQuads(text, chars, data, &used);
+                if(len && !_emit(data, len)) {
+                    return 0;
+                }
+            }
+            text += used;
+            left -= used;
+            if(used) {
+                continue;
+            }
+        }
+
+        // the rest one character at a time: line breaks, padding and split quads
+        uint8_t c = *text++;
+        left--;
+        if(c == '\r' || c == '\n' || c == ' ' || c == '\t') {
+            continue;
+        }
+        if(c == '=') {
+            if(_quadLen >= 2) {
+                // a quad of n characters is padded with 4 - n, this is the first
+                _padLeft = 3 - _quadLen;
+                _padded = true;
+            } else if(!_quadLen && _padLeft) {
+                _padLeft--;
+                continue;
+            } else {
+                setWriteError();
+                return 0;
+            }
+        } else if(_padded || (_decodeTable[c] & 0x80)) {
+            setWriteError();
+            return 0;
+        } else {
+            _quad[_quadLen++] = _decodeTable[c];
+            if(_quadLen < 4) {
+                continue;
+            }
+        }
+        if(_quadLen) {
+            uint8_t data[3];
+            uint32_t v = (_quad[0] << 18) | (_quad[1] << 12) | (_quad[2] << 6) | _quad[3];
+            STORE_QUAD(v, data);
+            size_t len = _quadLen - 1;
+            _quadLen = 0;
+            if(!_emit(data, len)) {
+                return 0;
+            }
+        }
+    }
+    return size;
+}
+
+bool Base64Decoder::end()
+{
+    if(_quadLen == 1 || _padLeft) {
+        setWriteError();
+    } else if(_quadLen && !getWriteError()) {
+        uint8_t data[3];
+        uint32_t v = (_quad[0] << 18) | (_quad[1] << 12) | (_quad[2] << 6);
+        STORE_QUAD(v, data);
+        _emit(data, _quadLen - 1);
+    }
+    _quadLen = 0;
+    _padded = false;
+    _padLeft = 0;
+    return !getWriteError();
+}
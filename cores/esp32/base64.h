@@ -1,13 +1,98 @@
 #ifndef CORE_BASE64_H_
 #define CORE_BASE64_H_
 
+#include <stdint.h>
+#include <stddef.h>
+#include "Print.h"
+#include "WString.h"
+
+// characters encoded or bytes decoded on the stack per call to the output
+#ifndef BASE64_STREAM_BUFFER_SIZE
+#define BASE64_STREAM_BUFFER_SIZE 192
+#endif
+
 class base64
 {
 public:
     static String encode(const uint8_t * data, size_t length);
     static String encode(const String& text);
+
+    static size_t encodedLength(size_t length)
+    {
+        return (length + 2) / 3 * 4;
+    }
+
+    // writes encodedLength(length) characters to out, without a terminating zero
+    static size_t encode(const uint8_t * data, size_t length, char * out);
+
+    // upper bound of the decoded size of length characters
+    static size_t decodedLength(size_t length)
+    {
+        return (length + 3) / 4 * 3;
+    }
+
+    // returns the number of bytes written to out, or -1 if data is not base64
+    // padding is optional, whitespace is not allowed
+    static int decode(const char * data, size_t length, uint8_t * out);
+    static String decode(const String& text);
+
 private:
 };
 
+/*
+  Encodes everything written to it and writes the text to out as it goes,
+  so nothing has to be held in memory in either form. Call end() after the
+  last byte to write the padding.
+
+    Base64Encoder encoder(client);
+    encoder.write(fb->buf, fb->len);
+    encoder.end();
+*/
+class Base64Encoder : public Print
+{
+public:
+    Base64Encoder(Print &out);
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+
+    // writes the last group and padding, returns false if out refused data
+    bool end();
+
+private:
+    bool _emit(const char *text, size_t length);
+
+    Print &_out;
+    uint8_t _pending[3];
+    uint8_t _pendingLen;
+};
+
+/*
+  Decodes base64 text written to it and writes the bytes to out as it goes.
+  Line breaks and spaces are skipped, anything else outside the alphabet
+  sets the write error. Call end() after the last character.
+*/
+class Base64Decoder : public Print
+{
+public:
+    Base64Decoder(Print &out);
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+
+    // writes the last partial group, returns false if the text was not valid base64
+    bool end();
+
+private:
+    bool _emit(const uint8_t *data, size_t length);
+
+    Print &_out;
+    uint8_t _quad[4];
+    uint8_t _quadLen;
+    bool _padded;
+    uint8_t _padLeft;   // padding characters still allowed
+};
 
 #endif /* CORE_BASE64_H_ */
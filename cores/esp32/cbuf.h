@@ -25,6 +25,7 @@
 #include <stdint.h>
 #include <string.h>
 
+// Not safe to share between an ISR or task and another task, use SpscRing for that
 class cbuf
 {
 public:
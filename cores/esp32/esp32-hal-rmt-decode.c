@@ -0,0 +1,291 @@
+// Copyright 2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+#include "esp32-hal-rmt-decode.h"
+
+/**
+ * Internal macros
+ */
+
+#define NEC_LEADER_MARK_US      9000
+#define NEC_LEADER_SPACE_US     4500
+#define NEC_REPEAT_SPACE_US     2250
+#define NEC_BIT_MARK_US         560
+#define NEC_ZERO_SPACE_US       560
+#define NEC_ONE_SPACE_US        1690
+#define NEC_DATA_BITS           32
+
+#define RC5_HALF_BIT_US         889
+#define RC5_BITS                14
+
+#define DHT_BITS                40
+#define DHT_THRESHOLD_US        48
+
+#define ONEWIRE_THRESHOLD_US    15
+
+/**
+ * Internal types and helpers
+ */
+
+// acceptance window in ticks, precomputed once per decode call
+typedef struct {
+    uint32_t min;
+    uint32_t max;
+} rmt_window_t;
+
+static inline uint32_t _rmtUsToTicks(uint32_t us, float tick_ns)
+{
+    return (uint32_t)((float)us * 1000.0f / tick_ns);
+}
+
+// +/- 25% tolerance, enough for cheap IR receivers and RC oscillators in sensors
+static inline rmt_window_t _rmtWindow(uint32_t us, float tick_ns)
+{
+    uint32_t ticks = _rmtUsToTicks(us, tick_ns);
+    rmt_window_t w = { ticks - ticks / 4, ticks + ticks / 4 };
+    return w;
+}
+
+static inline bool _rmtInWindow(uint32_t ticks, rmt_window_t w)
+{
+    return ticks >= w.min && ticks <= w.max;
+}
+
+/**
+ * Public method definitions
+ */
+
+size_t rmtDecodePulseWidth(const rmt_data_t *data, size_t len, float tick_ns, bool level, uint32_t threshold_us, uint8_t *out, size_t max_bits)
+{
+    if (!data || !out || tick_ns <= 0) {
+        return 0;
+    }
+    uint32_t threshold = _rmtUsToTicks(threshold_us, tick_ns);
+    size_t bits = 0;
+
+    for (size_t i = 0; i < len && bits < max_bits; i++) {
+        uint32_t durations[2] = { data[i].duration0, data[i].duration1 };
+        bool levels[2] = { data[i].level0, data[i].level1 };
+        for (int h = 0; h < 2 && bits < max_bits; h++) {
+            if (durations[h] == 0) {
+                // end marker
+                return bits;
+            }
+            if (levels[h] != level) {
+                continue;
+            }
+            if ((bits & 7) == 0) {
+                out[bits >> 3] = 0;
+            }
+            if (durations[h] > threshold) {
+                out[bits >> 3] |= 1 << (bits & 7);
+            }
+            bits++;
+        }
+    }
+    return bits;
+}
+
+bool rmtDecodeNEC(const rmt_data_t *data, size_t len, float tick_ns, rmt_nec_frame_t *frame)
+{
+    if (!data || !frame || len < 2 || tick_ns <= 0) {
+        return false;
+    }
+    rmt_window_t leader_mark = _rmtWindow(NEC_LEADER_MARK_US, tick_ns);
+    rmt_window_t leader_space = _rmtWindow(NEC_LEADER_SPACE_US, tick_ns);
+    rmt_window_t repeat_space = _rmtWindow(NEC_REPEAT_SPACE_US, tick_ns);
+    rmt_window_t bit_mark = _rmtWindow(NEC_BIT_MARK_US, tick_ns);
+    rmt_window_t zero_space = _rmtWindow(NEC_ZERO_SPACE_US, tick_ns);
+    rmt_window_t one_space = _rmtWindow(NEC_ONE_SPACE_US, tick_ns);
+
+    // duration0 is always the mark: reception starts on the first active edge
+    if (!_rmtInWindow(data[0].duration0, leader_mark)) {
+        return false;
+    }
+    if (_rmtInWindow(data[0].duration1, repeat_space)) {
+        if (!_rmtInWindow(data[1].duration0, bit_mark)) {
+            return false;
+        }
+        frame->repeat = true;
+        return true;
+    }
+    if (!_rmtInWindow(data[0].duration1, leader_space) || len < NEC_DATA_BITS + 2) {
+        return false;
+    }
+
+    uint32_t code = 0;
+    for (int i = 0; i < NEC_DATA_BITS; i++) {
+        const rmt_data_t *item = &data[i + 1];
+        if (!_rmtInWindow(item->duration0, bit_mark)) {
+            return false;
+        }
+        if (_rmtInWindow(item->duration1, one_space)) {
+            code |= 1UL << i;
+        } else if (!_rmtInWindow(item->duration1, zero_space)) {
+            return false;
+        }
+    }
+    uint8_t command = (code >> 16) & 0xFF;
+    uint8_t command_inv = (code >> 24) & 0xFF;
+    if ((uint8_t)(command ^ command_inv) != 0xFF) {
+        return false;
+    }
+    frame->address = code & 0xFF;
+    frame->address_inv = (code >> 8) & 0xFF;
+    frame->command = command;
+    frame->repeat = false;
+    return true;
+}
+
+bool rmtDecodeRC5(const rmt_data_t *data, size_t len, float tick_ns, rmt_rc5_frame_t *frame)
+{
+    if (!data || !frame || len == 0 || tick_ns <= 0) {
+        return false;
+    }
+    uint32_t half = _rmtUsToTicks(RC5_HALF_BIT_US, tick_ns);
+    uint32_t one_min = half / 2, one_max = half + half / 2, two_max = 2 * half + half / 2;
+    bool mark_level = data[0].level0;
+
+    // Manchester half-bit stream (1 = mark); the idle space before the first start bit is implied
+    uint32_t halves = 0;
+    uint32_t count = 1;
+    bool done = false;
+
+    for (size_t i = 0; i < len && !done; i++) {
+        uint32_t durations[2] = { data[i].duration0, data[i].duration1 };
+        bool levels[2] = { data[i].level0, data[i].level1 };
+        for (int h = 0; h < 2; h++) {
+            bool mark = levels[h] == mark_level;
+            uint32_t n;
+            if (durations[h] == 0 || (!mark && durations[h] >= two_max)) {
+                // end marker or trailing idle
+                done = true;
+                break;
+            }
+            if (durations[h] < one_min || durations[h] >= two_max) {
+                return false;
+            }
+            n = (durations[h] < one_max) ? 1 : 2;
+            while (n--) {
+                if (count >= 2 * RC5_BITS) {
+                    return false;
+                }
+                if (mark) {
+                    halves |= 1UL << count;
+                }
+                count++;
+            }
+        }
+    }
+    // a final 0 bit ends in a space which merges with idle
+    if (count == 2 * RC5_BITS - 1) {
+        count++;
+    }
+    if (count != 2 * RC5_BITS) {
+        return false;
+    }
+
+    uint16_t bits = 0;
+    for (int b = 0; b < RC5_BITS; b++) {
+        uint32_t pair = (halves >> (2 * b)) & 0x3;
+        bits <<= 1;
+        if (pair == 0x2) {          // space then mark
+            bits |= 1;
+        } else if (pair != 0x1) {   // anything but mark then space
+            return false;
+        }
+    }
+    if (!(bits & (1 << 13))) {      // first start bit is always 1
+        return false;
+    }
+    frame->toggle = (bits >> 11) & 0x1;
+    frame->address = (bits >> 6) & 0x1F;
+    frame->command = (bits & 0x3F) | ((~bits >> 6) & 0x40);
+    return true;
+}
+
+bool rmtDecodeDHT(const rmt_data_t *data, size_t len, float tick_ns, rmt_dht_frame_t *frame)
+{
+    if (!data || !frame || tick_ns <= 0) {
+        return false;
+    }
+    uint32_t threshold = _rmtUsToTicks(DHT_THRESHOLD_US, tick_ns);
+    size_t pulses = 0;
+
+    // the data bits are the last 40 high pulses, whatever part of the start handshake got captured
+    for (size_t i = 0; i < len; i++) {
+        if (data[i].level0 && data[i].duration0) {
+            pulses++;
+        }
+        if (data[i].level1 && data[i].duration1) {
+            pulses++;
+        }
+    }
+    if (pulses < DHT_BITS) {
+        return false;
+    }
+    size_t skip = pulses - DHT_BITS;
+    size_t bit = 0;
+
+    memset(frame->data, 0, sizeof(frame->data));
+    for (size_t i = 0; i < len && bit < DHT_BITS; i++) {
+        uint32_t durations[2] = { data[i].duration0, data[i].duration1 };
+        bool levels[2] = { data[i].level0, data[i].level1 };
+        for (int h = 0; h < 2 && bit < DHT_BITS; h++) {
+            if (!levels[h] || !durations[h]) {
+                continue;
+            }
+            if (skip) {
+                skip--;
+                continue;
+            }
+            if (durations[h] > threshold) {
+                frame->data[bit >> 3] |= 0x80 >> (bit & 7);
+            }
+            bit++;
+        }
+    }
+    uint8_t sum = frame->data[0] + frame->data[1] + frame->data[2] + frame->data[3];
+    return sum == frame->data[4];
+}
+
+size_t rmtDecodeOneWire(const rmt_data_t *data, size_t len, float tick_ns, uint8_t *out, size_t max_bits)
+{
+    size_t bits = rmtDecodePulseWidth(data, len, tick_ns, false, ONEWIRE_THRESHOLD_US, out, max_bits);
+    for (size_t i = 0; i < (bits + 7) / 8; i++) {
+        out[i] = ~out[i];
+    }
+    if (bits & 7) {
+        out[bits >> 3] &= (1 << (bits & 7)) - 1;
+    }
+    return bits;
+}
+
+rmt_protocol_t rmtDecode(const rmt_data_t *data, size_t len, float tick_ns, uint32_t protocols, rmt_frame_t *frame)
+{
+    if (!frame) {
+        return RMT_PROTO_NONE;
+    }
+    if ((protocols & RMT_PROTO_NEC) && rmtDecodeNEC(data, len, tick_ns, &frame->nec)) {
+        frame->protocol = RMT_PROTO_NEC;
+    } else if ((protocols & RMT_PROTO_RC5) && rmtDecodeRC5(data, len, tick_ns, &frame->rc5)) {
+        frame->protocol = RMT_PROTO_RC5;
+    } else if ((protocols & RMT_PROTO_DHT) && rmtDecodeDHT(data, len, tick_ns, &frame->dht)) {
+        frame->protocol = RMT_PROTO_DHT;
+    } else {
+        frame->protocol = RMT_PROTO_NONE;
+    }
+    return frame->protocol;
+}
@@ -0,0 +1,101 @@
+// Copyright 2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MAIN_ESP32_HAL_RMT_DECODE_H_
+#define MAIN_ESP32_HAL_RMT_DECODE_H_
+
+// Pulse protocol decoders working directly on received RMT items.
+// Only plain C and the rmt_data_t layout are used, so the decoders
+// can also be built and fed with recorded captures on a host.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp32-hal-rmt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    RMT_PROTO_NONE = 0,
+    RMT_PROTO_NEC  = (1 << 0),
+    RMT_PROTO_RC5  = (1 << 1),
+    RMT_PROTO_DHT  = (1 << 2),
+    RMT_PROTO_ALL  = (RMT_PROTO_NEC | RMT_PROTO_RC5 | RMT_PROTO_DHT),
+} rmt_protocol_t;
+
+typedef struct {
+    uint8_t address;
+    uint8_t address_inv;    // inverted address, or high byte of the extended NEC address
+    uint8_t command;
+    bool repeat;            // repeat code, address and command are left untouched
+} rmt_nec_frame_t;
+
+typedef struct {
+    uint8_t address;        // 5 bits
+    uint8_t command;        // 7 bits (RC5X field bit included)
+    bool toggle;
+} rmt_rc5_frame_t;
+
+typedef struct {
+    uint8_t data[5];        // humidity hi/lo, temperature hi/lo, checksum
+} rmt_dht_frame_t;
+
+typedef struct {
+    rmt_protocol_t protocol;
+    union {
+        rmt_nec_frame_t nec;
+        rmt_rc5_frame_t rc5;
+        rmt_dht_frame_t dht;
+    };
+} rmt_frame_t;
+
+/**
+*    Decodes pulse-width encoded bits: every pulse at 'level' longer than threshold_us is a 1, shorter a 0.
+*    Bits are stored LSB first into out[]. Returns the number of bits decoded (at most max_bits)
+*/
+size_t rmtDecodePulseWidth(const rmt_data_t *data, size_t len, float tick_ns, bool level, uint32_t threshold_us, uint8_t *out, size_t max_bits);
+
+/**
+*    Decodes a NEC (or extended NEC) frame or repeat code. The first captured level is taken as the mark
+*    so both active-low and active-high IR receivers work. tick_ns is the value returned by rmtSetTick()
+*/
+bool rmtDecodeNEC(const rmt_data_t *data, size_t len, float tick_ns, rmt_nec_frame_t *frame);
+
+/**
+*    Decodes a Philips RC5 Manchester frame
+*/
+bool rmtDecodeRC5(const rmt_data_t *data, size_t len, float tick_ns, rmt_rc5_frame_t *frame);
+
+/**
+*    Decodes the 40 data bits of a DHT11/DHT22 response and validates the checksum
+*/
+bool rmtDecodeDHT(const rmt_data_t *data, size_t len, float tick_ns, rmt_dht_frame_t *frame);
+
+/**
+*    Decodes 1-Wire read slots (short low pulse is a 1). Returns the number of bits decoded
+*/
+size_t rmtDecodeOneWire(const rmt_data_t *data, size_t len, float tick_ns, uint8_t *out, size_t max_bits);
+
+/**
+*    Tries the decoders selected in 'protocols' in turn and fills 'frame' with the first match
+*/
+rmt_protocol_t rmtDecode(const rmt_data_t *data, size_t len, float tick_ns, uint32_t protocols, rmt_frame_t *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_ESP32_HAL_RMT_DECODE_H_ */
@@ -97,6 +97,7 @@ struct rmt_obj_s
     TaskHandle_t rxTaskHandle;  
     bool rx_completed;
     bool tx_not_rx;
+    rmt_rx_slice_cb_t slice_cb;
 };
 
 /**
@@ -110,15 +111,15 @@ static xSemaphoreHandle g_rmt_objlocks[MAX_CHANNELS] = {
 };
 
 static rmt_obj_t g_rmt_objects[MAX_CHANNELS] = {
-    { false, NULL, 0, 0, 0, NULL, NULL, NULL, NULL, true, true},
-    { false, NULL, 0, 0, 0, NULL, NULL, NULL, NULL, true, true},
-    { false, NULL, 0, 0, 0, NULL, NULL, NULL, NULL, true, true},
-    { false, NULL, 0, 0, 0, NULL, NULL, NULL, NULL, true, true},
+    { false, NULL, 0, 0, 0, NULL, NULL, NULL, NULL, true, true, NULL},
+    { false, NULL, 0, 0, 0, NULL, NULL, NULL, NULL, true, true, NULL},
+    { false, NULL, 0, 0, 0, NULL, NULL, NULL, NULL, true, true, NULL},
+    { false, NULL, 0, 0, 0, NULL, NULL, NULL, NULL, true, true, NULL},
 #if MAX_CHANNELS > 4
-    { false, NULL, 0, 0, 0, NULL, NULL, NULL, NULL, true, true},
-    { false, NULL, 0, 0, 0, NULL, NULL, NULL, NULL, true, true},
-    { false, NULL, 0, 0, 0, NULL, NULL, NULL, NULL, true, true},
-    { false, NULL, 0, 0, 0, NULL, NULL, NULL, NULL, true, true},
+    { false, NULL, 0, 0, 0, NULL, NULL, NULL, NULL, true, true, NULL},
+    { false, NULL, 0, 0, 0, NULL, NULL, NULL, NULL, true, true, NULL},
+    { false, NULL, 0, 0, 0, NULL, NULL, NULL, NULL, true, true, NULL},
+    { false, NULL, 0, 0, 0, NULL, NULL, NULL, NULL, true, true, NULL},
 #endif
 };
 
@@ -199,8 +200,18 @@ static void _rmtRxTask(void *args) {
     for(;;) {
         data = (rmt_item32_t *) xRingbufferReceive(rb, &rmt_len, portMAX_DELAY);
         if (data) {
-            log_d(" -- Got %d bytes on RX Ringbuffer - CH %d", rmt_len, rmt->channel);
+            log_v(" -- Got %d bytes on RX Ringbuffer - CH %d", rmt_len, rmt->channel);
             rmt->rx_completed = true;  // used in rmtReceiveCompleted()
+            // zero-copy callback -- the consumer may keep the slice and return it later with rmtReleaseSlice()
+            if (rmt->slice_cb) {
+                if (!(rmt->slice_cb)((const rmt_data_t *)data, rmt_len / sizeof(rmt_item32_t), rmt->arg)) {
+                    vRingbufferReturnItem(rb, (void *) data);
+                }
+                if (rmt->events) {
+                    xEventGroupSetBits(rmt->events, RMT_FLAG_RX_DONE);
+                }
+                continue;
+            }
             // callback
             if (rmt->cb) {
                 (rmt->cb)((uint32_t *)data, rmt_len / sizeof(rmt_item32_t), rmt->arg);
@@ -210,13 +221,8 @@ static void _rmtRxTask(void *args) {
             }
             // Async Read -- copy data to caller
             if (rmt->data_ptr && rmt->data_size) {
-                uint32_t data_size = rmt->data_size;
                 uint32_t read_len = rmt_len / sizeof(rmt_item32_t);
-                if (read_len < rmt->data_size) data_size = read_len;
-                rmt_item32_t *p = (rmt_item32_t *)rmt->data_ptr;
-                for (uint32_t i = 0; i < data_size; i++) {
-                    p[i] = data[i];
-                }
+                memcpy(rmt->data_ptr, data, _LIMIT(read_len, rmt->data_size) * sizeof(rmt_item32_t));
             }
             // set events
             if (rmt->events) {
@@ -447,11 +453,13 @@ bool rmtRead(rmt_obj_t* rmt, rmt_rx_data_cb_t cb, void * arg)
 
     rmt->arg = arg;
     rmt->cb = cb;
+    rmt->slice_cb = NULL;
 
     RMT_MUTEX_LOCK(channel);
     // cb as NULL is a way to cancel the callback process
     if (cb == NULL) {        
         rmt_rx_stop(channel);
+        RMT_MUTEX_UNLOCK(channel);
         return true;
     }
     // Start a read process but now with a call back function
@@ -463,6 +471,71 @@ bool rmtRead(rmt_obj_t* rmt, rmt_rx_data_cb_t cb, void * arg)
     return true;
 }
 
+bool rmtReadSlices(rmt_obj_t* rmt, rmt_rx_slice_cb_t cb, void * arg)
+{
+    if (!_rmtCheckTXnotRX(rmt, RMT_RX_MODE)) {
+        return false;
+    }
+    int channel = rmt->channel;
+
+    RMT_MUTEX_LOCK(channel);
+    rmt->arg = arg;
+    rmt->cb = NULL;
+    rmt->slice_cb = cb;
+    // cb as NULL is a way to cancel the callback process
+    if (cb == NULL) {
+        rmt_rx_stop(channel);
+        RMT_MUTEX_UNLOCK(channel);
+        return true;
+    }
+    rmt_set_memory_owner(channel, RMT_MEM_OWNER_RX);
+    rmt_rx_start(channel, true);
+    rmt->rx_completed = false;
+    _rmtCreateRxTask(rmt);
+    RMT_MUTEX_UNLOCK(channel);
+    return true;
+}
+
+const rmt_data_t* rmtReceiveSlice(rmt_obj_t* rmt, size_t* len, uint32_t timeout_ms)
+{
+    RingbufHandle_t rb = NULL;
+    size_t rmt_len = 0;
+
+    if (!_rmtCheckTXnotRX(rmt, RMT_RX_MODE) || !len) {
+        return NULL;
+    }
+    *len = 0;
+    if (rmt->rxTaskHandle) {
+        log_e("RMT channel %d is already consumed by rmtRead()/rmtReadAsync()", rmt->channel);
+        return NULL;
+    }
+    rmt_get_ringbuf_handle(rmt->channel, &rb);
+    if (!rb) {
+        return NULL;
+    }
+    rmt_data_t* data = (rmt_data_t *) xRingbufferReceive(rb, &rmt_len, (timeout_ms == portMAX_DELAY) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms));
+    if (data) {
+        rmt->rx_completed = true;
+        *len = rmt_len / sizeof(rmt_data_t);
+    }
+    return data;
+}
+
+bool rmtReleaseSlice(rmt_obj_t* rmt, const rmt_data_t* data)
+{
+    RingbufHandle_t rb = NULL;
+
+    if (!_rmtCheckTXnotRX(rmt, RMT_RX_MODE) || !data) {
+        return false;
+    }
+    rmt_get_ringbuf_handle(rmt->channel, &rb);
+    if (!rb) {
+        return false;
+    }
+    vRingbufferReturnItem(rb, (void *) data);
+    return true;
+}
+
 bool rmtEnd(rmt_obj_t* rmt) 
 {
     if (!rmt) {
@@ -590,6 +663,7 @@ rmt_obj_t* rmtInit(int pin, bool tx_not_rx, rmt_reserve_memsize_t memsize)
     rmt->channel = channel;
     rmt->arg = NULL;
     rmt->cb = NULL;
+    rmt->slice_cb = NULL;
     rmt->data_ptr = NULL;
     rmt->data_size = 0;
     rmt->rx_completed = false;
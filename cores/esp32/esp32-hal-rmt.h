@@ -57,6 +57,13 @@ typedef struct {
     };
 } rmt_data_t;
 
+/**
+*    Zero-copy receive callback, called with a slice of the RX ring buffer.
+*    Return true to keep the slice (it must then be handed back with rmtReleaseSlice()),
+*    or false to let the driver return it as soon as the callback ends.
+*/
+typedef bool (*rmt_rx_slice_cb_t)(const rmt_data_t *data, size_t len, void *arg);
+
 
 /**
 *    Prints object information
@@ -109,6 +116,26 @@ bool rmtReadAsync(rmt_obj_t* rmt, rmt_data_t* data, size_t size, void* eventFlag
 */
 bool rmtRead(rmt_obj_t* rmt, rmt_rx_data_cb_t cb, void * arg);
 
+/**
+*    Initiates async receive with zero-copy callback
+*    the callback gets the RMT ring buffer slice directly
+*
+*/
+bool rmtReadSlices(rmt_obj_t* rmt, rmt_rx_slice_cb_t cb, void * arg);
+
+/**
+*    Waits up to timeout_ms for a received frame and returns the ring buffer slice
+*    (len in items), or NULL on timeout. The slice must be returned with rmtReleaseSlice().
+*    Use after rmtBeginReceive(); not to be mixed with rmtRead()/rmtReadAsync() on the same channel
+*/
+const rmt_data_t* rmtReceiveSlice(rmt_obj_t* rmt, size_t* len, uint32_t timeout_ms);
+
+/**
+*    Returns a slice obtained from rmtReceiveSlice() or kept by a rmt_rx_slice_cb_t
+*
+*/
+bool rmtReleaseSlice(rmt_obj_t* rmt, const rmt_data_t* data);
+
 /***
  * Ends async receive started with rmtRead(); but does not
  * rmtDeInit().
@@ -31,6 +31,10 @@
 
 static int s_uart_debug_nr = 0;               // UART number for debug output
 
+#ifndef UART_PATTERN_QUEUE_LEN
+#define UART_PATTERN_QUEUE_LEN 20             // pattern positions kept by the IDF driver
+#endif
+
 struct uart_struct_t {
 
 #if !CONFIG_DISABLE_HAL_LOCKS
@@ -515,6 +519,25 @@ bool uartSetRxFIFOFull(uart_t* uart, uint8_t numBytesFIFOFull)
 }
 
 
+bool uartSetPatternDetect(uart_t* uart, char pattern, uint8_t count)
+{
+    if(uart == NULL) {
+        return false;
+    }
+
+    UART_MUTEX_LOCK();
+    bool retCode;
+    if (count == 0) {
+        retCode = (ESP_OK == uart_disable_pattern_det_intr(uart->num));
+    } else {
+        // no idle gap is required before or after the pattern, so delimiters inside a continuous stream are detected
+        retCode = (ESP_OK == uart_enable_pattern_det_baud_intr(uart->num, pattern, count, 9, 0, 0));
+        if (retCode) retCode = (ESP_OK == uart_pattern_queue_reset(uart->num, UART_PATTERN_QUEUE_LEN));
+    }
+    UART_MUTEX_UNLOCK();
+    return retCode;
+}
+
 void uartEnd(uint8_t uart_num)
 {
     if(uart_num >= SOC_UART_NUM) {
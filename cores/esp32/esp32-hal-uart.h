@@ -54,6 +54,8 @@ uint32_t uartGetBaudRate(uart_t* uart);
 void uartSetRxInvert(uart_t* uart, bool invert);
 bool uartSetRxTimeout(uart_t* uart, uint8_t numSymbTimeout);
 bool uartSetRxFIFOFull(uart_t* uart, uint8_t numBytesFIFOFull);
+// Enables UART_PATTERN_DET events when 'count' consecutive 'pattern' characters are received. count = 0 disables it
+bool uartSetPatternDetect(uart_t* uart, char pattern, uint8_t count);
 void uartSetFastReading(uart_t* uart);
 
 void uartSetDebug(uart_t* uart);
@@ -0,0 +1,527 @@
+// Copyright 2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp32-hal.h"
+#include "esp32-hal-workqueue.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+/**
+ * Internal types and state
+ */
+
+enum {
+    WORK_STATE_IDLE,
+    WORK_STATE_QUEUED,
+    WORK_STATE_RUNNING,
+    WORK_STATE_RERUN
+};
+
+enum {
+    WORK_QUEUE_STOPPED,
+    WORK_QUEUE_STARTING,
+    WORK_QUEUE_RUNNING
+};
+
+typedef struct {
+    work_item_t * head;
+    work_item_t * tail;
+} work_lane_t;
+
+struct work_worker_s {
+    work_lane_t lane;
+    SemaphoreHandle_t pending;  // counts queued items
+};
+
+static const UBaseType_t s_lane_priority[WORK_PRIORITY_MAX] = {
+    WORK_QUEUE_PRIORITY_LOW,
+    WORK_QUEUE_PRIORITY_NORMAL,
+    WORK_QUEUE_PRIORITY_HIGH
+};
+
+// everything below is guarded by s_lock, which works from tasks and ISRs
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static work_lane_t s_lanes[WORK_PRIORITY_MAX];
+static work_item_t s_pool_items[WORK_QUEUE_POOL_SIZE];
+static work_item_t * s_pool = NULL;        // free preallocated items
+static work_item_t * s_pool_grown = NULL;  // free items taken from the heap
+static bool s_pool_ready = false;
+static volatile uint8_t s_state = WORK_QUEUE_STOPPED;
+static SemaphoreHandle_t s_pending = NULL;   // counts queued items
+static work_queue_stats_t s_stats;
+
+#define WORK_LOCK()     portENTER_CRITICAL_SAFE(&s_lock)
+#define WORK_UNLOCK()   portEXIT_CRITICAL_SAFE(&s_lock)
+
+/**
+ * Item pool, called with the lock held
+ */
+
+static void poolInit(void)
+{
+    for (size_t i = 0; i < WORK_QUEUE_POOL_SIZE; i++) {
+        s_pool_items[i].pooled = 1;
+        s_pool_items[i].next = (i + 1 < WORK_QUEUE_POOL_SIZE) ? &s_pool_items[i + 1] : NULL;
+    }
+    s_pool = &s_pool_items[0];
+    s_stats.pool_size = WORK_QUEUE_POOL_SIZE;
+    s_stats.pool_free = WORK_QUEUE_POOL_SIZE;
+    s_pool_ready = true;
+}
+
+static work_item_t ** poolList(const work_item_t * item)
+{
+    bool preallocated = item >= s_pool_items && item < s_pool_items + WORK_QUEUE_POOL_SIZE;
+    return preallocated ? &s_pool : &s_pool_grown;
+}
+
+static work_item_t * poolTake(void)
+{
+    work_item_t ** list = s_pool ? &s_pool : &s_pool_grown;
+    work_item_t * item = *list;
+    if (item) {
+        *list = item->next;
+        item->next = NULL;
+        s_stats.pool_free--;
+    }
+    return item;
+}
+
+static void poolGive(work_item_t * item)
+{
+    work_item_t ** list = poolList(item);
+    item->next = *list;
+    item->state = WORK_STATE_IDLE;
+    *list = item;
+    s_stats.pool_free++;
+}
+
+// Returns an item to the pool. Never more than the preallocated number are
+// kept free, so once every item is back the grown ones have all been freed,
+// whatever order they came back in.
+static void poolRelease(work_item_t * item)
+{
+    work_item_t * spare = NULL;
+    WORK_LOCK();
+    poolGive(item);
+    if (s_stats.pool_free > WORK_QUEUE_POOL_SIZE && s_pool_grown) {
+        spare = s_pool_grown;
+        s_pool_grown = spare->next;
+        s_stats.pool_free--;
+        s_stats.pool_size--;
+    }
+    WORK_UNLOCK();
+    free(spare);
+}
+
+// Takes a pooled item, growing the pool from the heap when not in an ISR
+static work_item_t * poolAlloc(void)
+{
+    WORK_LOCK();
+    work_item_t * item = poolTake();
+    WORK_UNLOCK();
+    if (item || xPortInIsrContext()) {
+        return item;
+    }
+    item = (work_item_t *)calloc(1, sizeof(work_item_t));
+    if (item) {
+        item->pooled = 1;
+        WORK_LOCK();
+        s_stats.pool_size++;
+        WORK_UNLOCK();
+    }
+    return item;
+}
+
+/**
+ * Lanes, called with the lock held
+ */
+
+static void laneAppend(work_item_t * item)
+{
+    work_lane_t * lane = item->worker ? &item->worker->lane : &s_lanes[item->priority];
+    item->next = NULL;
+    item->state = WORK_STATE_QUEUED;
+    if (lane->tail) {
+        lane->tail->next = item;
+    } else {
+        lane->head = item;
+    }
+    lane->tail = item;
+    s_stats.posted++;
+}
+
+static work_item_t * laneTake(work_lane_t * lane)
+{
+    work_item_t * item = lane->head;
+    if (item) {
+        lane->head = item->next;
+        if (!lane->head) {
+            lane->tail = NULL;
+        }
+        item->next = NULL;
+        item->state = WORK_STATE_RUNNING;
+    }
+    return item;
+}
+
+static work_item_t * laneTakeShared(void)
+{
+    for (int p = WORK_PRIORITY_MAX - 1; p >= 0; p--) {
+        work_item_t * item = laneTake(&s_lanes[p]);
+        if (item) {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+static void signalPending(const work_item_t * item)
+{
+    SemaphoreHandle_t pending = item->worker ? item->worker->pending : s_pending;
+    if (xPortInIsrContext()) {
+        BaseType_t woken = pdFALSE;
+        xSemaphoreGiveFromISR(pending, &woken);
+        if (woken) {
+            portYIELD_FROM_ISR();
+        }
+    } else {
+        xSemaphoreGive(pending);
+    }
+}
+
+/**
+ * Workers
+ */
+
+static void workRun(work_item_t * item)
+{
+    item->fn(item->arg);
+
+    bool rerun = false;
+    WORK_LOCK();
+    s_stats.executed++;
+    if (item->pooled) {
+        // released below, outside the lock
+    } else if (item->state == WORK_STATE_RERUN) {
+        laneAppend(item);
+        rerun = true;
+    } else {
+        item->state = WORK_STATE_IDLE;
+    }
+    WORK_UNLOCK();
+    if (item->pooled) {
+        poolRelease(item);
+    } else if (rerun) {
+        signalPending(item);
+    }
+}
+
+static void workQueueTask(void * arg)
+{
+    (void)arg;
+    UBaseType_t priority = WORK_QUEUE_PRIORITY_HIGH;
+    for (;;) {
+        xSemaphoreTake(s_pending, portMAX_DELAY);
+        // run until the lanes are empty: once the semaphore is at its
+        // maximum, one wake up stands for more than one item
+        for (;;) {
+            WORK_LOCK();
+            work_item_t * item = laneTakeShared();
+            WORK_UNLOCK();
+            if (!item) {
+                break;
+            }
+
+            // run at the priority of the lane, wait for work at the highest one
+            UBaseType_t lane_priority = s_lane_priority[item->priority];
+            if (lane_priority != priority) {
+                vTaskPrioritySet(NULL, lane_priority);
+                priority = lane_priority;
+            }
+            workRun(item);
+        }
+        if (priority != WORK_QUEUE_PRIORITY_HIGH) {
+            vTaskPrioritySet(NULL, WORK_QUEUE_PRIORITY_HIGH);
+            priority = WORK_QUEUE_PRIORITY_HIGH;
+        }
+    }
+}
+
+bool workQueueBegin(void)
+{
+    if (s_state == WORK_QUEUE_RUNNING) {
+        return true;
+    }
+    if (xPortInIsrContext()) {
+        return false;
+    }
+
+    WORK_LOCK();
+    uint8_t state = s_state;
+    if (state == WORK_QUEUE_STOPPED) {
+        s_state = WORK_QUEUE_STARTING;
+        if (!s_pool_ready) {
+            poolInit();
+        }
+    }
+    WORK_UNLOCK();
+    if (state != WORK_QUEUE_STOPPED) {
+        // another task is starting the workers
+        while (s_state == WORK_QUEUE_STARTING) {
+            vTaskDelay(1);
+        }
+        return s_state == WORK_QUEUE_RUNNING;
+    }
+
+    if (!s_pending) {
+        s_pending = xSemaphoreCreateCounting(0x7FFF, 0);
+    }
+    if (!s_pending) {
+        log_e("Work queue semaphore create failed");
+        s_state = WORK_QUEUE_STOPPED;
+        return false;
+    }
+
+    uint8_t workers = 0;
+    int cores = WORK_QUEUE_ALL_CORES ? portNUM_PROCESSORS : 1;
+    for (int c = 0; c < cores; c++) {
+        int core = WORK_QUEUE_ALL_CORES ? ((portNUM_PROCESSORS > 1) ? c : -1) : WORK_QUEUE_RUNNING_CORE;
+        for (int i = 0; i < WORK_QUEUE_WORKERS_PER_CORE; i++) {
+            TaskHandle_t handle = NULL;
+            xTaskCreateUniversal(workQueueTask, "arduino_work", WORK_QUEUE_STACK_SIZE, NULL, WORK_QUEUE_PRIORITY_HIGH, &handle, core);
+            if (handle) {
+                workers++;
+            }
+        }
+    }
+    if (!workers) {
+        log_e("Work queue task create failed");
+        s_state = WORK_QUEUE_STOPPED;
+        return false;
+    }
+    s_stats.workers = workers;
+    s_state = WORK_QUEUE_RUNNING;
+    return true;
+}
+
+// Runs what is bound to one worker, in order and at the priority it was created with
+static void workWorkerTask(void * arg)
+{
+    work_worker_t * worker = (work_worker_t *)arg;
+    for (;;) {
+        xSemaphoreTake(worker->pending, portMAX_DELAY);
+        for (;;) {
+            WORK_LOCK();
+            work_item_t * item = laneTake(&worker->lane);
+            WORK_UNLOCK();
+            if (!item) {
+                break;
+            }
+            workRun(item);
+        }
+    }
+}
+
+work_worker_t * workWorkerCreate(const char * name, uint32_t stack_size, uint32_t priority, int core)
+{
+    if (xPortInIsrContext()) {
+        return NULL;
+    }
+    work_worker_t * worker = (work_worker_t *)calloc(1, sizeof(work_worker_t));
+    if (!worker) {
+        log_e("Work queue worker alloc failed");
+        return NULL;
+    }
+    worker->pending = xSemaphoreCreateCounting(0x7FFF, 0);
+    if (!worker->pending) {
+        log_e("Work queue semaphore create failed");
+        free(worker);
+        return NULL;
+    }
+    // strands bound to the worker take their items from the pool
+    WORK_LOCK();
+    if (!s_pool_ready) {
+        poolInit();
+    }
+    WORK_UNLOCK();
+
+    TaskHandle_t handle = NULL;
+    xTaskCreateUniversal(workWorkerTask, name, stack_size, worker, priority, &handle, core);
+    if (!handle) {
+        log_e("Work queue task create failed");
+        vSemaphoreDelete(worker->pending);
+        free(worker);
+        return NULL;
+    }
+    WORK_LOCK();
+    s_stats.own_workers++;
+    WORK_UNLOCK();
+    return worker;
+}
+
+// Work may be queued before the workers run, as long as the semaphore exists.
+// Own workers are running from the moment they are created.
+static bool workQueueReady(const work_worker_t * worker)
+{
+    if (worker || s_state == WORK_QUEUE_RUNNING || workQueueBegin()) {
+        return true;
+    }
+    WORK_LOCK();
+    s_stats.failed++;
+    WORK_UNLOCK();
+    return false;
+}
+
+void workItemInit(work_item_t * item, work_fn_t fn, void * arg, work_priority_t priority)
+{
+    memset(item, 0, sizeof(work_item_t));
+    item->fn = fn;
+    item->arg = arg;
+    item->priority = (priority < WORK_PRIORITY_MAX) ? priority : WORK_PRIORITY_NORMAL;
+}
+
+void workItemBind(work_item_t * item, work_worker_t * worker)
+{
+    item->worker = worker;
+}
+
+bool workQueueSubmit(work_item_t * item)
+{
+    if (!item || !item->fn || !workQueueReady(item->worker)) {
+        return false;
+    }
+    bool queued = false;
+    WORK_LOCK();
+    if (item->state == WORK_STATE_IDLE) {
+        laneAppend(item);
+        queued = true;
+    } else if (item->state == WORK_STATE_RUNNING) {
+        item->state = WORK_STATE_RERUN;
+    }
+    WORK_UNLOCK();
+    if (queued) {
+        signalPending(item);
+    }
+    return true;
+}
+
+bool workItemPending(const work_item_t * item)
+{
+    return item->state != WORK_STATE_IDLE;
+}
+
+bool workQueuePost(work_fn_t fn, void * arg, work_priority_t priority)
+{
+    if (!fn || !workQueueReady(NULL)) {
+        return false;
+    }
+    work_item_t * item = poolAlloc();
+    if (!item) {
+        WORK_LOCK();
+        s_stats.failed++;
+        WORK_UNLOCK();
+        return false;
+    }
+    item->fn = fn;
+    item->arg = arg;
+    item->worker = NULL;
+    item->priority = (priority < WORK_PRIORITY_MAX) ? priority : WORK_PRIORITY_NORMAL;
+    WORK_LOCK();
+    laneAppend(item);
+    WORK_UNLOCK();
+    signalPending(item);
+    return true;
+}
+
+/**
+ * Strands
+ */
+
+// Runs the oldest work of the strand, the strand item is queued again while more is left
+static void strandRun(void * arg)
+{
+    work_strand_t * strand = (work_strand_t *)arg;
+    WORK_LOCK();
+    work_item_t * item = strand->head;
+    if (item) {
+        strand->head = item->next;
+        if (!strand->head) {
+            strand->tail = NULL;
+        }
+    }
+    WORK_UNLOCK();
+    if (!item) {
+        return;
+    }
+
+    item->fn(item->arg);
+
+    poolRelease(item);
+    WORK_LOCK();
+    bool more = strand->head != NULL;
+    WORK_UNLOCK();
+    if (more) {
+        workQueueSubmit(&strand->item);
+    }
+}
+
+void workStrandInit(work_strand_t * strand, work_priority_t priority)
+{
+    workItemInit(&strand->item, strandRun, strand, priority);
+    strand->head = NULL;
+    strand->tail = NULL;
+}
+
+void workStrandBind(work_strand_t * strand, work_worker_t * worker)
+{
+    workItemBind(&strand->item, worker);
+}
+
+bool workStrandPost(work_strand_t * strand, work_fn_t fn, void * arg)
+{
+    if (!fn || !workQueueReady(strand->item.worker)) {
+        return false;
+    }
+    work_item_t * item = poolAlloc();
+    if (!item) {
+        WORK_LOCK();
+        s_stats.failed++;
+        WORK_UNLOCK();
+        return false;
+    }
+    item->fn = fn;
+    item->arg = arg;
+    item->state = WORK_STATE_QUEUED;
+    WORK_LOCK();
+    item->next = NULL;
+    if (strand->tail) {
+        strand->tail->next = item;
+    } else {
+        strand->head = item;
+    }
+    strand->tail = item;
+    WORK_UNLOCK();
+    return workQueueSubmit(&strand->item);
+}
+
+void workQueueGetStats(work_queue_stats_t * stats)
+{
+    WORK_LOCK();
+    memcpy(stats, &s_stats, sizeof(work_queue_stats_t));
+    WORK_UNLOCK();
+}
@@ -0,0 +1,183 @@
+// Copyright 2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MAIN_ESP32_HAL_WORKQUEUE_H_
+#define MAIN_ESP32_HAL_WORKQUEUE_H_
+
+// Shared work queue for deferred callbacks. Libraries post work here instead
+// of owning a task each: the workers take items from priority lanes, highest
+// lane first, and run each at the task priority of its lane. By default a
+// single worker runs on the core Arduino events are set to run on, and
+// carries the events (high lane) and AsyncUDP (normal lane).
+// Only FreeRTOS semaphores, tasks and critical sections are used, so the
+// queue can also be built on a host against a small FreeRTOS shim.
+//
+// Work on the shared workers must not block: everything queued behind a
+// blocked item waits with it. Work that may block, or that has to run on a
+// given core or at a given task priority, goes to a worker of its own
+// (workWorkerCreate).
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef WORK_QUEUE_WORKERS_PER_CORE
+#define WORK_QUEUE_WORKERS_PER_CORE 1
+#endif
+
+// core the shared workers run on, -1 for any core
+#ifndef WORK_QUEUE_RUNNING_CORE
+#ifdef ARDUINO_EVENT_RUNNING_CORE
+#define WORK_QUEUE_RUNNING_CORE ARDUINO_EVENT_RUNNING_CORE
+#else
+#define WORK_QUEUE_RUNNING_CORE -1
+#endif
+#endif
+
+// 1 starts WORK_QUEUE_WORKERS_PER_CORE workers on every core instead
+#ifndef WORK_QUEUE_ALL_CORES
+#define WORK_QUEUE_ALL_CORES 0
+#endif
+
+#ifndef WORK_QUEUE_STACK_SIZE
+#define WORK_QUEUE_STACK_SIZE 4096
+#endif
+
+// items allocated up front, more are taken from the heap when posting from a task
+#ifndef WORK_QUEUE_POOL_SIZE
+#define WORK_QUEUE_POOL_SIZE 16
+#endif
+
+// task priority work of each lane runs at
+#ifndef WORK_QUEUE_PRIORITY_LOW
+#define WORK_QUEUE_PRIORITY_LOW 1
+#endif
+#ifndef WORK_QUEUE_PRIORITY_NORMAL
+#define WORK_QUEUE_PRIORITY_NORMAL 3
+#endif
+#ifndef WORK_QUEUE_PRIORITY_HIGH
+#define WORK_QUEUE_PRIORITY_HIGH 19     // ESP_TASKD_EVENT_PRIO - 1, like the old event tasks
+#endif
+
+typedef void (*work_fn_t)(void * arg);
+
+typedef struct work_worker_s work_worker_t;
+
+typedef enum {
+    WORK_PRIORITY_LOW,
+    WORK_PRIORITY_NORMAL,
+    WORK_PRIORITY_HIGH,
+    WORK_PRIORITY_MAX
+} work_priority_t;
+
+/**
+ * A unit of work. Items owned by the caller are submitted again and again
+ * without allocating: submitting one that is pending does nothing and
+ * submitting one that is running makes it run once more afterwards, so an
+ * item never runs on two workers at the same time. It must stay valid
+ * until it has run.
+ */
+typedef struct work_item_s {
+    struct work_item_s * next;
+    work_fn_t fn;
+    void * arg;
+    work_worker_t * worker;     // NULL for the shared workers
+    uint8_t priority;
+    volatile uint8_t state;
+    uint8_t pooled;
+} work_item_t;
+
+#define WORK_ITEM_INIT(fn, arg, priority) { NULL, (fn), (arg), NULL, (priority), 0, 0 }
+
+/**
+ * Runs the work posted to it one at a time and in order, on whichever
+ * worker is free. Use it for callbacks that must not overlap or reorder.
+ */
+typedef struct {
+    work_item_t item;
+    work_item_t * head;
+    work_item_t * tail;
+} work_strand_t;
+
+typedef struct {
+    uint32_t posted;        // items queued, including re-runs
+    uint32_t executed;      // items run to completion
+    uint32_t failed;        // posts refused: queue not started or pool empty in an ISR
+    uint16_t pool_size;     // items owned by the pool
+    uint16_t pool_free;     // of those, not in use
+    uint8_t workers;        // shared workers
+    uint8_t own_workers;    // workers created with workWorkerCreate
+} work_queue_stats_t;
+
+/**
+ * Starts the workers. Called on first use from a task, call it from setup()
+ * when work will first be posted from an interrupt.
+ */
+bool workQueueBegin(void);
+
+/**
+ * Runs fn(arg) on a worker. Takes an item from the pool, safe from ISRs.
+ */
+bool workQueuePost(work_fn_t fn, void * arg, work_priority_t priority);
+
+void workItemInit(work_item_t * item, work_fn_t fn, void * arg, work_priority_t priority);
+
+/**
+ * Creates a worker task that runs only the items and strands bound to it,
+ * in the order they were queued, pinned to core (-1 for any core) and at
+ * the given task priority. Its work neither waits behind nor holds up the
+ * shared workers. Workers are never deleted.
+ */
+work_worker_t * workWorkerCreate(const char * name, uint32_t stack_size, uint32_t priority, int core);
+
+/**
+ * Makes the item run on worker, or on the shared workers when worker is NULL.
+ * Call it only while the item is not pending.
+ */
+void workItemBind(work_item_t * item, work_worker_t * worker);
+
+/**
+ * Queues an item owned by the caller, safe from ISRs.
+ * Returns false only when the queue is not running.
+ */
+bool workQueueSubmit(work_item_t * item);
+
+/**
+ * True while the item is queued or running.
+ */
+bool workItemPending(const work_item_t * item);
+
+void workStrandInit(work_strand_t * strand, work_priority_t priority);
+
+/**
+ * Runs the strand on worker instead of the shared workers, before the first post.
+ */
+void workStrandBind(work_strand_t * strand, work_worker_t * worker);
+
+/**
+ * Runs fn(arg) on the strand after everything posted to it before.
+ */
+bool workStrandPost(work_strand_t * strand, work_fn_t fn, void * arg);
+
+void workQueueGetStats(work_queue_stats_t * stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_ESP32_HAL_WORKQUEUE_H_ */
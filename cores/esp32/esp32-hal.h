@@ -88,12 +88,14 @@ void yield(void);
 #include "esp32-hal-i2c.h"
 #include "esp32-hal-ledc.h"
 #include "esp32-hal-rmt.h"
+#include "esp32-hal-rmt-decode.h"
 #include "esp32-hal-sigmadelta.h"
 #include "esp32-hal-timer.h"
 #include "esp32-hal-bt.h"
 #include "esp32-hal-psram.h"
 #include "esp32-hal-rgb-led.h"
 #include "esp32-hal-cpu.h"
+#include "esp32-hal-workqueue.h"
 
 void analogWrite(uint8_t pin, int value);
 int8_t analogGetChannel(uint8_t pin);
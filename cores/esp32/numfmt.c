@@ -0,0 +1,452 @@
+/*
+ numfmt.c - fast number to text conversion used by Print and String
+ Copyright (c) 2022 Espressif Systems (Shanghai) Co., Ltd.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ The shortest representation follows Florian Loitsch, "Printing
+ Floating-Point Numbers Quickly and Accurately with Integers" (Grisu2).
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include "numfmt.h"
+
+static const char _digitPairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const uint64_t _pow10[20] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+    100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+    10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+// writes value backwards, ending just before 'end', returns the first character
+static char *_u32Backwards(char *end, uint32_t value)
+{
+    while (value >= 100) {
+        uint32_t q = value / 100;
+        end -= 2;
+        memcpy(end, &_digitPairs[(value - q * 100) * 2], 2);
+        value = q;
+    }
+    if (value >= 10) {
+        end -= 2;
+        memcpy(end, &_digitPairs[value * 2], 2);
+    } else {
+        *--end = '0' + value;
+    }
+    return end;
+}
+
+static size_t _copyOut(char *buf, const char *start, const char *end)
+{
+    size_t len = end - start;
+    memmove(buf, start, len);
+    buf[len] = 0;
+    return len;
+}
+
+size_t numfmt_u32(char *buf, uint32_t value)
+{
+    char tmp[NUMFMT_U32_SIZE];
+    char *end = tmp + sizeof(tmp);
+    return _copyOut(buf, _u32Backwards(end, value), end);
+}
+
+size_t numfmt_u64(char *buf, uint64_t value)
+{
+    char tmp[NUMFMT_U64_SIZE];
+    char *end = tmp + sizeof(tmp);
+    char *p = end;
+
+    // peel off 8 digits at a time so the rest runs on 32 bit divisions
+    while (value > UINT32_MAX) {
+        uint64_t q = value / 100000000;
+        uint32_t low = (uint32_t)(value - q * 100000000);
+        for (int i = 0; i < 4; i++) {
+            uint32_t pq = low / 100;
+            p -= 2;
+            memcpy(p, &_digitPairs[(low - pq * 100) * 2], 2);
+            low = pq;
+        }
+        value = q;
+    }
+    p = _u32Backwards(p, (uint32_t)value);
+    return _copyOut(buf, p, end);
+}
+
+size_t numfmt_base(char *buf, uint64_t value, uint8_t base)
+{
+    char tmp[NUMFMT_BASE_SIZE];
+    char *end = tmp + sizeof(tmp);
+    char *p = end;
+
+    if (base < 2) {
+        base = 10;
+    }
+    if (base == 10) {
+        return numfmt_u64(buf, value);
+    }
+    if ((base & (base - 1)) == 0) {
+        // powers of two only need shifts
+        int shift = __builtin_ctz(base);
+        do {
+            uint8_t d = value & (base - 1);
+            *--p = d < 10 ? '0' + d : 'A' + d - 10;
+            value >>= shift;
+        } while (value);
+    } else {
+        do {
+            uint64_t q = value / base;
+            uint8_t d = value - q * base;
+            *--p = d < 10 ? '0' + d : 'A' + d - 10;
+            value = q;
+        } while (value);
+    }
+    return _copyOut(buf, p, end);
+}
+
+size_t numfmt_fixed(char *buf, double value, uint8_t digits)
+{
+    char *p = buf;
+
+    if (value != value) {
+        return _copyOut(buf, "nan", "nan" + 3);
+    }
+    if (value > 1.7976931348623157e308 || value < -1.7976931348623157e308) {
+        return _copyOut(buf, "inf", "inf" + 3);
+    }
+    if (value > 4294967040.0 || value < -4294967040.0) {
+        return _copyOut(buf, "ovf", "ovf" + 3);    // constant determined empirically
+    }
+    if (value < 0.0) {
+        *p++ = '-';
+        value = -value;
+    }
+
+    // round so that 1.999 with 2 digits prints as "2.00"
+    double rounding = 0.5;
+    for (uint8_t i = 0; i < digits; ++i) {
+        rounding /= 10.0;
+    }
+    value += rounding;
+
+    uint32_t int_part = (uint32_t)value;
+    double remainder = value - (double)int_part;
+    p += numfmt_u32(p, int_part);
+
+    if (digits > 0) {
+        *p++ = '.';
+    }
+    while (digits-- > 0) {
+        remainder *= 10.0;
+        int d = (int)remainder;
+        *p++ = '0' + d;
+        remainder -= d;
+    }
+    *p = 0;
+    return p - buf;
+}
+
+/*
+ * Grisu2
+ */
+
+typedef struct {
+    uint64_t f;
+    int e;
+} diy_fp_t;
+
+// normalized 10^k for k = -348, -340, ..., 340
+static const uint64_t _cachedPowersF[87] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+    0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+    0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+    0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+    0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+    0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+    0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+    0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+    0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+    0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+    0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+    0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+    0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+    0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+    0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+    0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+    0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+    0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+    0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+    0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+    0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+    0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+
+static const int16_t _cachedPowersE[87] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+    -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+    -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+    -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+    56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+    694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+    1013, 1039, 1066
+};
+
+static diy_fp_t _fpMul(diy_fp_t x, diy_fp_t y)
+{
+    const uint64_t M32 = 0xFFFFFFFFULL;
+    uint64_t a = x.f >> 32, b = x.f & M32, c = y.f >> 32, d = y.f & M32;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t tmp = (bd >> 32) + (ad & M32) + (bc & M32);
+    tmp += 1ULL << 31;  // round
+    diy_fp_t r = { ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64 };
+    return r;
+}
+
+static diy_fp_t _fpNormalize(diy_fp_t v)
+{
+    int s = __builtin_clzll(v.f);
+    v.f <<= s;
+    v.e -= s;
+    return v;
+}
+
+// picks the cached power that brings the exponent of a value with binary exponent e into [-60, -32]
+static diy_fp_t _cachedPower(int e, int *K)
+{
+    double dk = (-61 - e) * 0.30102999566398114 + 347;
+    int k = (int)dk;
+    if (dk - k > 0.0) {
+        k++;
+    }
+    unsigned index = (unsigned)((k >> 3) + 1);
+    *K = -(-348 + (int)(index << 3));
+    diy_fp_t r = { _cachedPowersF[index], _cachedPowersE[index] };
+    return r;
+}
+
+static void _grisuRound(char *digits, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w)
+{
+    while (rest < wp_w && delta - rest >= ten_kappa &&
+           (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+        digits[len - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+static void _digitGen(diy_fp_t w, diy_fp_t mp, uint64_t delta, char *digits, int *len, int *K)
+{
+    const diy_fp_t one = { 1ULL << -mp.e, mp.e };
+    const uint64_t wp_w = mp.f - w.f;
+    uint32_t p1 = (uint32_t)(mp.f >> -one.e);
+    uint64_t p2 = mp.f & (one.f - 1);
+    int kappa = 1;
+
+    while (kappa < 10 && p1 >= _pow10[kappa]) {
+        kappa++;
+    }
+    *len = 0;
+
+    while (kappa > 0) {
+        uint32_t div = (uint32_t)_pow10[kappa - 1];
+        uint32_t d = p1 / div;
+        p1 -= d * div;
+        if (d || *len) {
+            digits[(*len)++] = '0' + d;
+        }
+        kappa--;
+        uint64_t tmp = ((uint64_t)p1 << -one.e) + p2;
+        if (tmp <= delta) {
+            *K += kappa;
+            _grisuRound(digits, *len, delta, tmp, _pow10[kappa] << -one.e, wp_w);
+            return;
+        }
+    }
+    for (;;) {
+        p2 *= 10;
+        delta *= 10;
+        char d = (char)(p2 >> -one.e);
+        if (d || *len) {
+            digits[(*len)++] = '0' + d;
+        }
+        p2 &= one.f - 1;
+        kappa--;
+        if (p2 < delta) {
+            *K += kappa;
+            int index = -kappa;
+            _grisuRound(digits, *len, delta, p2, one.f, wp_w * (index < 20 ? _pow10[index] : 0));
+            return;
+        }
+    }
+}
+
+// v is the unnormalized significand with its hidden bit, which makes the lower neighbour closer
+static void _grisu2(diy_fp_t v, uint64_t hidden, char *digits, int *len, int *K)
+{
+    diy_fp_t plus = { (v.f << 1) + 1, v.e - 1 };
+    diy_fp_t minus;
+
+    plus = _fpNormalize(plus);
+    if (v.f == hidden) {
+        minus.f = (v.f << 2) - 1;
+        minus.e = v.e - 2;
+    } else {
+        minus.f = (v.f << 1) - 1;
+        minus.e = v.e - 1;
+    }
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+
+    diy_fp_t c = _cachedPower(plus.e, K);
+    diy_fp_t w = _fpMul(_fpNormalize(v), c);
+    diy_fp_t wp = _fpMul(plus, c);
+    diy_fp_t wm = _fpMul(minus, c);
+    wm.f++;
+    wp.f--;
+    _digitGen(w, wp, wp.f - wm.f, digits, len, K);
+}
+
+static size_t _writeExponent(char *p, int e)
+{
+    char *start = p;
+    *p++ = 'e';
+    if (e < 0) {
+        *p++ = '-';
+        e = -e;
+    }
+    p += numfmt_u32(p, e);
+    return p - start;
+}
+
+// lays out len digits with the value digits * 10^k, buf holds the digits on entry
+static size_t _prettify(char *buf, int len, int k)
+{
+    const int kk = len + k;     // 10^(kk-1) <= value < 10^kk
+
+    if (k >= 0 && kk <= 21) {
+        // 1234e7 -> 12340000000
+        memset(buf + len, '0', k);
+        buf[kk] = 0;
+        return kk;
+    }
+    if (kk > 0 && kk <= 21) {
+        // 1234e-2 -> 12.34
+        memmove(buf + kk + 1, buf + kk, len - kk);
+        buf[kk] = '.';
+        buf[len + 1] = 0;
+        return len + 1;
+    }
+    if (kk > -6 && kk <= 0) {
+        // 1234e-6 -> 0.001234
+        int offset = 2 - kk;
+        memmove(buf + offset, buf, len);
+        buf[0] = '0';
+        buf[1] = '.';
+        memset(buf + 2, '0', offset - 2);
+        buf[len + offset] = 0;
+        return len + offset;
+    }
+    if (len == 1) {
+        // 1e30
+        return 1 + _writeExponent(buf + 1, kk - 1);
+    }
+    // 1234e30 -> 1.234e33
+    memmove(buf + 2, buf + 1, len - 1);
+    buf[1] = '.';
+    return len + 1 + _writeExponent(buf + len + 1, kk - 1);
+}
+
+static size_t _shortest(char *buf, bool negative, bool special, diy_fp_t v, uint64_t hidden)
+{
+    char *p = buf;
+    int len, K;
+
+    if (special) {
+        // exponent all ones: NaN carries a significand
+        if (v.f != hidden) {
+            return _copyOut(buf, "nan", "nan" + 3);
+        }
+        if (negative) {
+            *p++ = '-';
+        }
+        return (p - buf) + _copyOut(p, "inf", "inf" + 3);
+    }
+    if (negative) {
+        *p++ = '-';
+    }
+    if (v.f == 0) {
+        *p++ = '0';
+        *p = 0;
+        return p - buf;
+    }
+    _grisu2(v, hidden, p, &len, &K);
+    return (p - buf) + _prettify(p, len, K);
+}
+
+size_t numfmt_shortest(char *buf, double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    const uint64_t hidden = 1ULL << 52;
+    int biased = (bits >> 52) & 0x7FF;
+    diy_fp_t v;
+    v.f = bits & (hidden - 1);
+    if (biased) {
+        v.f += hidden;
+        v.e = biased - 0x3FF - 52;
+    } else {
+        v.e = 1 - 0x3FF - 52;
+    }
+    return _shortest(buf, bits >> 63, biased == 0x7FF, v, hidden);
+}
+
+size_t numfmt_shortest_f(char *buf, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    const uint64_t hidden = 1ULL << 23;
+    int biased = (bits >> 23) & 0xFF;
+    diy_fp_t v;
+    v.f = bits & (hidden - 1);
+    if (biased) {
+        v.f += hidden;
+        v.e = biased - 0x7F - 23;
+    } else {
+        v.e = 1 - 0x7F - 23;
+    }
+    return _shortest(buf, bits >> 31, biased == 0xFF, v, hidden);
+}
@@ -0,0 +1,60 @@
+/*
+ numfmt.h - fast number to text conversion used by Print and String
+ Copyright (c) 2022 Espressif Systems (Shanghai) Co., Ltd.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef NUMFMT_H
+#define NUMFMT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Buffer sizes, including the terminating zero
+#define NUMFMT_U32_SIZE         11      // "4294967295"
+#define NUMFMT_U64_SIZE         21      // "18446744073709551615"
+#define NUMFMT_BASE_SIZE        65      // 64 bit value in base 2
+#define NUMFMT_SHORTEST_SIZE    32      // "-1.2345678901234567e-308"
+#define NUMFMT_FIXED_SIZE(digits) (13 + (digits))   // "-4294967040." + digits
+
+// Every function writes a zero terminated string and returns its length.
+
+// unsigned decimal, two digits per step
+size_t numfmt_u32(char *buf, uint32_t value);
+size_t numfmt_u64(char *buf, uint64_t value);
+
+// unsigned in any base from 2 to 36, upper case letters. Bases below 2 print in base 10.
+size_t numfmt_base(char *buf, uint64_t value, uint8_t base);
+
+// fixed number of decimals, same output as Print::print(double, digits):
+// "nan", "inf" and "ovf" beyond +/-4294967040
+size_t numfmt_fixed(char *buf, double value, uint8_t digits);
+
+// shortest digits that read back as the same value (Grisu2).
+// Plain notation between 1e-6 and 1e21, exponent notation outside ("1.5e-7").
+size_t numfmt_shortest(char *buf, double value);
+// same for single precision, so 0.1f prints as "0.1"
+size_t numfmt_shortest_f(char *buf, float value);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* NUMFMT_H */
@@ -7,6 +7,7 @@
 #include "ESPmDNS.h"
 #include "MD5Builder.h"
 #include "Update.h"
+#include "lwip/sockets.h"
 
 
 // #define OTA_DEBUG Serial
@@ -21,6 +22,11 @@ ArduinoOTAClass::ArduinoOTAClass()
 , _cmd(0)
 , _ota_port(0)
 , _ota_timeout(1000)
+, _proto(1)
+, _resume_offset(0)
+, _received(0)
+, _resumable(false)
+, _suspended_at(0)
 , _start_callback(NULL)
 , _end_callback(NULL)
 , _error_callback(NULL)
@@ -170,21 +176,51 @@ String ArduinoOTAClass::readStringUntil(char end){
     return res;
 }
 
+void ArduinoOTAClass::_sendOK(){
+    _udp_ota.beginPacket(_udp_ota.remoteIP(), _udp_ota.remotePort());
+    if (_proto >= 2) {
+        _udp_ota.printf("OK %d %u %u", _proto, _resume_offset, OTA_WINDOW_SIZE);
+    } else {
+        _udp_ota.print("OK");
+    }
+    _udp_ota.endPacket();
+    _ota_ip = _udp_ota.remoteIP();
+    _state = OTA_RUNUPDATE;
+}
+
 void ArduinoOTAClass::_onRx(){
     if (_state == OTA_IDLE) {
         int cmd = parseInt();
         if (cmd != U_FLASH && cmd != U_SPIFFS)
             return;
-        _cmd  = cmd;
-        _ota_port = parseInt();
-        _size = parseInt();
+        int ota_port = parseInt();
+        int size = parseInt();
         _udp_ota.read();
-        _md5 = readStringUntil('\n');
-        _md5.trim();
-        if(_md5.length() != 32){
+        String md5 = readStringUntil('\n');
+        md5.trim();
+        if(md5.length() != 32){
             log_e("bad md5 length");
             return;
         }
+        // newer senders ask for a protocol on a second line, older firmware never reads it
+        int proto = 1;
+        if (_udp_ota.peek() == 'P') {
+            String ext = readStringUntil('\n');
+            if (ext.startsWith("PROTO ")) {
+                proto = ext.substring(6).toInt();
+            }
+        }
+        _proto = (proto >= OTA_PROTOCOL_VERSION) ? OTA_PROTOCOL_VERSION : 1;
+
+        // the same image again picks up where the interrupted transfer stopped
+        _resume_offset = 0;
+        if (_resumable && _proto >= 2 && (size_t)size == Update.size() && md5.equals(_resume_md5)) {
+            _resume_offset = _received;
+        }
+        _cmd = cmd;
+        _ota_port = ota_port;
+        _size = size;
+        _md5 = md5;
 
         if (_password.length()){
             MD5Builder nonce_md5;
@@ -199,11 +235,7 @@ void ArduinoOTAClass::_onRx(){
             _state = OTA_WAITAUTH;
             return;
         } else {
-            _udp_ota.beginPacket(_udp_ota.remoteIP(), _udp_ota.remotePort());
-            _udp_ota.print("OK");
-            _udp_ota.endPacket();
-            _ota_ip = _udp_ota.remoteIP();
-            _state = OTA_RUNUPDATE;
+            _sendOK();
         }
     } else if (_state == OTA_WAITAUTH) {
         int cmd = parseInt();
@@ -229,11 +261,7 @@ void ArduinoOTAClass::_onRx(){
         String result = _challengemd5.toString();
 
         if(result.equals(response)){
-            _udp_ota.beginPacket(_udp_ota.remoteIP(), _udp_ota.remotePort());
-            _udp_ota.print("OK");
-            _udp_ota.endPacket();
-            _ota_ip = _udp_ota.remoteIP();
-            _state = OTA_RUNUPDATE;
+            _sendOK();
         } else {
             _udp_ota.beginPacket(_udp_ota.remoteIP(), _udp_ota.remotePort());
             _udp_ota.print("Authentication Failed");
@@ -245,47 +273,103 @@ void ArduinoOTAClass::_onRx(){
     }
 }
 
+int ArduinoOTAClass::_waitForData(WiFiClient &client) {
+    int available = client.available();
+    int fd = client.fd();
+    if (available || fd < 0) {
+        return available;
+    }
+    // sleep in lwip until data arrives instead of polling available()
+    fd_set set;
+    FD_ZERO(&set);
+    FD_SET(fd, &set);
+    struct timeval tv;
+    tv.tv_sec = _ota_timeout / 1000;
+    tv.tv_usec = (_ota_timeout % 1000) * 1000;
+    if (select(fd + 1, &set, NULL, NULL, &tv) <= 0) {
+        return 0;
+    }
+    return client.available();
+}
+
+void ArduinoOTAClass::_failUpdate(ota_error_t error, uint32_t received) {
+    if (_error_callback) {
+        _error_callback(error);
+    }
+    if (_proto >= 2 && received && !Update.hasError()) {
+        // keep the update open, the sender can come back and resume from here
+        log_i("Transfer suspended at %u", received);
+        _received = received;
+        _resume_md5 = _md5;
+        _resumable = true;
+        _suspended_at = millis();
+    } else {
+        Update.abort();
+    }
+    _state = OTA_IDLE;
+}
+
+void ArduinoOTAClass::_abortResume() {
+    if (_resumable) {
+        Update.abort();
+        _resumable = false;
+        _received = 0;
+    }
+}
+
 void ArduinoOTAClass::_runUpdate() {
-    const char *partition_label = _partition_label.length() ? _partition_label.c_str() : NULL;
-    if (!Update.begin(_size, _cmd, -1, LOW, partition_label)) {
+    uint32_t total = _resume_offset;
+    if (total) {
+        log_i("Resuming at %u", total);
+    } else {
+        // a different image replaces the transfer left for resuming
+        _abortResume();
+        const char *partition_label = _partition_label.length() ? _partition_label.c_str() : NULL;
+        if (!Update.begin(_size, _cmd, -1, LOW, partition_label)) {
 
-        log_e("Begin ERROR: %s", Update.errorString());
+            log_e("Begin ERROR: %s", Update.errorString());
 
-        if (_error_callback) {
-            _error_callback(OTA_BEGIN_ERROR);
+            if (_error_callback) {
+                _error_callback(OTA_BEGIN_ERROR);
+            }
+            _state = OTA_IDLE;
+            return;
         }
-        _state = OTA_IDLE;
-        return;
+        Update.setMD5(_md5.c_str());
     }
-    Update.setMD5(_md5.c_str());
+    _resumable = false;
 
     if (_start_callback) {
         _start_callback();
     }
     if (_progress_callback) {
-        _progress_callback(0, _size);
+        _progress_callback(total, _size);
     }
 
     WiFiClient client;
     if (!client.connect(_ota_ip, _ota_port)) {
-        if (_error_callback) {
-            _error_callback(OTA_CONNECT_ERROR);
-        }
-        _state = OTA_IDLE;
+        _failUpdate(OTA_CONNECT_ERROR, total);
+        return;
+    }
+    if (_proto >= 2) {
+        // acks are tiny, Nagle would hold each one back until the previous is acknowledged
+        client.setNoDelay(true);
     }
 
-    uint32_t written = 0, total = 0, tried = 0;
+    uint8_t *buf = (uint8_t *)malloc(OTA_BUFFER_SIZE);
+    if (!buf) {
+        log_e("Out of memory");
+        client.stop();
+        _failUpdate(OTA_RECEIVE_ERROR, total);
+        return;
+    }
+
+    uint32_t written = 0, tried = 0;
 
     while (!Update.isFinished() && client.connected()) {
-        size_t waited = _ota_timeout;
-        size_t available = client.available();
-        while (!available && waited){
-            delay(1);
-            waited -=1 ;
-            available = client.available();
-        }
-        if (!waited){
-            if(written && tried++ < 3){
+        size_t available = _waitForData(client);
+        if (!available){
+            if(_proto < 2 && written && tried++ < 3){
                 log_i("Try[%u]: %u", tried, written);
                 if(!client.printf("%u", written)){
                     log_e("failed to respond");
@@ -295,48 +379,50 @@ void ArduinoOTAClass::_runUpdate() {
                 continue;
             }
             log_e("Receive Failed");
-            if (_error_callback) {
-                _error_callback(OTA_RECEIVE_ERROR);
-            }
-            _state = OTA_IDLE;
-            Update.abort();
+            free(buf);
+            client.stop();
+            _failUpdate(OTA_RECEIVE_ERROR, total);
             return;
         }
-        if(!available){
-            log_e("No Data: %u", waited);
-            _state = OTA_IDLE;
-            break;
-        }
         tried = 0;
-        static uint8_t buf[1460];
-        if(available > 1460){
-            available = 1460;
+        if(available > OTA_BUFFER_SIZE){
+            available = OTA_BUFFER_SIZE;
+        }
+        int r = client.read(buf, available);
+        if(r <= 0) {
+            log_w("didn't read anything: %d", r);
+            continue;
         }
-        size_t r = client.read(buf, available);
-        if(r != available){
+        if((size_t)r != available){
             log_w("didn't read enough! %u != %u", r, available);
-	    if((int32_t) r<0) {
-	        delay(1);
-	        continue;  	//let's not try to write 4 gigabytes when client.read returns -1
-	    }
         }
 
         written = Update.write(buf, r);
         if (written > 0) {
-            if(written != r){
+            if(written != (size_t)r){
                 log_w("didn't write enough! %u != %u", written, r);
             }
-            if(!client.printf("%u", written)){
+            total += written;
+            // protocol 2 acks the running total, so a lost or merged ack costs nothing
+            if(!(_proto >= 2 ? client.printf("%u\n", total) : client.printf("%u", written))){
                 log_w("failed to respond");
             }
-            total += written;
             if(_progress_callback) {
                 _progress_callback(total, _size);
             }
         } else {
             log_e("Write ERROR: %s", Update.errorString());
+            break;
         }
     }
+    free(buf);
+
+    if (_proto >= 2 && !Update.isFinished() && !Update.hasError()) {
+        log_e("Connection lost");
+        client.stop();
+        _failUpdate(OTA_RECEIVE_ERROR, total);
+        return;
+    }
 
     if (Update.end()) {
         client.print("OK");
@@ -363,6 +449,7 @@ void ArduinoOTAClass::_runUpdate() {
 }
 
 void ArduinoOTAClass::end() {
+    _abortResume();
     _initialized = false;
     _udp_ota.stop();
     if(_mdnsEnabled){
@@ -380,6 +467,10 @@ void ArduinoOTAClass::handle() {
         _runUpdate();
         _state = OTA_IDLE;
     }
+    if (_resumable && millis() - _suspended_at > OTA_RESUME_TIMEOUT) {
+        log_w("Resume timed out");
+        _abortResume();
+    }
     if(_udp_ota.parsePacket()){
         _onRx();
     }
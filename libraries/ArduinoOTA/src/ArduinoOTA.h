@@ -7,6 +7,22 @@
 
 #define INT_BUFFER_SIZE 16
 
+// Protocol 1 acknowledges every chunk, protocol 2 keeps a window of data in flight
+// and can resume an interrupted transfer. The sender asks for 2 in the invitation.
+#define OTA_PROTOCOL_VERSION 2
+
+#ifndef OTA_BUFFER_SIZE
+#define OTA_BUFFER_SIZE 4096            // bytes read from the socket at once
+#endif
+
+#ifndef OTA_WINDOW_SIZE
+#define OTA_WINDOW_SIZE 32768           // unacknowledged bytes the sender may have in flight
+#endif
+
+#ifndef OTA_RESUME_TIMEOUT
+#define OTA_RESUME_TIMEOUT 60000        // ms an interrupted update is kept open for the sender to resume
+#endif
+
 typedef enum {
   OTA_IDLE,
   OTA_WAITAUTH,
@@ -95,6 +111,12 @@ class ArduinoOTAClass
     int _cmd;
     int _ota_port;
     int _ota_timeout;
+    int _proto;
+    uint32_t _resume_offset;
+    uint32_t _received;
+    bool _resumable;
+    String _resume_md5;
+    unsigned long _suspended_at;
     IPAddress _ota_ip;
     String _md5;
 
@@ -105,6 +127,10 @@ class ArduinoOTAClass
 
     void _runUpdate(void);
     void _onRx(void);
+    void _sendOK(void);
+    int _waitForData(WiFiClient &client);
+    void _failUpdate(ota_error_t error, uint32_t received);
+    void _abortResume(void);
     int parseInt(void);
     String readStringUntil(char end);
 };
@@ -123,60 +123,78 @@ typedef struct {
         struct netif * netif;
 } lwip_event_packet_t;
 
-static xQueueHandle _udp_queue;
-static volatile TaskHandle_t _udp_task_handle = NULL;
-
-static void _udp_task(void *pvParameters){
-    lwip_event_packet_t * e = NULL;
-    for (;;) {
-        if(xQueueReceive(_udp_queue, &e, portMAX_DELAY) == pdTRUE){
-            if(!e->pb){
-                free((void*)(e));
-                continue;
-            }
-            AsyncUDP::_s_recv(e->arg, e->pcb, e->pb, e->addr, e->port, e->netif);
-            free((void*)(e));
+#if (ASYNC_UDP_QUEUE_LENGTH & (ASYNC_UDP_QUEUE_LENGTH - 1)) != 0
+#error ASYNC_UDP_QUEUE_LENGTH must be a power of two
+#endif
+
+// Preallocated single-producer/single-consumer ring of events. Only the
+// tcpip thread (in _udp_recv) advances the head and only the drain work
+// advances the tail, so neither side needs a lock. The drain runs in the
+// normal lane of the shared workers, or on a worker of its own with
+// ASYNC_UDP_OWN_WORKER.
+static lwip_event_packet_t _udp_events[ASYNC_UDP_QUEUE_LENGTH];
+static volatile uint32_t _udp_events_head = 0;
+static volatile uint32_t _udp_events_tail = 0;
+
+static void _udp_drain(void *arg);
+static work_item_t _udp_work = WORK_ITEM_INIT(_udp_drain, NULL, WORK_PRIORITY_NORMAL);
+static volatile bool _udp_work_ready = false;
+
+static void _udp_drain(void *arg){
+    uint32_t tail = _udp_events_tail;
+    // bounded, so a flood of packets does not hold the worker forever
+    for(uint32_t n = 0; n < ASYNC_UDP_QUEUE_LENGTH; n++){
+        if(tail == __atomic_load_n(&_udp_events_head, __ATOMIC_ACQUIRE)){
+            return;
         }
+        // copy the event out and release its slot before running the handler
+        lwip_event_packet_t e = _udp_events[tail & (ASYNC_UDP_QUEUE_LENGTH - 1)];
+        tail++;
+        __atomic_store_n(&_udp_events_tail, tail, __ATOMIC_RELEASE);
+        AsyncUDP::_s_recv(e.arg, e.pcb, e.pb, e.addr, e.port, e.netif);
+    }
+    if(tail != __atomic_load_n(&_udp_events_head, __ATOMIC_ACQUIRE)){
+        workQueueSubmit(&_udp_work);
     }
-    _udp_task_handle = NULL;
-    vTaskDelete(NULL);
 }
 
 static bool _udp_task_start(){
-    if(!_udp_queue){
-        _udp_queue = xQueueCreate(32, sizeof(lwip_event_packet_t *));
-        if(!_udp_queue){
+    if(!_udp_work_ready){
+#if ASYNC_UDP_OWN_WORKER
+        work_worker_t * worker = workWorkerCreate("async_udp", ASYNC_UDP_TASK_STACK_SIZE, CONFIG_ARDUINO_UDP_TASK_PRIORITY, CONFIG_ARDUINO_UDP_RUNNING_CORE);
+        if(!worker){
             return false;
         }
-    }
-    if(!_udp_task_handle){
-        xTaskCreateUniversal(_udp_task, "async_udp", 4096, NULL, CONFIG_ARDUINO_UDP_TASK_PRIORITY, (TaskHandle_t*)&_udp_task_handle, CONFIG_ARDUINO_UDP_RUNNING_CORE);
-        if(!_udp_task_handle){
+        workItemBind(&_udp_work, worker);
+#else
+        if(!workQueueBegin()){
             return false;
         }
+#endif
+        _udp_work_ready = true;
     }
     return true;
 }
 
 static bool _udp_task_post(void *arg, udp_pcb *pcb, pbuf *pb, const ip_addr_t *addr, uint16_t port, struct netif *netif)
 {
-    if(!_udp_task_handle || !_udp_queue){
+    if(!_udp_work_ready){
         return false;
     }
-    lwip_event_packet_t * e = (lwip_event_packet_t *)malloc(sizeof(lwip_event_packet_t));
-    if(!e){
+    uint32_t head = _udp_events_head;
+    if(head - __atomic_load_n(&_udp_events_tail, __ATOMIC_ACQUIRE) >= ASYNC_UDP_QUEUE_LENGTH){
         return false;
     }
+    lwip_event_packet_t * e = &_udp_events[head & (ASYNC_UDP_QUEUE_LENGTH - 1)];
     e->arg = arg;
     e->pcb = pcb;
     e->pb = pb;
     e->addr = addr;
     e->port = port;
     e->netif = netif;
-    if (xQueueSend(_udp_queue, &e, portMAX_DELAY) != pdPASS) {
-        free((void*)(e));
-        return false;
-    }
+    __atomic_store_n(&_udp_events_head, head + 1, __ATOMIC_RELEASE);
+    // a drain that is running is made to run again, so this event is not missed
+    workQueueSubmit(&_udp_work);
     return true;
 }
 
@@ -187,30 +205,11 @@ static void _udp_recv(void *arg, udp_pcb *pcb, pbuf *pb, const ip_addr_t *addr,
         pb = pb->next;
         this_pb->next = NULL;
         if(!_udp_task_post(arg, pcb, this_pb, addr, port, ip_current_input_netif())){
+            AsyncUDP::_s_dropped(arg);
             pbuf_free(this_pb);
         }
     }
 }
-/*
-static bool _udp_task_stop(){
-    if(!_udp_task_post(NULL, NULL, NULL, NULL, 0, NULL)){
-        return false;
-    }
-    while(_udp_task_handle){
-        vTaskDelay(10);
-    }
-
-    lwip_event_packet_t * e;
-    while (xQueueReceive(_udp_queue, &e, 0) == pdTRUE) {
-        if(e->pb){
-            pbuf_free(e->pb);
-        }
-        free((void*)(e));
-    }
-    vQueueDelete(_udp_queue);
-    _udp_queue = NULL;
-}
-*/
 
 
 
@@ -497,6 +496,8 @@ AsyncUDP::AsyncUDP()
     _connected = false;
 	_lastErr = ERR_OK;
     _handler = NULL;
+    _received = 0;
+    _dropped = 0;
 }
 
 AsyncUDP::~AsyncUDP()
@@ -698,6 +699,7 @@ void AsyncUDP::_recv(udp_pcb *upcb, pbuf *pb, const ip_addr_t *addr, uint16_t po
         this_pb->next = NULL;
         if(_handler) {
             AsyncUDPPacket packet(this, this_pb, addr, port, netif);
+            _received++;
             _handler(packet);
         }
         pbuf_free(this_pb);
@@ -709,6 +711,25 @@ void AsyncUDP::_s_recv(void *arg, udp_pcb *upcb, pbuf *p, const ip_addr_t *addr,
     reinterpret_cast<AsyncUDP*>(arg)->_recv(upcb, p, addr, port, netif);
 }
 
+void AsyncUDP::_s_dropped(void *arg)
+{
+    reinterpret_cast<AsyncUDP*>(arg)->_dropped++;
+}
+
+AsyncUDPStats AsyncUDP::stats()
+{
+    AsyncUDPStats s;
+    s.received = _received;
+    s.dropped = _dropped;
+    return s;
+}
+
+void AsyncUDP::resetStats()
+{
+    _received = 0;
+    _dropped = 0;
+}
+
 bool AsyncUDP::listen(uint16_t port)
 {
     return listen(IP_ANY_TYPE, port);
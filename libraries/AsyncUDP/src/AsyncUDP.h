@@ -12,6 +12,29 @@ extern "C" {
 #include "freertos/semphr.h"
 }
 
+// Packets in flight between lwIP and the onPacket() handlers. Must be a power of
+// two. When the queue is full new packets are dropped instead of stalling lwIP.
+#ifndef ASYNC_UDP_QUEUE_LENGTH
+#define ASYNC_UDP_QUEUE_LENGTH 64
+#endif
+
+// Handlers run on the shared work queue, next to Arduino events, so they
+// should not block. Set to 1 for an "async_udp" worker of its own, on the
+// core and at the priority of the ARDUINO_UDP Kconfig options, at the cost
+// of another task stack.
+#ifndef ASYNC_UDP_OWN_WORKER
+#define ASYNC_UDP_OWN_WORKER 0
+#endif
+
+#ifndef ASYNC_UDP_TASK_STACK_SIZE
+#define ASYNC_UDP_TASK_STACK_SIZE 4096
+#endif
+
+typedef struct {
+    uint32_t received;  // packets handed to the onPacket() handler
+    uint32_t dropped;   // packets lost because the event queue was full
+} AsyncUDPStats;
+
 class AsyncUDP;
 class AsyncUDPPacket;
 class AsyncUDPMessage;
@@ -98,6 +121,8 @@ protected:
     bool _connected;
 	esp_err_t _lastErr;
     AuPacketHandlerFunction _handler;
+    volatile uint32_t _received;
+    volatile uint32_t _dropped;
 
     bool _init();
     void _recv(udp_pcb *upcb, pbuf *pb, const ip_addr_t *addr, uint16_t port, struct netif * netif);
@@ -149,7 +174,11 @@ public:
 	esp_err_t lastErr();
     operator bool();
 
+    AsyncUDPStats stats();
+    void resetStats();
+
     static void _s_recv(void *arg, udp_pcb *upcb, pbuf *p, const ip_addr_t *addr, uint16_t port, struct netif * netif);
+    static void _s_dropped(void *arg);
 };
 
 #endif
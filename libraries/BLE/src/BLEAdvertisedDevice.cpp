@@ -15,6 +15,7 @@
 #if defined(CONFIG_BLUEDROID_ENABLED)
 #include <sstream>
 #include "BLEAdvertisedDevice.h"
+#include "BLEAdvertisementView.h"
 #include "BLEUtils.h"
 #include "esp32-hal-log.h"
 
@@ -270,133 +271,120 @@ bool BLEAdvertisedDevice::haveTXPower() {
  * https://www.bluetooth.com/specifications/assigned-numbers/generic-access-profile
  */
 void BLEAdvertisedDevice::parseAdvertisement(uint8_t* payload, size_t total_len) {
-	uint8_t length;
-	uint8_t ad_type;
-	uint8_t sizeConsumed = 0;
-	bool finished = false;
 	m_payload = payload;
 	m_payloadLength = total_len;
 
-	while(!finished) {
-		length = *payload;          // Retrieve the length of the record.
-		payload++;                  // Skip to type
-		sizeConsumed += 1 + length; // increase the size consumed.
+	BLEAdvertisementView view(payload, total_len);
+	for (const BLEAdRecord& record : view) {
+		uint8_t ad_type = record.type;
+		uint8_t length  = record.length;
+		uint8_t* data   = const_cast<uint8_t*>(record.data);
 
-		if (length != 0) { // A length of 0 indicates that we have reached the end.
-			ad_type = *payload;
-			payload++;
-			length--;
-
-			char* pHex = BLEUtils::buildHexData(nullptr, payload, length);
-			log_d("Type: 0x%.2x (%s), length: %d, data: %s",
-					ad_type, BLEUtils::advTypeToString(ad_type), length, pHex);
-			free(pHex);
-
-			switch(ad_type) {
-				case ESP_BLE_AD_TYPE_NAME_CMPL: {   // Adv Data Type: 0x09
-					setName(std::string(reinterpret_cast<char*>(payload), length));
-					break;
-				} // ESP_BLE_AD_TYPE_NAME_CMPL
-
-				case ESP_BLE_AD_TYPE_TX_PWR: {      // Adv Data Type: 0x0A
-					setTXPower(*payload);
-					break;
-				} // ESP_BLE_AD_TYPE_TX_PWR
-
-				case ESP_BLE_AD_TYPE_APPEARANCE: { // Adv Data Type: 0x19
-					setAppearance(*reinterpret_cast<uint16_t*>(payload));
-					break;
-				} // ESP_BLE_AD_TYPE_APPEARANCE
-
-				case ESP_BLE_AD_TYPE_FLAG: {        // Adv Data Type: 0x01
-					setAdFlag(*payload);
-					break;
-				} // ESP_BLE_AD_TYPE_FLAG
-
-				case ESP_BLE_AD_TYPE_16SRV_CMPL:
-				case ESP_BLE_AD_TYPE_16SRV_PART: {   // Adv Data Type: 0x02
-					for (int var = 0; var < length/2; ++var) {
-						setServiceUUID(BLEUUID(*reinterpret_cast<uint16_t*>(payload + var * 2)));
-					}
-					break;
-				} // ESP_BLE_AD_TYPE_16SRV_PART
-
-				case ESP_BLE_AD_TYPE_32SRV_CMPL:
-				case ESP_BLE_AD_TYPE_32SRV_PART: {   // Adv Data Type: 0x04
-					for (int var = 0; var < length/4; ++var) {
-						setServiceUUID(BLEUUID(*reinterpret_cast<uint32_t*>(payload + var * 4)));
-					}
-					break;
-				} // ESP_BLE_AD_TYPE_32SRV_PART
-
-				case ESP_BLE_AD_TYPE_128SRV_CMPL: { // Adv Data Type: 0x07
-					setServiceUUID(BLEUUID(payload, 16, false));
-					break;
-				} // ESP_BLE_AD_TYPE_128SRV_CMPL
+#if ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_DEBUG
+		char* pHex = BLEUtils::buildHexData(nullptr, data, length);
+		log_d("Type: 0x%.2x (%s), length: %d, data: %s",
+				ad_type, BLEUtils::advTypeToString(ad_type), length, pHex);
+		free(pHex);
+#endif
+
+		switch(ad_type) {
+			case ESP_BLE_AD_TYPE_NAME_CMPL: {   // Adv Data Type: 0x09
+				setName(std::string(reinterpret_cast<char*>(data), length));
+				break;
+			} // ESP_BLE_AD_TYPE_NAME_CMPL
+
+			case ESP_BLE_AD_TYPE_TX_PWR: {      // Adv Data Type: 0x0A
+				setTXPower(*data);
+				break;
+			} // ESP_BLE_AD_TYPE_TX_PWR
+
+			case ESP_BLE_AD_TYPE_APPEARANCE: { // Adv Data Type: 0x19
+				setAppearance(*reinterpret_cast<uint16_t*>(data));
+				break;
+			} // ESP_BLE_AD_TYPE_APPEARANCE
+
+			case ESP_BLE_AD_TYPE_FLAG: {        // Adv Data Type: 0x01
+				setAdFlag(*data);
+				break;
+			} // ESP_BLE_AD_TYPE_FLAG
+
+			case ESP_BLE_AD_TYPE_16SRV_CMPL:
+			case ESP_BLE_AD_TYPE_16SRV_PART: {   // Adv Data Type: 0x02
+				for (int var = 0; var < length/2; ++var) {
+					setServiceUUID(BLEUUID(*reinterpret_cast<uint16_t*>(data + var * 2)));
+				}
+				break;
+			} // ESP_BLE_AD_TYPE_16SRV_PART
 
-				case ESP_BLE_AD_TYPE_128SRV_PART: { // Adv Data Type: 0x06
-					setServiceUUID(BLEUUID(payload, 16, false));
+			case ESP_BLE_AD_TYPE_32SRV_CMPL:
+			case ESP_BLE_AD_TYPE_32SRV_PART: {   // Adv Data Type: 0x04
+				for (int var = 0; var < length/4; ++var) {
+					setServiceUUID(BLEUUID(*reinterpret_cast<uint32_t*>(data + var * 4)));
+				}
+				break;
+			} // ESP_BLE_AD_TYPE_32SRV_PART
+
+			case ESP_BLE_AD_TYPE_128SRV_CMPL: { // Adv Data Type: 0x07
+				setServiceUUID(BLEUUID(data, 16, false));
+				break;
+			} // ESP_BLE_AD_TYPE_128SRV_CMPL
+
+			case ESP_BLE_AD_TYPE_128SRV_PART: { // Adv Data Type: 0x06
+				setServiceUUID(BLEUUID(data, 16, false));
+				break;
+			} // ESP_BLE_AD_TYPE_128SRV_PART
+
+			// See CSS Part A 1.4 Manufacturer Specific Data
+			case ESP_BLE_AD_MANUFACTURER_SPECIFIC_TYPE: {
+				setManufacturerData(std::string(reinterpret_cast<char*>(data), length));
+				break;
+			} // ESP_BLE_AD_MANUFACTURER_SPECIFIC_TYPE
+
+			case ESP_BLE_AD_TYPE_SERVICE_DATA: {  // Adv Data Type: 0x16 (Service Data) - 2 byte UUID
+				if (length < 2) {
+					log_e("Length too small for ESP_BLE_AD_TYPE_SERVICE_DATA");
 					break;
-				} // ESP_BLE_AD_TYPE_128SRV_PART
+				}
+				uint16_t uuid = *(uint16_t*)data;
+				setServiceDataUUID(BLEUUID(uuid));
+				if (length > 2) {
+					setServiceData(std::string(reinterpret_cast<char*>(data + 2), length - 2));
+				}
+				break;
+			} //ESP_BLE_AD_TYPE_SERVICE_DATA
 
-				// See CSS Part A 1.4 Manufacturer Specific Data
-				case ESP_BLE_AD_MANUFACTURER_SPECIFIC_TYPE: {
-					setManufacturerData(std::string(reinterpret_cast<char*>(payload), length));
-					break;
-				} // ESP_BLE_AD_MANUFACTURER_SPECIFIC_TYPE
-
-				case ESP_BLE_AD_TYPE_SERVICE_DATA: {  // Adv Data Type: 0x16 (Service Data) - 2 byte UUID
-					if (length < 2) {
-						log_e("Length too small for ESP_BLE_AD_TYPE_SERVICE_DATA");
-						break;
-					}
-					uint16_t uuid = *(uint16_t*)payload;
-					setServiceDataUUID(BLEUUID(uuid));
-					if (length > 2) {
-						setServiceData(std::string(reinterpret_cast<char*>(payload + 2), length - 2));
-					}
+			case ESP_BLE_AD_TYPE_32SERVICE_DATA: {  // Adv Data Type: 0x20 (Service Data) - 4 byte UUID
+				if (length < 4) {
+					log_e("Length too small for ESP_BLE_AD_TYPE_32SERVICE_DATA");
 					break;
-				} //ESP_BLE_AD_TYPE_SERVICE_DATA
-
-				case ESP_BLE_AD_TYPE_32SERVICE_DATA: {  // Adv Data Type: 0x20 (Service Data) - 4 byte UUID
-					if (length < 4) {
-						log_e("Length too small for ESP_BLE_AD_TYPE_32SERVICE_DATA");
-						break;
-					}
-					uint32_t uuid = *(uint32_t*) payload;
-					setServiceDataUUID(BLEUUID(uuid));
-					if (length > 4) {
-						setServiceData(std::string(reinterpret_cast<char*>(payload + 4), length - 4));
-					}
-					break;
-				} //ESP_BLE_AD_TYPE_32SERVICE_DATA
-
-				case ESP_BLE_AD_TYPE_128SERVICE_DATA: {  // Adv Data Type: 0x21 (Service Data) - 16 byte UUID
-					if (length < 16) {
-						log_e("Length too small for ESP_BLE_AD_TYPE_128SERVICE_DATA");
-						break;
-					}
-
-					setServiceDataUUID(BLEUUID(payload, (size_t)16, false));
-					if (length > 16) {
-						setServiceData(std::string(reinterpret_cast<char*>(payload + 16), length - 16));
-					}
-					break;
-				} //ESP_BLE_AD_TYPE_32SERVICE_DATA
+				}
+				uint32_t uuid = *(uint32_t*) data;
+				setServiceDataUUID(BLEUUID(uuid));
+				if (length > 4) {
+					setServiceData(std::string(reinterpret_cast<char*>(data + 4), length - 4));
+				}
+				break;
+			} //ESP_BLE_AD_TYPE_32SERVICE_DATA
 
-				default: {
-					log_d("Unhandled type: adType: %d - 0x%.2x", ad_type, ad_type);
+			case ESP_BLE_AD_TYPE_128SERVICE_DATA: {  // Adv Data Type: 0x21 (Service Data) - 16 byte UUID
+				if (length < 16) {
+					log_e("Length too small for ESP_BLE_AD_TYPE_128SERVICE_DATA");
 					break;
 				}
-			} // switch
-			payload += length;
-		} // Length <> 0
 
-
-		if (sizeConsumed >= total_len)
-			finished = true;
-
-	} // !finished
+				setServiceDataUUID(BLEUUID(data, (size_t)16, false));
+				if (length > 16) {
+					setServiceData(std::string(reinterpret_cast<char*>(data + 16), length - 16));
+				}
+				break;
+			} //ESP_BLE_AD_TYPE_32SERVICE_DATA
+
+			default: {
+				log_d("Unhandled type: adType: %d - 0x%.2x", ad_type, ad_type);
+				break;
+			}
+		} // switch
+	} // for each record
 } // parseAdvertisement
 
 /**
@@ -445,9 +433,11 @@ void BLEAdvertisedDevice::setAppearance(uint16_t appearance) {
 void BLEAdvertisedDevice::setManufacturerData(std::string manufacturerData) {
 	m_manufacturerData     = manufacturerData;
 	m_haveManufacturerData = true;
+#if ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_DEBUG
 	char* pHex = BLEUtils::buildHexData(nullptr, (uint8_t*) m_manufacturerData.data(), (uint8_t) m_manufacturerData.length());
 	log_d("- manufacturer data: %s", pHex);
 	free(pHex);
+#endif
 } // setManufacturerData
 
 
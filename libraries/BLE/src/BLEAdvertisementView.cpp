@@ -0,0 +1,182 @@
+/*
+ * BLEAdvertisementView.cpp
+ *
+ * A read only view over the AD records of an advertising payload.
+ *
+ * See also:
+ * https://www.bluetooth.com/specifications/assigned-numbers/generic-access-profile
+ */
+#include "sdkconfig.h"
+#if defined(CONFIG_BLUEDROID_ENABLED)
+#include <esp_gap_ble_api.h>
+#include "BLEAdvertisementView.h"
+
+
+BLEAdvertisementView::iterator::iterator(const uint8_t* pos, const uint8_t* end) {
+	m_pos = pos;
+	m_end = end;
+	load();
+} // iterator
+
+
+/**
+ * @brief Decode the record at the current position, or move to the end if there is none.
+ */
+void BLEAdvertisementView::iterator::load() {
+	// zero length bytes are padding, the next record may still follow (scan response data)
+	while (m_pos < m_end && *m_pos == 0) {
+		m_pos++;
+	}
+	if (m_pos >= m_end || m_pos + 1 + *m_pos > m_end) {
+		m_pos = m_end;
+		return;
+	}
+	m_record.type   = m_pos[1];
+	m_record.length = m_pos[0] - 1;
+	m_record.data   = m_pos + 2;
+} // load
+
+
+BLEAdvertisementView::iterator& BLEAdvertisementView::iterator::operator++() {
+	if (m_pos < m_end) {
+		m_pos += 1 + *m_pos;
+		load();
+	}
+	return *this;
+} // operator++
+
+
+/**
+ * @brief Create a view, the payload is neither copied nor parsed.
+ * @param [in] payload The advertising data, followed by the scan response data if any.
+ * @param [in] length The total length of the payload.
+ */
+BLEAdvertisementView::BLEAdvertisementView(const uint8_t* payload, size_t length) {
+	m_payload = payload;
+	m_length  = payload ? length : 0;
+} // BLEAdvertisementView
+
+
+BLEAdvertisementView::iterator BLEAdvertisementView::begin() const {
+	return iterator(m_payload, m_payload + m_length);
+} // begin
+
+
+BLEAdvertisementView::iterator BLEAdvertisementView::end() const {
+	return iterator(m_payload + m_length, m_payload + m_length);
+} // end
+
+
+/**
+ * @brief Find the first record of a given type.
+ * @param [in] type The AD type.
+ * @param [out] record The record found.
+ * @return True if there is one.
+ */
+bool BLEAdvertisementView::find(uint8_t type, BLEAdRecord* record) const {
+	for (const BLEAdRecord& r : *this) {
+		if (r.type == type) {
+			*record = r;
+			return true;
+		}
+	}
+	return false;
+} // find
+
+
+bool BLEAdvertisementView::getFlags(uint8_t* flags) const {
+	BLEAdRecord record;
+	if (!find(ESP_BLE_AD_TYPE_FLAG, &record) || record.length < 1) {
+		return false;
+	}
+	*flags = record.data[0];
+	return true;
+} // getFlags
+
+
+/**
+ * @brief Get the complete name, or the shortened one if that is all there is.
+ * @param [out] name The name, not null terminated.
+ * @param [out] length The length of the name.
+ */
+bool BLEAdvertisementView::getName(const char** name, size_t* length) const {
+	BLEAdRecord record;
+	if (!find(ESP_BLE_AD_TYPE_NAME_CMPL, &record) && !find(ESP_BLE_AD_TYPE_NAME_SHORT, &record)) {
+		return false;
+	}
+	*name   = reinterpret_cast<const char*>(record.data);
+	*length = record.length;
+	return true;
+} // getName
+
+
+bool BLEAdvertisementView::getTXPower(int8_t* txPower) const {
+	BLEAdRecord record;
+	if (!find(ESP_BLE_AD_TYPE_TX_PWR, &record) || record.length < 1) {
+		return false;
+	}
+	*txPower = (int8_t)record.data[0];
+	return true;
+} // getTXPower
+
+
+bool BLEAdvertisementView::getAppearance(uint16_t* appearance) const {
+	BLEAdRecord record;
+	if (!find(ESP_BLE_AD_TYPE_APPEARANCE, &record) || record.length < 2) {
+		return false;
+	}
+	*appearance = record.data[0] | (record.data[1] << 8);
+	return true;
+} // getAppearance
+
+
+/**
+ * @brief Get the manufacturer specific data, company identifier included.
+ */
+bool BLEAdvertisementView::getManufacturerData(const uint8_t** data, size_t* length) const {
+	BLEAdRecord record;
+	if (!find(ESP_BLE_AD_MANUFACTURER_SPECIFIC_TYPE, &record)) {
+		return false;
+	}
+	*data   = record.data;
+	*length = record.length;
+	return true;
+} // getManufacturerData
+
+
+/**
+ * @brief Get the service data published for a 16 bit service UUID.
+ * @param [in] uuid The service UUID.
+ * @param [out] data The service data, the UUID excluded.
+ * @param [out] length The length of the service data.
+ */
+bool BLEAdvertisementView::getServiceData(uint16_t uuid, const uint8_t** data, size_t* length) const {
+	for (const BLEAdRecord& r : *this) {
+		if (r.type == ESP_BLE_AD_TYPE_SERVICE_DATA && r.length >= 2 && (r.data[0] | (r.data[1] << 8)) == uuid) {
+			*data   = r.data + 2;
+			*length = r.length - 2;
+			return true;
+		}
+	}
+	return false;
+} // getServiceData
+
+
+/**
+ * @brief Check whether a 16 bit service UUID is listed, completely or partially.
+ */
+bool BLEAdvertisementView::isAdvertisingService(uint16_t uuid) const {
+	for (const BLEAdRecord& r : *this) {
+		if (r.type != ESP_BLE_AD_TYPE_16SRV_CMPL && r.type != ESP_BLE_AD_TYPE_16SRV_PART) {
+			continue;
+		}
+		for (int i = 0; i + 1 < r.length; i += 2) {
+			if ((r.data[i] | (r.data[i + 1] << 8)) == uuid) {
+				return true;
+			}
+		}
+	}
+	return false;
+} // isAdvertisingService
+
+#endif /* CONFIG_BLUEDROID_ENABLED */
@@ -0,0 +1,79 @@
+/*
+ * BLEAdvertisementView.h
+ *
+ * A read only view over the AD records of an advertising payload.
+ */
+
+#ifndef COMPONENTS_CPP_UTILS_BLEADVERTISEMENTVIEW_H_
+#define COMPONENTS_CPP_UTILS_BLEADVERTISEMENTVIEW_H_
+#include "sdkconfig.h"
+#if defined(CONFIG_BLUEDROID_ENABLED)
+#include <stddef.h>
+#include <stdint.h>
+
+
+/**
+ * @brief One AD record, pointing into the payload it was found in.
+ */
+struct BLEAdRecord {
+	uint8_t        type;
+	uint8_t        length;   // of the data, the type byte excluded
+	const uint8_t* data;
+};
+
+
+/**
+ * @brief Lazy parser for the AD records of an advertising payload.
+ *
+ * Nothing is copied or allocated: records are decoded while iterating and point into the
+ * payload, so the view is only valid as long as the payload is.  A record running past the
+ * end of the payload ends the iteration.
+ *
+ * @code
+ * for (const BLEAdRecord& record : view) {
+ *   if (record.type == ESP_BLE_AD_MANUFACTURER_SPECIFIC_TYPE) ...
+ * }
+ * @endcode
+ */
+class BLEAdvertisementView {
+public:
+	class iterator {
+	public:
+		iterator(const uint8_t* pos, const uint8_t* end);
+		const BLEAdRecord& operator*() const  { return m_record; }
+		const BLEAdRecord* operator->() const { return &m_record; }
+		iterator&          operator++();
+		bool               operator!=(const iterator& other) const { return m_pos != other.m_pos; }
+		bool               operator==(const iterator& other) const { return m_pos == other.m_pos; }
+
+	private:
+		void load();
+
+		const uint8_t* m_pos;
+		const uint8_t* m_end;
+		BLEAdRecord    m_record;
+	};
+
+	BLEAdvertisementView(const uint8_t* payload, size_t length);
+
+	iterator       begin() const;
+	iterator       end() const;
+	const uint8_t* getPayload() const       { return m_payload; }
+	size_t         getPayloadLength() const { return m_length; }
+
+	bool find(uint8_t type, BLEAdRecord* record) const;
+	bool getFlags(uint8_t* flags) const;
+	bool getName(const char** name, size_t* length) const;
+	bool getTXPower(int8_t* txPower) const;
+	bool getAppearance(uint16_t* appearance) const;
+	bool getManufacturerData(const uint8_t** data, size_t* length) const;
+	bool getServiceData(uint16_t uuid, const uint8_t** data, size_t* length) const;
+	bool isAdvertisingService(uint16_t uuid) const;
+
+private:
+	const uint8_t* m_payload;
+	size_t         m_length;
+};
+
+#endif /* CONFIG_BLUEDROID_ENABLED */
+#endif /* COMPONENTS_CPP_UTILS_BLEADVERTISEMENTVIEW_H_ */
@@ -24,6 +24,158 @@
 
 static BLECharacteristicCallbacks defaultCallback; //null-object-pattern
 
+
+/**
+ * @brief State behind notifyAsync().
+ *
+ * Values wait in a ring, each with a mask of the peers it still has to reach.  A peer is sent
+ * its oldest pending value as long as it has credits left and its link is not congested; a
+ * credit comes back with the ESP_GATTS_CONF_EVT of that packet, or all of them once the peer
+ * has had none back for BLE_NOTIFY_CREDIT_TIMEOUT_MS.  Everything is guarded by a spinlock that
+ * is never held across a call into the stack.  The queue lives as long as the characteristic,
+ * setNotifyQueue() only swaps its ring.
+ */
+class BLENotifyQueue {
+public:
+	struct Peer {
+		uint16_t connId;
+		uint8_t  inFlight;
+		bool     used;
+		bool     congested;
+		uint32_t lastCredit;   // ms, when the peer last got busy or had a packet confirmed
+	};
+
+	struct Entry {
+		uint16_t pending;    // one bit per peer
+		uint16_t length;
+		bool     indicate;
+		uint8_t  data[BLE_NOTIFY_VALUE_MAX];
+	};
+
+	BLENotifyQueue(BLECharacteristic::NotifyQueueMode mode, uint8_t depth, uint8_t credits) {
+		m_mode      = mode;
+		m_depth     = depth;
+		m_credits   = credits;
+		m_entries   = new Entry[depth];
+		memset(m_peers, 0, sizeof(m_peers));
+		memset(&m_stats, 0, sizeof(m_stats));
+	}
+
+	~BLENotifyQueue() {
+		delete[] m_entries;
+	}
+
+	// switches to a new ring, dropping the values still waiting; returns the old ring to free
+	Entry* reconfigure(BLECharacteristic::NotifyQueueMode mode, uint8_t depth, uint8_t credits, Entry* entries) {
+		dropPending(0xFFFF);
+		Entry* old = m_entries;
+		m_mode     = mode;
+		m_depth    = depth;
+		m_credits  = credits;
+		m_entries  = entries;
+		m_head     = 0;
+		m_count    = 0;
+		return old;
+	}
+
+	Peer* findPeer(uint16_t connId) {
+		for (int i = 0; i < BLE_NOTIFY_MAX_PEERS; i++) {
+			if (m_peers[i].used && m_peers[i].connId == connId) {
+				return &m_peers[i];
+			}
+		}
+		return nullptr;
+	}
+
+	void addPeer(uint16_t connId) {
+		if (findPeer(connId) != nullptr) {
+			return;
+		}
+		for (int i = 0; i < BLE_NOTIFY_MAX_PEERS; i++) {
+			if (!m_peers[i].used) {
+				m_peers[i].connId    = connId;
+				m_peers[i].inFlight  = 0;
+				m_peers[i].congested = false;
+				m_peers[i].used      = true;
+				m_peers[i].lastCredit = 0;
+				return;
+			}
+		}
+	}
+
+	void removePeer(uint16_t connId) {
+		Peer* peer = findPeer(connId);
+		if (peer == nullptr) {
+			return;
+		}
+		peer->used = false;
+		dropPending(1 << (peer - m_peers));
+	}
+
+	uint16_t peerMask() {
+		uint16_t mask = 0;
+		for (int i = 0; i < BLE_NOTIFY_MAX_PEERS; i++) {
+			if (m_peers[i].used) {
+				mask |= 1 << i;
+			}
+		}
+		return mask;
+	}
+
+	bool canSend(const Peer& peer, bool indicate) {
+		// ATT allows a single outstanding indication per connection
+		return !peer.congested && peer.inFlight < (indicate ? 1 : m_credits);
+	}
+
+	// takes back the credits of peers that have waited too long for a confirmation
+	void expireCredits(uint32_t now) {
+		for (int i = 0; i < BLE_NOTIFY_MAX_PEERS; i++) {
+			Peer& peer = m_peers[i];
+			if (peer.used && peer.inFlight > 0 && (int32_t)(now - peer.lastCredit) >= BLE_NOTIFY_CREDIT_TIMEOUT_MS) {
+				peer.inFlight = 0;
+				peer.lastCredit = now;
+				m_stats.timeouts++;
+			}
+		}
+	}
+
+	Entry& at(uint8_t n) {
+		return m_entries[(m_head + n) % m_depth];
+	}
+
+	// removes the given peers from every pending value
+	void dropPending(uint16_t mask) {
+		for (uint8_t n = 0; n < m_count; n++) {
+			Entry& entry = at(n);
+			m_stats.dropped += __builtin_popcount(entry.pending & mask);
+			entry.pending &= ~mask;
+		}
+		compact();
+	}
+
+	// releases the values at the head that have reached every peer
+	void compact() {
+		while (m_count > 0 && at(0).pending == 0) {
+			m_head = (m_head + 1) % m_depth;
+			m_count--;
+		}
+	}
+
+	BLECharacteristic::NotifyQueueMode m_mode;
+	uint8_t      m_depth;
+	uint8_t      m_credits;
+	uint8_t      m_head      = 0;
+	uint8_t      m_count     = 0;
+	bool         m_pumping   = false;
+	bool         m_pumpAgain = false;
+	portMUX_TYPE m_mux       = portMUX_INITIALIZER_UNLOCKED;
+	Peer         m_peers[BLE_NOTIFY_MAX_PEERS];
+	Entry*       m_entries;
+	uint8_t      m_scratch[BLE_NOTIFY_VALUE_MAX];   // the value being handed to the stack
+	BLECharacteristic::NotifyStats m_stats;
+};
+
+
 /**
  * @brief Construct a characteristic
  * @param [in] uuid - UUID (const char*) for the characteristic.
@@ -56,6 +208,7 @@ BLECharacteristic::BLECharacteristic(BLEUUID uuid, uint32_t properties) {
  */
 BLECharacteristic::~BLECharacteristic() {
 	//free(m_value.attr_value); // Release the storage for the value.
+	delete m_pNotifyQueue;
 } // ~BLECharacteristic
 
 
@@ -440,15 +593,71 @@ void BLECharacteristic::handleGATTServerEvent(
 			// log_d("m_handle = %d, conf->handle = %d", m_handle, param->conf.handle);
 			if(param->conf.conn_id == getService()->getServer()->getConnId()) // && param->conf.handle == m_handle) // bug in esp-idf and not implemented in arduino yet
 				m_semaphoreConfEvt.give(param->conf.status);
+			if (m_pNotifyQueue != nullptr) {
+				// the packet left: give the credit back and send what was waiting for it.  The
+				// handle is not always filled in, so every confirmation for a peer with packets
+				// in flight also pumps, which takes the credits back once they time out.
+				bool pump = false;
+				uint32_t now = FreeRTOS::getTimeSinceStart();
+				portENTER_CRITICAL(&m_pNotifyQueue->m_mux);
+				BLENotifyQueue::Peer* peer = m_pNotifyQueue->findPeer(param->conf.conn_id);
+				if (peer != nullptr && peer->inFlight > 0) {
+					if (param->conf.handle == m_handle) {
+						peer->inFlight--;
+						peer->lastCredit = now;
+						if (param->conf.status == ESP_GATT_OK) {
+							m_pNotifyQueue->m_stats.confirmed++;
+						} else {
+							m_pNotifyQueue->m_stats.errors++;
+						}
+					}
+					pump = true;
+				}
+				portEXIT_CRITICAL(&m_pNotifyQueue->m_mux);
+				if (pump) {
+					pumpNotifyQueue();
+				}
+			}
+			break;
+		}
+
+		// ESP_GATTS_CONGEST_EVT
+		//
+		// congest:
+		// - uint16_t conn_id
+		// - bool     congested
+		//
+		case ESP_GATTS_CONGEST_EVT: {
+			if (m_pNotifyQueue != nullptr) {
+				portENTER_CRITICAL(&m_pNotifyQueue->m_mux);
+				BLENotifyQueue::Peer* peer = m_pNotifyQueue->findPeer(param->congest.conn_id);
+				if (peer != nullptr) {
+					peer->congested = param->congest.congested;
+				}
+				portEXIT_CRITICAL(&m_pNotifyQueue->m_mux);
+				if (!param->congest.congested) {
+					pumpNotifyQueue();
+				}
+			}
 			break;
 		}
 
 		case ESP_GATTS_CONNECT_EVT: {
+			if (m_pNotifyQueue != nullptr) {
+				portENTER_CRITICAL(&m_pNotifyQueue->m_mux);
+				m_pNotifyQueue->addPeer(param->connect.conn_id);
+				portEXIT_CRITICAL(&m_pNotifyQueue->m_mux);
+			}
 			break;
 		}
 
 		case ESP_GATTS_DISCONNECT_EVT: {
 			m_semaphoreConfEvt.give();
+			if (m_pNotifyQueue != nullptr) {
+				portENTER_CRITICAL(&m_pNotifyQueue->m_mux);
+				m_pNotifyQueue->removePeer(param->disconnect.conn_id);
+				portEXIT_CRITICAL(&m_pNotifyQueue->m_mux);
+			}
 			break;
 		}
 
@@ -558,6 +767,233 @@ void BLECharacteristic::notify(bool is_notification) {
 } // Notify
 
 
+/**
+ * @brief Set up non-blocking notifications with notifyAsync().
+ *
+ * Call it once, before notifications start.  Each connected peer is then sent values on its own:
+ * a slow or congested peer only delays itself.
+ *
+ * @param [in] mode NOTIFY_QUEUE_LATEST to only keep the newest value per peer (sensor readings),
+ * NOTIFY_QUEUE_FIFO to deliver every value in order (streams).
+ * @param [in] depth How many values can wait.
+ * @param [in] credits How many packets a peer may have in flight for this characteristic.
+ * @return True on success.
+ */
+bool BLECharacteristic::setNotifyQueue(NotifyQueueMode mode, uint8_t depth, uint8_t credits) {
+	if (depth == 0 || credits == 0) {
+		log_e("setNotifyQueue: depth and credits must be at least 1");
+		return false;
+	}
+	if (mode == NOTIFY_QUEUE_LATEST) {
+		depth = 1;
+	}
+	if (m_pNotifyQueue != nullptr) {
+		// the BT task may be using the queue, so it stays and only its ring is replaced
+		BLENotifyQueue::Entry* pEntries = new BLENotifyQueue::Entry[depth];
+		portENTER_CRITICAL(&m_pNotifyQueue->m_mux);
+		pEntries = m_pNotifyQueue->reconfigure(mode, depth, credits, pEntries);
+		portEXIT_CRITICAL(&m_pNotifyQueue->m_mux);
+		delete[] pEntries;
+		return true;
+	}
+	BLENotifyQueue* pQueue = new BLENotifyQueue(mode, depth, credits);
+	if (getService() != nullptr && getService()->getServer() != nullptr) {
+		for (auto &myPair : getService()->getServer()->m_connectedServersMap) {
+			pQueue->addPeer(myPair.first);
+		}
+	}
+	m_pNotifyQueue = pQueue;
+	return true;
+} // setNotifyQueue
+
+
+/**
+ * @brief Queue the current value for every connected peer and return without waiting.
+ * @param [in] is_notification True for a notification, false for an indication.
+ * @return True if the value was queued.
+ */
+bool BLECharacteristic::notifyAsync(bool is_notification) {
+	m_pCallbacks->onNotify(this);   // Invoke the notify callback.
+	return notifyAsync(getData(), getLength(), is_notification);
+} // notifyAsync
+
+
+/**
+ * @brief Queue a value for every connected peer and return without waiting.
+ *
+ * The value is copied, the characteristic value is left alone.  In FIFO mode a value is refused
+ * when the queue is full; in LATEST mode it replaces whatever a peer has not been sent yet.
+ *
+ * @param [in] data The value.
+ * @param [in] length The length of the value, at most BLE_NOTIFY_VALUE_MAX.
+ * @param [in] is_notification True for a notification, false for an indication.
+ * @return True if the value was queued.
+ */
+bool BLECharacteristic::notifyAsync(const uint8_t* data, size_t length, bool is_notification) {
+	BLENotifyQueue* pQueue = m_pNotifyQueue;
+	if (pQueue == nullptr) {
+		log_e("notifyAsync: call setNotifyQueue() first");
+		return false;
+	}
+
+	BLE2902 *p2902 = (BLE2902*)getDescriptorByUUID((uint16_t)0x2902);
+	if (is_notification && p2902 != nullptr && !p2902->getNotifications()) {
+		m_pCallbacks->onStatus(this, BLECharacteristicCallbacks::Status::ERROR_NOTIFY_DISABLED, 0);
+		return false;
+	}
+	if (!is_notification && p2902 != nullptr && !p2902->getIndications()) {
+		m_pCallbacks->onStatus(this, BLECharacteristicCallbacks::Status::ERROR_INDICATE_DISABLED, 0);
+		return false;
+	}
+	if (length > BLE_NOTIFY_VALUE_MAX) {
+		log_w("- Truncating to %d bytes (BLE_NOTIFY_VALUE_MAX)", BLE_NOTIFY_VALUE_MAX);
+		length = BLE_NOTIFY_VALUE_MAX;
+	}
+
+	bool queued = false;
+	portENTER_CRITICAL(&pQueue->m_mux);
+	uint16_t peers = pQueue->peerMask();
+	if (peers != 0) {
+		if (pQueue->m_mode == NOTIFY_QUEUE_LATEST) {
+			pQueue->dropPending(peers);
+		}
+		if (pQueue->m_count < pQueue->m_depth) {
+			BLENotifyQueue::Entry& entry = pQueue->at(pQueue->m_count++);
+			entry.pending  = peers;
+			entry.length   = length;
+			entry.indicate = !is_notification;
+			memcpy(entry.data, data, length);
+			pQueue->m_stats.queued++;
+			for (int i = 0; i < BLE_NOTIFY_MAX_PEERS; i++) {
+				if ((peers & (1 << i)) && !pQueue->canSend(pQueue->m_peers[i], entry.indicate)) {
+					pQueue->m_stats.congested++;
+				}
+			}
+			queued = true;
+		} else {
+			pQueue->m_stats.dropped += __builtin_popcount(peers);
+		}
+	}
+	portEXIT_CRITICAL(&pQueue->m_mux);
+
+	if (peers == 0) {
+		m_pCallbacks->onStatus(this, BLECharacteristicCallbacks::Status::ERROR_NO_CLIENT, 0);
+		return false;
+	}
+	// also when full, so a peer whose credits have timed out is served again
+	pumpNotifyQueue();
+	return queued;
+} // notifyAsync
+
+
+/**
+ * @brief Hand the stack every queued value a peer has credits for.
+ *
+ * Runs from notifyAsync() and from the GATT events returning credits.  Only one caller sends
+ * at a time, which keeps each peer's values in order; a concurrent caller just asks it to
+ * look again.
+ */
+void BLECharacteristic::pumpNotifyQueue() {
+	BLENotifyQueue* pQueue = m_pNotifyQueue;
+	if (pQueue == nullptr || getService() == nullptr || getService()->getServer() == nullptr) {
+		return;
+	}
+	esp_gatt_if_t gatts_if = getService()->getServer()->getGattsIf();
+	uint32_t now = FreeRTOS::getTimeSinceStart();
+
+	portENTER_CRITICAL(&pQueue->m_mux);
+	pQueue->expireCredits(now);
+	if (pQueue->m_pumping) {
+		pQueue->m_pumpAgain = true;
+		portEXIT_CRITICAL(&pQueue->m_mux);
+		return;
+	}
+	pQueue->m_pumping = true;
+
+	for (;;) {
+		BLENotifyQueue::Entry* pEntry = nullptr;
+		int peer = 0;
+		for (; peer < BLE_NOTIFY_MAX_PEERS && pEntry == nullptr; peer++) {
+			if (!pQueue->m_peers[peer].used) {
+				continue;
+			}
+			// oldest value this peer is waiting for
+			for (uint8_t n = 0; n < pQueue->m_count; n++) {
+				BLENotifyQueue::Entry& entry = pQueue->at(n);
+				if (entry.pending & (1 << peer)) {
+					if (pQueue->canSend(pQueue->m_peers[peer], entry.indicate)) {
+						pEntry = &entry;
+					}
+					break;
+				}
+			}
+		}
+		if (pEntry == nullptr) {
+			if (pQueue->m_pumpAgain) {
+				pQueue->m_pumpAgain = false;
+				continue;
+			}
+			pQueue->m_pumping = false;
+			break;
+		}
+		peer--;
+
+		uint16_t connId   = pQueue->m_peers[peer].connId;
+		uint16_t length   = pEntry->length;
+		bool     indicate = pEntry->indicate;
+		memcpy(pQueue->m_scratch, pEntry->data, length);
+		pEntry->pending &= ~(1 << peer);
+		if (pQueue->m_peers[peer].inFlight++ == 0) {
+			pQueue->m_peers[peer].lastCredit = now;
+		}
+		pQueue->m_stats.sent++;
+		pQueue->m_stats.bytes += length;
+		pQueue->compact();
+		portEXIT_CRITICAL(&pQueue->m_mux);
+
+		esp_err_t errRc = ::esp_ble_gatts_send_indicate(gatts_if, connId, getHandle(), length, pQueue->m_scratch, indicate);
+		if (errRc != ESP_OK) {
+			log_e("esp_ble_gatts_send_indicate: rc=%d %s", errRc, GeneralUtils::errorToString(errRc));
+			m_pCallbacks->onStatus(this, BLECharacteristicCallbacks::Status::ERROR_GATT, errRc);
+		}
+
+		portENTER_CRITICAL(&pQueue->m_mux);
+		if (errRc != ESP_OK) {
+			BLENotifyQueue::Peer* pPeer = pQueue->findPeer(connId);
+			if (pPeer != nullptr && pPeer->inFlight > 0) {
+				pPeer->inFlight--;
+			}
+			pQueue->m_stats.errors++;
+		}
+	}
+	portEXIT_CRITICAL(&pQueue->m_mux);
+} // pumpNotifyQueue
+
+
+/**
+ * @brief Get the notifyAsync() counters.
+ */
+BLECharacteristic::NotifyStats BLECharacteristic::getNotifyStats() {
+	NotifyStats stats;
+	memset(&stats, 0, sizeof(stats));
+	if (m_pNotifyQueue != nullptr) {
+		portENTER_CRITICAL(&m_pNotifyQueue->m_mux);
+		stats = m_pNotifyQueue->m_stats;
+		portEXIT_CRITICAL(&m_pNotifyQueue->m_mux);
+	}
+	return stats;
+} // getNotifyStats
+
+
+void BLECharacteristic::resetNotifyStats() {
+	if (m_pNotifyQueue != nullptr) {
+		portENTER_CRITICAL(&m_pNotifyQueue->m_mux);
+		memset(&m_pNotifyQueue->m_stats, 0, sizeof(m_pNotifyQueue->m_stats));
+		portEXIT_CRITICAL(&m_pNotifyQueue->m_mux);
+	}
+} // resetNotifyStats
+
+
 /**
  * @brief Set the permission to broadcast.
  * A characteristics has properties associated with it which define what it is capable of doing.
@@ -18,9 +18,35 @@
 #include "BLEValue.h"
 #include "RTOS.h"
 
+// Values a peer may have in flight per characteristic before notifyAsync() holds back
+#ifndef BLE_NOTIFY_CREDITS
+#define BLE_NOTIFY_CREDITS 4
+#endif
+
+// Time without a confirmation after which a peer's credits are taken back, so a lost
+// ESP_GATTS_CONF_EVT cannot stall its notifications for good
+#ifndef BLE_NOTIFY_CREDIT_TIMEOUT_MS
+#define BLE_NOTIFY_CREDIT_TIMEOUT_MS 1000
+#endif
+
+// Largest value notifyAsync() queues, longer ones are truncated
+#ifndef BLE_NOTIFY_VALUE_MAX
+#define BLE_NOTIFY_VALUE_MAX 244
+#endif
+
+// Connections tracked by notifyAsync()
+#ifndef BLE_NOTIFY_MAX_PEERS
+#ifdef CONFIG_BT_ACL_CONNECTIONS
+#define BLE_NOTIFY_MAX_PEERS CONFIG_BT_ACL_CONNECTIONS
+#else
+#define BLE_NOTIFY_MAX_PEERS 4
+#endif
+#endif
+
 class BLEService;
 class BLEDescriptor;
 class BLECharacteristicCallbacks;
+class BLENotifyQueue;
 
 /**
  * @brief A management structure for %BLE descriptors.
@@ -66,6 +92,29 @@ public:
 
 	void indicate();
 	void notify(bool is_notification = true);
+
+	typedef enum {
+		NOTIFY_QUEUE_LATEST,   // a peer only ever gets the newest pending value
+		NOTIFY_QUEUE_FIFO      // every value is delivered in order, new ones are refused when full
+	} NotifyQueueMode;
+
+	typedef struct {
+		uint32_t queued;       // values accepted by notifyAsync()
+		uint32_t sent;         // packets handed to the stack
+		uint32_t confirmed;    // packets the stack reported as done
+		uint32_t bytes;        // payload bytes handed to the stack
+		uint32_t dropped;      // per peer values superseded, refused or lost on disconnect
+		uint32_t congested;    // sends held back by a congested link or a peer without credits
+		uint32_t errors;       // sends or confirmations that failed
+		uint32_t timeouts;     // times a peer's credits were taken back without a confirmation
+	} NotifyStats;
+
+	bool        setNotifyQueue(NotifyQueueMode mode, uint8_t depth = 1, uint8_t credits = BLE_NOTIFY_CREDITS);
+	bool        notifyAsync(bool is_notification = true);
+	bool        notifyAsync(const uint8_t* data, size_t length, bool is_notification = true);
+	NotifyStats getNotifyStats();
+	void        resetNotifyStats();
+
 	void setBroadcastProperty(bool value);
 	void setCallbacks(BLECharacteristicCallbacks* pCallbacks);
 	void setIndicateProperty(bool value);
@@ -108,6 +157,7 @@ private:
 	BLEService*                 m_pService;
 	BLEValue                    m_value;
 	esp_gatt_perm_t             m_permissions = ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE;
+	BLENotifyQueue*             m_pNotifyQueue = nullptr;
 	bool						m_writeEvt = false; // If we have started a long write, this tells the commit code that we were the target
 
 	void handleGATTServerEvent(
@@ -119,6 +169,7 @@ private:
 	esp_gatt_char_prop_t getProperties();
 	BLEService*          getService();
 	void                 setHandle(uint16_t handle);
+	void                 pumpNotifyQueue();
 	FreeRTOS::Semaphore m_semaphoreCreateEvt = FreeRTOS::Semaphore("CreateEvt");
 	FreeRTOS::Semaphore m_semaphoreConfEvt   = FreeRTOS::Semaphore("ConfEvt");
 	FreeRTOS::Semaphore m_semaphoreSetValue  = FreeRTOS::Semaphore("SetValue");  
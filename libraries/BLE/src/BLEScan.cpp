@@ -13,7 +13,6 @@
 
 #include <esp_err.h>
 
-#include <map>
 
 #include "BLEAdvertisedDevice.h"
 #include "BLEScan.h"
@@ -34,6 +33,8 @@ BLEScan::BLEScan() {
 	m_stopped                        = true;
 	m_wantDuplicates                 = false;
 	m_shouldParse                    = true;
+	m_pRawCallbacks                  = nullptr;
+	m_scanResults.m_pTable           = &m_resultTable;
 	setInterval(100);
 	setWindow(100);
 } // BLEScan
@@ -90,48 +91,46 @@ void BLEScan::handleGAPEvent(
 						break;
 					}
 
-// Examine our list of previously scanned addresses and, if we found this one already,
-// ignore it.
-					BLEAddress advertisedAddress(param->scan_rst.bda);
-					bool found = false;
-					bool shouldDelete = true;
-
-					if (!m_wantDuplicates) {
-						if (m_scanResults.m_vectorAdvertisedDevices.count(advertisedAddress.toString()) != 0) {
-							found = true;
-						}
+					uint8_t* payload = (uint8_t*)param->scan_rst.ble_adv;
+					size_t payloadLength = param->scan_rst.adv_data_len + param->scan_rst.scan_rsp_len;
 
-						if (found) {  // If we found a previous entry AND we don't want duplicates, then we are done.
-							log_d("Ignoring %s, already seen it.", advertisedAddress.toString().c_str());
-							vTaskDelay(1);  // <--- allow to switch task in case we scan infinity and dont have new devices to report, or we are blocked here
+					if (m_pRawCallbacks != nullptr) {
+						BLEAdvertisementView records(payload, payloadLength);
+						if (!m_pRawCallbacks->onRawResult(param->scan_rst, records)) {
 							break;
 						}
 					}
 
+// Examine our list of previously scanned addresses and, if we found this one already,
+// ignore it.
+					if (!m_wantDuplicates && m_resultTable.find(param->scan_rst.bda) != nullptr) {
+						// If we found a previous entry AND we don't want duplicates, then we are done.
+						log_d("Ignoring %s, already seen it.", BLEAddress(param->scan_rst.bda).toString().c_str());
+						vTaskDelay(1);  // <--- allow to switch task in case we scan infinity and dont have new devices to report, or we are blocked here
+						break;
+					}
+
 					// We now construct a model of the advertised device that we have just found for the first
 					// time.
 					// ESP_LOG_BUFFER_HEXDUMP((uint8_t*)param->scan_rst.ble_adv, param->scan_rst.adv_data_len + param->scan_rst.scan_rsp_len, ESP_LOG_DEBUG);
 					// log_w("bytes length: %d + %d, addr type: %d", param->scan_rst.adv_data_len, param->scan_rst.scan_rsp_len, param->scan_rst.ble_addr_type);
 					BLEAdvertisedDevice *advertisedDevice = new BLEAdvertisedDevice();
-					advertisedDevice->setAddress(advertisedAddress);
+					advertisedDevice->setAddress(BLEAddress(param->scan_rst.bda));
 					advertisedDevice->setRSSI(param->scan_rst.rssi);
 					advertisedDevice->setAdFlag(param->scan_rst.flag);
 					if (m_shouldParse) {
-						advertisedDevice->parseAdvertisement((uint8_t*)param->scan_rst.ble_adv, param->scan_rst.adv_data_len + param->scan_rst.scan_rsp_len);
+						advertisedDevice->parseAdvertisement(payload, payloadLength);
 					} else {
-						advertisedDevice->setPayload((uint8_t*)param->scan_rst.ble_adv, param->scan_rst.adv_data_len + param->scan_rst.scan_rsp_len);
+						advertisedDevice->setPayload(payload, payloadLength);
 					}
 					advertisedDevice->setScan(this);
 					advertisedDevice->setAddressType(param->scan_rst.ble_addr_type);
 
 					if (m_pAdvertisedDeviceCallbacks) { // if has callback, no need to record to vector
 						m_pAdvertisedDeviceCallbacks->onResult(*advertisedDevice);
-					} 
-					if (!m_wantDuplicates && !found) {   // if no callback and not want duplicate, and not already in vector, record it
-						m_scanResults.m_vectorAdvertisedDevices.insert(std::pair<std::string, BLEAdvertisedDevice*>(advertisedAddress.toString(), advertisedDevice));
-						shouldDelete = false;
 					}
-					if (shouldDelete) {
+					// if not want duplicate, record it; the table owns it from there
+					if (m_wantDuplicates || !m_resultTable.insert(param->scan_rst.bda, advertisedDevice)) {
 						delete advertisedDevice;
 					}
 
@@ -261,6 +260,25 @@ void BLEScan::setActiveScan(bool active) {
 } // setActiveScan
 
 
+/**
+ * @brief Set the call backs receiving raw advertising reports.
+ * @param [in] pRawCallbacks Call backs to be invoked, nullptr to stop.
+ */
+void BLEScan::setRawAdvertisedDeviceCallbacks(BLERawAdvertisedDeviceCallbacks* pRawCallbacks) {
+	m_pRawCallbacks = pRawCallbacks;
+} // setRawAdvertisedDeviceCallbacks
+
+
+/**
+ * @brief Set how many devices the scan results keep.
+ * Once full, the device seen least recently makes room for a new one.  Current results are cleared.
+ * @param [in] maxResults The maximum number of devices, BLE_SCAN_RESULTS_MAX by default.
+ */
+void BLEScan::setMaxResults(uint16_t maxResults) {
+	m_resultTable.setCapacity(maxResults);
+} // setMaxResults
+
+
 /**
  * @brief Set the call backs to be invoked.
  * @param [in] pAdvertisedDeviceCallbacks Call backs to be invoked.
@@ -390,10 +408,7 @@ bool BLEScan::start(uint32_t duration, void (*scanCompleteCB)(BLEScanResults), b
 	//  if we are connecting to devices that are advertising even after being connected, multiconnecting peripherals
 	//  then we should not clear map or we will connect the same device few times
 	if(!is_continue) {  
-		for(auto _dev : m_scanResults.m_vectorAdvertisedDevices){
-			delete _dev.second;
-		}
-		m_scanResults.m_vectorAdvertisedDevices.clear();
+		m_resultTable.clear();
 	}
 
 	esp_err_t errRc = ::esp_ble_gap_set_scan_params(&m_scan_params);
@@ -455,9 +470,7 @@ void BLEScan::stop() {
 // delete peer device from cache after disconnecting, it is required in case we are connecting to devices with not public address
 void BLEScan::erase(BLEAddress address) {
 	log_i("erase device: %s", address.toString().c_str());
-	BLEAdvertisedDevice *advertisedDevice = m_scanResults.m_vectorAdvertisedDevices.find(address.toString())->second;
-	m_scanResults.m_vectorAdvertisedDevices.erase(address.toString());
-	delete advertisedDevice;
+	m_resultTable.erase(*address.getNative());
 }
 
 
@@ -477,7 +490,7 @@ void BLEScanResults::dump() {
  * @return The number of devices found in the last scan.
  */
 int BLEScanResults::getCount() {
-	return m_vectorAdvertisedDevices.size();
+	return m_pTable ? m_pTable->getCount() : 0;
 } // getCount
 
 
@@ -488,14 +501,11 @@ int BLEScanResults::getCount() {
  * @return The device at the specified index.
  */
 BLEAdvertisedDevice BLEScanResults::getDevice(uint32_t i) {
-	uint32_t x = 0;
-	BLEAdvertisedDevice dev = *m_vectorAdvertisedDevices.begin()->second;
-	for (auto it = m_vectorAdvertisedDevices.begin(); it != m_vectorAdvertisedDevices.end(); it++) {
-		dev = *it->second;
-		if (x==i)	break;
-		x++;
+	BLEAdvertisedDevice* pDevice = m_pTable ? m_pTable->getDevice(i) : nullptr;
+	if (pDevice == nullptr) {
+		return BLEAdvertisedDevice();
 	}
-	return dev;
+	return *pDevice;
 }
 
 BLEScanResults BLEScan::getResults() {
@@ -503,10 +513,212 @@ BLEScanResults BLEScan::getResults() {
 }
 
 void BLEScan::clearResults() {
-	for(auto _dev : m_scanResults.m_vectorAdvertisedDevices){
-		delete _dev.second;
-	}
-	m_scanResults.m_vectorAdvertisedDevices.clear();
+	m_resultTable.clear();
 }
 
+
+BLEScanResultTable::BLEScanResultTable() {
+} // BLEScanResultTable
+
+
+BLEScanResultTable::~BLEScanResultTable() {
+	release();
+} // ~BLEScanResultTable
+
+
+/**
+ * @brief Set how many devices are kept.  Current devices are deleted.
+ * @param [in] capacity The maximum number of devices.
+ */
+void BLEScanResultTable::setCapacity(uint16_t capacity) {
+	release();
+	if (capacity == 0) {
+		capacity = 1;
+	}
+	m_capacity = capacity > 0x4000 ? 0x4000 : capacity;
+} // setCapacity
+
+
+uint16_t BLEScanResultTable::getCapacity() {
+	return m_capacity;
+} // getCapacity
+
+
+bool BLEScanResultTable::allocate() {
+	size_t slots = 2;
+	while (slots < 2 * (size_t)m_capacity) {
+		slots <<= 1;
+	}
+	m_entries = (Entry*)malloc(m_capacity * sizeof(Entry));
+	m_index = (uint16_t*)calloc(slots, sizeof(uint16_t));
+	if (m_entries == nullptr || m_index == nullptr) {
+		log_e("out of memory for %d scan results", m_capacity);
+		release();
+		return false;
+	}
+	m_mask = slots - 1;
+	return true;
+} // allocate
+
+
+void BLEScanResultTable::release() {
+	clear();
+	free(m_entries);
+	free(m_index);
+	m_entries = nullptr;
+	m_index = nullptr;
+	m_mask = 0;
+} // release
+
+
+uint16_t BLEScanResultTable::hash(const uint8_t* address) {
+	// FNV-1a
+	uint32_t h = 2166136261UL;
+	for (int i = 0; i < ESP_BD_ADDR_LEN; i++) {
+		h = (h ^ address[i]) * 16777619UL;
+	}
+	return (h ^ (h >> 16)) & m_mask;
+} // hash
+
+
+/**
+ * @brief Find the index slot holding an address.
+ * @return The slot, or -1 if the address is not in the table.
+ */
+int BLEScanResultTable::findSlot(const uint8_t* address) {
+	if (m_index == nullptr) {
+		return -1;
+	}
+	for (uint16_t slot = hash(address); m_index[slot] != 0; slot = (slot + 1) & m_mask) {
+		if (memcmp(m_entries[m_index[slot] - 1].address, address, ESP_BD_ADDR_LEN) == 0) {
+			return slot;
+		}
+	}
+	return -1;
+} // findSlot
+
+
+/**
+ * @brief Look a device up by address and mark it as just seen.
+ * @return The device, or nullptr if it is not in the table.
+ */
+BLEAdvertisedDevice* BLEScanResultTable::find(const uint8_t* address) {
+	int slot = findSlot(address);
+	if (slot < 0) {
+		return nullptr;
+	}
+	Entry& entry = m_entries[m_index[slot] - 1];
+	entry.lastSeen = ++m_clock;
+	return entry.device;
+} // find
+
+
+/**
+ * @brief Add a device not in the table yet, evicting the least recently seen one when full.
+ * @param [in] address The device address.
+ * @param [in] device The device, owned by the table on success.
+ * @return False if the storage could not be allocated.
+ */
+bool BLEScanResultTable::insert(const uint8_t* address, BLEAdvertisedDevice* device) {
+	if (m_index == nullptr && !allocate()) {
+		return false;
+	}
+	if (m_count == m_capacity) {
+		uint16_t oldest = 0;
+		for (uint16_t i = 1; i < m_count; i++) {
+			if ((int32_t)(m_entries[i].lastSeen - m_entries[oldest].lastSeen) < 0) {
+				oldest = i;
+			}
+		}
+		log_d("scan results full, dropping the least recently seen device");
+		removeAt(findSlot(m_entries[oldest].address));
+	}
+	uint16_t slot = hash(address);
+	while (m_index[slot] != 0) {
+		slot = (slot + 1) & m_mask;
+	}
+	Entry& entry = m_entries[m_count];
+	memcpy(entry.address, address, ESP_BD_ADDR_LEN);
+	entry.lastSeen = ++m_clock;
+	entry.device = device;
+	m_index[slot] = ++m_count;
+	return true;
+} // insert
+
+
+/**
+ * @brief Delete the device in a given index slot.
+ */
+void BLEScanResultTable::removeAt(int slot) {
+	uint16_t entry = m_index[slot] - 1;
+	delete m_entries[entry].device;
+
+	// backward shift deletion keeps every probe sequence free of holes
+	uint16_t hole = slot;
+	m_index[hole] = 0;
+	for (uint16_t next = (hole + 1) & m_mask; m_index[next] != 0; next = (next + 1) & m_mask) {
+		uint16_t home = hash(m_entries[m_index[next] - 1].address);
+		// move it back unless its home lies cyclically in (hole, next]
+		bool stays = (hole <= next) ? (home > hole && home <= next) : (home > hole || home <= next);
+		if (!stays) {
+			m_index[hole] = m_index[next];
+			m_index[next] = 0;
+			hole = next;
+		}
+	}
+
+	// keep the entries dense by moving the last one into the gap
+	uint16_t last = m_count - 1;
+	if (entry != last) {
+		m_entries[entry] = m_entries[last];
+		uint16_t moved = hash(m_entries[entry].address);
+		while (m_index[moved] != last + 1) {
+			moved = (moved + 1) & m_mask;
+		}
+		m_index[moved] = entry + 1;
+	}
+	m_count--;
+} // removeAt
+
+
+/**
+ * @brief Delete the device with a given address.
+ * @return False if it was not in the table.
+ */
+bool BLEScanResultTable::erase(const uint8_t* address) {
+	int slot = findSlot(address);
+	if (slot < 0) {
+		return false;
+	}
+	removeAt(slot);
+	return true;
+} // erase
+
+
+/**
+ * @brief Delete all devices, the storage is kept.
+ */
+void BLEScanResultTable::clear() {
+	for (uint16_t i = 0; i < m_count; i++) {
+		delete m_entries[i].device;
+	}
+	m_count = 0;
+	if (m_index != nullptr) {
+		memset(m_index, 0, (m_mask + 1) * sizeof(uint16_t));
+	}
+} // clear
+
+
+int BLEScanResultTable::getCount() {
+	return m_count;
+} // getCount
+
+
+/**
+ * @brief Return the device at a position between 0 and getCount()-1.
+ */
+BLEAdvertisedDevice* BLEScanResultTable::getDevice(uint32_t i) {
+	return i < m_count ? m_entries[i].device : nullptr;
+} // getDevice
+
 #endif /* CONFIG_BLUEDROID_ENABLED */
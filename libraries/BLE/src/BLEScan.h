@@ -14,11 +14,18 @@
 // #include <vector>
 #include <string>
 #include "BLEAdvertisedDevice.h"
+#include "BLEAdvertisementView.h"
 #include "BLEClient.h"
 #include "RTOS.h"
 
+// Devices kept by a scan; once full, the one seen least recently is dropped
+#ifndef BLE_SCAN_RESULTS_MAX
+#define BLE_SCAN_RESULTS_MAX 128
+#endif
+
 class BLEAdvertisedDevice;
 class BLEAdvertisedDeviceCallbacks;
+class BLERawAdvertisedDeviceCallbacks;
 class BLEExtAdvertisingCallbacks;
 class BLEClient;
 class BLEScan;
@@ -35,6 +42,50 @@ struct esp_ble_periodic_adv_sync_estab_param_t {
 	uint8_t adv_clk_accuracy;            /*!< periodic advertising clock accuracy */
 };
 
+/**
+ * @brief The devices found by a scan, keyed by their 6 byte address.
+ *
+ * Open addressing with linear probing over an index of twice the capacity, so a lookup
+ * neither formats the address nor allocates.  The devices sit in a dense array that can be
+ * walked by position.  When the table is full, the device seen least recently is deleted to
+ * make room for a new one.  Storage is allocated on the first insert and kept until the
+ * capacity changes.
+ */
+class BLEScanResultTable {
+public:
+	BLEScanResultTable();
+	~BLEScanResultTable();
+
+	void                 setCapacity(uint16_t capacity);
+	uint16_t             getCapacity();
+	BLEAdvertisedDevice* find(const uint8_t* address);
+	bool                 insert(const uint8_t* address, BLEAdvertisedDevice* device);
+	bool                 erase(const uint8_t* address);
+	void                 clear();
+	int                  getCount();
+	BLEAdvertisedDevice* getDevice(uint32_t i);
+
+private:
+	struct Entry {
+		esp_bd_addr_t        address;
+		uint32_t             lastSeen;
+		BLEAdvertisedDevice* device;
+	};
+
+	bool     allocate();
+	void     release();
+	uint16_t hash(const uint8_t* address);
+	int      findSlot(const uint8_t* address);
+	void     removeAt(int slot);
+
+	Entry*    m_entries  = nullptr;
+	uint16_t* m_index    = nullptr;  // entry number + 1, 0 for a free slot
+	uint16_t  m_capacity = BLE_SCAN_RESULTS_MAX;
+	uint16_t  m_count    = 0;
+	uint16_t  m_mask     = 0;
+	uint32_t  m_clock    = 0;
+};
+
 /**
  * @brief The result of having performed a scan.
  * When a scan completes, we have a set of found devices.  Each device is described
@@ -50,7 +101,7 @@ public:
 
 private:
 	friend BLEScan;
-	std::map<std::string, BLEAdvertisedDevice*> m_vectorAdvertisedDevices;
+	BLEScanResultTable* m_pTable = nullptr;
 };
 
 /**
@@ -65,6 +116,8 @@ public:
 			              BLEAdvertisedDeviceCallbacks* pAdvertisedDeviceCallbacks,
 										bool wantDuplicates = false,
 										bool shouldParse = true);
+	void           setRawAdvertisedDeviceCallbacks(BLERawAdvertisedDeviceCallbacks* pRawCallbacks);
+	void           setMaxResults(uint16_t maxResults);
 	void           setInterval(uint16_t intervalMSecs);
 	void           setWindow(uint16_t windowMSecs);
 	bool           start(uint32_t duration, void (*scanCompleteCB)(BLEScanResults), bool is_continue = false);
@@ -97,14 +150,33 @@ private:
 
 	esp_ble_scan_params_t         m_scan_params;
 	BLEAdvertisedDeviceCallbacks* m_pAdvertisedDeviceCallbacks = nullptr;
+	BLERawAdvertisedDeviceCallbacks* m_pRawCallbacks = nullptr;
 	bool                          m_stopped = true;
 	bool                          m_shouldParse = true;
 	FreeRTOS::Semaphore           m_semaphoreScanEnd = FreeRTOS::Semaphore("ScanEnd");
+	BLEScanResultTable            m_resultTable;
 	BLEScanResults                m_scanResults;
 	bool                          m_wantDuplicates;
 	void                        (*m_scanCompleteCB)(BLEScanResults scanResults);
 }; // BLEScan
 
+/**
+ * @brief Callback receiving every advertising report before any BLEAdvertisedDevice is built.
+ *
+ * Nothing is copied or allocated on the way: the report and the records point into the
+ * stack's event and are only valid during the call.
+ */
+class BLERawAdvertisedDeviceCallbacks {
+public:
+	virtual ~BLERawAdvertisedDeviceCallbacks() {}
+	/**
+	 * @brief Called for each advertising report.
+	 * @return True to carry on with the usual processing (result table and onResult()),
+	 * false when the report has been dealt with.
+	 */
+	virtual bool onRawResult(const esp_ble_gap_cb_param_t::ble_scan_result_evt_param& report, const BLEAdvertisementView& records) = 0;
+};
+
 class BLEPeriodicScanCallbacks {
 public:
 	virtual ~BLEPeriodicScanCallbacks() {}
@@ -9,27 +9,91 @@
 #define DEBUG_OUTPUT Serial
 #endif
 
+#define DNS_MAX_NAME_SIZE 255   // wire format, including the terminating zero
+#define DNS_MAX_LABELS 128
+
+// Converts "Foo.example.com" to lowercase wire format "\3foo\7example\3com\0".
+// A leading "*." (or a lone "*") sets wildcard and is not encoded.
+static bool encodeName(const String &name, uint8_t *out, uint16_t &length, bool *wildcard)
+{
+  const char *p = name.c_str();
+  size_t n = name.length();
+  if (wildcard) {
+    *wildcard = false;
+    if (n == 1 && p[0] == '*') {
+      *wildcard = true;
+      out[0] = 0;
+      length = 1;
+      return true;
+    }
+    if (n > 2 && p[0] == '*' && p[1] == '.') {
+      *wildcard = true;
+      p += 2;
+      n -= 2;
+    }
+  }
+  if (n && p[n - 1] == '.')
+    n--;
+  if (n == 0 || n > DNS_MAX_NAME_SIZE - 2)
+    return false;
+
+  uint16_t o = 0;
+  while (true)
+  {
+    const char *dot = (const char *)memchr(p, '.', n);
+    size_t l = dot ? (size_t)(dot - p) : n;
+    if (l == 0 || l > 63)
+      return false;
+    out[o++] = l;
+    for (size_t i = 0; i < l; i++)
+      out[o++] = tolower((unsigned char)p[i]);
+    if (!dot)
+      break;
+    p += l + 1;
+    n -= l + 1;
+  }
+  out[o++] = 0;
+  length = o;
+  return true;
+}
+
+// Label length bytes are at most 63 so lowering the whole wire name is safe
+static bool wireEquals(const uint8_t *name, const uint8_t *lowered, uint16_t length)
+{
+  for (uint16_t i = 0; i < length; i++) {
+    if (tolower(name[i]) != lowered[i])
+      return false;
+  }
+  return true;
+}
+
+// Offsets of each label in a validated wire name; the offset of the
+// terminating zero is stored after the last label.
+static uint8_t wireLabels(const uint8_t *name, uint16_t *labels)
+{
+  uint8_t count = 0;
+  uint16_t pos = 0;
+  while (name[pos] != 0 && count < DNS_MAX_LABELS - 1) {
+    labels[count++] = pos;
+    pos += name[pos] + 1;
+  }
+  labels[count] = pos;
+  return count;
+}
+
 DNSServer::DNSServer()
 {
   _ttl = htonl(DNS_DEFAULT_TTL);
   _errorReplyCode = DNSReplyCode::NonExistentDomain;
-  _dnsHeader    = (DNSHeader*) malloc( sizeof(DNSHeader) ) ;
-  _dnsQuestion  = (DNSQuestion*) malloc( sizeof(DNSQuestion) ) ;     
   _buffer     = NULL;
   _currentPacketSize = 0;
   _port = 0;
+  _recordCount = 0;
 }
 
 DNSServer::~DNSServer()
 {
-  if (_dnsHeader) {
-    free(_dnsHeader);
-    _dnsHeader = NULL;
-  }
-  if (_dnsQuestion) {
-    free(_dnsQuestion);
-    _dnsQuestion = NULL;
-  }
+  clearRecords();
   if (_buffer) {
     free(_buffer);
     _buffer = NULL;
@@ -38,15 +102,31 @@ DNSServer::~DNSServer()
 
 bool DNSServer::start(const uint16_t &port, const String &domainName,
                      const IPAddress &resolvedIP)
+{
+  // Compatible behaviour: answer the domain with and without "www."
+  String domain = domainName;
+  domain.toLowerCase();
+  clearRecords();
+  if (domain == "*") {
+    addRecord(domain, resolvedIP);
+  } else {
+    if (domain.startsWith("www."))
+      domain.remove(0, 4);
+    if (!addRecord(domain, resolvedIP))
+      return false;
+    addRecord(String("www.") + domain, resolvedIP);
+  }
+  return start(port);
+}
+
+bool DNSServer::start(const uint16_t &port)
 {
   _port = port;
-  _buffer = NULL;
-  _domainName = domainName;
-  _resolvedIP[0] = resolvedIP[0];
-  _resolvedIP[1] = resolvedIP[1];
-  _resolvedIP[2] = resolvedIP[2];
-  _resolvedIP[3] = resolvedIP[3];
-  downcaseAndRemoveWwwPrefix(_domainName);
+  if (_buffer == NULL) {
+    _buffer = (unsigned char*)malloc(DNS_MAX_PACKET_SIZE);
+    if (_buffer == NULL)
+      return false;
+  }
   return _udp.begin(_port) == 1;
 }
 
@@ -67,157 +147,242 @@ void DNSServer::stop()
   _buffer = NULL;
 }
 
-void DNSServer::downcaseAndRemoveWwwPrefix(String &domainName)
+bool DNSServer::addRecord(const String &name, const IPAddress &ip)
 {
-  domainName.toLowerCase();
-  domainName.replace("www.", "");
+  uint8_t rdata[DNS_RDLENGTH_IPV4] = { ip[0], ip[1], ip[2], ip[3] };
+  return addRecord(name, DNS_TYPE_A, rdata, sizeof(rdata));
 }
 
-void DNSServer::processNextRequest()
+bool DNSServer::addRecord(const String &name, const IPv6Address &ip)
 {
-  _currentPacketSize = _udp.parsePacket();
-  if (_currentPacketSize)
-  {
-    // Allocate buffer for the DNS query
-    if (_buffer != NULL) 
-      free(_buffer);
-    _buffer = (unsigned char*)malloc(_currentPacketSize * sizeof(char));
-    if (_buffer == NULL) 
-      return;
+  return addRecord(name, DNS_TYPE_AAAA, (const uint8_t *)ip, DNS_RDLENGTH_IPV6);
+}
 
-    // Put the packet received in the buffer and get DNS header (beginning of message)
-    // and the question
-    _udp.read(_buffer, _currentPacketSize);
-    memcpy( _dnsHeader, _buffer, DNS_HEADER_SIZE ) ; 
-    if ( requestIncludesOnlyOneQuestion() )
-    {
-      // The QName has a variable length, maximum 255 bytes and is comprised of multiple labels.
-      // Each label contains a byte to describe its length and the label itself. The list of 
-      // labels terminates with a zero-valued byte. In "github.com", we have two labels "github" & "com"
-      // Iterate through the labels and copy them as they come into a single buffer (for simplicity's sake)
-      _dnsQuestion->QNameLength = 0 ;
-      while ( _buffer[ DNS_HEADER_SIZE + _dnsQuestion->QNameLength ] != 0 )
-      {
-        memcpy( (void*) &_dnsQuestion->QName[_dnsQuestion->QNameLength], (void*) &_buffer[DNS_HEADER_SIZE + _dnsQuestion->QNameLength], _buffer[DNS_HEADER_SIZE + _dnsQuestion->QNameLength] + 1 ) ;
-        _dnsQuestion->QNameLength += _buffer[DNS_HEADER_SIZE + _dnsQuestion->QNameLength] + 1 ; 
-      }
-      _dnsQuestion->QName[_dnsQuestion->QNameLength] = 0 ; 
-      _dnsQuestion->QNameLength++ ;   
+bool DNSServer::addCNAME(const String &name, const String &target)
+{
+  uint8_t rdata[DNS_MAX_NAME_SIZE];
+  uint16_t rdLength;
+  if (!encodeName(target, rdata, rdLength, NULL))
+    return false;
+  return addRecord(name, DNS_TYPE_CNAME, rdata, rdLength);
+}
 
-      // Copy the QType and QClass 
-      memcpy( &_dnsQuestion->QType, (void*) &_buffer[DNS_HEADER_SIZE + _dnsQuestion->QNameLength], sizeof(_dnsQuestion->QType) ) ;
-      memcpy( &_dnsQuestion->QClass, (void*) &_buffer[DNS_HEADER_SIZE + _dnsQuestion->QNameLength + sizeof(_dnsQuestion->QType)], sizeof(_dnsQuestion->QClass) ) ;
-    }
-    
+bool DNSServer::addRecord(const String &name, uint16_t type, const uint8_t *rdata, uint16_t rdLength)
+{
+  if (_recordCount >= DNS_MAX_RECORDS)
+    return false;
+  uint8_t wire[DNS_MAX_NAME_SIZE];
+  DNSRecord &record = _records[_recordCount];
+  if (!encodeName(name, wire, record.NameLength, &record.Wildcard))
+    return false;
+  record.Name = (uint8_t *)malloc(record.NameLength + rdLength);
+  if (record.Name == NULL)
+    return false;
+  memcpy(record.Name, wire, record.NameLength);
+  record.RData = record.Name + record.NameLength;
+  memcpy(record.RData, rdata, rdLength);
+  record.RDLength = rdLength;
+  record.Type = type;
+  _recordCount++;
+  return true;
+}
 
-    if (_dnsHeader->QR == DNS_QR_QUERY &&
-        _dnsHeader->OPCode == DNS_OPCODE_QUERY &&
-        requestIncludesOnlyOneQuestion() &&
-        (_domainName == "*" || getDomainNameWithoutWwwPrefix() == _domainName)
-       )
-    {
-      replyWithIP();
-    }
-    else if (_dnsHeader->QR == DNS_QR_QUERY)
-    {
-      replyWithCustomCode();
+void DNSServer::clearRecords()
+{
+  for (uint8_t i = 0; i < _recordCount; i++)
+    free(_records[i].Name);
+  _recordCount = 0;
+}
+
+void DNSServer::processNextRequest()
+{
+  if (_buffer == NULL)
+    return;
+  // Drain what queued up since the last call, bounded so loop() stays responsive
+  for (int i = 0; i < DNS_MAX_REQUESTS_PER_CALL; i++)
+  {
+    _currentPacketSize = _udp.parsePacket();
+    if (!_currentPacketSize)
+      return;
+    if (_currentPacketSize < DNS_HEADER_SIZE || _currentPacketSize > DNS_MAX_PACKET_SIZE) {
+      _udp.flush();
+      continue;
     }
+    _udp.read(_buffer, _currentPacketSize);
+    processRequest();
+  }
+}
 
-    free(_buffer);
-    _buffer = NULL;
+// An exact name beats any wildcard, a longer wildcard suffix beats a shorter one
+int DNSServer::matchScore(const DNSRecord &record, const uint8_t *name, uint16_t nameLength,
+                          const uint16_t *labels, uint8_t labelCount)
+{
+  if (!record.Wildcard)
+    return (nameLength == record.NameLength && wireEquals(name, record.Name, nameLength)) ? 256 : -1;
+  if (record.NameLength >= nameLength)
+    return -1;
+  uint16_t offset = nameLength - record.NameLength;
+  for (uint8_t i = 1; i <= labelCount; i++) {
+    if (labels[i] == offset)
+      return wireEquals(name + offset, record.Name, record.NameLength) ? record.NameLength : -1;
   }
+  return -1;
 }
 
-bool DNSServer::requestIncludesOnlyOneQuestion()
+int DNSServer::bestMatch(const uint8_t *name, uint16_t nameLength, const uint16_t *labels, uint8_t labelCount)
 {
-  return ntohs(_dnsHeader->QDCount) == 1 &&
-         _dnsHeader->ANCount == 0 &&
-         _dnsHeader->NSCount == 0 &&
-         _dnsHeader->ARCount == 0;
+  int best = -1;
+  for (uint8_t i = 0; i < _recordCount; i++) {
+    int score = matchScore(_records[i], name, nameLength, labels, labelCount);
+    if (score > best)
+      best = score;
+  }
+  return best;
 }
 
+bool DNSServer::appendAnswer(uint16_t &pos, uint16_t nameOffset, const DNSRecord &record)
+{
+  if (pos + 12 + record.RDLength > DNS_MAX_PACKET_SIZE)
+    return false;
+  // Use DNS name compression : the owner name is a pointer (two MSB set) to
+  // a name already present in the message
+  uint8_t *p = _buffer + pos;
+  p[0] = 0xC0 | (nameOffset >> 8);
+  p[1] = nameOffset & 0xFF;
+  p[2] = record.Type >> 8;
+  p[3] = record.Type & 0xFF;
+  p[4] = 0;
+  p[5] = DNS_CLASS_IN;
+  memcpy(p + 6, &_ttl, 4);   // DNS Time To Live, already in network order
+  p[10] = record.RDLength >> 8;
+  p[11] = record.RDLength & 0xFF;
+  memcpy(p + 12, record.RData, record.RDLength);
+  pos += 12 + record.RDLength;
+  return true;
+}
 
-String DNSServer::getDomainNameWithoutWwwPrefix()
+void DNSServer::processRequest()
 {
-  // Error checking : if the buffer containing the DNS request is a null pointer, return an empty domain
-  String parsedDomainName = "";
-  if (_buffer == NULL) 
-    return parsedDomainName;
-  
-  // Set the start of the domain just after the header (12 bytes). If equal to null character, return an empty domain
-  unsigned char *start = _buffer + DNS_OFFSET_DOMAIN_NAME;
-  if (*start == 0)
+  DNSHeader *header = (DNSHeader *)_buffer;
+  if (header->QR != DNS_QR_QUERY)
+    return;
+  // Additional records (EDNS OPT) are accepted and dropped from the reply
+  if (header->OPCode != DNS_OPCODE_QUERY || ntohs(header->QDCount) != 1 ||
+      header->ANCount != 0 || header->NSCount != 0)
   {
-    return parsedDomainName;
+    replyWithCustomCode();
+    return;
   }
 
-  int pos = 0;
-  while(true)
+  // The QName is matched in place, in wire format : length-prefixed labels
+  // terminated by a zero-valued byte. Compression is not allowed here.
+  const uint8_t *name = _buffer + DNS_HEADER_SIZE;
+  uint16_t labels[DNS_MAX_LABELS];
+  uint8_t labelCount = 0;
+  uint16_t pos = DNS_HEADER_SIZE;
+  while (true)
   {
-    unsigned char labelLength = *(start + pos);
-    for(int i = 0; i < labelLength; i++)
-    {
-      pos++;
-      parsedDomainName += (char)*(start + pos);
+    if (pos >= _currentPacketSize || labelCount == DNS_MAX_LABELS - 1) {
+      replyWithCustomCode();
+      return;
     }
-    pos++;
-    if (*(start + pos) == 0)
-    {
-      downcaseAndRemoveWwwPrefix(parsedDomainName);
-      return parsedDomainName;
+    uint8_t length = _buffer[pos];
+    if (length == 0)
+      break;
+    if (length > 63) {
+      replyWithCustomCode();
+      return;
     }
-    else
+    labels[labelCount++] = pos - DNS_HEADER_SIZE;
+    pos += length + 1;
+  }
+  labels[labelCount] = pos - DNS_HEADER_SIZE;
+  pos++;
+  uint16_t nameLength = pos - DNS_HEADER_SIZE;
+  if (nameLength > DNS_MAX_NAME_SIZE || pos + 4 > _currentPacketSize) {
+    replyWithCustomCode();
+    return;
+  }
+  uint16_t qType = (_buffer[pos] << 8) | _buffer[pos + 1];
+  uint16_t qClass = (_buffer[pos + 2] << 8) | _buffer[pos + 3];
+  pos += 4;
+
+  int best = (qClass == DNS_CLASS_IN || qClass == DNS_CLASS_ANY) ?
+             bestMatch(name, nameLength, labels, labelCount) : -1;
+  if (best < 0) {
+    replyWithCustomCode();
+    return;
+  }
+
+  // The reply reuses the query in the buffer : header and question stay,
+  // answers are appended right after the question.
+  uint16_t answers = 0;
+  bool truncated = false;
+  for (uint8_t i = 0; i < _recordCount && !truncated; i++)
+  {
+    const DNSRecord &record = _records[i];
+    if (matchScore(record, name, nameLength, labels, labelCount) != best)
+      continue;
+    if (record.Type != qType && qType != DNS_TYPE_ANY && record.Type != DNS_TYPE_CNAME)
+      continue;
+    uint16_t rdataOffset = pos + 12;
+    if (!appendAnswer(pos, DNS_HEADER_SIZE, record)) {
+      truncated = true;
+      break;
+    }
+    answers++;
+    if (record.Type != DNS_TYPE_CNAME || qType == DNS_TYPE_CNAME || qType == DNS_TYPE_ANY)
+      continue;
+
+    // Follow the alias one level when its target is in the zone
+    uint16_t targetLabels[DNS_MAX_LABELS];
+    uint8_t targetLabelCount = wireLabels(record.RData, targetLabels);
+    int targetBest = bestMatch(record.RData, record.RDLength, targetLabels, targetLabelCount);
+    for (uint8_t j = 0; j < _recordCount && targetBest >= 0; j++)
     {
-      parsedDomainName += ".";
+      const DNSRecord &target = _records[j];
+      if (target.Type != qType ||
+          matchScore(target, record.RData, record.RDLength, targetLabels, targetLabelCount) != targetBest)
+        continue;
+      if (!appendAnswer(pos, rdataOffset, target)) {
+        truncated = true;
+        break;
+      }
+      answers++;
     }
   }
-}
 
-void DNSServer::replyWithIP()
-{
+  // Change the type of message to an authoritative response; a known name
+  // without records of the asked type gets an empty NOERROR answer
+  header->QR      = DNS_QR_RESPONSE;
+  header->AA      = 1;
+  header->TC      = truncated;
+  header->RA      = 0;
+  header->RCode   = (unsigned char)DNSReplyCode::NoError;
+  header->ANCount = htons(answers);
+  header->NSCount = 0;
+  header->ARCount = 0;
+
   _udp.beginPacket(_udp.remoteIP(), _udp.remotePort());
-  
-  // Change the type of message to a response and set the number of answers equal to 
-  // the number of questions in the header
-  _dnsHeader->QR      = DNS_QR_RESPONSE;
-  _dnsHeader->ANCount = _dnsHeader->QDCount;
-  _udp.write( (unsigned char*) _dnsHeader, DNS_HEADER_SIZE ) ;
-
-  // Write the question
-  _udp.write(_dnsQuestion->QName, _dnsQuestion->QNameLength) ;
-  _udp.write( (unsigned char*) &_dnsQuestion->QType, 2 ) ;
-  _udp.write( (unsigned char*) &_dnsQuestion->QClass, 2 ) ;
-
-  // Write the answer 
-  // Use DNS name compression : instead of repeating the name in this RNAME occurence,
-  // set the two MSB of the byte corresponding normally to the length to 1. The following
-  // 14 bits must be used to specify the offset of the domain name in the message 
-  // (<255 here so the first byte has the 6 LSB at 0) 
-  _udp.write((uint8_t) 0xC0); 
-  _udp.write((uint8_t) DNS_OFFSET_DOMAIN_NAME);  
-
-  // DNS type A : host address, DNS class IN for INternet, returning an IPv4 address 
-  uint16_t answerType = htons(DNS_TYPE_A), answerClass = htons(DNS_CLASS_IN), answerIPv4 = htons(DNS_RDLENGTH_IPV4)  ; 
-  _udp.write((unsigned char*) &answerType, 2 );
-  _udp.write((unsigned char*) &answerClass, 2 );
-  _udp.write((unsigned char*) &_ttl, 4);        // DNS Time To Live
-  _udp.write((unsigned char*) &answerIPv4, 2 );
-  _udp.write(_resolvedIP, sizeof(_resolvedIP)); // The IP address to return
+  _udp.write(_buffer, pos);
   _udp.endPacket();
 
   #ifdef DEBUG_ESP_DNS
-    DEBUG_OUTPUT.printf("DNS responds: %s for %s\n",
-            IPAddress(_resolvedIP).toString().c_str(), getDomainNameWithoutWwwPrefix().c_str() );
-  #endif  
+    DEBUG_OUTPUT.printf("DNS responds: %u answers for type %u\n", answers, qType);
+  #endif
 }
 
 void DNSServer::replyWithCustomCode()
 {
-  _dnsHeader->QR = DNS_QR_RESPONSE;
-  _dnsHeader->RCode = (unsigned char)_errorReplyCode;
-  _dnsHeader->QDCount = 0;
+  DNSHeader *header = (DNSHeader *)_buffer;
+  header->QR = DNS_QR_RESPONSE;
+  header->RCode = (unsigned char)_errorReplyCode;
+  header->QDCount = 0;
+  header->ANCount = 0;
+  header->NSCount = 0;
+  header->ARCount = 0;
 
   _udp.beginPacket(_udp.remoteIP(), _udp.remotePort());
-  _udp.write((unsigned char*)_dnsHeader, sizeof(DNSHeader));
+  _udp.write(_buffer, DNS_HEADER_SIZE);
   _udp.endPacket();
 }
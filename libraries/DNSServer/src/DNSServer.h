@@ -1,6 +1,7 @@
 #ifndef DNSServer_h
 #define DNSServer_h
 #include <WiFiUdp.h>
+#include <IPv6Address.h>
 
 #define DNS_QR_QUERY 0
 #define DNS_QR_RESPONSE 1
@@ -9,6 +10,16 @@
 #define DNS_OFFSET_DOMAIN_NAME 12 // Offset in bytes to reach the domain name in the DNS message 
 #define DNS_HEADER_SIZE 12 
 
+#ifndef DNS_MAX_PACKET_SIZE
+#define DNS_MAX_PACKET_SIZE 512   // Classic DNS over UDP limit, the reply is built in place in a buffer this size
+#endif
+#ifndef DNS_MAX_RECORDS
+#define DNS_MAX_RECORDS 8         // Size of the zone table
+#endif
+#ifndef DNS_MAX_REQUESTS_PER_CALL
+#define DNS_MAX_REQUESTS_PER_CALL 8 // Queued queries answered by one processNextRequest() call
+#endif
+
 enum class DNSReplyCode
 {
   NoError   = 0,
@@ -25,21 +36,25 @@ enum class DNSReplyCode
 enum DNSType
 {
   DNS_TYPE_A      = 1,  // Host Address
+  DNS_TYPE_CNAME  = 5,  // Canonical NAME for an alias
   DNS_TYPE_AAAA   = 28, // IPv6 Address
   DNS_TYPE_SOA    = 6,  // Start Of a zone of Authority
   DNS_TYPE_PTR    = 12, // Domain name PoinTeR
-  DNS_TYPE_DNAME  = 39  // Delegation Name
+  DNS_TYPE_DNAME  = 39, // Delegation Name
+  DNS_TYPE_ANY    = 255 // All records (query only)
 } ; 
 
 enum DNSClass
 {
   DNS_CLASS_IN = 1, // INternet
-  DNS_CLASS_CH = 3  // CHaos
+  DNS_CLASS_CH = 3, // CHaos
+  DNS_CLASS_ANY = 255 // Any class (query only)
 } ; 
 
 enum DNSRDLength
 {
-  DNS_RDLENGTH_IPV4 = 4 // 4 bytes for an IPv4 address 
+  DNS_RDLENGTH_IPV4 = 4, // 4 bytes for an IPv4 address 
+  DNS_RDLENGTH_IPV6 = 16 // 16 bytes for an IPv6 address
 } ; 
 
 struct DNSHeader
@@ -72,6 +87,18 @@ struct DNSQuestion
   uint16_t  QClass ; 
 } ; 
 
+// One entry of the zone table. Name and data are kept in DNS wire format
+// (lowercase labels) so queries are matched without decoding them.
+struct DNSRecord
+{
+  uint8_t*  Name ;      // wire-format name followed by RData, one allocation
+  uint8_t*  RData ;
+  uint16_t  NameLength ;
+  uint16_t  RDLength ;
+  uint16_t  Type ;
+  bool      Wildcard ;  // "*.suffix" : matches any name below suffix, "*" : everything
+} ;
+
 class DNSServer
 {
   public:
@@ -85,26 +112,34 @@ class DNSServer
     bool start(const uint16_t &port,
               const String &domainName,
               const IPAddress &resolvedIP);
+    // Serves the records added with addRecord()/addCNAME()
+    bool start(const uint16_t &port);
     // stops the DNS server
     void stop();
 
+    // Zone table. Names may start with "*." to match every name below the
+    // suffix, "*" alone matches any name. Returns false when the table is full
+    // or the name is invalid.
+    bool addRecord(const String &name, const IPAddress &ip);
+    bool addRecord(const String &name, const IPv6Address &ip);
+    bool addCNAME(const String &name, const String &target);
+    void clearRecords();
+
   private:
     WiFiUDP _udp;
     uint16_t _port;
-    String _domainName;
-    unsigned char _resolvedIP[4];
     int _currentPacketSize;
     unsigned char* _buffer;
-    DNSHeader* _dnsHeader;
     uint32_t _ttl;
     DNSReplyCode _errorReplyCode;
-    DNSQuestion*    _dnsQuestion ; 
-
+    DNSRecord _records[DNS_MAX_RECORDS];
+    uint8_t _recordCount;
 
-    void downcaseAndRemoveWwwPrefix(String &domainName);
-    String getDomainNameWithoutWwwPrefix();
-    bool requestIncludesOnlyOneQuestion();
-    void replyWithIP();
+    bool addRecord(const String &name, uint16_t type, const uint8_t *rdata, uint16_t rdLength);
+    void processRequest();
+    int bestMatch(const uint8_t *name, uint16_t nameLength, const uint16_t *labels, uint8_t labelCount);
+    int matchScore(const DNSRecord &record, const uint8_t *name, uint16_t nameLength, const uint16_t *labels, uint8_t labelCount);
+    bool appendAnswer(uint16_t &pos, uint16_t nameOffset, const DNSRecord &record);
     void replyWithCustomCode();
 };
 #endif
@@ -28,12 +28,27 @@
 #include <esp_partition.h>
 #include <esp_log.h>
 
+// Layout metadata and chunk keys, stored next to the legacy single blob key
+#define EEPROM_KEY_SIZE   "eeprom.size"
+#define EEPROM_KEY_CHUNK  "eeprom.chunk"
+#define EEPROM_KEY_FORMAT "eeprom.%u"
+
+static size_t chunkCount(size_t size, size_t chunk_size) {
+  return (size + chunk_size - 1) / chunk_size;
+}
+
+static void chunkKey(char* key, size_t len, size_t index) {
+  snprintf(key, len, EEPROM_KEY_FORMAT, (unsigned)index);
+}
+
 EEPROMClass::EEPROMClass(void)
   : _handle(0)
   , _data(0)
   , _size(0)
   , _dirty(false)
   , _name("eeprom")
+  , _dirtyChunks(0)
+  , _untracked(false)
 {
 }
 
@@ -44,6 +59,8 @@ EEPROMClass::EEPROMClass(uint32_t sector)
   , _size(0)
   , _dirty(false)
   , _name("eeprom")
+  , _dirtyChunks(0)
+  , _untracked(false)
 {
 }
 
@@ -53,6 +70,8 @@ EEPROMClass::EEPROMClass(const char* name)
   , _size(0)
   , _dirty(false)
   , _name(name)
+  , _dirtyChunks(0)
+  , _untracked(false)
 {
 }
 
@@ -60,6 +79,12 @@ EEPROMClass::~EEPROMClass() {
   end();
 }
 
+/*
+   The data lives in NVS as blobs of EEPROM_CHUNK_SIZE bytes plus the total
+   size and chunk size, so a commit only rewrites the chunks that changed.
+   A single blob stored by older versions (or by convert) is moved to that
+   layout here, its key is erased only once the chunks are written.
+*/
 bool EEPROMClass::begin(size_t size) {
   if (!size) {
       return false;
@@ -71,70 +96,79 @@ bool EEPROMClass::begin(size_t size) {
       return false;
   }
 
+  uint32_t stored_size = 0;
+  uint16_t stored_chunk = 0;
+  if (nvs_get_u32(_handle, EEPROM_KEY_SIZE, &stored_size) != ESP_OK
+    || nvs_get_u16(_handle, EEPROM_KEY_CHUNK, &stored_chunk) != ESP_OK || !stored_chunk) {
+      stored_size = 0;
+      stored_chunk = EEPROM_CHUNK_SIZE;
+  }
+
   size_t key_size = 0;
   res = nvs_get_blob(_handle, _name, NULL, &key_size);
   if(res != ESP_OK && res != ESP_ERR_NVS_NOT_FOUND) {
       log_e("Unable to read NVS key: %d", res);
       return false;
   }
-  if (size < key_size) { // truncate
-      log_w("truncating EEPROM from %d to %d", key_size, size);
+
+  _freeData();
+  size_t chunks = chunkCount(size, EEPROM_CHUNK_SIZE);
+  _data = (uint8_t*) malloc(size);
+  _dirtyChunks = (uint8_t*) calloc((chunks + 7) / 8, 1);
+  if(!_data || !_dirtyChunks) {
+    log_e("Not enough memory for %d bytes in EEPROM", size);
+    _freeData();
+    return false;
+  }
+  memset(_data, 0xFF, size);
+  _size = size;
+
+  bool rewrite = true;
+  if (key_size) {
       uint8_t* key_data = (uint8_t*) malloc(key_size);
       if(!key_data) {
-         log_e("Not enough memory to truncate EEPROM!");
+         log_e("Not enough memory to migrate EEPROM!");
+         _freeData();
          return false;
       }
       nvs_get_blob(_handle, _name, key_data, &key_size);
-      nvs_set_blob(_handle, _name, key_data, size);
-      nvs_commit(_handle);
-      free(key_data);
-  }
-  else if (size > key_size) { // expand or new
-      size_t expand_size = size - key_size;
-      uint8_t* expand_key = (uint8_t*) malloc(expand_size);
-      if(!expand_key) {
-         log_e("Not enough memory to expand EEPROM!");
-         return false;
-      }
-      // check for adequate free space
-      if(nvs_set_blob(_handle, "expand", expand_key, expand_size)) {
-        log_e("Not enough space to expand EEPROM from %d to %d", key_size, size);
-        free(expand_key);
-        return false;
+      if (size < key_size) {
+        log_w("truncating EEPROM from %d to %d", key_size, size);
       }
-      free(expand_key);
-      nvs_erase_key(_handle, "expand");
-      uint8_t* key_data = (uint8_t*) malloc(size);
-      if(!key_data) {
-         log_e("Not enough memory to expand EEPROM!");
-         return false;
-      }
-      memset(key_data, 0xFF, size);
-      if(key_size) {
-        log_i("Expanding EEPROM from %d to %d", key_size, size);
-	// hold data while key is deleted
-        nvs_get_blob(_handle, _name, key_data, &key_size);
-        nvs_erase_key(_handle, _name);
-      } else {
-        log_i("New EEPROM of %d bytes", size);
-      }
-      nvs_commit(_handle);
-      nvs_set_blob(_handle, _name, key_data, size);
+      log_i("Migrating EEPROM of %d bytes to %d byte chunks", key_size, EEPROM_CHUNK_SIZE);
+      memcpy(_data, key_data, (size < key_size) ? size : key_size);
       free(key_data);
-      nvs_commit(_handle);
+  } else if (stored_size) {
+      _readChunks(stored_size, stored_chunk);
+      if (stored_size != size) {
+        log_i("Resizing EEPROM from %d to %d", stored_size, size);
+      }
+      rewrite = (stored_size != size || stored_chunk != EEPROM_CHUNK_SIZE);
+  } else {
+      log_i("New EEPROM of %d bytes", size);
   }
 
-  if (_data) {
-    delete[] _data;
+  if (!rewrite) {
+    return true;
   }
 
-  _data = (uint8_t*) malloc(size);
-  if(!_data) {
-    log_e("Not enough memory for %d bytes in EEPROM", size);
+  // layout keys go last so an interrupted migration starts over from the old blob
+  if (!_writeChunks(true)
+    || nvs_set_u32(_handle, EEPROM_KEY_SIZE, size) != ESP_OK
+    || nvs_set_u16(_handle, EEPROM_KEY_CHUNK, EEPROM_CHUNK_SIZE) != ESP_OK) {
+    log_e("Not enough space to store EEPROM of %d bytes", size);
+    _freeData();
     return false;
   }
-  _size = size;
-  nvs_get_blob(_handle, _name, _data, &_size);
+  if (key_size) {
+    nvs_erase_key(_handle, _name);
+  }
+  char key[16];
+  for (size_t i = chunks; i < chunkCount(stored_size, stored_chunk); i++) {
+    chunkKey(key, sizeof(key), i);
+    nvs_erase_key(_handle, key);
+  }
+  nvs_commit(_handle);
   return true;
 }
 
@@ -144,16 +178,109 @@ void EEPROMClass::end() {
   }
 
   commit();
-  if (_data) {
-    delete[] _data;
-  }
-  _data = 0;
-  _size = 0;
+  _freeData();
 
   nvs_close(_handle);
   _handle = 0;
 }
 
+void EEPROMClass::_freeData() {
+  free(_data);
+  free(_dirtyChunks);
+  _data = 0;
+  _dirtyChunks = 0;
+  _size = 0;
+  _dirty = false;
+  _untracked = false;
+}
+
+void EEPROMClass::_readChunks(size_t stored_size, size_t chunk_size) {
+  char key[16];
+  size_t chunks = chunkCount(stored_size, chunk_size);
+  uint8_t* buf = (uint8_t*) malloc(chunk_size);
+  if (!buf) {
+    log_e("Not enough memory to read EEPROM!");
+    return;
+  }
+  for (size_t i = 0; i < chunks && i * chunk_size < _size; i++) {
+    size_t offset = i * chunk_size;
+    size_t len = chunk_size;
+    chunkKey(key, sizeof(key), i);
+    if (nvs_get_blob(_handle, key, buf, &len) != ESP_OK) {
+      log_w("EEPROM chunk %u is missing", (unsigned)i);
+      continue;
+    }
+    memcpy(_data + offset, buf, (_size - offset < len) ? _size - offset : len);
+  }
+  free(buf);
+}
+
+void EEPROMClass::_markDirty(size_t address, size_t len) {
+  if (!len || address >= _size) {
+    return;
+  }
+  if (address + len > _size) {
+    len = _size - address;
+  }
+  size_t last = (address + len - 1) / EEPROM_CHUNK_SIZE;
+  for (size_t i = address / EEPROM_CHUNK_SIZE; i <= last; i++) {
+    _dirtyChunks[i / 8] |= 1 << (i % 8);
+  }
+  _dirty = true;
+}
+
+void EEPROMClass::_update(size_t address, const void* data, size_t len) {
+  if (memcmp(_data + address, data, len)) {
+    memcpy(_data + address, data, len);
+    _markDirty(address, len);
+  }
+}
+
+/*
+   Write the dirty chunks (or all of them) to NVS. The write functions only
+   mark chunks whose bytes changed. After getDataPtr() every chunk is marked,
+   so each one is read back from NVS and only written if it differs.
+*/
+bool EEPROMClass::_writeChunks(bool all) {
+  bool ret = true;
+  bool written = false;
+  char key[16];
+  size_t chunks = chunkCount(_size, EEPROM_CHUNK_SIZE);
+  uint8_t* stored = (!all && _untracked) ? (uint8_t*) malloc(EEPROM_CHUNK_SIZE) : NULL;
+  for (size_t i = 0; i < chunks; i++) {
+    uint8_t mask = 1 << (i % 8);
+    if (!all && !(_dirtyChunks[i / 8] & mask)) {
+      continue;
+    }
+    size_t offset = i * EEPROM_CHUNK_SIZE;
+    size_t len = (_size - offset < EEPROM_CHUNK_SIZE) ? _size - offset : EEPROM_CHUNK_SIZE;
+    chunkKey(key, sizeof(key), i);
+    size_t stored_len = len;
+    if (stored && nvs_get_blob(_handle, key, stored, &stored_len) == ESP_OK
+      && stored_len == len && !memcmp(stored, _data + offset, len)) {
+      _dirtyChunks[i / 8] &= ~mask;
+      continue;
+    }
+    esp_err_t err = nvs_set_blob(_handle, key, _data + offset, len);
+    if (err != ESP_OK) {
+      log_e("error in write: %s", esp_err_to_name(err));
+      ret = false;
+      continue;
+    }
+    _dirtyChunks[i / 8] &= ~mask;
+    written = true;
+  }
+  free(stored);
+  if (written) {
+    nvs_commit(_handle);
+  }
+  if (ret) {
+    _dirty = false;
+    _untracked = false;
+  }
+  return ret;
+}
+
 uint8_t EEPROMClass::read(int address) {
   if (address < 0 || (size_t)address >= _size) {
     return 0;
@@ -176,12 +303,11 @@ void EEPROMClass::write(int address, uint8_t value) {
   if (*pData != value)
   {
     *pData = value;
-    _dirty = true;
+    _markDirty(address, 1);
   }
 }
 
 bool EEPROMClass::commit() {
-  bool ret = false;
   if (!_size) {
     return false;
   }
@@ -192,19 +318,13 @@ bool EEPROMClass::commit() {
     return true;
   }
 
-  esp_err_t err = nvs_set_blob(_handle, _name, _data, _size);
-  if (err != ESP_OK) {
-    log_e("error in write: %s", esp_err_to_name(err));
-  } else {
-    _dirty = false;
-    ret = true;
-  }
-
-  return ret;
+  return _writeChunks(false);
 }
 
 uint8_t * EEPROMClass::getDataPtr() {
-  _dirty = true;
+  // writes through the pointer are not tracked, commit compares every chunk with NVS
+  _markDirty(0, _size);
+  _untracked = true;
   return &_data[0];
 }
 
@@ -519,8 +639,7 @@ size_t EEPROMClass::writeString (int address, const char* value)
   if (address + len > _size)
     return 0;
 
-  memcpy(_data + address, (const uint8_t*) value, len + 1);
-  _dirty = true;
+  _update(address, value, len + 1);
   return strlen(value);
 }
 
@@ -537,8 +656,7 @@ size_t EEPROMClass::writeBytes (int address, const void* value, size_t len)
   if (address < 0 || address + len > _size)
     return 0;
 
-  memcpy(_data + address, (const void*) value, len);
-  _dirty = true;
+  _update(address, value, len);
   return len;
 }
 
@@ -547,8 +665,7 @@ template <class T> T EEPROMClass::writeAll (int address, const T &value)
   if (address < 0 || address + sizeof(T) > _size)
     return value;
 
-  memcpy(_data + address, (const uint8_t*) &value, sizeof(T));
-  _dirty = true;
+  _update(address, &value, sizeof(T));
 
   return sizeof (value);
 }
@@ -28,6 +28,10 @@
 #ifndef EEPROM_FLASH_PARTITION_NAME
 #define EEPROM_FLASH_PARTITION_NAME "eeprom"
 #endif
+// Data is kept in NVS as blobs of this many bytes, commit() only rewrites changed ones
+#ifndef EEPROM_CHUNK_SIZE
+#define EEPROM_CHUNK_SIZE 256
+#endif
 #include <Arduino.h>
 
 typedef uint32_t nvs_handle;
@@ -63,8 +67,7 @@ class EEPROMClass {
       if (address < 0 || address + sizeof(T) > _size)
         return t;
 
-      memcpy(_data + address, (const uint8_t*) &t, sizeof(T));
-      _dirty = true;
+      _update(address, &t, sizeof(T));
       return t;
     }
 
@@ -107,11 +110,19 @@ class EEPROMClass {
     template <class T> T writeAll (int address, const T &);
 
   protected:
+    void _markDirty(size_t address, size_t len);
+    void _update(size_t address, const void* data, size_t len);
+    void _readChunks(size_t stored_size, size_t chunk_size);
+    bool _writeChunks(bool all);
+    void _freeData();
+
     nvs_handle _handle;
     uint8_t* _data;
     size_t _size;
     bool _dirty;
     const char* _name;
+    uint8_t* _dirtyChunks;
+    bool _untracked;    // getDataPtr() was handed out since the last commit
 };
 
 #if !defined(NO_GLOBAL_INSTANCES) && !defined(NO_GLOBAL_EEPROM)
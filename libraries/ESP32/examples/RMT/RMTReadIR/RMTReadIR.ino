@@ -0,0 +1,50 @@
+#include "Arduino.h"
+#include "esp32-hal.h"
+
+// IR receiver (e.g. TSOP38238) output connected to GPIO 4
+#define IR_PIN 4
+
+rmt_obj_t* rmt_recv = NULL;
+float realNanoTick;
+
+void setup()
+{
+  Serial.begin(115200);
+
+  if ((rmt_recv = rmtInit(IR_PIN, RMT_RX_MODE, RMT_MEM_192)) == NULL)
+  {
+    Serial.println("init receiver failed\n");
+  }
+  realNanoTick = rmtSetTick(rmt_recv, 1000);
+  // end of frame after 12ms of idle line
+  rmtSetRxThreshold(rmt_recv, 12000);
+  rmtBeginReceive(rmt_recv);
+}
+
+void loop()
+{
+  size_t len = 0;
+  rmt_frame_t frame;
+
+  // the slice points straight into the RMT ring buffer, no copy is made
+  const rmt_data_t* items = rmtReceiveSlice(rmt_recv, &len, 1000);
+  if (!items) {
+    return;
+  }
+  switch (rmtDecode(items, len, realNanoTick, RMT_PROTO_NEC | RMT_PROTO_RC5, &frame)) {
+    case RMT_PROTO_NEC:
+      if (frame.nec.repeat) {
+        Serial.println("NEC repeat");
+      } else {
+        Serial.printf("NEC address: 0x%02x command: 0x%02x\n", frame.nec.address, frame.nec.command);
+      }
+      break;
+    case RMT_PROTO_RC5:
+      Serial.printf("RC5 address: %u command: %u toggle: %u\n", frame.rc5.address, frame.rc5.command, frame.rc5.toggle);
+      break;
+    default:
+      Serial.printf("Unknown frame of %u items\n", len);
+      break;
+  }
+  rmtReleaseSlice(rmt_recv, items);
+}
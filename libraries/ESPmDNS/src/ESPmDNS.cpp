@@ -51,6 +51,24 @@ License (MIT license):
 #define STR(tok) tok
 #endif
 
+struct MDNSBrowse {
+    String service;
+    String proto;
+    MDNSServiceCallback onAdd;
+    MDNSServiceCallback onRemove;
+    uint32_t interval;
+    unsigned long lastQuery;
+    bool queried;
+    bool stopped;
+    mdns_search_once_t * search;
+    std::vector<MDNSService> services;
+};
+
+// TTL in ms, clamped so the 80% refresh math can not overflow
+static unsigned long _ttlMillis(uint32_t ttl){
+    return (ttl > 86400 ? 86400UL : ttl) * 1000UL;
+}
+
 // static void _on_sys_event(arduino_event_t *event){
 //     mdns_handle_system_event(NULL, event);
 // }
@@ -76,6 +94,22 @@ bool MDNSResponder::begin(const String& hostName){
 }
 
 void MDNSResponder::end() {
+    for(size_t i = 0; i < _browses.size(); i++){
+        MDNSBrowse * b = _browses[i];
+        if(!b){
+            continue;
+        }
+        if(b->search){
+            mdns_result_t * res = NULL;
+            // a search can only be deleted once it has finished
+            mdns_query_async_get_results(b->search, MDNS_BROWSE_QUERY_TIME, &res);
+            mdns_query_results_free(res);
+            mdns_query_async_delete(b->search);
+        }
+        delete b;
+    }
+    _browses.clear();
+    _freeResults();
     mdns_free();
 }
 
@@ -173,6 +207,30 @@ bool MDNSResponder::addServiceTxt(char *name, char *proto, char *key, char *valu
 }
 
 IPAddress MDNSResponder::queryHost(char *host, uint32_t timeout){
+    if(!host || !host[0]){
+        log_e("Bad Parameters");
+        return IPAddress();
+    }
+    // answer from the browse cache when a live entry is known
+    size_t len = strlen(host);
+    if(len > 6 && strcasecmp(host + len - 6, ".local") == 0){
+        len -= 6;
+    }
+    unsigned long now = millis();
+    for(size_t i = 0; i < _browses.size(); i++){
+        MDNSBrowse * b = _browses[i];
+        if(!b){
+            continue;
+        }
+        for(size_t j = 0; j < b->services.size(); j++){
+            const MDNSService & s = b->services[j];
+            if(s.hostname.length() == len && strncasecmp(s.hostname.c_str(), host, len) == 0
+              && (uint32_t)s.ip != 0 && (now - s._updated) < _ttlMillis(s.ttl)){
+                return s.ip;
+            }
+        }
+    }
+
     esp_ip4_addr_t addr;
     addr.addr = 0;
 
@@ -195,10 +253,7 @@ int MDNSResponder::queryService(char *service, char *proto) {
         return 0;
     }
 
-    if(results){
-        mdns_query_results_free(results);
-        results = NULL;
-    }
+    _freeResults();
 
     char srv[strlen(service)+2];
     char prt[strlen(proto)+2];
@@ -223,26 +278,28 @@ int MDNSResponder::queryService(char *service, char *proto) {
         return 0;
     }
 
+    // index the list once so the accessors below are O(1)
     mdns_result_t * r = results;
-    int i = 0;
     while(r){
-        i++;
+        _resultIndex.push_back(r);
         r = r->next;
     }
-    return i;
+    return _resultIndex.size();
+}
+
+void MDNSResponder::_freeResults(){
+    _resultIndex.clear();
+    if(results){
+        mdns_query_results_free(results);
+        results = NULL;
+    }
 }
 
 mdns_result_t * MDNSResponder::_getResult(int idx){
-    mdns_result_t * result = results;
-    int i = 0;
-    while(result){
-        if(i == idx){
-            break;
-        }
-        i++;
-        result = result->next;
+    if(idx < 0 || (size_t)idx >= _resultIndex.size()){
+        return NULL;
     }
-    return result;
+    return _resultIndex[idx];
 }
 
 mdns_txt_item_t * MDNSResponder::_getResultTxt(int idx, int txtIdx){
@@ -356,4 +413,232 @@ String MDNSResponder::txtKey(int idx, int txtIdx) {
         : resultTxt->key;
 }
 
+int MDNSResponder::browseService(const char *service, const char *proto, MDNSServiceCallback onAdd, MDNSServiceCallback onRemove, uint32_t interval) {
+    if(!service || !service[0] || !proto || !proto[0]){
+        log_e("Bad Parameters");
+        return -1;
+    }
+
+    MDNSBrowse * b = new MDNSBrowse();
+    if(!b){
+        log_e("Out of memory");
+        return -1;
+    }
+    b->service = (service[0] == '_') ? String(service) : (String("_") + service);
+    b->proto = (proto[0] == '_') ? String(proto) : (String("_") + proto);
+    b->onAdd = onAdd;
+    b->onRemove = onRemove;
+    b->interval = (interval < MDNS_BROWSE_QUERY_TIME) ? MDNS_BROWSE_QUERY_TIME : interval;
+    b->lastQuery = 0;
+    b->queried = false;
+    b->stopped = false;
+    b->search = NULL;
+
+    // reuse a free slot so session ids stay small
+    for(size_t i = 0; i < _browses.size(); i++){
+        if(!_browses[i]){
+            _browses[i] = b;
+            _browseQuery(b, millis());
+            return i;
+        }
+    }
+    _browses.push_back(b);
+    _browseQuery(b, millis());
+    return _browses.size() - 1;
+}
+
+void MDNSResponder::stopBrowse(int id) {
+    MDNSBrowse * b = _getBrowse(id);
+    if(!b){
+        return;
+    }
+    // the session may be inside a callback right now, update() reaps it
+    b->stopped = true;
+}
+
+int MDNSResponder::numServices(int id) {
+    MDNSBrowse * b = _getBrowse(id);
+    return b ? b->services.size() : 0;
+}
+
+const MDNSService * MDNSResponder::service(int id, int idx) {
+    MDNSBrowse * b = _getBrowse(id);
+    if(!b || idx < 0 || (size_t)idx >= b->services.size()){
+        return NULL;
+    }
+    return &b->services[idx];
+}
+
+void MDNSResponder::update() {
+    unsigned long now = millis();
+    for(size_t id = 0; id < _browses.size(); id++){
+        MDNSBrowse * b = _browses[id];
+        if(!b){
+            continue;
+        }
+        if(b->search){
+            mdns_result_t * res = NULL;
+            if(!mdns_query_async_get_results(b->search, 0, &res)){
+                continue;
+            }
+            mdns_query_async_delete(b->search);
+            b->search = NULL;
+            if(!b->stopped){
+                _browseMerge(b, res, now);
+            }
+            mdns_query_results_free(res);
+        }
+        if(b->stopped){
+            delete b;
+            _browses[id] = NULL;
+            continue;
+        }
+        _browseExpire(b, now);
+        if(!b->stopped){
+            _browseQuery(b, now);
+        }
+    }
+}
+
+MDNSBrowse * MDNSResponder::_getBrowse(int id) {
+    if(id < 0 || (size_t)id >= _browses.size() || !_browses[id] || _browses[id]->stopped){
+        return NULL;
+    }
+    return _browses[id];
+}
+
+// Start the next query when the interval is up, or earlier when a cached
+// entry reaches 80%, 85%, 90% or 95% of its TTL (RFC 6762, 5.2).
+void MDNSResponder::_browseQuery(MDNSBrowse * b, unsigned long now) {
+    if(b->search){
+        return;
+    }
+    bool due = !b->queried || (now - b->lastQuery) >= b->interval;
+    if(b->queried && (now - b->lastQuery) < MDNS_BROWSE_QUERY_TIME){
+        return;
+    }
+    for(size_t i = 0; i < b->services.size(); i++){
+        MDNSService & s = b->services[i];
+        if(s._refresh < 4 && (now - s._updated) >= _ttlMillis(s.ttl) / 100 * (80 + 5 * s._refresh)){
+            s._refresh++;
+            due = true;
+        }
+    }
+    if(!due){
+        return;
+    }
+    b->search = mdns_query_async_new(NULL, b->service.c_str(), b->proto.c_str(), MDNS_TYPE_PTR, MDNS_BROWSE_QUERY_TIME, MDNS_BROWSE_MAX_RESULTS, NULL);
+    if(!b->search){
+        log_e("Query Failed");
+    }
+    b->lastQuery = now;
+    b->queried = true;
+}
+
+void MDNSResponder::_browseMerge(MDNSBrowse * b, mdns_result_t * res, unsigned long now) {
+    for(mdns_result_t * r = res; r; r = r->next){
+        if(!r->instance_name){
+            continue;
+        }
+        size_t i = 0;
+        while(i < b->services.size() && !b->services[i].instance.equalsIgnoreCase(r->instance_name)){
+            i++;
+        }
+        if(r->ttl == 0){
+            // goodbye packet
+            if(i < b->services.size()){
+                if(b->onRemove){
+                    b->onRemove(b->services[i]);
+                }
+                b->services.erase(b->services.begin() + i);
+                if(b->stopped){
+                    return;
+                }
+            }
+            continue;
+        }
+        bool added = (i == b->services.size());
+        if(added){
+            if(b->services.size() >= MDNS_BROWSE_MAX_RESULTS){
+                log_w("Browse cache full, dropping %s", r->instance_name);
+                continue;
+            }
+            b->services.push_back(MDNSService());
+            b->services[i].instance = r->instance_name;
+        }
+        MDNSService & s = b->services[i];
+        if(r->hostname){
+            s.hostname = r->hostname;
+        }
+        if(r->port){
+            s.port = r->port;
+        }
+        for(mdns_ip_addr_t * addr = r->addr; addr; addr = addr->next){
+            if(addr->addr.type == MDNS_IP_PROTOCOL_V4){
+                s.ip = IPAddress(addr->addr.u_addr.ip4.addr);
+            } else if(addr->addr.type == MDNS_IP_PROTOCOL_V6){
+                s.ipv6 = IPv6Address(addr->addr.u_addr.ip6.addr);
+            }
+        }
+        if(r->txt_count){
+            s._txt.clear();
+            s._txt.reserve(r->txt_count);
+            for(size_t t = 0; t < r->txt_count; t++){
+                s._txt.push_back(std::make_pair(String(r->txt[t].key), String(r->txt[t].value ? r->txt[t].value : "")));
+            }
+        }
+        s.ttl = r->ttl;
+        s._updated = now;
+        s._refresh = 0;
+        if(added && b->onAdd){
+            b->onAdd(s);
+            if(b->stopped){
+                return;
+            }
+        }
+    }
+}
+
+void MDNSResponder::_browseExpire(MDNSBrowse * b, unsigned long now) {
+    size_t i = 0;
+    while(i < b->services.size()){
+        const MDNSService & s = b->services[i];
+        if((now - s._updated) < _ttlMillis(s.ttl)){
+            i++;
+            continue;
+        }
+        if(b->onRemove){
+            b->onRemove(s);
+        }
+        if(b->stopped){
+            return;
+        }
+        b->services.erase(b->services.begin() + i);
+    }
+}
+
+bool MDNSService::hasTxt(const char * key) const {
+    for(size_t i = 0; i < _txt.size(); i++){
+        if(_txt[i].first == key) return true;
+    }
+    return false;
+}
+
+String MDNSService::txt(const char * key) const {
+    for(size_t i = 0; i < _txt.size(); i++){
+        if(_txt[i].first == key) return _txt[i].second;
+    }
+    return "";
+}
+
+String MDNSService::txt(int txtIdx) const {
+    if(txtIdx < 0 || (size_t)txtIdx >= _txt.size()) return "";
+    return _txt[txtIdx].second;
+}
+
+String MDNSService::txtKey(int txtIdx) const {
+    if(txtIdx < 0 || (size_t)txtIdx >= _txt.size()) return "";
+    return _txt[txtIdx].first;
+}
+
 MDNSResponder MDNS;
@@ -44,12 +44,59 @@ License (MIT license):
 #include "Arduino.h"
 #include "IPv6Address.h"
 #include "mdns.h"
+#include <vector>
+#include <functional>
 
 //this should be defined at build time
 #ifndef ARDUINO_VARIANT
 #define ARDUINO_VARIANT "esp32"
 #endif
 
+// maximum number of instances kept per browse session
+#ifndef MDNS_BROWSE_MAX_RESULTS
+#define MDNS_BROWSE_MAX_RESULTS 64
+#endif
+
+// how long a single browse query listens for answers (ms)
+#ifndef MDNS_BROWSE_QUERY_TIME
+#define MDNS_BROWSE_QUERY_TIME 3000
+#endif
+
+// default interval between browse queries (ms)
+#ifndef MDNS_BROWSE_INTERVAL
+#define MDNS_BROWSE_INTERVAL 60000
+#endif
+
+// A service instance found by a browse session. Kept until its TTL runs out
+// without being refreshed or until the peer sends a goodbye.
+class MDNSService {
+public:
+  String instance;
+  String hostname;
+  IPAddress ip;
+  IPv6Address ipv6;
+  uint16_t port;
+  uint32_t ttl;
+
+  MDNSService() : port(0), ttl(0), _updated(0), _refresh(0) {}
+
+  int numTxt() const { return _txt.size(); }
+  bool hasTxt(const char * key) const;
+  String txt(const char * key) const;
+  String txt(int txtIdx) const;
+  String txtKey(int txtIdx) const;
+
+private:
+  friend class MDNSResponder;
+  std::vector<std::pair<String, String>> _txt;
+  unsigned long _updated;
+  uint8_t _refresh;
+};
+
+typedef std::function<void(const MDNSService &service)> MDNSServiceCallback;
+
+struct MDNSBrowse;
+
 class MDNSResponder {
 public:
   MDNSResponder();
@@ -115,12 +162,32 @@ public:
   String txt(int idx, const char * key);
   String txt(int idx, int txtIdx);
   String txtKey(int idx, int txtIdx);
-  
+
+  // Non-blocking browsing. The session re-queries in the background and keeps
+  // a cache of the instances found; onAdd/onRemove run from update().
+  // Returns a session id or -1 on failure.
+  int browseService(const char *service, const char *proto, MDNSServiceCallback onAdd, MDNSServiceCallback onRemove = NULL, uint32_t interval = MDNS_BROWSE_INTERVAL);
+  int browseService(String service, String proto, MDNSServiceCallback onAdd, MDNSServiceCallback onRemove = NULL, uint32_t interval = MDNS_BROWSE_INTERVAL){
+    return browseService(service.c_str(), proto.c_str(), onAdd, onRemove, interval);
+  }
+  void stopBrowse(int id);
+  int numServices(int id);
+  const MDNSService * service(int id, int idx);
+  // call from loop() to collect answers, expire stale entries and refresh
+  void update();
+
 private:
   String _hostname;
   mdns_result_t * results;
+  std::vector<mdns_result_t *> _resultIndex;
+  std::vector<MDNSBrowse *> _browses;
   mdns_result_t * _getResult(int idx);
   mdns_txt_item_t * _getResultTxt(int idx, int txtIdx);
+  void _freeResults();
+  MDNSBrowse * _getBrowse(int id);
+  void _browseQuery(MDNSBrowse * b, unsigned long now);
+  void _browseMerge(MDNSBrowse * b, mdns_result_t * res, unsigned long now);
+  void _browseExpire(MDNSBrowse * b, unsigned long now);
 };
 
 extern MDNSResponder MDNS;
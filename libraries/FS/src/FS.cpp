@@ -247,6 +247,40 @@ bool FS::exists(const String& path)
     return exists(path.c_str());
 }
 
+bool FS::stat(const char* path, FileStat* st)
+{
+    if (!_impl) {
+        return false;
+    }
+    return _impl->stat(path, st);
+}
+
+bool FS::stat(const String& path, FileStat* st)
+{
+    return stat(path.c_str(), st);
+}
+
+Dir FS::openDir(const char* path)
+{
+    if (!_impl) {
+        return Dir();
+    }
+    return Dir(_impl->openDir(path));
+}
+
+Dir FS::openDir(const String& path)
+{
+    return openDir(path.c_str());
+}
+
+bool FS::setStatCache(size_t entries)
+{
+    if (!_impl) {
+        return false;
+    }
+    return _impl->setStatCache(entries);
+}
+
 bool FS::remove(const char* path)
 {
     if (!_impl) {
@@ -301,8 +335,95 @@ bool FS::rmdir(const String &path)
 }
 
 
+bool Dir::next()
+{
+    if (!_impl) {
+        return false;
+    }
+    return _impl->next();
+}
+
+const char* Dir::fileName()
+{
+    if (!_impl) {
+        return "";
+    }
+    return _impl->fileName();
+}
+
+size_t Dir::fileSize()
+{
+    if (!_impl) {
+        return 0;
+    }
+    return _impl->fileSize();
+}
+
+time_t Dir::fileTime()
+{
+    if (!_impl) {
+        return 0;
+    }
+    return _impl->fileTime();
+}
+
+bool Dir::isFile()
+{
+    if (!_impl) {
+        return false;
+    }
+    return _impl->isFile();
+}
+
+bool Dir::isDirectory()
+{
+    if (!_impl) {
+        return false;
+    }
+    return _impl->isDirectory();
+}
+
+File Dir::openFile(const char* mode)
+{
+    if (!_impl) {
+        return File();
+    }
+    return File(_impl->openFile(mode));
+}
+
+bool Dir::rewind()
+{
+    if (!_impl) {
+        return false;
+    }
+    return _impl->rewind();
+}
+
+Dir::operator bool() const
+{
+    return !!_impl;
+}
+
+// Fallback for implementations without a cheaper way to read metadata
+bool FSImpl::stat(const char* path, FileStat* st)
+{
+    FileImplPtr f = open(path, FILE_READ, false);
+    if (!f || !*f) {
+        return false;
+    }
+    if (st) {
+        st->isDirectory = f->isDirectory();
+        st->size = st->isDirectory ? 0 : f->size();
+        st->lastWrite = f->getLastWrite();
+    }
+    f->close();
+    return true;
+}
+
 void FSImpl::mountpoint(const char * mp)
 {
+    // mounted, unmounted or remounted (maybe another card): nothing cached is valid
+    clearStatCache();
     _mountpoint = mp;
 }
 
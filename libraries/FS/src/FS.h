@@ -35,6 +35,8 @@ class File;
 
 class FileImpl;
 typedef std::shared_ptr<FileImpl> FileImplPtr;
+class DirImpl;
+typedef std::shared_ptr<DirImpl> DirImplPtr;
 class FSImpl;
 typedef std::shared_ptr<FSImpl> FSImplPtr;
 
@@ -88,6 +90,36 @@ protected:
     FileImplPtr _p;
 };
 
+// Metadata of a path, filled without opening it
+struct FileStat
+{
+    size_t size;
+    time_t lastWrite;
+    bool isDirectory;
+};
+
+// Lists a directory without opening the entries:
+//   Dir dir = SPIFFS.openDir("/");
+//   while (dir.next()) { Serial.println(dir.fileName()); }
+class Dir
+{
+public:
+    Dir(DirImplPtr impl = DirImplPtr()) : _impl(impl) { }
+
+    bool next();
+    const char* fileName();
+    size_t fileSize();
+    time_t fileTime();
+    bool isFile();
+    bool isDirectory();
+    File openFile(const char* mode = FILE_READ);
+    bool rewind();
+    operator bool() const;
+
+protected:
+    DirImplPtr _impl;
+};
+
 class FS
 {
 public:
@@ -99,6 +131,16 @@ public:
     bool exists(const char* path);
     bool exists(const String& path);
 
+    bool stat(const char* path, FileStat* st);
+    bool stat(const String& path, FileStat* st);
+
+    Dir openDir(const char* path);
+    Dir openDir(const String& path);
+
+    // Remember the metadata of up to entries paths (0 disables). Only changes
+    // made through this FS object keep the cache up to date.
+    bool setStatCache(size_t entries);
+
     bool remove(const char* path);
     bool remove(const String& path);
 
@@ -121,6 +163,8 @@ protected:
 #ifndef FS_NO_GLOBALS
 using fs::FS;
 using fs::File;
+using fs::Dir;
+using fs::FileStat;
 using fs::SeekMode;
 using fs::SeekSet;
 using fs::SeekCur;
@@ -50,6 +50,20 @@ public:
     virtual operator bool() = 0;
 };
 
+class DirImpl
+{
+public:
+    virtual ~DirImpl() { }
+    virtual bool next() = 0;
+    virtual const char* fileName() = 0;
+    virtual size_t fileSize() = 0;
+    virtual time_t fileTime() = 0;
+    virtual bool isFile() = 0;
+    virtual bool isDirectory() = 0;
+    virtual FileImplPtr openFile(const char* mode) = 0;
+    virtual bool rewind() = 0;
+};
+
 class FSImpl
 {
 protected:
@@ -63,6 +77,10 @@ public:
     virtual bool remove(const char* path) = 0;
     virtual bool mkdir(const char *path) = 0;
     virtual bool rmdir(const char *path) = 0;
+    virtual bool stat(const char* path, FileStat* st);
+    virtual DirImplPtr openDir(const char*) { return DirImplPtr(); }
+    virtual bool setStatCache(size_t) { return false; }
+    virtual void clearStatCache() { }
     void mountpoint(const char *);
     const char * mountpoint();
 };
@@ -18,6 +18,21 @@ using namespace fs;
 
 #define DEFAULT_FILE_BUFFER_SIZE 4096
 
+VFSImpl::VFSImpl()
+    : _statCache(NULL)
+    , _statCacheSize(0)
+    , _statCacheLock(NULL)
+{
+}
+
+VFSImpl::~VFSImpl()
+{
+    setStatCache(0);
+    if(_statCacheLock) {
+        vSemaphoreDelete(_statCacheLock);
+    }
+}
+
 FileImplPtr VFSImpl::open(const char* fpath, const char* mode, const bool create)
 {
     if(!_mountpoint) {
@@ -30,6 +45,10 @@ FileImplPtr VFSImpl::open(const char* fpath, const char* mode, const bool create
         return FileImplPtr();
     }
 
+    if(mode && (mode[0] != 'r' || strchr(mode, '+'))) {
+        _statCacheInvalidate(fpath);
+    }
+
     char * temp = (char *)malloc(strlen(fpath)+strlen(_mountpoint)+2);
     if(!temp) {
         log_e("malloc failed");
@@ -41,7 +60,7 @@ FileImplPtr VFSImpl::open(const char* fpath, const char* mode, const bool create
 
     struct stat st;
     //file found
-    if(!stat(temp, &st)) {
+    if(!::stat(temp, &st)) {
         free(temp);
         if (S_ISREG(st.st_mode) || S_ISDIR(st.st_mode)) {
             return std::make_shared<VFSFileImpl>(this, fpath, mode);
@@ -108,18 +127,193 @@ FileImplPtr VFSImpl::open(const char* fpath, const char* mode, const bool create
 }
 
 bool VFSImpl::exists(const char* fpath)
+{
+    return stat(fpath, NULL);
+}
+
+bool VFSImpl::stat(const char* fpath, FileStat* st)
 {
     if(!_mountpoint) {
         log_e("File system is not mounted");
         return false;
     }
 
-    VFSFileImpl f(this, fpath, "r");
-    if(f) {
-        f.close();
-        return true;
+    if(!fpath || fpath[0] != '/') {
+        return false;
     }
-    return false;
+
+    bool found;
+    FileStat info;
+    if(_statCacheGet(fpath, found, &info)) {
+        if(found && st) {
+            *st = info;
+        }
+        return found;
+    }
+
+    char temp[strlen(_mountpoint)+strlen(fpath)+1];
+    strcpy(temp, _mountpoint);
+    strcat(temp, fpath);
+
+    struct stat s;
+    found = false;
+    info.size = 0;
+    info.lastWrite = 0;
+    info.isDirectory = false;
+    if(!::stat(temp, &s)) {
+        if(S_ISREG(s.st_mode) || S_ISDIR(s.st_mode)) {
+            found = true;
+            info.isDirectory = S_ISDIR(s.st_mode);
+            info.size = info.isDirectory ? 0 : s.st_size;
+            info.lastWrite = s.st_mtime;
+        }
+    } else {
+        //might be a mount point or a file system without directory entries
+        DIR * d = opendir(temp);
+        if(d) {
+            closedir(d);
+            found = true;
+            info.isDirectory = true;
+        }
+    }
+    _statCachePut(fpath, found, info);
+    if(found && st) {
+        *st = info;
+    }
+    return found;
+}
+
+DirImplPtr VFSImpl::openDir(const char* fpath)
+{
+    if(!_mountpoint) {
+        log_e("File system is not mounted");
+        return DirImplPtr();
+    }
+
+    if(!fpath || fpath[0] != '/') {
+        log_e("%s does not start with /", fpath);
+        return DirImplPtr();
+    }
+
+    char temp[strlen(_mountpoint)+strlen(fpath)+1];
+    strcpy(temp, _mountpoint);
+    strcat(temp, fpath);
+
+    DIR * d = opendir(temp);
+    if(!d) {
+        return DirImplPtr();
+    }
+    return std::make_shared<VFSDirImpl>(this, fpath, d);
+}
+
+static uint32_t _statCacheHash(const char* path)
+{
+    uint32_t h = 2166136261u;
+    while(*path) {
+        h = (h ^ (uint8_t)*path++) * 16777619u;
+    }
+    return h;
+}
+
+bool VFSImpl::setStatCache(size_t entries)
+{
+    if(!_statCacheLock) {
+        if(!entries) {
+            return true;
+        }
+        _statCacheLock = xSemaphoreCreateMutex();
+        if(!_statCacheLock) {
+            return false;
+        }
+    }
+    xSemaphoreTake(_statCacheLock, portMAX_DELAY);
+    if(_statCache) {
+        for(size_t i = 0; i < _statCacheSize; i++) {
+            free(_statCache[i].path);
+        }
+        free(_statCache);
+        _statCache = NULL;
+        _statCacheSize = 0;
+    }
+    bool ok = true;
+    if(entries) {
+        _statCache = (StatCacheEntry *)calloc(entries, sizeof(StatCacheEntry));
+        if(_statCache) {
+            _statCacheSize = entries;
+        } else {
+            log_e("calloc failed");
+            ok = false;
+        }
+    }
+    xSemaphoreGive(_statCacheLock);
+    return ok;
+}
+
+void VFSImpl::clearStatCache()
+{
+    _statCacheInvalidate(NULL);
+}
+
+// Direct mapped: a path lives in the slot picked by its hash, a colliding
+// path simply replaces it
+bool VFSImpl::_statCacheGet(const char* path, bool &found, FileStat* st)
+{
+    if(!_statCache) {
+        return false;
+    }
+    bool hit = false;
+    xSemaphoreTake(_statCacheLock, portMAX_DELAY);
+    if(_statCache) {
+        StatCacheEntry &e = _statCache[_statCacheHash(path) % _statCacheSize];
+        if(e.path && strcmp(e.path, path) == 0) {
+            found = e.found;
+            *st = e.st;
+            hit = true;
+        }
+    }
+    xSemaphoreGive(_statCacheLock);
+    return hit;
+}
+
+void VFSImpl::_statCachePut(const char* path, bool found, const FileStat &st)
+{
+    if(!_statCache) {
+        return;
+    }
+    xSemaphoreTake(_statCacheLock, portMAX_DELAY);
+    if(_statCache) {
+        StatCacheEntry &e = _statCache[_statCacheHash(path) % _statCacheSize];
+        if(!e.path || strcmp(e.path, path) != 0) {
+            free(e.path);
+            e.path = strdup(path);
+        }
+        e.found = found;
+        e.st = st;
+    }
+    xSemaphoreGive(_statCacheLock);
+}
+
+void VFSImpl::_statCacheInvalidate(const char* path)
+{
+    if(!_statCache) {
+        return;
+    }
+    xSemaphoreTake(_statCacheLock, portMAX_DELAY);
+    if(_statCache) {
+        if(path) {
+            StatCacheEntry &e = _statCache[_statCacheHash(path) % _statCacheSize];
+            if(e.path && strcmp(e.path, path) == 0) {
+                free(e.path);
+                e.path = NULL;
+            }
+        } else {
+            for(size_t i = 0; i < _statCacheSize; i++) {
+                free(_statCache[i].path);
+                _statCache[i].path = NULL;
+            }
+        }
+    }
+    xSemaphoreGive(_statCacheLock);
 }
 
 bool VFSImpl::rename(const char* pathFrom, const char* pathTo)
@@ -159,6 +353,8 @@ bool VFSImpl::rename(const char* pathFrom, const char* pathTo)
     auto rc = ::rename(temp1, temp2);
     free(temp1);
     free(temp2);
+    // a renamed directory moves everything below it
+    _statCacheInvalidate(NULL);
     return rc == 0;
 }
 
@@ -174,15 +370,11 @@ bool VFSImpl::remove(const char* fpath)
         return false;
     }
 
-    VFSFileImpl f(this, fpath, "r");
-    if(!f || f.isDirectory()) {
-        if(f) {
-            f.close();
-        }
+    FileStat st;
+    if(!stat(fpath, &st) || st.isDirectory) {
         log_e("%s does not exists or is directory", fpath);
         return false;
     }
-    f.close();
 
     char * temp = (char *)malloc(strlen(fpath)+strlen(_mountpoint)+1);
     if(!temp) {
@@ -195,6 +387,7 @@ bool VFSImpl::remove(const char* fpath)
 
     auto rc = unlink(temp);
     free(temp);
+    _statCacheInvalidate(fpath);
     return rc == 0;
 }
 
@@ -205,13 +398,12 @@ bool VFSImpl::mkdir(const char *fpath)
         return false;
     }
 
-    VFSFileImpl f(this, fpath, "r");
-    if(f && f.isDirectory()) {
-        f.close();
-        //log_w("%s already exists", fpath);
-        return true;
-    } else if(f) {
-        f.close();
+    FileStat st;
+    if(stat(fpath, &st)) {
+        if(st.isDirectory) {
+            //log_w("%s already exists", fpath);
+            return true;
+        }
         log_e("%s is a file", fpath);
         return false;
     }
@@ -227,6 +419,7 @@ bool VFSImpl::mkdir(const char *fpath)
 
     auto rc = ::mkdir(temp, ACCESSPERMS);
     free(temp);
+    _statCacheInvalidate(fpath);
     return rc == 0;
 }
 
@@ -242,15 +435,11 @@ bool VFSImpl::rmdir(const char *fpath)
         return false;
     }
 
-    VFSFileImpl f(this, fpath, "r");
-    if(!f || !f.isDirectory()) {
-        if(f) {
-            f.close();
-        }
+    FileStat st;
+    if(!stat(fpath, &st) || !st.isDirectory) {
         log_e("%s does not exists or is a file", fpath);
         return false;
     }
-    f.close();
 
     char * temp = (char *)malloc(strlen(fpath)+strlen(_mountpoint)+1);
     if(!temp) {
@@ -263,6 +452,7 @@ bool VFSImpl::rmdir(const char *fpath)
 
     auto rc = ::rmdir(temp);
     free(temp);
+    _statCacheInvalidate(fpath);
     return rc == 0;
 }
 
@@ -348,6 +538,9 @@ VFSFileImpl::~VFSFileImpl()
 void VFSFileImpl::close()
 {
     if(_path) {
+        if(_written) {
+            _fs->_statCacheInvalidate(_path);
+        }
         free(_path);
         _path = NULL;
     }
@@ -395,6 +588,9 @@ size_t VFSFileImpl::write(const uint8_t *buf, size_t size)
     if(_isDirectory || !_f || !buf || !size) {
         return 0;
     }
+    if(!_written) {
+        _fs->_statCacheInvalidate(_path);
+    }
     _written = true;
     return fwrite(buf, 1, size, _f);
 }
@@ -573,3 +769,130 @@ void VFSFileImpl::rewindDirectory(void)
     }
     rewinddir(_d);
 }
+
+VFSDirImpl::VFSDirImpl(VFSImpl* fs, const char* fpath, DIR * d)
+    : _fs(fs)
+    , _d(d)
+    , _path(fpath)
+    , _isDirectory(false)
+    , _haveStat(false)
+{
+    if(_path.length() > 1 && _path.endsWith("/")) {
+        _path.remove(_path.length() - 1);
+    }
+}
+
+VFSDirImpl::~VFSDirImpl()
+{
+    if(_d) {
+        closedir(_d);
+        _d = NULL;
+    }
+}
+
+String VFSDirImpl::_entryPath()
+{
+    String p = _path;
+    if(!p.endsWith("/")) {
+        p += "/";
+    }
+    p += _name;
+    return p;
+}
+
+// Size and time need a stat() of the entry, done on first use only
+void VFSDirImpl::_getStat()
+{
+    if(_haveStat) {
+        return;
+    }
+    _haveStat = true;
+    if(!_fs->stat(_entryPath().c_str(), &_stat)) {
+        _stat.size = 0;
+        _stat.lastWrite = 0;
+        _stat.isDirectory = _isDirectory;
+    }
+}
+
+bool VFSDirImpl::next()
+{
+    if(!_d) {
+        return false;
+    }
+    struct dirent *file;
+    while((file = readdir(_d)) != NULL) {
+        if(file->d_name[0] == '.' && (file->d_name[1] == 0 || (file->d_name[1] == '.' && file->d_name[2] == 0))) {
+            continue;
+        }
+        if(file->d_type == DT_REG || file->d_type == DT_DIR) {
+            _name = file->d_name;
+            _isDirectory = (file->d_type == DT_DIR);
+            _haveStat = false;
+            return true;
+        }
+        if(file->d_type == DT_UNKNOWN) {
+            // type not reported by this file system, ask stat()
+            _name = file->d_name;
+            _haveStat = false;
+            _isDirectory = false;
+            _getStat();
+            _isDirectory = _stat.isDirectory;
+            return true;
+        }
+    }
+    _name = "";
+    _haveStat = false;
+    return false;
+}
+
+const char* VFSDirImpl::fileName()
+{
+    return _name.c_str();
+}
+
+size_t VFSDirImpl::fileSize()
+{
+    if(!_name.length() || _isDirectory) {
+        return 0;
+    }
+    _getStat();
+    return _stat.size;
+}
+
+time_t VFSDirImpl::fileTime()
+{
+    if(!_name.length()) {
+        return 0;
+    }
+    _getStat();
+    return _stat.lastWrite;
+}
+
+bool VFSDirImpl::isFile()
+{
+    return _name.length() && !_isDirectory;
+}
+
+bool VFSDirImpl::isDirectory()
+{
+    return _name.length() && _isDirectory;
+}
+
+FileImplPtr VFSDirImpl::openFile(const char* mode)
+{
+    if(!_name.length()) {
+        return FileImplPtr();
+    }
+    return _fs->open(_entryPath().c_str(), mode, false);
+}
+
+bool VFSDirImpl::rewind()
+{
+    if(!_d) {
+        return false;
+    }
+    rewinddir(_d);
+    _name = "";
+    _haveStat = false;
+    return true;
+}
@@ -22,25 +22,75 @@ extern "C" {
 #include <sys/unistd.h>
 #include <sys/stat.h>
 #include <dirent.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 }
 
 using namespace fs;
 
 class VFSFileImpl;
+class VFSDirImpl;
 
 class VFSImpl : public FSImpl
 {
 
 protected:
     friend class VFSFileImpl;
+    friend class VFSDirImpl;
+
+    struct StatCacheEntry {
+        char *   path;
+        bool     found;
+        FileStat st;
+    };
+    StatCacheEntry *  _statCache;
+    size_t            _statCacheSize;
+    SemaphoreHandle_t _statCacheLock;
+
+    bool _statCacheGet(const char* path, bool &found, FileStat* st);
+    void _statCachePut(const char* path, bool found, const FileStat &st);
+    void _statCacheInvalidate(const char* path);
 
 public:
+    VFSImpl();
+    ~VFSImpl() override;
     FileImplPtr open(const char* path, const char* mode, const bool create) override;
     bool        exists(const char* path) override;
     bool        rename(const char* pathFrom, const char* pathTo) override;
     bool        remove(const char* path) override;
     bool        mkdir(const char *path) override;
     bool        rmdir(const char *path) override;
+    bool        stat(const char* path, FileStat* st) override;
+    DirImplPtr  openDir(const char* path) override;
+    bool        setStatCache(size_t entries) override;
+    void        clearStatCache() override;
+};
+
+class VFSDirImpl : public DirImpl
+{
+protected:
+    VFSImpl*    _fs;
+    DIR *       _d;
+    String      _path;
+    String      _name;
+    bool        _isDirectory;
+    bool        _haveStat;
+    FileStat    _stat;
+
+    String      _entryPath();
+    void        _getStat();
+
+public:
+    VFSDirImpl(VFSImpl* fs, const char* path, DIR * d);
+    ~VFSDirImpl() override;
+    bool        next() override;
+    const char* fileName() override;
+    size_t      fileSize() override;
+    time_t      fileTime() override;
+    bool        isFile() override;
+    bool        isDirectory() override;
+    FileImplPtr openFile(const char* mode) override;
+    bool        rewind() override;
 };
 
 class VFSFileImpl : public FileImpl
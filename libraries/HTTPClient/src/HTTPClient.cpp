@@ -42,6 +42,39 @@
 /// Cookie jar support
 #include <time.h>
 
+// Response header names are matched by a case insensitive FNV-1a hash; the known ones
+// are hashed at compile time so the lookup is a switch over constants.
+static constexpr char headerLower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static constexpr uint32_t headerHash(const char * name, uint32_t hash = 2166136261u)
+{
+    return *name ? headerHash(name + 1, (hash ^ (uint8_t) headerLower(*name)) * 16777619u) : hash;
+}
+
+static uint32_t headerHash(const char * name, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    while(len--) {
+        hash = (hash ^ (uint8_t) headerLower(*name++)) * 16777619u;
+    }
+    return hash;
+}
+
+static bool headerNameIs(const char * name, size_t len, const char * known)
+{
+    return strlen(known) == len && strncasecmp(name, known, len) == 0;
+}
+
+enum {
+    TE_NONE,
+    TE_IDENTITY,
+    TE_CHUNKED,
+    TE_UNKNOWN
+};
+
 #ifdef HTTPCLIENT_1_1_COMPATIBLE
 class TransportTraits
 {
@@ -112,6 +145,7 @@ HTTPClient::~HTTPClient()
     if(_currentHeaders) {
         delete[] _currentHeaders;
     }
+    free(_headerLine);
     if(_tcpDeprecated) {
         _tcpDeprecated.reset(nullptr);
     }
@@ -383,6 +417,7 @@ void HTTPClient::end(void)
  */
 void HTTPClient::disconnect(bool preserveClient)
 {
+    _body.end();
     if(connected()) {
         if(_client->available() > 0) {
             log_d("still data in buffer (%d), clean up.\n", _client->available());
@@ -905,69 +940,28 @@ int HTTPClient::writeToStream(Stream * stream)
         return returnError(HTTPC_ERROR_NOT_CONNECTED);
     }
 
+    if(_transferEncoding != HTTPC_TE_IDENTITY && _transferEncoding != HTTPC_TE_CHUNKED) {
+        return returnError(HTTPC_ERROR_ENCODING);
+    }
+
     // get length of document (is -1 when Server sends no Content-Length header)
-    int len = _size;
-    int ret = 0;
+    int ret = writeToStreamDataBlock(stream, _transferEncoding == HTTPC_TE_IDENTITY ? _size : -1);
 
-    if(_transferEncoding == HTTPC_TE_IDENTITY) {
-        ret = writeToStreamDataBlock(stream, len);
+    // have we an error?
+    if(ret < 0) {
+        return returnError(ret);
+    }
 
-        // have we an error?
-        if(ret < 0) {
-            return returnError(ret);
+    if(_transferEncoding == HTTPC_TE_CHUNKED) {
+        // if no length Header use global chunk size
+        if(_size <= 0) {
+            _size = ret;
         }
-    } else if(_transferEncoding == HTTPC_TE_CHUNKED) {
-        int size = 0;
-        while(1) {
-            if(!connected()) {
-                return returnError(HTTPC_ERROR_CONNECTION_LOST);
-            }
-            String chunkHeader = _client->readStringUntil('\n');
-
-            if(chunkHeader.length() <= 0) {
-                return returnError(HTTPC_ERROR_READ_TIMEOUT);
-            }
-
-            chunkHeader.trim(); // remove \r
-
-            // read size of chunk
-            len = (uint32_t) strtol((const char *) chunkHeader.c_str(), NULL, 16);
-            size += len;
-            log_d(" read chunk len: %d", len);
-
-            // data left?
-            if(len > 0) {
-                int r = writeToStreamDataBlock(stream, len);
-                if(r < 0) {
-                    // error in writeToStreamDataBlock
-                    return returnError(r);
-                }
-                ret += r;
-            } else {
 
-                // if no length Header use global chunk size
-                if(_size <= 0) {
-                    _size = size;
-                }
-
-                // check if we have write all data out
-                if(ret != _size) {
-                    return returnError(HTTPC_ERROR_STREAM_WRITE);
-                }
-                break;
-            }
-
-            // read trailing \r\n at the end of the chunk
-            char buf[2];
-            auto trailing_seq_len = _client->readBytes((uint8_t*)buf, 2);
-            if (trailing_seq_len != 2 || buf[0] != '\r' || buf[1] != '\n') {
-                return returnError(HTTPC_ERROR_READ_TIMEOUT);
-            }
-
-            delay(0);
+        // check if we have write all data out
+        if(ret != _size) {
+            return returnError(HTTPC_ERROR_STREAM_WRITE);
         }
-    } else {
-        return returnError(HTTPC_ERROR_ENCODING);
     }
 
 //    end();
@@ -1075,13 +1069,15 @@ void HTTPClient::collectHeaders(const char* headerKeys[], const size_t headerKey
     _currentHeaders = new RequestArgument[_headerKeysCount];
     for(size_t i = 0; i < _headerKeysCount; i++) {
         _currentHeaders[i].key = headerKeys[i];
+        _currentHeaders[i].hash = headerHash(headerKeys[i]);
     }
 }
 
 String HTTPClient::header(const char* name)
 {
+    uint32_t hash = headerHash(name);
     for(size_t i = 0; i < _headerKeysCount; ++i) {
-        if(_currentHeaders[i].key.equalsIgnoreCase(name)) {
+        if(_currentHeaders[i].hash == hash && _currentHeaders[i].key.equalsIgnoreCase(name)) {
             return _currentHeaders[i].value;
         }
     }
@@ -1111,8 +1107,9 @@ int HTTPClient::headers()
 
 bool HTTPClient::hasHeader(const char* name)
 {
+    uint32_t hash = headerHash(name);
     for(size_t i = 0; i < _headerKeysCount; ++i) {
-        if((_currentHeaders[i].key.equalsIgnoreCase(name)) && (_currentHeaders[i].value.length() > 0)) {
+        if(_currentHeaders[i].hash == hash && (_currentHeaders[i].key.equalsIgnoreCase(name)) && (_currentHeaders[i].value.length() > 0)) {
             return true;
         }
     }
@@ -1189,22 +1186,26 @@ bool HTTPClient::sendHeader(const char * type)
         return false;
     }
 
-    String header = String(type) + " " + _uri + F(" HTTP/1.");
+    // room for every part and the fixed header lines, so the appends below do not reallocate
+    String header;
+    header.reserve(strlen(type) + _uri.length() + _host.length() + _userAgent.length() + _headers.length()
+        + _authorizationType.length() + _base64Authorization.length() + 160);
 
-    if(_useHTTP10) {
-        header += "0";
-    } else {
-        header += "1";
-    }
+    header += type;
+    header += ' ';
+    header += _uri;
+    header += _useHTTP10 ? F(" HTTP/1.0") : F(" HTTP/1.1");
+    header += F("\r\nHost: ");
+    header += _host;
 
-    header += String(F("\r\nHost: ")) + _host;
     if (_port != 80 && _port != 443)
     {
         header += ':';
-        header += String(_port);
+        header += _port;
     }
-    header += String(F("\r\nUser-Agent: ")) + _userAgent +
-              F("\r\nConnection: ");
+    header += F("\r\nUser-Agent: ");
+    header += _userAgent;
+    header += F("\r\nConnection: ");
 
     if(_reuse) {
         header += F("keep-alive");
@@ -1226,11 +1227,156 @@ bool HTTPClient::sendHeader(const char * type)
         header += "\r\n";
     }
 
-    header += _headers + "\r\n";
+    header += _headers;
+    header += "\r\n";
 
     return (_client->write((const uint8_t *) header.c_str(), header.length()) == header.length());
 }
 
+/**
+ * appends to the response line, dropping what exceeds HTTP_HEADER_LINE_MAX
+ * @param data const char *
+ * @param len size_t
+ */
+void HTTPClient::appendHeaderLine(const char * data, size_t len)
+{
+    if(_headerLineLen + len > HTTP_HEADER_LINE_MAX) {
+        len = HTTP_HEADER_LINE_MAX - _headerLineLen;
+    }
+    if(_headerLineLen + len + 1 > _headerLineSize) {
+        size_t size = _headerLineSize ? _headerLineSize * 2 : 256;
+        while(size < _headerLineLen + len + 1) {
+            size *= 2;
+        }
+        char * line = (char *) realloc(_headerLine, size);
+        if(!line) {
+            log_e("out of memory for header line");
+            return;
+        }
+        _headerLine = line;
+        _headerLineSize = size;
+    }
+    memcpy(_headerLine + _headerLineLen, data, len);
+    _headerLineLen += len;
+    _headerLine[_headerLineLen] = '\0';
+}
+
+/**
+ * reads one response line into _headerLine, without waiting for more data
+ * @return true when the line is complete
+ */
+bool HTTPClient::readHeaderLine()
+{
+    while(true) {
+        if(_client->hasPeekBufferAPI()) {
+            size_t len = _client->peekAvailable();
+            if(!len) {
+                return false;
+            }
+            const char * data = _client->peekBuffer();
+            const char * nl = (const char *) memchr(data, '\n', len);
+            size_t take = nl ? nl - data + 1 : len;
+            appendHeaderLine(data, take);
+            _client->peekConsume(take);
+            if(nl) {
+                return true;
+            }
+        } else {
+            int c = _client->read();
+            if(c < 0) {
+                return false;
+            }
+            char ch = c;
+            appendHeaderLine(&ch, 1);
+            if(ch == '\n') {
+                return true;
+            }
+        }
+    }
+}
+
+/**
+ * handles one "name: value" response header, in place
+ * @param line char *               the line, trimmed and zero terminated
+ * @param len size_t
+ * @param date String &             last Date header, for cookies
+ * @param transferEncoding int &
+ */
+void HTTPClient::handleHeaderLine(char * line, size_t len, String &date, int &transferEncoding)
+{
+    char * colon = (char *) memchr(line, ':', len);
+    if(!colon || colon == line) {
+        return;
+    }
+    size_t nameLen = colon - line;
+    char * value = colon + 1;
+    while(*value == ' ' || *value == '\t') {
+        value++;
+    }
+    size_t valueLen = line + len - value;
+    uint32_t hash = headerHash(line, nameLen);
+
+    switch(hash) {
+    case headerHash("date"):
+        if(_cookieJar && headerNameIs(line, nameLen, "date")) {
+            date = value;
+        }
+        break;
+    case headerHash("content-length"):
+        if(headerNameIs(line, nameLen, "content-length")) {
+            _size = atoi(value);
+        }
+        break;
+    case headerHash("connection"):
+        if(_canReuse && headerNameIs(line, nameLen, "connection")) {
+            if(strstr(value, "close") && !strstr(value, "keep-alive")) {
+                _canReuse = false;
+            }
+        }
+        break;
+    case headerHash("transfer-encoding"):
+        // an empty value counts as no header at all, as it always did
+        if(headerNameIs(line, nameLen, "transfer-encoding") && *value) {
+            log_d("Transfer-Encoding: %s", value);
+            if(!strcasecmp(value, "chunked")) {
+                transferEncoding = TE_CHUNKED;
+            } else if(!strcasecmp(value, "identity")) {
+                transferEncoding = TE_IDENTITY;
+            } else {
+                transferEncoding = TE_UNKNOWN;
+            }
+        }
+        break;
+    case headerHash("location"):
+        if(headerNameIs(line, nameLen, "location")) {
+            _location = value;
+        }
+        break;
+    case headerHash("set-cookie"):
+        if(_cookieJar && headerNameIs(line, nameLen, "set-cookie")) {
+            setCookie(date, value);
+        }
+        break;
+    default:
+        break;
+    }
+
+    for(size_t i = 0; i < _headerKeysCount; i++) {
+        if(_currentHeaders[i].hash == hash && headerNameIs(line, nameLen, _currentHeaders[i].key.c_str())) {
+            // Uncomment the following lines if you need to add support for multiple headers with the same key:
+            // if (!_currentHeaders[i].value.isEmpty()) {
+            //     // Existing value, append this one with a comma
+            //     _currentHeaders[i].value += ',';
+            //     _currentHeaders[i].value.concat(value, valueLen);
+            // } else {
+            _currentHeaders[i].value.clear();
+            _currentHeaders[i].value.concat(value, valueLen);
+            // }
+            break; // We found a match, stop looking
+        }
+    }
+}
+
 /**
  * reads the response from the server
  * @return int http code
@@ -1246,96 +1392,62 @@ int HTTPClient::handleHeaderResponse()
     _size = -1;
     _canReuse = _reuse;
 
-    String transferEncoding;
+    int transferEncoding = TE_NONE;
 
     _transferEncoding = HTTPC_TE_IDENTITY;
     unsigned long lastDataTime = millis();
     bool firstLine = true;
     String date;
+    _headerLineLen = 0;
 
     while(connected()) {
         size_t len = _client->available();
         if(len > 0) {
-            String headerLine = _client->readStringUntil('\n');
-            headerLine.trim(); // remove \r
-
             lastDataTime = millis();
+            if(!readHeaderLine()) {
+                continue;
+            }
 
-            log_v("RX: '%s'", headerLine.c_str());
+            // trim, in place
+            char empty[1] = "";
+            char * line = _headerLine ? _headerLine : empty;
+            size_t lineLen = _headerLineLen;
+            _headerLineLen = 0;
+            while(lineLen && isspace((unsigned char) line[lineLen - 1])) {
+                lineLen--;
+            }
+            while(lineLen && isspace((unsigned char) *line)) {
+                line++;
+                lineLen--;
+            }
+            line[lineLen] = '\0';
+
+            log_v("RX: '%s'", line);
 
             if(firstLine) {
 		        firstLine = false;
-                if(_canReuse && headerLine.startsWith("HTTP/1.")) {
-                    _canReuse = (headerLine[sizeof "HTTP/1." - 1] != '0');
+                if(_canReuse && !strncmp(line, "HTTP/1.", sizeof "HTTP/1." - 1)) {
+                    _canReuse = (line[sizeof "HTTP/1." - 1] != '0');
                 }
-                int codePos = headerLine.indexOf(' ') + 1;
-                _returnCode = headerLine.substring(codePos, headerLine.indexOf(' ', codePos)).toInt();
-            } else if(headerLine.indexOf(':')) {
-                String headerName = headerLine.substring(0, headerLine.indexOf(':'));
-                String headerValue = headerLine.substring(headerLine.indexOf(':') + 1);
-                headerValue.trim();
-
-                if(headerName.equalsIgnoreCase("Date")) {
-                    date = headerValue;
-                }
-
-                if(headerName.equalsIgnoreCase("Content-Length")) {
-                    _size = headerValue.toInt();
-                }
-
-                if(_canReuse && headerName.equalsIgnoreCase("Connection")) {
-                    if(headerValue.indexOf("close") >= 0 && headerValue.indexOf("keep-alive") < 0) {
-                        _canReuse = false;
-                    }
-                }
-
-                if(headerName.equalsIgnoreCase("Transfer-Encoding")) {
-                    transferEncoding = headerValue;
-                }
-
-                if (headerName.equalsIgnoreCase("Location")) {
-                    _location = headerValue;
-                }
-
-                if (headerName.equalsIgnoreCase("Set-Cookie")) {
-                    setCookie(date, headerValue);
-                }
-
-                for (size_t i = 0; i < _headerKeysCount; i++) {
-                    if (_currentHeaders[i].key.equalsIgnoreCase(headerName)) {
-                        // Uncomment the following lines if you need to add support for multiple headers with the same key:
-                        // if (!_currentHeaders[i].value.isEmpty()) {
-                        //     // Existing value, append this one with a comma
-                        //     _currentHeaders[i].value += ',';
-                        //     _currentHeaders[i].value += headerValue;
-                        // } else {
-                        _currentHeaders[i].value = headerValue;
-                        // }
-                        break; // We found a match, stop looking
-                    }
-                }
-
-            }
-
-            if(headerLine == "") {
+                const char * code = strchr(line, ' ');
+                _returnCode = code ? atoi(code + 1) : 0;
+            } else if(lineLen) {
+                handleHeaderLine(line, lineLen, date, transferEncoding);
+            } else {
                 log_d("code: %d", _returnCode);
 
                 if(_size > 0) {
                     log_d("size: %d", _size);
                 }
 
-                if(transferEncoding.length() > 0) {
-                    log_d("Transfer-Encoding: %s", transferEncoding.c_str());
-                    if(transferEncoding.equalsIgnoreCase("chunked")) {
-                        _transferEncoding = HTTPC_TE_CHUNKED;
-                    } else if(transferEncoding.equalsIgnoreCase("identity")) {
-                        _transferEncoding = HTTPC_TE_IDENTITY;
-                    } else {
-                        return HTTPC_ERROR_ENCODING;
-                    }
+                if(transferEncoding == TE_CHUNKED) {
+                    _transferEncoding = HTTPC_TE_CHUNKED;
+                } else if(transferEncoding == TE_UNKNOWN) {
+                    return HTTPC_ERROR_ENCODING;
                 } else {
                     _transferEncoding = HTTPC_TE_IDENTITY;
                 }
+                _body.begin(_client, _transferEncoding == HTTPC_TE_CHUNKED, _size, _tcpTimeout);
 
                 if(_returnCode) {
                     return _returnCode;
@@ -1357,116 +1469,139 @@ int HTTPClient::handleHeaderResponse()
 }
 
 /**
- * write one Data Block to Stream
- * @param stream Stream *
- * @param size int
- * @return < 0 = error >= 0 = size written
+ * HTTPBodyStream &
+ * @return the decoded response body, valid until the connection is reused or closed
  */
-int HTTPClient::writeToStreamDataBlock(Stream * stream, int size)
+HTTPBodyStream& HTTPClient::bodyStream(void)
 {
-    int buff_size = HTTP_TCP_BUFFER_SIZE;
-    int len = size;
-    int bytesWritten = 0;
-
-    // if possible create smaller buffer then HTTP_TCP_BUFFER_SIZE
-    if((len > 0) && (len < HTTP_TCP_BUFFER_SIZE)) {
-        buff_size = len;
-    }
-
-    // create buffer for read
-    uint8_t * buff = (uint8_t *) malloc(buff_size);
-
-    if(buff) {
-        // read all data from server
-        while(connected() && (len > 0 || len == -1)) {
-
-            // get available data size
-            size_t sizeAvailable = _client->available();
-
-            if(sizeAvailable) {
-
-                int readBytes = sizeAvailable;
+    return _body;
+}
 
-                // read only the asked bytes
-                if(len > 0 && readBytes > len) {
-                    readBytes = len;
-                }
+/**
+ * write one block of data to Stream, retrying a short write once
+ * @param stream Stream *
+ * @param data const uint8_t *
+ * @param len int
+ * @return bytes written ( negative values are error codes )
+ */
+int HTTPClient::writeToStreamBlock(Stream * stream, const uint8_t * data, int len)
+{
+    int bytesWritten = stream->write(data, len);
 
-                // not read more the buffer can handle
-                if(readBytes > buff_size) {
-                    readBytes = buff_size;
-                }
-		    
-        		// stop if no more reading    
-        		if (readBytes == 0)
-        			break;
+    // are all Bytes a writen to stream ?
+    if(bytesWritten != len) {
+        log_d("short write asked for %d but got %d retry...", len, bytesWritten);
 
-                // read data
-                int bytesRead = _client->readBytes(buff, readBytes);
+        // check for write error
+        if(stream->getWriteError()) {
+            log_d("stream write error %d", stream->getWriteError());
 
-                // write it to Stream
-                int bytesWrite = stream->write(buff, bytesRead);
-                bytesWritten += bytesWrite;
+            //reset write error for retry
+            stream->clearWriteError();
+        }
 
-                // are all Bytes a writen to stream ?
-                if(bytesWrite != bytesRead) {
-                    log_d("short write asked for %d but got %d retry...", bytesRead, bytesWrite);
+        // some time for the stream
+        delay(1);
 
-                    // check for write error
-                    if(stream->getWriteError()) {
-                        log_d("stream write error %d", stream->getWriteError());
+        int leftBytes = (len - bytesWritten);
 
-                        //reset write error for retry
-                        stream->clearWriteError();
-                    }
+        // retry to send the missed bytes
+        int bytesWrite = stream->write((data + bytesWritten), leftBytes);
+        bytesWritten += bytesWrite;
 
-                    // some time for the stream
-                    delay(1);
+        if(bytesWrite != leftBytes) {
+            // failed again
+            log_w("short write asked for %d but got %d failed.", leftBytes, bytesWrite);
+            return HTTPC_ERROR_STREAM_WRITE;
+        }
+    }
 
-                    int leftBytes = (bytesRead - bytesWrite);
+    // check for write error
+    if(stream->getWriteError()) {
+        log_w("stream write error %d", stream->getWriteError());
+        return HTTPC_ERROR_STREAM_WRITE;
+    }
+    return bytesWritten;
+}
 
-                    // retry to send the missed bytes
-                    bytesWrite = stream->write((buff + bytesWrite), leftBytes);
-                    bytesWritten += bytesWrite;
+/**
+ * write the decoded body to Stream
+ * Data goes from the receive buffer straight into the stream when the connection
+ * has a peek buffer, or is read straight into the stream's writeBuffer().
+ * @param stream Stream *
+ * @param size int      expected body size, -1 if not known
+ * @return bytes written ( negative values are error codes )
+ */
+int HTTPClient::writeToStreamDataBlock(Stream * stream, int size)
+{
+    uint8_t * buff = nullptr;
+    int bytesWritten = 0;
+    unsigned long lastDataTime = millis();
 
-                    if(bytesWrite != leftBytes) {
-                        // failed again
-                        log_w("short write asked for %d but got %d failed.", leftBytes, bytesWrite);
-                        free(buff);
-                        return HTTPC_ERROR_STREAM_WRITE;
+    while(!_body.finished()) {
+        int r = 0;
+        size_t len;
+        if(_body.hasPeekBufferAPI() && (len = _body.peekAvailable()) > 0) {
+            r = writeToStreamBlock(stream, (const uint8_t *) _body.peekBuffer(), len);
+            if(r > 0) {
+                _body.peekConsume(r);
+            }
+        } else if((len = _body.available()) > 0) {
+            char * dst = stream->writeBuffer(len);
+            if(dst) {
+                r = _body.read((uint8_t *) dst, len);
+                stream->writeCommit(r);
+            } else {
+                if(!buff) {
+                    buff = (uint8_t *) malloc(HTTP_TCP_BUFFER_SIZE);
+                    if(!buff) {
+                        log_w("too less ram! need %d", HTTP_TCP_BUFFER_SIZE);
+                        return HTTPC_ERROR_TOO_LESS_RAM;
                     }
                 }
-
-                // check for write error
-                if(stream->getWriteError()) {
-                    log_w("stream write error %d", stream->getWriteError());
-                    free(buff);
-                    return HTTPC_ERROR_STREAM_WRITE;
-                }
-
-                // count bytes to read left
-                if(len > 0) {
-                    len -= bytesRead;
+                r = _body.read(buff, len < HTTP_TCP_BUFFER_SIZE ? len : HTTP_TCP_BUFFER_SIZE);
+                if(r > 0) {
+                    r = writeToStreamBlock(stream, buff, r);
                 }
-
-                delay(0);
-            } else {
-                delay(1);
             }
+        } else {
+            if(_body.error()) {
+                break;
+            }
+            if(!connected()) {
+                break;
+            }
+            if((millis() - lastDataTime) > _tcpTimeout) {
+                free(buff);
+                return HTTPC_ERROR_READ_TIMEOUT;
+            }
+            delay(1);
+            continue;
         }
 
-        free(buff);
+        if(r < 0) {
+            free(buff);
+            return r;
+        }
+        bytesWritten += r;
+        lastDataTime = millis();
+        delay(0);
+    }
 
-        log_d("connection closed or file end (written: %d).", bytesWritten);
+    free(buff);
 
-        if((size > 0) && (size != bytesWritten)) {
-            log_d("bytesWritten %d and size %d mismatch!.", bytesWritten, size);
-            return HTTPC_ERROR_STREAM_WRITE;
-        }
+    if(_body.error()) {
+        return _body.error();
+    }
+    if(_transferEncoding == HTTPC_TE_CHUNKED && !_body.finished()) {
+        return HTTPC_ERROR_CONNECTION_LOST;
+    }
 
-    } else {
-        log_w("too less ram! need %d", HTTP_TCP_BUFFER_SIZE);
-        return HTTPC_ERROR_TOO_LESS_RAM;
+    log_d("connection closed or file end (written: %d).", bytesWritten);
+
+    if((size > 0) && (size != bytesWritten)) {
+        log_d("bytesWritten %d and size %d mismatch!.", bytesWritten, size);
+        return HTTPC_ERROR_STREAM_WRITE;
     }
 
     return bytesWritten;
@@ -1706,3 +1841,248 @@ bool HTTPClient::generateCookieString(String *cookieString)
     
     return found;
 }
+
+/**
+ * starts decoding a response body
+ * @param client WiFiClient *       the connection, positioned after the header
+ * @param chunked bool              Transfer-Encoding: chunked
+ * @param size int                  Content-Length, -1 if not known
+ * @param timeout unsigned long     for readBytes() in ms
+ */
+void HTTPBodyStream::begin(WiFiClient * client, bool chunked, int size, unsigned long timeout)
+{
+    _client = client;
+    _chunked = chunked;
+    _size = chunked ? -1 : size;
+    _remaining = chunked ? 0 : size;
+    _state = chunked ? BODY_CHUNK_SIZE : BODY_DATA;
+    _position = 0;
+    _error = 0;
+    setTimeout(timeout);
+}
+
+void HTTPBodyStream::end()
+{
+    _client = nullptr;
+    _state = BODY_IDLE;
+}
+
+/**
+ * ends the size line of a chunk, a zero size is the last chunk
+ */
+void HTTPBodyStream::endOfSizeLine()
+{
+    if(_remaining == 0) {
+        _emptyLine = true;
+        _state = BODY_TRAILER;
+    } else {
+        log_d(" read chunk len: %d", _remaining);
+        _state = BODY_DATA;
+    }
+}
+
+/**
+ * parses the chunk framing that is already received, never waits
+ * @return true when body data can be read
+ */
+bool HTTPBodyStream::advance()
+{
+    while(true) {
+        switch(_state) {
+        case BODY_DATA:
+            if(_remaining != 0) {
+                return true;
+            }
+            _state = _chunked ? BODY_CHUNK_CR : BODY_DONE;
+            continue;
+        case BODY_IDLE:
+        case BODY_DONE:
+        case BODY_FAILED:
+            return false;
+        default:
+            break;
+        }
+
+        if(!_client->available()) {
+            return false;
+        }
+        int c = _client->read();
+        if(c < 0) {
+            return false;
+        }
+
+        switch(_state) {
+        case BODY_CHUNK_SIZE:
+            if(isxdigit(c)) {
+                if(_remaining > 0x7ffffff) {
+                    _error = HTTPC_ERROR_ENCODING;
+                    _state = BODY_FAILED;
+                    return false;
+                }
+                _remaining = (_remaining << 4) | (isdigit(c) ? c - '0' : (c | 0x20) - 'a' + 10);
+            } else if(c == ';' || c == ' ' || c == '\t') {
+                _state = BODY_CHUNK_EXT;
+            } else if(c == '\n') {
+                endOfSizeLine();
+            } else if(c != '\r') {
+                _error = HTTPC_ERROR_ENCODING;
+                _state = BODY_FAILED;
+                return false;
+            }
+            break;
+        case BODY_CHUNK_EXT:
+            if(c == '\n') {
+                endOfSizeLine();
+            }
+            break;
+        case BODY_CHUNK_CR:
+        case BODY_CHUNK_LF:
+            // every chunk ends with \r\n
+            if(c != (_state == BODY_CHUNK_CR ? '\r' : '\n')) {
+                _error = HTTPC_ERROR_READ_TIMEOUT;
+                _state = BODY_FAILED;
+                return false;
+            }
+            if(_state == BODY_CHUNK_CR) {
+                _state = BODY_CHUNK_LF;
+            } else {
+                _remaining = 0;
+                _state = BODY_CHUNK_SIZE;
+            }
+            break;
+        case BODY_TRAILER:
+            // trailer fields up to an empty line, they are not kept
+            if(c == '\n') {
+                if(_emptyLine) {
+                    _state = BODY_DONE;
+                }
+                _emptyLine = true;
+            } else if(c != '\r') {
+                _emptyLine = false;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void HTTPBodyStream::consumed(size_t size)
+{
+    _position += size;
+    if(_remaining > 0) {
+        _remaining -= size;
+    }
+}
+
+bool HTTPBodyStream::finished()
+{
+    // a chunked body is only done after its trailer, or the trailer would be
+    // left to the next response on a reused connection
+    advance();
+    if(_state == BODY_DONE) {
+        return true;
+    }
+    // without Content-Length the body ends with the connection
+    return _state == BODY_DATA && _remaining < 0 && !_client->connected() && !_client->available();
+}
+
+int HTTPBodyStream::available()
+{
+    if(!advance()) {
+        return 0;
+    }
+    int available = _client->available();
+    if(_remaining >= 0 && available > _remaining) {
+        available = _remaining;
+    }
+    return available;
+}
+
+int HTTPBodyStream::read()
+{
+    if(!advance()) {
+        return -1;
+    }
+    int c = _client->read();
+    if(c >= 0) {
+        consumed(1);
+    }
+    return c;
+}
+
+int HTTPBodyStream::peek()
+{
+    if(!advance()) {
+        return -1;
+    }
+    return _client->peek();
+}
+
+int HTTPBodyStream::read(uint8_t * buffer, size_t size)
+{
+    size_t total = 0;
+    while(total < size && advance()) {
+        size_t len = size - total;
+        if(_remaining >= 0 && len > (size_t) _remaining) {
+            len = _remaining;
+        }
+        int r = _client->read(buffer + total, len);
+        if(r <= 0) {
+            break;
+        }
+        consumed(r);
+        total += r;
+    }
+    return total;
+}
+
+size_t HTTPBodyStream::readBytes(char * buffer, size_t length)
+{
+    size_t count = 0;
+    unsigned long start = millis();
+    while(count < length) {
+        int r = read((uint8_t *) buffer + count, length - count);
+        if(r > 0) {
+            count += r;
+            start = millis();
+            continue;
+        }
+        if(_error || finished() || !_client || (!_client->connected() && !_client->available())) {
+            break;
+        }
+        if(millis() - start >= _timeout) {
+            break;
+        }
+        delay(1);
+    }
+    return count;
+}
+
+bool HTTPBodyStream::hasPeekBufferAPI() const
+{
+    return _client && _client->hasPeekBufferAPI();
+}
+
+size_t HTTPBodyStream::peekAvailable()
+{
+    if(!advance()) {
+        return 0;
+    }
+    size_t available = _client->peekAvailable();
+    if(_remaining >= 0 && available > (size_t) _remaining) {
+        available = _remaining;
+    }
+    return available;
+}
+
+const char * HTTPBodyStream::peekBuffer()
+{
+    return _client->peekBuffer();
+}
+
+void HTTPBodyStream::peekConsume(size_t consume)
+{
+    _client->peekConsume(consume);
+    consumed(consume);
+}
@@ -57,6 +57,11 @@
 /// size for the stream handling
 #define HTTP_TCP_BUFFER_SIZE (1460)
 
+/// longest response header line kept, the rest of a longer line is dropped
+#ifndef HTTP_HEADER_LINE_MAX
+#define HTTP_HEADER_LINE_MAX (4096)
+#endif
+
 /// HTTP codes see RFC7231
 typedef enum {
     HTTP_CODE_CONTINUE = 100,
@@ -168,6 +173,63 @@ typedef struct  {
 } Cookie;
 typedef std::vector<Cookie> CookieJar;
 
+/**
+ * The response body as a Stream, with the chunked transfer encoding removed.
+ * Reads go straight from the connection into the caller's buffer, and the peek
+ * buffer API exposes the receive buffer itself, so parsers can scan the body in place.
+ * available(), read() and peekAvailable() never wait, readBytes() waits up to the timeout.
+ */
+class HTTPBodyStream : public Stream
+{
+public:
+    void begin(WiFiClient * client, bool chunked, int size, unsigned long timeout);
+    void end();
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    int read(uint8_t * buffer, size_t size);                    // what is already received, up to size
+    size_t readBytes(char * buffer, size_t length) override;
+
+    size_t write(uint8_t) override { return 0; }
+
+    bool hasPeekBufferAPI() const override;
+    size_t peekAvailable() override;
+    const char * peekBuffer() override;
+    void peekConsume(size_t consume) override;
+
+    int size() const { return _size; }                          // Content-Length, -1 if not known
+    size_t position() const { return _position; }               // body bytes read so far
+    bool finished();                                            // the whole body and any trailer were read
+    int error() const { return _error; }                        // HTTPC_ERROR_* once decoding failed
+
+protected:
+    typedef enum {
+        BODY_IDLE,
+        BODY_DATA,
+        BODY_CHUNK_SIZE,
+        BODY_CHUNK_EXT,
+        BODY_CHUNK_CR,
+        BODY_CHUNK_LF,
+        BODY_TRAILER,
+        BODY_DONE,
+        BODY_FAILED
+    } bodyState_t;
+
+    bool advance();
+    void consumed(size_t size);
+    void endOfSizeLine();
+
+    WiFiClient* _client = nullptr;
+    bodyState_t _state = BODY_IDLE;
+    bool _chunked = false;
+    bool _emptyLine = false;
+    int _size = -1;
+    int32_t _remaining = 0;    // of the body or the current chunk, -1 until the connection closes
+    size_t _position = 0;
+    int _error = 0;
+};
+
 
 class HTTPClient
 {
@@ -239,6 +301,7 @@ public:
     WiFiClient* getStreamPtr(void);
     int writeToStream(Stream* stream);
     String getString(void);
+    HTTPBodyStream& bodyStream(void);
 
     static String errorToString(int error);
 
@@ -251,6 +314,7 @@ protected:
     struct RequestArgument {
         String key;
         String value;
+        uint32_t hash = 0;  // of the lower case key
     };
 
     bool beginInternal(String url, const char* expectedProtocol);
@@ -260,7 +324,11 @@ protected:
     bool connect(void);
     bool sendHeader(const char * type);
     int handleHeaderResponse();
+    void appendHeaderLine(const char * data, size_t len);
+    bool readHeaderLine();
+    void handleHeaderLine(char * line, size_t len, String &date, int &transferEncoding);
     int writeToStreamDataBlock(Stream * stream, int len);
+    int writeToStreamBlock(Stream * stream, const uint8_t * data, int len);
 
     /// Cookie jar support
     void setCookie(String date, String headerValue);
@@ -293,6 +361,11 @@ protected:
     RequestArgument* _currentHeaders = nullptr;
     size_t           _headerKeysCount = 0;
 
+    /// response header line, kept between requests
+    char*  _headerLine = nullptr;
+    size_t _headerLineSize = 0;
+    size_t _headerLineLen = 0;
+
     int _returnCode = 0;
     int _size = -1;
     bool _canReuse = false;
@@ -300,6 +373,7 @@ protected:
     uint16_t _redirectLimit = 10;
     String _location;
     transferEncoding_t _transferEncoding = HTTPC_TE_IDENTITY;
+    HTTPBodyStream _body;
 
     /// Cookie jar support
     CookieJar* _cookieJar = nullptr;
@@ -142,6 +142,12 @@ String HTTPUpdate::getLastErrorString(void)
         return "New Binary Does Not Fit Flash Size";
     case HTTP_UE_NO_PARTITION:
         return "Partition Could Not be Found";
+    case HTTP_UE_DELTA_HEADER_FAILED:
+        return "Verify Delta Patch Header Failed";
+    case HTTP_UE_DELTA_BASE_MISMATCH:
+        return "Delta Patch Is For A Different Sketch";
+    case HTTP_UE_DELTA_APPLY_FAILED:
+        return "Delta Patch Could Not be Applied";
     }
 
     return String();
@@ -149,29 +155,10 @@ String HTTPUpdate::getLastErrorString(void)
 
 
 String getSketchSHA256() {
-  const size_t HASH_LEN = 32; // SHA-256 digest length
-
-  uint8_t sha_256[HASH_LEN] = { 0 };
-
-// get sha256 digest for running partition
-  if(esp_partition_get_sha256(esp_ota_get_running_partition(), sha_256) == 0) {
-    char buffer[2 * HASH_LEN + 1];
-
-    for(size_t index = 0; index < HASH_LEN; index++) {
-      uint8_t nibble = (sha_256[index] & 0xf0) >> 4;
-      buffer[2 * index] = nibble < 10 ? char(nibble + '0') : char(nibble - 10 + 'A');
-
-      nibble = sha_256[index] & 0x0f;
-      buffer[2 * index + 1] = nibble < 10 ? char(nibble + '0') : char(nibble - 10 + 'A');
-    }
-
-    buffer[2 * HASH_LEN] = '\0';
-
-    return String(buffer);
-  } else {
-
-    return String();
-  }
+  // same digest as esp_partition_get_sha256(), cached by the core
+  String sha256 = ESP.getSketchSHA256();
+  sha256.toUpperCase();
+  return sha256;
 }
 
 /**
@@ -211,6 +198,9 @@ HTTPUpdateResult HTTPUpdate::handleUpdate(HTTPClient& http, const String& curren
         http.addHeader("x-ESP32-mode", "spiffs");
     } else {
         http.addHeader("x-ESP32-mode", "sketch");
+        if(_deltaUpdates && sketchMD5.length() != 0) {
+            http.addHeader("x-ESP32-delta", String(UPDATE_DELTA_VERSION));
+        }
     }
 
     if(currentVersion && currentVersion[0] != 0x00) {
@@ -300,6 +290,7 @@ HTTPUpdateResult HTTPUpdate::handleUpdate(HTTPClient& http, const String& curren
                 delay(100);
 
                 int command;
+                bool delta = false;
 
                 if(spiffs) {
                     command = U_SPIFFS;
@@ -322,7 +313,11 @@ HTTPUpdateResult HTTPUpdate::handleUpdate(HTTPClient& http, const String& curren
 
                     // check for valid first magic byte
 //                    if(buf[0] != 0xE9) {
-                    if(tcp->peek() != 0xE9) {
+                    int magic = tcp->peek();
+                    if(_deltaUpdates && magic == UPDATE_DELTA_MAGIC[0]) {
+                        delta = true;
+                        log_d("runDeltaUpdate flash...\n");
+                    } else if(magic != 0xE9) {
                         log_e("Magic header does not start with 0xE9\n");
                         _lastError = HTTP_UE_BIN_VERIFY_HEADER_FAILED;
                         http.end();
@@ -341,7 +336,7 @@ HTTPUpdateResult HTTPUpdate::handleUpdate(HTTPClient& http, const String& curren
                     }
 */
                 }
-                if(runUpdate(*tcp, len, http.header("x-MD5"), command)) {
+                if(delta ? runDeltaUpdate(*tcp, len) : runUpdate(*tcp, len, http.header("x-MD5"), command)) {
                     ret = HTTP_UPDATE_OK;
                     log_d("Update ok\n");
                     http.end();
@@ -449,6 +444,106 @@ bool HTTPUpdate::runUpdate(Stream& in, uint32_t size, String md5, int command)
     return true;
 }
 
+/**
+ * apply a delta patch against the running sketch and write the result to flash
+ * @param in Stream&
+ * @param size uint32_t size of the patch
+ * @return true if Update ok
+ */
+bool HTTPUpdate::runDeltaUpdate(Stream& in, uint32_t size)
+{
+    StreamString error;
+    update_delta_header_t header;
+
+    if(size <= sizeof(header) || in.readBytes((uint8_t*)&header, sizeof(header)) != sizeof(header)
+        || !UpdateDelta::checkHeader(header)) {
+        _lastError = HTTP_UE_DELTA_HEADER_FAILED;
+        log_e("Delta patch header invalid\n");
+        return false;
+    }
+
+    // the patch is only valid for the exact image it was made against
+    char md5[33];
+    for(size_t i = 0; i < sizeof(header.oldMD5); i++) {
+        sprintf(md5 + 2 * i, "%02x", header.oldMD5[i]);
+    }
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    if(!running || header.oldSize != ESP.getSketchSize() || !ESP.getSketchMD5().equalsIgnoreCase(md5)) {
+        _lastError = HTTP_UE_DELTA_BASE_MISMATCH;
+        log_e("Delta patch base %s does not match the running sketch\n", md5);
+        return false;
+    }
+
+    if (_cbProgress) {
+        Update.onProgress(_cbProgress);
+    }
+
+    if(!Update.begin(header.newSize, U_FLASH, _ledPin, _ledOn)) {
+        _lastError = Update.getError();
+        Update.printError(error);
+        error.trim(); // remove line ending
+        log_e("Update.begin failed! (%s)\n", error.c_str());
+        return false;
+    }
+
+    if (_cbProgress) {
+        _cbProgress(0, header.newSize);
+    }
+
+    for(size_t i = 0; i < sizeof(header.newMD5); i++) {
+        sprintf(md5 + 2 * i, "%02x", header.newMD5[i]);
+    }
+    Update.setMD5(md5);
+
+    UpdateDelta delta;
+    bool ok = delta.begin(header,
+        [running](uint32_t offset, uint8_t* data, size_t len) {
+            return esp_partition_read(running, offset, data, len) == ESP_OK;
+        },
+        [](const uint8_t* data, size_t len) {
+            return Update.write(const_cast<uint8_t*>(data), len) == len;
+        });
+
+    uint8_t buf[512];
+    size_t remaining = size - sizeof(header);
+    while(ok && remaining) {
+        size_t toRead = (remaining < sizeof(buf)) ? remaining : sizeof(buf);
+        size_t len = in.readBytes(buf, toRead);
+        if(!len) {
+            log_e("Delta patch stream read timeout\n");
+            ok = false;
+            break;
+        }
+        ok = delta.write(buf, len) == len;
+        remaining -= len;
+    }
+
+    if(!delta.end() || !ok) {
+        if(Update.hasError()) {
+            _lastError = Update.getError();
+        } else {
+            _lastError = HTTP_UE_DELTA_APPLY_FAILED;
+        }
+        log_e("Delta patch failed! (%s)\n", delta.errorString());
+        Update.abort();
+        return false;
+    }
+
+    if (_cbProgress) {
+        _cbProgress(header.newSize, header.newSize);
+    }
+
+    if(!Update.end()) {
+        _lastError = Update.getError();
+        Update.printError(error);
+        error.trim(); // remove line ending
+        log_e("Update.end failed! (%s)\n", error.c_str());
+        return false;
+    }
+
+    return true;
+}
+
 #if !defined(NO_GLOBAL_INSTANCES) && !defined(NO_GLOBAL_HTTPUPDATE)
 HTTPUpdate httpUpdate;
 #endif
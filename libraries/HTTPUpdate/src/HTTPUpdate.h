@@ -32,6 +32,7 @@
 #include <WiFiUdp.h>
 #include <HTTPClient.h>
 #include <Update.h>
+#include <UpdateDelta.h>
 
 /// note we use HTTP client errors too so we start at 100
 #define HTTP_UE_TOO_LESS_SPACE              (-100)
@@ -43,6 +44,9 @@
 #define HTTP_UE_BIN_VERIFY_HEADER_FAILED    (-106)
 #define HTTP_UE_BIN_FOR_WRONG_FLASH         (-107)
 #define HTTP_UE_NO_PARTITION                (-108)
+#define HTTP_UE_DELTA_HEADER_FAILED         (-109)
+#define HTTP_UE_DELTA_BASE_MISMATCH         (-110)
+#define HTTP_UE_DELTA_APPLY_FAILED          (-111)
 
 enum HTTPUpdateResult {
     HTTP_UPDATE_FAILED,
@@ -79,6 +83,16 @@ public:
         _followRedirects = follow;
     }
 
+    /**
+      * accept delta patches against the running sketch (tools/esp_delta.py)
+      * instead of full images. On by default, the server decides what to send.
+      * @param enable
+      */
+    void setDeltaUpdates(bool enable)
+    {
+        _deltaUpdates = enable;
+    }
+
     void setLedPin(int ledPin = -1, uint8_t ledOn = HIGH)
     {
         _ledPin = ledPin;
@@ -110,6 +124,7 @@ public:
 protected:
     t_httpUpdate_return handleUpdate(HTTPClient& http, const String& currentVersion, bool spiffs = false, HTTPUpdateRequestCB requestCB = NULL);
     bool runUpdate(Stream& in, uint32_t size, String md5, int command = U_FLASH);
+    bool runDeltaUpdate(Stream& in, uint32_t size);
 
     // Set the error and potentially use a CB to notify the application
     void _setLastError(int err) {
@@ -120,6 +135,7 @@ protected:
     }
     int _lastError;
     bool _rebootOnUpdate = true;
+    bool _deltaUpdates = true;
 private:
     int _httpClientTimeout;
     followRedirects_t _followRedirects;
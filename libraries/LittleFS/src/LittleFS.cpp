@@ -36,19 +36,12 @@ class LittleFSImpl : public VFSImpl
 public:
     LittleFSImpl();
     virtual ~LittleFSImpl() { }
-    virtual bool exists(const char* path);
 };
 
 LittleFSImpl::LittleFSImpl()
 {
 }
 
-bool LittleFSImpl::exists(const char* path)
-{
-    File f = open(path, "r",false);
-    return (f == true);
-}
-
 LittleFSFS::LittleFSFS() : FS(FSImplPtr(new LittleFSImpl())), partitionLabel_(NULL)
 {
 }
@@ -123,6 +116,7 @@ bool LittleFSFS::format()
         log_e("Formatting LittleFS failed! Error: %d", err);
         return false;
     }
+    _impl->clearStatCache();
     return true;
 }
 
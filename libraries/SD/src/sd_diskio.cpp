@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 #include "sd_diskio.h"
+#include "sd_diskio_cache.h"
 #include "esp_system.h"
 extern "C" {
     #include "ff.h"
@@ -58,6 +59,7 @@ typedef struct {
     unsigned long sectors;
     bool supports_crc;
     int status;
+    sd_sector_cache_t * cache;
 } ardu_sdcard_t;
 
 static ardu_sdcard_t* s_cards[FF_VOLUMES] = { NULL };
@@ -96,8 +98,9 @@ bool sdWait(uint8_t pdrv, int timeout)
     char resp;
     uint32_t start = millis();
 
+    // poll four bytes per transfer, only the last one received matters
     do {
-        resp = s_cards[pdrv]->spi->transfer(0xFF);
+        resp = s_cards[pdrv]->spi->transfer32(0xFFFFFFFF) & 0xFF;
     } while (resp == 0x00 && (millis() - start) < (unsigned int)timeout);
 
     if (!resp) {
@@ -202,6 +205,8 @@ char sdCommand(uint8_t pdrv, char cmd, unsigned int arg, unsigned int* resp)
     return token;
 }
 
+#define SD_TOKEN_POLL_SIZE 8
+
 bool sdReadBytes(uint8_t pdrv, char* buffer, int length)
 {
     char token;
@@ -209,15 +214,36 @@ bool sdReadBytes(uint8_t pdrv, char* buffer, int length)
     ardu_sdcard_t * card = s_cards[pdrv];
 
     uint32_t start = millis();
+    if (length < SD_TOKEN_POLL_SIZE) {
+        do {
+            token = card->spi->transfer(0xFF);
+        } while (token == 0xFF && (millis() - start) < 500);
+
+        if (token != 0xFE) {
+            return false;
+        }
+
+        card->spi->transferBytes(NULL, (uint8_t*)buffer, length);
+        crc = card->spi->transfer16(0xFFFF);
+        return (!card->supports_crc || crc == CRC16(buffer, length));
+    }
+
+    // Poll for the data token several bytes per transfer. What follows the
+    // token in the same chunk is already the start of the block.
+    uint8_t chunk[SD_TOKEN_POLL_SIZE];
+    int pos;
     do {
-        token = card->spi->transfer(0xFF);
-    } while (token == 0xFF && (millis() - start) < 500);
+        card->spi->transferBytes(NULL, chunk, SD_TOKEN_POLL_SIZE);
+        for (pos = 0; pos < SD_TOKEN_POLL_SIZE && chunk[pos] == 0xFF; pos++);
+    } while (pos == SD_TOKEN_POLL_SIZE && (millis() - start) < 500);
 
-    if (token != 0xFE) {
+    if (pos == SD_TOKEN_POLL_SIZE || chunk[pos] != 0xFE) {
         return false;
     }
-
-    card->spi->transferBytes(NULL, (uint8_t*)buffer, length);
+    pos++;
+    int have = SD_TOKEN_POLL_SIZE - pos;
+    memcpy(buffer, chunk + pos, have);
+    card->spi->transferBytes(NULL, (uint8_t*)buffer + have, length - have);
     crc = card->spi->transfer16(0xFFFF);
     return (!card->supports_crc || crc == CRC16(buffer, length));
 }
@@ -414,6 +440,15 @@ bool sdWriteSectors(uint8_t pdrv, const char* buffer, unsigned long long sector,
     return false;
 }
 
+static bool sdTransferSectors(void * ctx, uint8_t * buffer, uint32_t sector, uint32_t count, bool write)
+{
+    uint8_t pdrv = (uint8_t)(uintptr_t)ctx;
+    if (write) {
+        return (count > 1) ? sdWriteSectors(pdrv, (const char*)buffer, sector, count) : sdWriteSector(pdrv, (const char*)buffer, sector);
+    }
+    return (count > 1) ? sdReadSectors(pdrv, (char*)buffer, sector, count) : sdReadSector(pdrv, (char*)buffer, sector);
+}
+
 unsigned long sdGetSectorsCount(uint8_t pdrv)
 {
     for (int f = 0; f < 3; f++) {
@@ -606,6 +641,9 @@ DSTATUS ff_sd_initialize(uint8_t pdrv)
         card->frequency = 25000000;
     }
 
+    if (card->cache) {
+        sd_cache_invalidate(card->cache);
+    }
     card->status &= ~STA_NOINIT;
     return card->status;
 
@@ -637,10 +675,10 @@ DRESULT ff_sd_read(uint8_t pdrv, uint8_t* buffer, DWORD sector, UINT count)
 
     AcquireSPI lock(card);
 
-    if (count > 1) {
-        res = sdReadSectors(pdrv, (char*)buffer, sector, count) ? RES_OK : RES_ERROR;
+    if (card->cache) {
+        res = sd_cache_read(card->cache, buffer, sector, count) ? RES_OK : RES_ERROR;
     } else {
-        res = sdReadSector(pdrv, (char*)buffer, sector) ? RES_OK : RES_ERROR;
+        res = sdTransferSectors((void*)(uintptr_t)pdrv, buffer, sector, count, false) ? RES_OK : RES_ERROR;
     }
     return res;
 }
@@ -659,10 +697,10 @@ DRESULT ff_sd_write(uint8_t pdrv, const uint8_t* buffer, DWORD sector, UINT coun
 
     AcquireSPI lock(card);
 
-    if (count > 1) {
-        res = sdWriteSectors(pdrv, (const char*)buffer, sector, count) ? RES_OK : RES_ERROR;
+    if (card->cache) {
+        res = sd_cache_write(card->cache, buffer, sector, count) ? RES_OK : RES_ERROR;
     } else {
-        res = sdWriteSector(pdrv, (const char*)buffer, sector) ? RES_OK : RES_ERROR;
+        res = sdTransferSectors((void*)(uintptr_t)pdrv, (uint8_t*)buffer, sector, count, true) ? RES_OK : RES_ERROR;
     }
     return res;
 }
@@ -673,6 +711,9 @@ DRESULT ff_sd_ioctl(uint8_t pdrv, uint8_t cmd, void* buff)
     case CTRL_SYNC:
         {
             AcquireSPI lock(s_cards[pdrv]);
+            if (s_cards[pdrv]->cache && !sd_cache_flush(s_cards[pdrv]->cache)) {
+                return RES_ERROR;
+            }
             if (sdSelectCard(pdrv)) {
                 sdDeselectCard(pdrv);
                 return RES_OK;
@@ -713,6 +754,9 @@ uint8_t sdcard_uninit(uint8_t pdrv)
         return 1;
     }
     AcquireSPI lock(card);
+    if (card->cache && !(card->status & STA_NOINIT)) {
+        sd_cache_flush(card->cache);
+    }
     sdTransaction(pdrv, GO_IDLE_STATE, 0, NULL);
     ff_diskio_register(pdrv, NULL);
     s_cards[pdrv] = NULL;
@@ -721,6 +765,7 @@ uint8_t sdcard_uninit(uint8_t pdrv)
         err = esp_vfs_fat_unregister_path(card->base_path);
         free(card->base_path);
     }
+    sd_cache_free(card->cache);
     free(card);
     return err;
 }
@@ -746,6 +791,13 @@ uint8_t sdcard_init(uint8_t cs, SPIClass * spi, int hz)
     card->supports_crc = true;
     card->type = CARD_NONE;
     card->status = STA_NOINIT;
+    card->cache = NULL;
+#if SD_SECTOR_CACHE_SIZE > 0
+    card->cache = sd_cache_new(SD_SECTOR_CACHE_SIZE, &sdTransferSectors, (void*)(uintptr_t)pdrv);
+    if (!card->cache) {
+        log_w("sector cache disabled, not enough memory");
+    }
+#endif
 
     pinMode(card->ssPin, OUTPUT);
     digitalWrite(card->ssPin, HIGH);
@@ -770,6 +822,10 @@ uint8_t sdcard_unmount(uint8_t pdrv)
     if (pdrv >= FF_VOLUMES || card == NULL) {
         return 1;
     }
+    if (card->cache && !(card->status & STA_NOINIT)) {
+        AcquireSPI lock(card);
+        sd_cache_flush(card->cache);
+    }
     card->status |= STA_NOINIT;
     card->type = CARD_NONE;
 
@@ -830,6 +886,11 @@ bool sdcard_mount(uint8_t pdrv, const char* path, uint8_t max_files, bool format
     }
     AcquireSPI lock(card);
     card->sectors = sdGetSectorsCount(pdrv);
+    if (card->cache) {
+        // hold back writes to the boot sectors, the FATs and the FAT12/16 root
+        // directory only; FAT32 directories and file data are written through
+        sd_cache_set_writeback(card->cache, fs->volbase, fs->database - fs->volbase);
+    }
     return true;
 }
 
@@ -19,6 +19,12 @@
 #include "sd_defines.h"
 // #include "diskio.h"
 
+// Sectors of cache per card, 0 disables. Writes to the boot sectors, the FATs
+// and the FAT12/16 root directory are held until sync, the rest is written through
+#ifndef SD_SECTOR_CACHE_SIZE
+#define SD_SECTOR_CACHE_SIZE 8
+#endif
+
 uint8_t sdcard_init(uint8_t cs, SPIClass * spi, int hz);
 uint8_t sdcard_uninit(uint8_t pdrv);
 
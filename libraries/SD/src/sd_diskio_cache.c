@@ -0,0 +1,222 @@
+// Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "sd_diskio_cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    uint32_t sector;
+    uint32_t used;      // LRU stamp, 0 means the slot is empty
+    bool dirty;
+} sd_cache_entry_t;
+
+struct sd_sector_cache_s {
+    sd_cache_io_t io;
+    void * ctx;
+    size_t size;
+    uint32_t clock;
+    uint32_t wb_first;  // write-back window, empty until set
+    uint32_t wb_count;
+    sd_cache_entry_t * entries;
+    uint8_t * data;
+};
+
+#define ENTRY_DATA(c, i) ((c)->data + (size_t)(i) * SD_CACHE_SECTOR_SIZE)
+
+sd_sector_cache_t * sd_cache_new(size_t sectors, sd_cache_io_t io, void * ctx)
+{
+    if (!sectors || !io) {
+        return NULL;
+    }
+    sd_sector_cache_t * c = (sd_sector_cache_t *)calloc(1, sizeof(sd_sector_cache_t));
+    if (!c) {
+        return NULL;
+    }
+    c->entries = (sd_cache_entry_t *)calloc(sectors, sizeof(sd_cache_entry_t));
+    c->data = (uint8_t *)malloc(sectors * SD_CACHE_SECTOR_SIZE);
+    if (!c->entries || !c->data) {
+        sd_cache_free(c);
+        return NULL;
+    }
+    c->io = io;
+    c->ctx = ctx;
+    c->size = sectors;
+    return c;
+}
+
+void sd_cache_free(sd_sector_cache_t * c)
+{
+    if (!c) {
+        return;
+    }
+    free(c->entries);
+    free(c->data);
+    free(c);
+}
+
+static int find(sd_sector_cache_t * c, uint32_t sector)
+{
+    for (size_t i = 0; i < c->size; i++) {
+        if (c->entries[i].used && c->entries[i].sector == sector) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void touch(sd_sector_cache_t * c, int i)
+{
+    if (++c->clock == 0) {
+        // stamp wrapped, restart the order from scratch
+        for (size_t j = 0; j < c->size; j++) {
+            if (c->entries[j].used) {
+                c->entries[j].used = 1;
+            }
+        }
+        c->clock = 2;
+    }
+    c->entries[i].used = c->clock;
+}
+
+// Frees the least recently used slot, writing it back first when dirty
+static int victim(sd_sector_cache_t * c)
+{
+    int v = 0;
+    for (size_t i = 0; i < c->size; i++) {
+        if (!c->entries[i].used) {
+            return i;
+        }
+        if (c->entries[i].used < c->entries[v].used) {
+            v = i;
+        }
+    }
+    if (c->entries[v].dirty) {
+        if (!c->io(c->ctx, ENTRY_DATA(c, v), c->entries[v].sector, 1, true)) {
+            return -1;
+        }
+        c->entries[v].dirty = false;
+    }
+    c->entries[v].used = 0;
+    return v;
+}
+
+bool sd_cache_read(sd_sector_cache_t * c, uint8_t * buffer, uint32_t sector, uint32_t count)
+{
+    if (count == 1) {
+        int i = find(c, sector);
+        if (i < 0) {
+            i = victim(c);
+            if (i < 0 || !c->io(c->ctx, ENTRY_DATA(c, i), sector, 1, false)) {
+                return false;
+            }
+            c->entries[i].sector = sector;
+            c->entries[i].dirty = false;
+        }
+        touch(c, i);
+        memcpy(buffer, ENTRY_DATA(c, i), SD_CACHE_SECTOR_SIZE);
+        return true;
+    }
+
+    if (!c->io(c->ctx, buffer, sector, count, false)) {
+        return false;
+    }
+    // the card does not have the dirty sectors yet
+    for (size_t i = 0; i < c->size; i++) {
+        sd_cache_entry_t * e = &c->entries[i];
+        if (e->used && e->dirty && e->sector >= sector && e->sector - sector < count) {
+            memcpy(buffer + (size_t)(e->sector - sector) * SD_CACHE_SECTOR_SIZE, ENTRY_DATA(c, i), SD_CACHE_SECTOR_SIZE);
+        }
+    }
+    return true;
+}
+
+static bool held(sd_sector_cache_t * c, uint32_t sector)
+{
+    return sector >= c->wb_first && sector - c->wb_first < c->wb_count;
+}
+
+bool sd_cache_write(sd_sector_cache_t * c, const uint8_t * buffer, uint32_t sector, uint32_t count)
+{
+    if (count == 1 && held(c, sector)) {
+        int i = find(c, sector);
+        if (i < 0) {
+            i = victim(c);
+            if (i < 0) {
+                return false;
+            }
+            c->entries[i].sector = sector;
+        }
+        memcpy(ENTRY_DATA(c, i), buffer, SD_CACHE_SECTOR_SIZE);
+        c->entries[i].dirty = true;
+        touch(c, i);
+        return true;
+    }
+
+    if (!c->io(c->ctx, (uint8_t *)buffer, sector, count, true)) {
+        return false;
+    }
+    // written through, refresh any copy we hold
+    for (size_t i = 0; i < c->size; i++) {
+        sd_cache_entry_t * e = &c->entries[i];
+        if (e->used && e->sector >= sector && e->sector - sector < count) {
+            memcpy(ENTRY_DATA(c, i), buffer + (size_t)(e->sector - sector) * SD_CACHE_SECTOR_SIZE, SD_CACHE_SECTOR_SIZE);
+            e->dirty = false;
+        }
+    }
+    return true;
+}
+
+bool sd_cache_flush(sd_sector_cache_t * c)
+{
+    bool ok = true;
+    for (size_t i = 0; i < c->size; i++) {
+        sd_cache_entry_t * e = &c->entries[i];
+        if (e->used && e->dirty) {
+            if (c->io(c->ctx, ENTRY_DATA(c, i), e->sector, 1, true)) {
+                e->dirty = false;
+            } else {
+                ok = false;
+            }
+        }
+    }
+    return ok;
+}
+
+bool sd_cache_set_writeback(sd_sector_cache_t * c, uint32_t first, uint32_t count)
+{
+    bool ok = true;
+    for (size_t i = 0; i < c->size; i++) {
+        sd_cache_entry_t * e = &c->entries[i];
+        if (e->used && e->dirty && !(e->sector >= first && e->sector - first < count)) {
+            if (c->io(c->ctx, ENTRY_DATA(c, i), e->sector, 1, true)) {
+                e->dirty = false;
+            } else {
+                ok = false;
+            }
+        }
+    }
+    c->wb_first = first;
+    c->wb_count = count;
+    return ok;
+}
+
+void sd_cache_invalidate(sd_sector_cache_t * c)
+{
+    for (size_t i = 0; i < c->size; i++) {
+        c->entries[i].used = 0;
+        c->entries[i].dirty = false;
+    }
+    c->wb_first = 0;
+    c->wb_count = 0;
+}
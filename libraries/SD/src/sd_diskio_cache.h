@@ -0,0 +1,58 @@
+// Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef _SD_DISKIO_CACHE_H_
+#define _SD_DISKIO_CACHE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SD_CACHE_SECTOR_SIZE 512
+
+/*
+ * Small LRU cache of 512 byte sectors. Single sector requests (what FatFs
+ * issues for FAT and directory sectors) go through the cache, multi sector
+ * requests go straight to the card but stay coherent with it.
+ * Only single sector writes inside the window set with
+ * sd_cache_set_writeback() are held back; they reach the card on eviction
+ * or sd_cache_flush(). Every other write goes to the card before it returns,
+ * so file data is never lost to the cache on power failure.
+ * The code has no dependency on the SD driver so it can be built on a host.
+ */
+
+// Backend transfer of count consecutive sectors, returns true on success
+typedef bool (*sd_cache_io_t)(void * ctx, uint8_t * buffer, uint32_t sector, uint32_t count, bool write);
+
+typedef struct sd_sector_cache_s sd_sector_cache_t;
+
+sd_sector_cache_t * sd_cache_new(size_t sectors, sd_cache_io_t io, void * ctx);
+void sd_cache_free(sd_sector_cache_t * cache);
+
+bool sd_cache_read(sd_sector_cache_t * cache, uint8_t * buffer, uint32_t sector, uint32_t count);
+bool sd_cache_write(sd_sector_cache_t * cache, const uint8_t * buffer, uint32_t sector, uint32_t count);
+bool sd_cache_flush(sd_sector_cache_t * cache);
+// Holds single sector writes to sectors first .. first + count - 1, flushes the others
+bool sd_cache_set_writeback(sd_sector_cache_t * cache, uint32_t first, uint32_t count);
+// Drops every sector, dirty or not, and the write-back window
+void sd_cache_invalidate(sd_sector_cache_t * cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SD_DISKIO_CACHE_H_ */
@@ -39,8 +39,8 @@ SPIFFSImpl::SPIFFSImpl()
 
 bool SPIFFSImpl::exists(const char* path)
 {
-    File f = open(path, "r",false);
-    return (f == true) && !f.isDirectory();
+    FileStat st;
+    return stat(path, &st) && !st.isDirectory;
 }
 
 SPIFFSFS::SPIFFSFS() : FS(FSImplPtr(new SPIFFSImpl())), partitionLabel_(NULL)
@@ -114,6 +114,7 @@ bool SPIFFSFS::format()
         log_e("Formatting SPIFFS failed! Error: %d", err);
         return false;
     }
+    _impl->clearStatCache();
     return true;
 }
 
@@ -23,41 +23,71 @@
 */
 
 #include "Ticker.h"
+#include "esp32-hal-log.h"
 
-Ticker::Ticker() :
-  _timer(nullptr) {}
+static esp_timer_handle_t _timer = nullptr;
+
+static TickerWheel & _wheel();
+
+static void _wheelRun(void *) {
+  _wheel().advance(esp_timer_get_time());
+}
+
+// Called by the wheel, under its lock, whenever its next deadline changes
+static void _wheelArm(uint64_t when) {
+  if (!_timer) {
+    esp_timer_create_args_t _timerConfig;
+    _timerConfig.arg = nullptr;
+    _timerConfig.callback = _wheelRun;
+    _timerConfig.dispatch_method = ESP_TIMER_TASK;
+    _timerConfig.name = "Ticker";
+    if (esp_timer_create(&_timerConfig, &_timer) != ESP_OK) {
+      log_e("Ticker timer create failed");
+      _timer = nullptr;
+      return;
+    }
+  }
+  uint64_t now = esp_timer_get_time();
+  esp_timer_stop(_timer);
+  esp_timer_start_once(_timer, (when > now) ? when - now : 0);
+}
+
+static TickerWheel & _wheel() {
+  static TickerWheel wheel(_wheelArm);
+  return wheel;
+}
+
+Ticker::Ticker() {}
 
 Ticker::~Ticker() {
   detach();
 }
 
 void Ticker::_attach_ms(uint32_t milliseconds, bool repeat, callback_with_arg_t callback, uint32_t arg) {
-  esp_timer_create_args_t _timerConfig;
-  _timerConfig.arg = reinterpret_cast<void*>(arg);
-  _timerConfig.callback = callback;
-  _timerConfig.dispatch_method = ESP_TIMER_TASK;
-  _timerConfig.name = "Ticker";
-  if (_timer) {
-    esp_timer_stop(_timer);
-    esp_timer_delete(_timer);
-  }
-  esp_timer_create(&_timerConfig, &_timer);
+  void * ptr = reinterpret_cast<void*>(arg);
+  _attach_us(milliseconds * 1000ULL, repeat, [callback, ptr]() { callback(ptr); });
+}
+
+void Ticker::_attach_us(uint64_t microseconds, bool repeat, callback_function_t callback) {
+  uint64_t period = 0;
   if (repeat) {
-    esp_timer_start_periodic(_timer, milliseconds * 1000ULL);
-  } else {
-    esp_timer_start_once(_timer, milliseconds * 1000ULL);
+    period = microseconds ? microseconds : 1;
   }
+  _wheel().schedule(&_entry, esp_timer_get_time(), microseconds, period, std::move(callback));
 }
 
 void Ticker::detach() {
-  if (_timer) {
-    esp_timer_stop(_timer);
-    esp_timer_delete(_timer);
-    _timer = nullptr;
-  }
+  _wheel().cancel(&_entry);
 }
 
 bool Ticker::active() {
-  if (!_timer) return false;
-  return esp_timer_is_active(_timer);
+  return _entry.active();
+}
+
+void Ticker::getStats(ticker_wheel_stats_t * stats) {
+  _wheel().getStats(stats);
+}
+
+void Ticker::resetStats() {
+  _wheel().resetStats();
 }
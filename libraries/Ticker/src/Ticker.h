@@ -25,10 +25,18 @@
 #ifndef TICKER_H
 #define TICKER_H
 
+#include <functional>
+#include "TickerWheel.h"
+
 extern "C" {
   #include "esp_timer.h"
 }
 
+/*
+  All tickers share one hierarchical timer wheel driven by a single
+  esp_timer, so hundreds of them cost one timer and one dispatch per batch
+  of deadlines. Callbacks run in the esp_timer task, like before.
+*/
 class Ticker
 {
 public:
@@ -36,71 +44,93 @@ public:
   ~Ticker();
   typedef void (*callback_t)(void);
   typedef void (*callback_with_arg_t)(void*);
+  typedef std::function<void(void)> callback_function_t;
+
+  void attach(float seconds, callback_function_t callback)
+  {
+    _attach_us(seconds * 1000000.0, true, std::move(callback));
+  }
 
-  void attach(float seconds, callback_t callback)
+  void attach_ms(uint32_t milliseconds, callback_function_t callback)
   {
-    _attach_ms(seconds * 1000, true, reinterpret_cast<callback_with_arg_t>(callback), 0);
+    _attach_us(milliseconds * 1000ULL, true, std::move(callback));
   }
 
-  void attach_ms(uint32_t milliseconds, callback_t callback)
+  void attach_us(uint64_t microseconds, callback_function_t callback)
   {
-    _attach_ms(milliseconds, true, reinterpret_cast<callback_with_arg_t>(callback), 0);
+    _attach_us(microseconds, true, std::move(callback));
   }
 
   template<typename TArg>
   void attach(float seconds, void (*callback)(TArg), TArg arg)
   {
-    static_assert(sizeof(TArg) <= sizeof(uint32_t), "attach() callback argument size must be <= 4 bytes");
-    // C-cast serves two purposes:
-    // static_cast for smaller integer types,
-    // reinterpret_cast + const_cast for pointer types
-    uint32_t arg32 = (uint32_t)arg;
-    _attach_ms(seconds * 1000, true, reinterpret_cast<callback_with_arg_t>(callback), arg32);
+    _attach_us(seconds * 1000000.0, true, [callback, arg]() { callback(arg); });
   }
 
   template<typename TArg>
   void attach_ms(uint32_t milliseconds, void (*callback)(TArg), TArg arg)
   {
-    static_assert(sizeof(TArg) <= sizeof(uint32_t), "attach_ms() callback argument size must be <= 4 bytes");
-    uint32_t arg32 = (uint32_t)arg;
-    _attach_ms(milliseconds, true, reinterpret_cast<callback_with_arg_t>(callback), arg32);
+    _attach_us(milliseconds * 1000ULL, true, [callback, arg]() { callback(arg); });
   }
 
-  void once(float seconds, callback_t callback)
+  template<typename TArg>
+  void attach_us(uint64_t microseconds, void (*callback)(TArg), TArg arg)
   {
-    _attach_ms(seconds * 1000, false, reinterpret_cast<callback_with_arg_t>(callback), 0);
+    _attach_us(microseconds, true, [callback, arg]() { callback(arg); });
   }
 
-  void once_ms(uint32_t milliseconds, callback_t callback)
+  void once(float seconds, callback_function_t callback)
   {
-    _attach_ms(milliseconds, false, reinterpret_cast<callback_with_arg_t>(callback), 0);	
+    _attach_us(seconds * 1000000.0, false, std::move(callback));
+  }
+
+  void once_ms(uint32_t milliseconds, callback_function_t callback)
+  {
+    _attach_us(milliseconds * 1000ULL, false, std::move(callback));
+  }
+
+  void once_us(uint64_t microseconds, callback_function_t callback)
+  {
+    _attach_us(microseconds, false, std::move(callback));
   }
 
   template<typename TArg>
   void once(float seconds, void (*callback)(TArg), TArg arg)
   {
-    static_assert(sizeof(TArg) <= sizeof(uint32_t), "attach() callback argument size must be <= 4 bytes");
-    uint32_t arg32 = (uint32_t)(arg);
-    _attach_ms(seconds * 1000, false, reinterpret_cast<callback_with_arg_t>(callback), arg32);
+    _attach_us(seconds * 1000000.0, false, [callback, arg]() { callback(arg); });
   }
 
   template<typename TArg>
   void once_ms(uint32_t milliseconds, void (*callback)(TArg), TArg arg)
   {
-    static_assert(sizeof(TArg) <= sizeof(uint32_t), "attach_ms() callback argument size must be <= 4 bytes");
-    uint32_t arg32 = (uint32_t)(arg);
-    _attach_ms(milliseconds, false, reinterpret_cast<callback_with_arg_t>(callback), arg32);
+    _attach_us(milliseconds * 1000ULL, false, [callback, arg]() { callback(arg); });
+  }
+
+  template<typename TArg>
+  void once_us(uint64_t microseconds, void (*callback)(TArg), TArg arg)
+  {
+    _attach_us(microseconds, false, [callback, arg]() { callback(arg); });
   }
 
   void detach();
   bool active();
 
-protected:	
+  // times the callback ran, periods it missed and its worst delay
+  uint32_t fired() { return _entry.fired(); }
+  uint32_t overruns() { return _entry.overruns(); }
+  uint32_t maxLateUs() { return _entry.maxLateUs(); }
+
+  // totals of all tickers
+  static void getStats(ticker_wheel_stats_t * stats);
+  static void resetStats();
+
+protected:
   void _attach_ms(uint32_t milliseconds, bool repeat, callback_with_arg_t callback, uint32_t arg);
+  void _attach_us(uint64_t microseconds, bool repeat, callback_function_t callback);
 
 
 protected:
-  esp_timer_handle_t _timer;
+  TickerWheel::Entry _entry;
 };
 
 
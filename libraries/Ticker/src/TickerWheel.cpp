@@ -0,0 +1,318 @@
+/*
+  TickerWheel.cpp - hierarchical timer wheel behind Ticker
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "TickerWheel.h"
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+extern "C" {
+  #include "freertos/FreeRTOS.h"
+  #include "freertos/semphr.h"
+}
+#endif
+
+#define WHEEL_NEVER   UINT64_MAX
+
+TickerWheel::TickerWheel(arm_t arm) :
+  _overflow(nullptr),
+  _expired(nullptr),
+  _expiredTail(&_expired),
+  _expiredCount(0),
+  _now(0),
+  _running(nullptr),
+  _armed(WHEEL_NEVER),
+  _arm(arm),
+  _mutex(nullptr)
+{
+  memset(_slots, 0, sizeof(_slots));
+  memset(_occupied, 0, sizeof(_occupied));
+  memset(&_stats, 0, sizeof(_stats));
+#ifdef ESP_PLATFORM
+  _mutex = xSemaphoreCreateMutex();
+#endif
+}
+
+TickerWheel::~TickerWheel() {
+#ifdef ESP_PLATFORM
+  if (_mutex) {
+    vSemaphoreDelete((SemaphoreHandle_t)_mutex);
+  }
+#endif
+}
+
+// host builds drive the wheel from a single thread
+void TickerWheel::_lock() {
+#ifdef ESP_PLATFORM
+  xSemaphoreTake((SemaphoreHandle_t)_mutex, portMAX_DELAY);
+#endif
+}
+
+void TickerWheel::_unlock() {
+#ifdef ESP_PLATFORM
+  xSemaphoreGive((SemaphoreHandle_t)_mutex);
+#endif
+}
+
+/*
+  Lists, called with the lock held
+*/
+
+void TickerWheel::_append(Entry * entry) {
+  entry->_next = nullptr;
+  entry->_pprev = _expiredTail;
+  *_expiredTail = entry;
+  _expiredTail = &entry->_next;
+  entry->_list = LIST_EXPIRED;
+  _expiredCount++;
+}
+
+void TickerWheel::_insert(Entry * entry) {
+  if (entry->_expires <= _now) {
+    _append(entry);
+    return;
+  }
+
+  Entry ** head;
+  int level = (63 - __builtin_clzll(entry->_expires ^ _now)) / TICKER_WHEEL_BITS;
+  if (level >= TICKER_WHEEL_LEVELS) {
+    head = &_overflow;
+    entry->_list = LIST_OVERFLOW;
+  } else {
+    int slot = (entry->_expires >> (level * TICKER_WHEEL_BITS)) & (TICKER_WHEEL_SLOTS - 1);
+    entry->_list = level * TICKER_WHEEL_SLOTS + slot;
+    head = &_slots[entry->_list];
+    _occupied[level] |= 1ULL << slot;
+  }
+  entry->_next = *head;
+  if (entry->_next) {
+    entry->_next->_pprev = &entry->_next;
+  }
+  entry->_pprev = head;
+  *head = entry;
+}
+
+void TickerWheel::_unlink(Entry * entry) {
+  *entry->_pprev = entry->_next;
+  if (entry->_next) {
+    entry->_next->_pprev = entry->_pprev;
+  } else if (entry->_list == LIST_EXPIRED) {
+    _expiredTail = entry->_pprev;
+  }
+  if (entry->_list == LIST_EXPIRED) {
+    _expiredCount--;
+  } else if (entry->_list < LIST_OVERFLOW && !_slots[entry->_list]) {
+    _occupied[entry->_list / TICKER_WHEEL_SLOTS] &= ~(1ULL << (entry->_list % TICKER_WHEEL_SLOTS));
+  }
+  entry->_next = nullptr;
+  entry->_pprev = nullptr;
+  entry->_list = LIST_NONE;
+}
+
+// Finds the first used slot after the wheel time, lower levels always come first
+bool TickerWheel::_next(uint64_t * when, int * level, int * slot) {
+  for (int l = 0; l < TICKER_WHEEL_LEVELS; l++) {
+    int shift = l * TICKER_WHEEL_BITS;
+    int current = (_now >> shift) & (TICKER_WHEEL_SLOTS - 1);
+    uint64_t pending = (current == TICKER_WHEEL_SLOTS - 1) ? 0 : _occupied[l] & (~0ULL << (current + 1));
+    if (pending) {
+      *level = l;
+      *slot = __builtin_ctzll(pending);
+      *when = ((_now >> (shift + TICKER_WHEEL_BITS)) << (shift + TICKER_WHEEL_BITS)) | ((uint64_t)*slot << shift);
+      return true;
+    }
+  }
+  if (_overflow) {
+    // the overflow list is sorted out when the top level starts a new turn
+    int shift = TICKER_WHEEL_LEVELS * TICKER_WHEEL_BITS;
+    *level = -1;
+    *slot = 0;
+    *when = ((_now >> shift) + 1) << shift;
+    return true;
+  }
+  return false;
+}
+
+void TickerWheel::_rearm() {
+  uint64_t when = WHEEL_NEVER;
+  int level, slot;
+  if (_expiredCount) {
+    when = _now;
+  } else if (!_next(&when, &level, &slot)) {
+    when = WHEEL_NEVER;
+  }
+  if (when != _armed) {
+    _armed = when;
+    if (_arm && when != WHEEL_NEVER) {
+      _arm(when);
+    }
+  }
+}
+
+/*
+  Public API
+*/
+
+void TickerWheel::schedule(Entry * entry, uint64_t now, uint64_t delay, uint64_t period, callback_t callback) {
+  _lock();
+  if (entry->_list == LIST_RUNNING) {
+    entry->_list = LIST_NONE;
+  } else if (entry->_list != LIST_NONE) {
+    _unlink(entry);
+  }
+  if (_running == entry) {
+    _running = nullptr;
+  }
+  entry->_callback = std::move(callback);
+  entry->_expires = now + delay;
+  entry->_period = period;
+  _insert(entry);
+  _rearm();
+  _unlock();
+}
+
+bool TickerWheel::cancel(Entry * entry) {
+  _lock();
+  bool active = entry->active();
+  if (entry->_list == LIST_RUNNING) {
+    entry->_list = LIST_NONE;
+  } else if (active) {
+    _unlink(entry);
+  }
+  if (_running == entry) {
+    _running = nullptr;
+  }
+  _unlock();
+  return active;
+}
+
+size_t TickerWheel::advance(uint64_t now) {
+  uint64_t when;
+  int level, slot;
+
+  _lock();
+  // move everything due down the levels and into the expired list
+  while (_next(&when, &level, &slot) && when <= now) {
+    _now = when;
+    Entry * entry;
+    if (level < 0) {
+      entry = _overflow;
+      _overflow = nullptr;
+    } else {
+      entry = _slots[level * TICKER_WHEEL_SLOTS + slot];
+      _slots[level * TICKER_WHEEL_SLOTS + slot] = nullptr;
+      _occupied[level] &= ~(1ULL << slot);
+    }
+    while (entry) {
+      Entry * next = entry->_next;
+      _insert(entry);
+      entry = next;
+    }
+  }
+  if (now > _now) {
+    _now = now;
+  }
+
+  // entries made due by the callbacks themselves wait for the next batch
+  size_t batch = _expiredCount;
+  size_t run = 0;
+  while (run < batch && _expired) {
+    Entry * entry = _expired;
+    _unlink(entry);
+    entry->_list = LIST_RUNNING;
+    _running = entry;
+
+    uint64_t late = (now > entry->_expires) ? now - entry->_expires : 0;
+    if (late > UINT32_MAX) {
+      late = UINT32_MAX;
+    }
+    if (late > entry->_maxLateUs) {
+      entry->_maxLateUs = late;
+    }
+    if (late > _stats.maxLateUs) {
+      _stats.maxLateUs = late;
+    }
+    _stats.totalLateUs += late;
+    _stats.fired++;
+    entry->_fired++;
+
+    // the entry may be rescheduled or destroyed while its callback runs
+    callback_t callback;
+    callback.swap(entry->_callback);
+    _unlock();
+    if (callback) {
+      callback();
+    }
+    run++;
+    _lock();
+
+    if (_running == entry) {
+      entry->_callback.swap(callback);
+      if (entry->_period) {
+        uint64_t expires = entry->_expires + entry->_period;
+        if (expires <= now) {
+          uint64_t missed = (now - entry->_expires) / entry->_period;
+          entry->_overruns += missed;
+          _stats.overruns += missed;
+          expires = entry->_expires + (missed + 1) * entry->_period;
+        }
+        entry->_expires = expires;
+        _insert(entry);
+      } else {
+        entry->_list = LIST_NONE;
+      }
+      _running = nullptr;
+    }
+  }
+  if (run) {
+    _stats.batches++;
+    if (run > _stats.maxBatch) {
+      _stats.maxBatch = run;
+    }
+  }
+
+  // always arm again, the timer may have fired a little early
+  _armed = WHEEL_NEVER;
+  _rearm();
+  _unlock();
+  return run;
+}
+
+bool TickerWheel::nextExpiry(uint64_t * when) {
+  int level, slot;
+  _lock();
+  bool pending = true;
+  if (_expiredCount) {
+    *when = _now;
+  } else {
+    pending = _next(when, &level, &slot);
+  }
+  _unlock();
+  return pending;
+}
+
+void TickerWheel::getStats(ticker_wheel_stats_t * stats) {
+  _lock();
+  memcpy(stats, &_stats, sizeof(ticker_wheel_stats_t));
+  _unlock();
+}
+
+void TickerWheel::resetStats() {
+  _lock();
+  memset(&_stats, 0, sizeof(_stats));
+  _unlock();
+}
@@ -0,0 +1,141 @@
+/*
+  TickerWheel.h - hierarchical timer wheel behind Ticker
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef TICKER_WHEEL_H
+#define TICKER_WHEEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+
+/*
+  Time is kept in microseconds. Level 0 has one slot per microsecond and
+  every level above covers a whole turn of the one below, so six levels of
+  64 slots reach about 19 hours; later deadlines wait in an overflow list.
+  An entry sits in the level of the highest bit in which its deadline
+  differs from the wheel time and moves down a level each time the wheel
+  reaches its slot. Occupancy bitmaps let the wheel jump straight to the
+  next used slot, so idle time costs nothing.
+
+  The wheel does not read a clock: advance() is given the time, and the
+  arm callback is told when the wheel next needs to run. Ticker drives it
+  with a single esp_timer; a host test can drive it with a simulated clock.
+*/
+
+#define TICKER_WHEEL_BITS       6
+#define TICKER_WHEEL_SLOTS      (1 << TICKER_WHEEL_BITS)
+#define TICKER_WHEEL_LEVELS     6
+
+typedef struct {
+    uint32_t fired;         // callbacks run
+    uint32_t overruns;      // periods skipped because the callback ran too late
+    uint32_t batches;       // calls to advance() that ran at least one callback
+    uint32_t maxBatch;      // most callbacks run by one advance()
+    uint32_t maxLateUs;     // worst delay between a deadline and its callback
+    uint64_t totalLateUs;   // sum of those delays, divide by fired for the mean
+} ticker_wheel_stats_t;
+
+class TickerWheel
+{
+public:
+  typedef std::function<void(void)> callback_t;
+  // called with the time the wheel must next be advanced at, under the lock
+  typedef void (*arm_t)(uint64_t when);
+
+  class Entry
+  {
+  public:
+    Entry() : _next(nullptr), _pprev(nullptr), _expires(0), _period(0), _list(LIST_NONE), _fired(0), _overruns(0), _maxLateUs(0) {}
+
+    bool active() const { return _list != LIST_NONE; }
+    uint32_t fired() const { return _fired; }
+    uint32_t overruns() const { return _overruns; }
+    uint32_t maxLateUs() const { return _maxLateUs; }
+
+  private:
+    friend class TickerWheel;
+    Entry * _next;
+    Entry ** _pprev;
+    uint64_t _expires;
+    uint64_t _period;       // 0 for one shot entries
+    callback_t _callback;
+    uint16_t _list;         // wheel slot, or one of the lists below
+    uint32_t _fired;
+    uint32_t _overruns;
+    uint32_t _maxLateUs;
+  };
+
+  enum {
+    LIST_OVERFLOW = TICKER_WHEEL_LEVELS * TICKER_WHEEL_SLOTS,
+    LIST_EXPIRED,
+    LIST_RUNNING,
+    LIST_NONE
+  };
+
+  TickerWheel(arm_t arm = nullptr);
+  ~TickerWheel();
+
+  /*
+    Runs callback after delay microseconds, and then every period
+    microseconds if period is not 0. Reschedules the entry if it is active.
+  */
+  void schedule(Entry * entry, uint64_t now, uint64_t delay, uint64_t period, callback_t callback);
+
+  /*
+    Stops the entry, returns false if it was not active
+  */
+  bool cancel(Entry * entry);
+
+  /*
+    Runs every callback due at now, in deadline order
+    Returns the number of callbacks run
+  */
+  size_t advance(uint64_t now);
+
+  /*
+    Returns false if nothing is scheduled
+  */
+  bool nextExpiry(uint64_t * when);
+
+  void getStats(ticker_wheel_stats_t * stats);
+  void resetStats();
+
+private:
+  void _lock();
+  void _unlock();
+  void _insert(Entry * entry);
+  void _unlink(Entry * entry);
+  void _append(Entry * entry);
+  bool _next(uint64_t * when, int * level, int * slot);
+  void _rearm();
+
+  Entry * _slots[TICKER_WHEEL_LEVELS * TICKER_WHEEL_SLOTS];
+  uint64_t _occupied[TICKER_WHEEL_LEVELS];
+  Entry * _overflow;
+  Entry * _expired;         // due entries, oldest first
+  Entry ** _expiredTail;
+  size_t _expiredCount;
+  uint64_t _now;            // every deadline up to here has been collected
+  Entry * _running;         // entry whose callback is running, cleared if it is cancelled
+  uint64_t _armed;
+  arm_t _arm;
+  void * _mutex;
+  ticker_wheel_stats_t _stats;
+};
+
+#endif  // TICKER_WHEEL_H
@@ -0,0 +1,264 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "UpdateDelta.h"
+#include "Arduino.h"
+#include "sdkconfig.h"
+
+// the inflater is the one in ROM, it costs no flash
+#if CONFIG_IDF_TARGET_ESP32
+#include "esp32/rom/miniz.h"
+#elif CONFIG_IDF_TARGET_ESP32S2
+#include "esp32s2/rom/miniz.h"
+#elif CONFIG_IDF_TARGET_ESP32S3
+#include "esp32s3/rom/miniz.h"
+#elif CONFIG_IDF_TARGET_ESP32C3
+#include "esp32c3/rom/miniz.h"
+#else
+#error Target CONFIG_IDF_TARGET is not supported
+#endif
+
+// chunk of the old image read per step of a diff run
+#define UPDATE_DELTA_BUFFER_SIZE    256
+
+static const char * _err2str(uint8_t _error){
+    if(_error == UPDATE_DELTA_ERROR_OK){
+        return ("No Error");
+    } else if(_error == UPDATE_DELTA_ERROR_HEADER){
+        return ("Bad Patch Header");
+    } else if(_error == UPDATE_DELTA_ERROR_MEMORY){
+        return ("Not Enough Memory");
+    } else if(_error == UPDATE_DELTA_ERROR_INFLATE){
+        return ("Patch Decompression Failed");
+    } else if(_error == UPDATE_DELTA_ERROR_PATCH){
+        return ("Corrupt Patch");
+    } else if(_error == UPDATE_DELTA_ERROR_READ){
+        return ("Old Image Read Failed");
+    } else if(_error == UPDATE_DELTA_ERROR_WRITE){
+        return ("New Image Write Failed");
+    }
+    return ("UNKNOWN");
+}
+
+static uint32_t _le32(const uint8_t *p){
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+UpdateDelta::UpdateDelta()
+: _readOld(NULL)
+, _writeNew(NULL)
+, _error(UPDATE_DELTA_ERROR_OK)
+, _state(STATE_DONE)
+, _compressed(false)
+, _inflated(false)
+, _inflator(NULL)
+, _window(NULL)
+, _windowPos(0)
+, _buffer(NULL)
+, _controlLen(0)
+, _diffLeft(0)
+, _extraLeft(0)
+, _seek(0)
+, _oldPos(0)
+, _oldSize(0)
+, _newPos(0)
+, _newSize(0)
+{
+}
+
+UpdateDelta::~UpdateDelta(){
+    end();
+}
+
+bool UpdateDelta::checkHeader(const update_delta_header_t &header){
+    return !memcmp(header.magic, UPDATE_DELTA_MAGIC, sizeof(header.magic))
+        && header.version == UPDATE_DELTA_VERSION
+        && !(header.flags & ~UPDATE_DELTA_FLAG_ZLIB)
+        && header.newSize > 0;
+}
+
+bool UpdateDelta::begin(const update_delta_header_t &header, THandlerFunction_Read readOld, THandlerFunction_Write writeNew){
+    end();
+    _error = UPDATE_DELTA_ERROR_OK;
+    if(!checkHeader(header) || !readOld || !writeNew){
+        _error = UPDATE_DELTA_ERROR_HEADER;
+        return false;
+    }
+
+    _compressed = header.flags & UPDATE_DELTA_FLAG_ZLIB;
+    _inflated = !_compressed;
+    _buffer = (uint8_t*)malloc(UPDATE_DELTA_BUFFER_SIZE);
+    if(_compressed){
+        _inflator = malloc(sizeof(tinfl_decompressor));
+        _window = (uint8_t*)malloc(TINFL_LZ_DICT_SIZE);
+    }
+    if(!_buffer || (_compressed && (!_inflator || !_window))){
+        log_e("malloc failed");
+        _abort(UPDATE_DELTA_ERROR_MEMORY);
+        return false;
+    }
+    if(_compressed){
+        tinfl_init((tinfl_decompressor*)_inflator);
+    }
+    _windowPos = 0;
+
+    _readOld = readOld;
+    _writeNew = writeNew;
+    _oldSize = header.oldSize;
+    _newSize = header.newSize;
+    _oldPos = 0;
+    _newPos = 0;
+    _controlLen = 0;
+    _state = STATE_CONTROL;
+    return true;
+}
+
+bool UpdateDelta::end(){
+    free(_inflator);
+    free(_window);
+    free(_buffer);
+    _inflator = NULL;
+    _window = NULL;
+    _buffer = NULL;
+    return !hasError() && isFinished();
+}
+
+void UpdateDelta::_abort(uint8_t err){
+    end();
+    _error = err;
+    _state = STATE_DONE;
+}
+
+const char * UpdateDelta::errorString(){
+    return _err2str(_error);
+}
+
+size_t UpdateDelta::write(const uint8_t *data, size_t len){
+    if(hasError() || !_buffer){
+        return 0;
+    }
+    if(!_compressed){
+        return _process(data, len) ? len : 0;
+    }
+
+    size_t consumed = 0;
+    tinfl_status status;
+    do {
+        size_t inLen = len - consumed;
+        size_t outLen = TINFL_LZ_DICT_SIZE - _windowPos;
+        status = tinfl_decompress((tinfl_decompressor*)_inflator, data + consumed, &inLen,
+            _window, _window + _windowPos, &outLen,
+            TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+        consumed += inLen;
+        if(status < TINFL_STATUS_DONE){
+            log_e("inflate failed: %d", status);
+            _abort(UPDATE_DELTA_ERROR_INFLATE);
+            return consumed;
+        }
+        if(outLen && !_process(_window + _windowPos, outLen)){
+            return consumed;
+        }
+        _windowPos = (_windowPos + outLen) & (TINFL_LZ_DICT_SIZE - 1);
+    } while(status != TINFL_STATUS_DONE && (consumed < len || status == TINFL_STATUS_HAS_MORE_OUTPUT));
+
+    if(status == TINFL_STATUS_DONE){
+        _inflated = true;
+    }
+    if(status == TINFL_STATUS_DONE && _state != STATE_DONE){
+        log_e("patch ended early at %u of %u", _newPos, _newSize);
+        _abort(UPDATE_DELTA_ERROR_PATCH);
+    }
+    return consumed;
+}
+
+// Parses the control triple collected in _control and validates it against both images
+bool UpdateDelta::_nextRecord(){
+    _diffLeft = _le32(_control);
+    _extraLeft = _le32(_control + 4);
+    _seek = (int32_t)_le32(_control + 8);
+    _controlLen = 0;
+
+    if(_diffLeft > _newSize - _newPos || _extraLeft > _newSize - _newPos - _diffLeft
+        || _diffLeft > _oldSize - _oldPos){
+        log_e("record out of bounds at %u", _newPos);
+        _abort(UPDATE_DELTA_ERROR_PATCH);
+        return false;
+    }
+    _state = _diffLeft ? STATE_DIFF : STATE_EXTRA;
+    return true;
+}
+
+bool UpdateDelta::_process(const uint8_t *data, size_t len){
+    while(len){
+        size_t chunk;
+        switch(_state){
+        case STATE_CONTROL:
+            chunk = sizeof(_control) - _controlLen;
+            if(chunk > len){
+                chunk = len;
+            }
+            memcpy(_control + _controlLen, data, chunk);
+            _controlLen += chunk;
+            if(_controlLen == sizeof(_control) && !_nextRecord()){
+                return false;
+            }
+            break;
+
+        case STATE_DIFF:
+            chunk = (_diffLeft < len) ? _diffLeft : len;
+            if(chunk > UPDATE_DELTA_BUFFER_SIZE){
+                chunk = UPDATE_DELTA_BUFFER_SIZE;
+            }
+            if(!_readOld(_oldPos, _buffer, chunk)){
+                _abort(UPDATE_DELTA_ERROR_READ);
+                return false;
+            }
+            for(size_t i = 0; i < chunk; i++){
+                _buffer[i] += data[i];
+            }
+            if(!_writeNew(_buffer, chunk)){
+                _abort(UPDATE_DELTA_ERROR_WRITE);
+                return false;
+            }
+            _oldPos += chunk;
+            _newPos += chunk;
+            _diffLeft -= chunk;
+            if(!_diffLeft){
+                _state = STATE_EXTRA;
+            }
+            break;
+
+        case STATE_EXTRA:
+            chunk = (_extraLeft < len) ? _extraLeft : len;
+            if(chunk && !_writeNew(data, chunk)){
+                _abort(UPDATE_DELTA_ERROR_WRITE);
+                return false;
+            }
+            _newPos += chunk;
+            _extraLeft -= chunk;
+            break;
+
+        default:
+            // trailing bytes after the last record
+            _abort(UPDATE_DELTA_ERROR_PATCH);
+            return false;
+        }
+        data += chunk;
+        len -= chunk;
+
+        if(_state == STATE_EXTRA && !_extraLeft){
+            int64_t oldPos = (int64_t)_oldPos + _seek;
+            if(oldPos < 0 || oldPos > _oldSize){
+                log_e("seek out of bounds at %u", _newPos);
+                _abort(UPDATE_DELTA_ERROR_PATCH);
+                return false;
+            }
+            _oldPos = oldPos;
+            _state = (_newPos == _newSize) ? STATE_DONE : STATE_CONTROL;
+        }
+    }
+    return true;
+}
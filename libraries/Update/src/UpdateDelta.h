@@ -0,0 +1,123 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ESP32UPDATEDELTA_H
+#define ESP32UPDATEDELTA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+
+/*
+  Delta (binary diff) patches as created by tools/esp_delta.py
+
+  A patch is a 48 byte header followed by the body, optionally zlib
+  compressed. The body is a sequence of bsdiff style records:
+    uint32 diffLen, uint32 extraLen, int32 seek (little endian)
+    diffLen bytes added to the old image at the old position
+    extraLen bytes copied to the new image as they are
+    the old position then moves by diffLen + seek
+  The old image is read back while the patch streams in, so RAM use is
+  bounded by the inflate window and does not depend on the image size.
+*/
+
+#define UPDATE_DELTA_MAGIC          "EDLT"
+#define UPDATE_DELTA_VERSION        1
+#define UPDATE_DELTA_FLAG_ZLIB      0x01
+
+#define UPDATE_DELTA_ERROR_OK       (0)
+#define UPDATE_DELTA_ERROR_HEADER   (1)
+#define UPDATE_DELTA_ERROR_MEMORY   (2)
+#define UPDATE_DELTA_ERROR_INFLATE  (3)
+#define UPDATE_DELTA_ERROR_PATCH    (4)
+#define UPDATE_DELTA_ERROR_READ     (5)
+#define UPDATE_DELTA_ERROR_WRITE    (6)
+
+typedef struct {
+    char magic[4];
+    uint8_t version;
+    uint8_t flags;
+    uint16_t reserved;
+    uint32_t oldSize;
+    uint32_t newSize;
+    uint8_t oldMD5[16];
+    uint8_t newMD5[16];
+} __attribute__((packed)) update_delta_header_t;
+
+class UpdateDelta {
+  public:
+    // read len bytes of the old image at offset
+    typedef std::function<bool(uint32_t, uint8_t*, size_t)> THandlerFunction_Read;
+    // append len bytes to the new image
+    typedef std::function<bool(const uint8_t*, size_t)> THandlerFunction_Write;
+
+    UpdateDelta();
+    ~UpdateDelta();
+
+    /*
+      Returns true if the header is a patch this version can apply
+    */
+    static bool checkHeader(const update_delta_header_t &header);
+
+    /*
+      Prepares to apply the patch body described by header
+      Allocates the inflate state for compressed patches
+    */
+    bool begin(const update_delta_header_t &header, THandlerFunction_Read readOld, THandlerFunction_Write writeNew);
+
+    /*
+      Feeds len bytes of the patch body
+      Returns the amount consumed, less than len on error
+    */
+    size_t write(const uint8_t *data, size_t len);
+
+    /*
+      Frees the buffers, returns true if the whole new image was produced
+    */
+    bool end();
+
+    // a compressed body also has to reach the end of its zlib stream, which checks the Adler-32
+    bool isFinished(){ return _newPos == _newSize && _state == STATE_DONE && _inflated; }
+    bool hasError(){ return _error != UPDATE_DELTA_ERROR_OK; }
+    uint8_t getError(){ return _error; }
+    const char * errorString();
+    size_t progress(){ return _newPos; }
+
+  private:
+    enum {
+      STATE_CONTROL,
+      STATE_DIFF,
+      STATE_EXTRA,
+      STATE_DONE
+    };
+
+    bool _process(const uint8_t *data, size_t len);
+    bool _nextRecord();
+    void _abort(uint8_t err);
+
+    THandlerFunction_Read _readOld;
+    THandlerFunction_Write _writeNew;
+    uint8_t _error;
+    uint8_t _state;
+    bool _compressed;
+    bool _inflated;
+    void *_inflator;
+    uint8_t *_window;
+    size_t _windowPos;
+    uint8_t *_buffer;
+
+    uint8_t _control[12];
+    size_t _controlLen;
+    uint32_t _diffLeft;
+    uint32_t _extraLeft;
+    int32_t _seek;
+    uint32_t _oldPos;
+    uint32_t _oldSize;
+    uint32_t _newPos;
+    uint32_t _newSize;
+};
+
+#endif
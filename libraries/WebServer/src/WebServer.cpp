@@ -23,7 +23,7 @@
 
 #include <Arduino.h>
 #include <esp32-hal-log.h>
-#include <libb64/cencode.h>
+#include <base64.h>
 #include "esp_random.h"
 #include "WiFiServer.h"
 #include "WiFiClient.h"
@@ -119,7 +119,7 @@ String WebServer::_extractParam(String& authReq,const String& param,const char d
   return authReq.substring(_begin+param.length(),authReq.indexOf(delimit,_begin+param.length()));
 }
 
-static String md5str(String &in){
+static String md5str(const String &in){
   MD5Builder md5 = MD5Builder();
   md5.begin();
   md5.add(in);
@@ -133,20 +133,21 @@ bool WebServer::authenticate(const char * username, const char * password){
     if(authReq.startsWith(F("Basic"))){
       authReq = authReq.substring(6);
       authReq.trim();
-      char toencodeLen = strlen(username)+strlen(password)+1;
+      size_t toencodeLen = strlen(username)+strlen(password)+1;
       char *toencode = new char[toencodeLen + 1];
       if(toencode == NULL){
         authReq = "";
         return false;
       }
-      char *encoded = new char[base64_encode_expected_len(toencodeLen)+1];
+      char *encoded = new char[base64::encodedLength(toencodeLen)+1];
       if(encoded == NULL){
         authReq = "";
         delete[] toencode;
         return false;
       }
       sprintf(toencode, "%s:%s", username, password);
-      if(base64_encode_chars(toencode, toencodeLen, encoded) > 0 && authReq.equalsConstantTime(encoded)) {
+      encoded[base64::encode((const uint8_t *)toencode, toencodeLen, encoded)] = 0;
+      if(authReq.equalsConstantTime(encoded)) {
         authReq = "";
         delete[] toencode;
         delete[] encoded;
@@ -183,7 +184,7 @@ bool WebServer::authenticate(const char * username, const char * password){
         _nc = _extractParam(authReq, F("nc="), ',');
         _cnonce = _extractParam(authReq, F("cnonce=\""),'\"');
       }
-      String _H1 = md5str(String(username) + ':' + _realm + ':' + String(password));
+      String _H1 = md5str(String::join(username, ':', _realm, ':', password));
       log_v("Hash of user:realm:pass=%s", _H1.c_str());
       String _H2 = "";
       if(_currentMethod == HTTP_GET){
@@ -200,9 +201,9 @@ bool WebServer::authenticate(const char * username, const char * password){
       log_v("Hash of GET:uri=%s", _H2.c_str());
       String _responsecheck = "";
       if(authReq.indexOf(FPSTR(qop_auth)) != -1 || authReq.indexOf(FPSTR(qop_auth_quoted)) != -1) {
-          _responsecheck = md5str(_H1 + ':' + _nonce + ':' + _nc + ':' + _cnonce + F(":auth:") + _H2);
+          _responsecheck = md5str(String::join(_H1, ':', _nonce, ':', _nc, ':', _cnonce, F(":auth:"), _H2));
       } else {
-          _responsecheck = md5str(_H1 + ':' + _nonce + ':' + _H2);
+          _responsecheck = md5str(String::join(_H1, ':', _nonce, ':', _H2));
       }
       log_v("The Proper response=%s", _responsecheck.c_str());
       if(_response == _responsecheck){
@@ -231,11 +232,11 @@ void WebServer::requestAuthentication(HTTPAuthMethod mode, const char* realm, co
     _srealm = String(realm);
   }
   if(mode == BASIC_AUTH) {
-    sendHeader(String(FPSTR(WWW_Authenticate)), String(F("Basic realm=\"")) + _srealm + String(F("\"")));
+    sendHeader(String(FPSTR(WWW_Authenticate)), String::join(F("Basic realm=\""), _srealm, '"'));
   } else {
     _snonce=_getRandomHexString();
     _sopaque=_getRandomHexString();
-    sendHeader(String(FPSTR(WWW_Authenticate)), String(F("Digest realm=\"")) +_srealm + String(F("\", qop=\"auth\", nonce=\"")) + _snonce + String(F("\", opaque=\"")) + _sopaque + String(F("\"")));
+    sendHeader(String(FPSTR(WWW_Authenticate)), String::join(F("Digest realm=\""), _srealm, F("\", qop=\"auth\", nonce=\""), _snonce, F("\", opaque=\""), _sopaque, '"'));
   }
   using namespace mime;
   send(401, String(FPSTR(mimeTable[html].mimeType)), authFailMsg);
@@ -353,16 +354,14 @@ void WebServer::stop() {
 }
 
 void WebServer::sendHeader(const String& name, const String& value, bool first) {
-  String headerLine = name;
-  headerLine += F(": ");
-  headerLine += value;
-  headerLine += "\r\n";
-
   if (first) {
-    _responseHeaders = headerLine + _responseHeaders;
+    _responseHeaders = String::join(name, F(": "), value, "\r\n", _responseHeaders);
   }
   else {
-    _responseHeaders += headerLine;
+    _responseHeaders += name;
+    _responseHeaders += F(": ");
+    _responseHeaders += value;
+    _responseHeaders += "\r\n";
   }
 }
 
@@ -383,11 +382,7 @@ void WebServer::enableCrossOrigin(boolean value) {
 }
 
 void WebServer::_prepareHeader(String& response, int code, const char* content_type, size_t contentLength) {
-    response = String(F("HTTP/1.")) + String(_currentVersion) + ' ';
-    response += String(code);
-    response += ' ';
-    response += _responseCodeToString(code);
-    response += "\r\n";
+    response = String::join(F("HTTP/1."), _currentVersion, ' ', code, ' ', _responseCodeToString(code), "\r\n");
 
     using namespace mime;
     if (!content_type)
@@ -1,11 +1,14 @@
 #include "mimetable.h"
 #include "pgmspace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
 
 namespace mime
 {
 
 // Table of extension->MIME strings stored in PROGMEM, needs to be global due to GCC section typing rules
-const Entry mimeTable[maxType] = 
+constexpr Entry mimeTable[maxType] = 
 {
     { ".html", "text/html" },
     { ".htm", "text/html" },
@@ -32,4 +35,166 @@ const Entry mimeTable[maxType] =
     { "", "application/octet-stream" } 
 };
 
+struct Extension
+{
+  const char * extension;
+  type mimeType;
+};
+
+// mimeTable by lowercase extension without the dot, must stay sorted
+static constexpr Extension extensionTable[] =
+{
+    { "appcache", appcache },
+    { "css", css },
+    { "eot", eot },
+    { "gif", gif },
+    { "gz", gz },
+    { "htm", htm },
+    { "html", html },
+    { "ico", ico },
+    { "jpg", jpg },
+    { "js", js },
+    { "json", json },
+    { "otf", otf },
+    { "pdf", pdf },
+    { "png", png },
+    { "sfnt", sfnt },
+    { "svg", svg },
+    { "ttf", ttf },
+    { "txt", txt },
+    { "woff", woff },
+    { "woff2", woff2 },
+    { "xml", xml },
+    { "zip", zip },
+};
+
+static constexpr size_t extensionCount = sizeof(extensionTable) / sizeof(extensionTable[0]);
+
+static constexpr bool extensionLess(const char * a, const char * b)
+{
+  return (*a != *b) ? ((unsigned char)*a < (unsigned char)*b) : (*a && extensionLess(a + 1, b + 1));
+}
+
+static constexpr bool extensionsSorted(size_t i)
+{
+  return i + 1 >= extensionCount || (extensionLess(extensionTable[i].extension, extensionTable[i + 1].extension) && extensionsSorted(i + 1));
+}
+
+static constexpr bool extensionEqual(const char * a, const char * b)
+{
+  return (*a == *b) && (!*a || extensionEqual(a + 1, b + 1));
+}
+
+static constexpr size_t typeCount(type t, size_t i)
+{
+  return (i >= extensionCount) ? 0 : (extensionTable[i].mimeType == t) + typeCount(t, i + 1);
+}
+
+static constexpr bool typesUnique(size_t t)
+{
+  return t >= none || (typeCount((type)t, 0) == 1 && typesUnique(t + 1));
+}
+
+static constexpr bool extensionsMatch(size_t i)
+{
+  return i >= extensionCount || (mimeTable[extensionTable[i].mimeType].endsWith[0] == '.'
+    && extensionEqual(extensionTable[i].extension, mimeTable[extensionTable[i].mimeType].endsWith + 1)
+    && extensionsMatch(i + 1));
+}
+
+static_assert(extensionsSorted(0), "mime::extensionTable must be sorted by extension");
+static_assert(extensionCount == maxType - 1, "every mime::type but none needs an extension");
+static_assert(typesUnique(0), "every mime::type but none must be in mime::extensionTable exactly once");
+static_assert(extensionsMatch(0), "mime::extensionTable must use the extension of mimeTable[type].endsWith");
+
+// types added at run time, kept sorted the same way
+struct CustomExtension
+{
+  char extension[MIME_EXTENSION_MAX + 1];
+  char * mimeType;
+};
+
+static CustomExtension * customTable = NULL;
+static size_t customCount = 0;
+
+static int compareBuiltin(const void * key, const void * entry)
+{
+  return strcmp((const char *)key, ((const Extension *)entry)->extension);
+}
+
+static int compareCustom(const void * key, const void * entry)
+{
+  return strcmp((const char *)key, ((const CustomExtension *)entry)->extension);
+}
+
+// lowercase copy without the dot, false if it does not fit
+static bool normalizeExtension(const char * extension, char * out)
+{
+  if (*extension == '.') {
+    extension++;
+  }
+  size_t len = 0;
+  for (; extension[len]; len++) {
+    if (len == MIME_EXTENSION_MAX) {
+      return false;
+    }
+    out[len] = tolower((unsigned char)extension[len]);
+  }
+  out[len] = 0;
+  return len > 0;
+}
+
+const char * getContentType(const char * path)
+{
+  char extension[MIME_EXTENSION_MAX + 1];
+  const char * dot = strrchr(path, '.');
+  if (!dot || strchr(dot, '/') || !normalizeExtension(dot, extension)) {
+    return mimeTable[none].mimeType;
+  }
+  if (customCount) {
+    const CustomExtension * custom = (const CustomExtension *)bsearch(extension, customTable, customCount, sizeof(CustomExtension), compareCustom);
+    if (custom) {
+      return custom->mimeType;
+    }
+  }
+  const Extension * builtin = (const Extension *)bsearch(extension, extensionTable, extensionCount, sizeof(Extension), compareBuiltin);
+  return builtin ? mimeTable[builtin->mimeType].mimeType : mimeTable[none].mimeType;
+}
+
+bool registerType(const char * extension, const char * mimeType)
+{
+  char key[MIME_EXTENSION_MAX + 1];
+  if (!extension || !mimeType || !normalizeExtension(extension, key)) {
+    return false;
+  }
+  char * copy = strdup(mimeType);
+  if (!copy) {
+    return false;
+  }
+
+  // find the sorted position, replacing the type if the extension is there already
+  size_t pos = 0;
+  while (pos < customCount && strcmp(customTable[pos].extension, key) < 0) {
+    pos++;
+  }
+  if (pos < customCount && !strcmp(customTable[pos].extension, key)) {
+    free(customTable[pos].mimeType);
+    customTable[pos].mimeType = copy;
+    return true;
+  }
+
+  CustomExtension * table = (CustomExtension *)realloc(customTable, (customCount + 1) * sizeof(CustomExtension));
+  if (!table) {
+    free(copy);
+    return false;
+  }
+  customTable = table;
+  memmove(&customTable[pos + 1], &customTable[pos], (customCount - pos) * sizeof(CustomExtension));
+  strcpy(customTable[pos].extension, key);
+  customTable[pos].mimeType = copy;
+  customCount++;
+  return true;
 }
+
+}
+
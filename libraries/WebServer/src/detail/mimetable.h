@@ -41,6 +41,23 @@ struct Entry
 
 
 extern const Entry mimeTable[maxType];
+
+// longest extension getContentType() and registerType() handle, without the dot
+#define MIME_EXTENSION_MAX 15
+
+/*
+  Content type for the extension of path, matched case insensitively,
+  application/octet-stream if it is not known. Binary search over a table
+  sorted by lowercase extension, types added with registerType() first.
+*/
+const char * getContentType(const char * path);
+
+/*
+  Adds or replaces the type served for an extension (".webp" or "webp"),
+  also overriding a built in one. Both strings are copied. Call it before
+  the server starts.
+*/
+bool registerType(const char * extension, const char * mimeType);
 }
 
 
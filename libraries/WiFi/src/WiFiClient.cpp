@@ -22,11 +22,20 @@
 #include <lwip/sockets.h>
 #include <lwip/netdb.h>
 #include <errno.h>
+#include "esp_heap_caps.h"
 
 #define WIFI_CLIENT_DEF_CONN_TIMEOUT_MS  (3000)
 #define WIFI_CLIENT_MAX_WRITE_RETRY      (10)
 #define WIFI_CLIENT_SELECT_TIMEOUT_US    (1000000)
 #define WIFI_CLIENT_FLUSH_BUFFER_SIZE    (1024)
+#ifndef WIFI_CLIENT_RX_BUFFER_MIN
+#define WIFI_CLIENT_RX_BUFFER_MIN        (1436)
+#endif
+#ifndef WIFI_CLIENT_RX_BUFFER_MAX
+#define WIFI_CLIENT_RX_BUFFER_MAX        (1436 * 8)
+#endif
+#define WIFI_CLIENT_STREAM_CHUNK_SIZE    (1360)
+#define WIFI_CLIENT_MAX_IOV              (8)
 
 #undef connect
 #undef write
@@ -35,11 +44,16 @@
 class WiFiClientRxBuffer {
 private:
         size_t _size;
+        size_t _minSize;
+        size_t _maxSize;
+        bool _psram;
         uint8_t *_buffer;
         size_t _pos;
         size_t _fill;
         int _fd;
         bool _failed;
+        uint8_t _fullFills;     // fills in a row that found more data than fits
+        uint8_t _lightFills;    // fills in a row that used under a quarter of the buffer
 
         size_t r_available()
         {
@@ -59,21 +73,67 @@ private:
             return count;
         }
 
+        // grows while the sender keeps the buffer full, shrinks back while it trickles
+        void adapt()
+        {
+            size_t size = _size;
+            if(_fullFills >= 2 && _size < _maxSize){
+                size = (_size * 2 < _maxSize) ? _size * 2 : _maxSize;
+            } else if(_lightFills >= 8 && _size > _minSize){
+                size = (_size / 2 > _minSize) ? _size / 2 : _minSize;
+            }
+            if(size != _size){
+                log_v("fd %d: %u -> %u", _fd, _size, size);
+                free(_buffer);
+                _buffer = NULL;
+                _size = size;
+                _fullFills = 0;
+                _lightFills = 0;
+            }
+        }
+
+        void account(size_t received, size_t room)
+        {
+            if(received >= room){
+                if(_fullFills < UINT8_MAX){
+                    _fullFills++;
+                }
+                _lightFills = 0;
+            } else if(received < _size / 4){
+                if(_lightFills < UINT8_MAX){
+                    _lightFills++;
+                }
+                _fullFills = 0;
+            } else {
+                _fullFills = 0;
+                _lightFills = 0;
+            }
+        }
+
         size_t fillBuffer()
         {
+            if(_fill && _pos == _fill){
+                _fill = 0;
+                _pos = 0;
+            }
+            if(!_fill){
+                adapt();
+            }
             if(!_buffer){
-                _buffer = (uint8_t *)malloc(_size);
+                if(_psram && psramFound()){
+                    _buffer = (uint8_t *)heap_caps_malloc(_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+                }
+                if(!_buffer){
+                    _buffer = (uint8_t *)malloc(_size);
+                }
                 if(!_buffer) {
                     log_e("Not enough memory to allocate buffer");
                     _failed = true;
                     return 0;
                 }
             }
-            if(_fill && _pos == _fill){
-                _fill = 0;
-                _pos = 0;
-            }
-            if(!_buffer || _size <= _fill || !r_available()) {
+            size_t avail;
+            if(_size <= _fill || !(avail = r_available())) {
                 return 0;
             }
             int res = recv(_fd, _buffer + _fill, _size - _fill, MSG_DONTWAIT);
@@ -83,18 +143,24 @@ private:
                 }
                 return 0;
             }
+            account(avail, _size - _fill);
             _fill += res;
             return res;
         }
 
 public:
-    WiFiClientRxBuffer(int fd, size_t size=1436)
+    WiFiClientRxBuffer(int fd, size_t size=WIFI_CLIENT_RX_BUFFER_MIN, size_t maxSize=WIFI_CLIENT_RX_BUFFER_MAX)
         :_size(size)
+        ,_minSize(size)
+        ,_maxSize(maxSize < size ? size : maxSize)
+        ,_psram(false)
         ,_buffer(NULL)
         ,_pos(0)
         ,_fill(0)
         ,_fd(fd)
         ,_failed(false)
+        ,_fullFills(0)
+        ,_lightFills(0)
     {
         //_buffer = (uint8_t *)malloc(_size);
     }
@@ -104,15 +170,36 @@ public:
         free(_buffer);
     }
 
+    // takes effect the next time the buffer is empty
+    void setSize(size_t minSize, size_t maxSize, bool psram){
+        _minSize = minSize;
+        _maxSize = (maxSize < minSize) ? minSize : maxSize;
+        _psram = psram;
+        if(_pos == _fill){
+            free(_buffer);
+            _buffer = NULL;
+            _pos = _fill = 0;
+            _size = _minSize;
+        }
+    }
+
     bool failed(){
         return _failed;
     }
 
     int read(uint8_t * dst, size_t len){
-        if(!dst || !len || (_pos == _fill && !fillBuffer())){
+        if(!dst || !len){
             return _failed ? -1 : 0;
         }
         size_t a = _fill - _pos;
+        if(!a && len >= _size){
+            // nothing buffered and a large read, go straight to the caller's memory
+            return readDirect(dst, len);
+        }
+        if(!a && !fillBuffer()){
+            return _failed ? -1 : 0;
+        }
+        a = _fill - _pos;
         if(len <= a || ((len - a) <= (_size - _fill) && fillBuffer() >= (len - a))){
             if(len == 1){
                 *dst = _buffer[_pos];
@@ -123,12 +210,16 @@ public:
             return len;
         }
         size_t left = len;
-        size_t toRead = a;
+        size_t toRead = _fill - _pos;
         uint8_t * buf = dst;
         memcpy(buf, _buffer + _pos, toRead);
         _pos += toRead;
         left -= toRead;
         buf += toRead;
+        if(left >= _size){
+            int res = readDirect(buf, left);
+            return (res > 0) ? (int)(len - left + res) : (int)(len - left);
+        }
         while(left){
             if(!fillBuffer()){
                 return len - left;
@@ -143,6 +234,21 @@ public:
         return len;
     }
 
+    // recv into the caller's memory, the buffer must be empty
+    int readDirect(uint8_t * dst, size_t len){
+        int res = recv(_fd, dst, len, MSG_DONTWAIT);
+        if(res < 0) {
+            if(errno != EWOULDBLOCK) {
+                _failed = true;
+                return -1;
+            }
+            return 0;
+        }
+        // a read that filled up counts like a full buffer, so bulk transfers grow it
+        account(res, _size);
+        return res;
+    }
+
     int peek(){
         if(_pos == _fill && !fillBuffer()){
             return -1;
@@ -154,6 +260,21 @@ public:
         return _fill - _pos + r_available();
     }
 
+    size_t peekAvailable(){
+        if(_pos == _fill){
+            fillBuffer();
+        }
+        return _fill - _pos;
+    }
+
+    const char * peekBuffer(){
+        return (const char *)(_buffer + _pos);
+    }
+
+    void peekConsume(size_t consume){
+        _pos += (consume < _fill - _pos) ? consume : (_fill - _pos);
+    }
+
     void flush(){
         if(r_available()){
             fillBuffer();
@@ -162,6 +283,126 @@ public:
     }
 };
 
+class WiFiClientTxQueue {
+private:
+        uint8_t *_buffer;
+        size_t _size;
+        size_t _head;
+        size_t _len;
+        bool _above;
+
+public:
+    WiFiClient::WritableCallback onWritable;
+    size_t lowWater;
+
+    WiFiClientTxQueue(size_t size)
+        :_buffer((uint8_t *)malloc(size))
+        ,_size(size)
+        ,_head(0)
+        ,_len(0)
+        ,_above(false)
+        ,onWritable(NULL)
+        ,lowWater(0)
+    {
+    }
+
+    ~WiFiClientTxQueue()
+    {
+        free(_buffer);
+    }
+
+    bool valid(){
+        return _buffer != NULL;
+    }
+
+    size_t pending(){
+        return _len;
+    }
+
+    size_t room(){
+        return _size - _len;
+    }
+
+    size_t push(const uint8_t *data, size_t len){
+        if(len > room()){
+            len = room();
+        }
+        size_t tail = (_head + _len) % _size;
+        size_t first = (len < _size - tail) ? len : _size - tail;
+        memcpy(_buffer + tail, data, first);
+        memcpy(_buffer, data + first, len - first);
+        _len += len;
+        if(_len > lowWater){
+            _above = true;
+        }
+        return len;
+    }
+
+    // the queued data as up to two contiguous pieces
+    int chunks(struct iovec *iov){
+        if(!_len){
+            return 0;
+        }
+        size_t first = (_len < _size - _head) ? _len : _size - _head;
+        iov[0].iov_base = _buffer + _head;
+        iov[0].iov_len = first;
+        if(first == _len){
+            return 1;
+        }
+        iov[1].iov_base = _buffer;
+        iov[1].iov_len = _len - first;
+        return 2;
+    }
+
+    void pop(size_t len){
+        _head = (_head + len) % _size;
+        _len -= len;
+        if(!_len){
+            _head = 0;
+        }
+    }
+
+    // true once when the queue drained to the low water mark
+    bool drained(){
+        if(_above && _len <= lowWater){
+            _above = false;
+            return true;
+        }
+        return false;
+    }
+};
+
+// sends without waiting, returns the bytes sent, 0 if the socket is full or -1 on error
+static int sendNow(int fd, const struct iovec *iov, int count, int flags)
+{
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = (struct iovec *)iov;
+    msg.msg_iovlen = count;
+    int res = sendmsg(fd, &msg, flags | MSG_DONTWAIT);
+    if(res < 0) {
+        if(errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        }
+        log_e("fail on fd %d, errno: %d, \"%s\"", fd, errno, strerror(errno));
+    }
+    return res;
+}
+
+// drops sent bytes from the front of an iovec array
+static void iovAdvance(struct iovec *&iov, int &count, size_t sent)
+{
+    while(count && sent >= iov->iov_len) {
+        sent -= iov->iov_len;
+        iov++;
+        count--;
+    }
+    if(count) {
+        iov->iov_base = (uint8_t *)iov->iov_base + sent;
+        iov->iov_len -= sent;
+    }
+}
+
 class WiFiClientSocketHandle {
 private:
     int sockfd;
@@ -182,11 +423,11 @@ public:
     }
 };
 
-WiFiClient::WiFiClient():_rxBuffer(nullptr),_connected(false),_timeout(WIFI_CLIENT_DEF_CONN_TIMEOUT_MS),next(NULL)
+WiFiClient::WiFiClient():_rxBuffer(nullptr),_connected(false),_corked(false),_timeout(WIFI_CLIENT_DEF_CONN_TIMEOUT_MS),next(NULL)
 {
 }
 
-WiFiClient::WiFiClient(int fd):_connected(true),_timeout(WIFI_CLIENT_DEF_CONN_TIMEOUT_MS),next(NULL)
+WiFiClient::WiFiClient(int fd):_connected(true),_corked(false),_timeout(WIFI_CLIENT_DEF_CONN_TIMEOUT_MS),next(NULL)
 {
     clientSocketHandle.reset(new WiFiClientSocketHandle(fd));
     _rxBuffer.reset(new WiFiClientRxBuffer(fd));
@@ -202,7 +443,9 @@ WiFiClient & WiFiClient::operator=(const WiFiClient &other)
     stop();
     clientSocketHandle = other.clientSocketHandle;
     _rxBuffer = other._rxBuffer;
+    _txQueue = other._txQueue;
     _connected = other._connected;
+    _corked = other._corked;
     return *this;
 }
 
@@ -210,7 +453,9 @@ void WiFiClient::stop()
 {
     clientSocketHandle = NULL;
     _rxBuffer = NULL;
+    _txQueue = NULL;
     _connected = false;
+    _corked = false;
 }
 
 int WiFiClient::connect(IPAddress ip, uint16_t port)
@@ -386,19 +631,21 @@ int WiFiClient::read()
     return data;
 }
 
-size_t WiFiClient::write(const uint8_t *buf, size_t size)
+size_t WiFiClient::_writevBlocking(const struct iovec *iov, int count, int flags)
 {
     int res =0;
     int retry = WIFI_CLIENT_MAX_WRITE_RETRY;
     int socketFileDescriptor = fd();
     size_t totalBytesSent = 0;
-    size_t bytesRemaining = size;
+    struct iovec vec[WIFI_CLIENT_MAX_IOV];
+    struct iovec *next = vec;
 
-    if(!_connected || (socketFileDescriptor < 0)) {
-        return 0;
+    if(count > WIFI_CLIENT_MAX_IOV) {
+        count = WIFI_CLIENT_MAX_IOV;
     }
+    memcpy(vec, iov, count * sizeof(struct iovec));
 
-    while(retry) {
+    while(retry && count) {
         //use select to make sure the socket is ready for writing
         fd_set set;
         struct timeval tv;
@@ -413,35 +660,100 @@ size_t WiFiClient::write(const uint8_t *buf, size_t size)
         }
 
         if(FD_ISSET(socketFileDescriptor, &set)) {
-            res = send(socketFileDescriptor, (void*) buf, bytesRemaining, MSG_DONTWAIT);
+            res = sendNow(socketFileDescriptor, next, count, flags);
             if(res > 0) {
                 totalBytesSent += res;
-                if (totalBytesSent >= size) {
-                    //completed successfully
-                    retry = 0;
-                } else {
-                    buf += res;
-                    bytesRemaining -= res;
-                    retry = WIFI_CLIENT_MAX_WRITE_RETRY;
-                }
+                iovAdvance(next, count, res);
+                retry = WIFI_CLIENT_MAX_WRITE_RETRY;
             }
             else if(res < 0) {
-                log_e("fail on fd %d, errno: %d, \"%s\"", fd(), errno, strerror(errno));
-                if(errno != EAGAIN) {
-                    //if resource was busy, can try again, otherwise give up
-                    stop();
-                    res = 0;
-                    retry = 0;
-                }
+                // sendNow() already turned a busy socket into 0, this is an error
+                stop();
+                retry = 0;
             }
             else {
-                // Try again
+                // resource was busy, try again
             }
         }
     }
     return totalBytesSent;
 }
 
+size_t WiFiClient::_writevQueued(const struct iovec *iov, int count)
+{
+    struct iovec vec[WIFI_CLIENT_MAX_IOV];
+    struct iovec *next = vec;
+    size_t accepted = 0;
+
+    if(count > WIFI_CLIENT_MAX_IOV) {
+        count = WIFI_CLIENT_MAX_IOV;
+    }
+    memcpy(vec, iov, count * sizeof(struct iovec));
+
+    // queued data goes first, the rest only skips the queue if it is empty by then
+    if(_sendQueued() == 0 && !_corked) {
+        int res = sendNow(fd(), next, count, 0);
+        if(res < 0) {
+            stop();
+            return 0;
+        }
+        accepted = res;
+        iovAdvance(next, count, res);
+    }
+    while(count && _txQueue) {
+        size_t len = _txQueue->push((const uint8_t *)next->iov_base, next->iov_len);
+        accepted += len;
+        if(len < next->iov_len) {
+            break;
+        }
+        next++;
+        count--;
+    }
+    return accepted;
+}
+
+size_t WiFiClient::writev(const struct iovec *iov, int count)
+{
+    size_t written = 0;
+
+    if(!_connected || fd() < 0) {
+        return 0;
+    }
+    while(count > 0) {
+        int n = (count > WIFI_CLIENT_MAX_IOV) ? WIFI_CLIENT_MAX_IOV : count;
+        size_t expected = 0;
+        for(int i = 0; i < n; i++) {
+            expected += iov[i].iov_len;
+        }
+        size_t res = _txQueue ? _writevQueued(iov, n) : _writevBlocking(iov, n, _corked ? MSG_MORE : 0);
+        written += res;
+        if(res < expected) {
+            break;
+        }
+        iov += n;
+        count -= n;
+    }
+    return written;
+}
+
+size_t WiFiClient::write(const uint8_t *buf, size_t size)
+{
+    struct iovec iov;
+    iov.iov_base = (void *)buf;
+    iov.iov_len = size;
+    return writev(&iov, 1);
+}
+
+size_t WiFiClient::write(const uint8_t *header, size_t headerSize, const uint8_t *body, size_t bodySize)
+{
+    struct iovec iov[2];
+    iov[0].iov_base = (void *)header;
+    iov[0].iov_len = headerSize;
+    iov[1].iov_base = (void *)body;
+    iov[1].iov_len = bodySize;
+    return writev(iov, 2);
+}
+
 size_t WiFiClient::write_P(PGM_P buf, size_t size)
 {
     return write(buf, size);
@@ -449,22 +761,155 @@ size_t WiFiClient::write_P(PGM_P buf, size_t size)
 
 size_t WiFiClient::write(Stream &stream)
 {
-    uint8_t * buf = (uint8_t *)malloc(1360);
-    if(!buf){
-        return 0;
-    }
-    size_t toRead = 0, toWrite = 0, written = 0;
-    size_t available = stream.available();
-    while(available){
-        toRead = (available > 1360)?1360:available;
-        toWrite = stream.readBytes(buf, toRead);
-        written += write(buf, toWrite);
-        available = stream.available();
+    uint8_t *buf = NULL;
+    size_t written = 0;
+    while(true) {
+        // in non-blocking mode take no more from the stream than can be accepted
+        size_t room = _txQueue ? _txQueue->room() : SIZE_MAX;
+        if(!room) {
+            break;
+        }
+        size_t toWrite, sent;
+        if(stream.hasPeekBufferAPI()) {
+            toWrite = stream.peekAvailable();
+            if(!toWrite) {
+                break;
+            }
+            toWrite = (toWrite > room) ? room : toWrite;
+            sent = write((const uint8_t *)stream.peekBuffer(), toWrite);
+            stream.peekConsume(sent);
+        } else {
+            toWrite = stream.available();
+            if(!toWrite) {
+                break;
+            }
+            if(!buf) {
+                buf = (uint8_t *)malloc(WIFI_CLIENT_STREAM_CHUNK_SIZE);
+                if(!buf) {
+                    break;
+                }
+            }
+            toWrite = (toWrite > WIFI_CLIENT_STREAM_CHUNK_SIZE) ? WIFI_CLIENT_STREAM_CHUNK_SIZE : toWrite;
+            toWrite = (toWrite > room) ? room : toWrite;
+            toWrite = stream.readBytes(buf, toWrite);
+            sent = write(buf, toWrite);
+        }
+        written += sent;
+        if(sent < toWrite) {
+            break;
+        }
     }
     free(buf);
     return written;
 }
 
+void WiFiClient::setRxBufferSize(size_t minSize, size_t maxSize, bool psram)
+{
+    if(_rxBuffer) {
+        _rxBuffer->setSize(minSize, maxSize, psram);
+    }
+}
+
+bool WiFiClient::setNonBlocking(bool enable, size_t queueSize)
+{
+    if(!enable) {
+        if(_txQueue) {
+            // whatever is still queued goes out the blocking way, what is not sent stays queued
+            std::shared_ptr<WiFiClientTxQueue> queue = _txQueue;
+            struct iovec iov[2];
+            int count = queue->chunks(iov);
+            if(count) {
+                size_t pending = queue->pending();
+                size_t sent = _writevBlocking(iov, count, 0);
+                queue->pop(sent);
+                if(sent < pending) {
+                    log_e("fail on fd %d, %u bytes still queued", fd(), (unsigned)(pending - sent));
+                    return false;
+                }
+            }
+            _txQueue = NULL;
+        }
+        return true;
+    }
+    if(_txQueue || !_connected) {
+        return _txQueue != NULL;
+    }
+    std::shared_ptr<WiFiClientTxQueue> queue(new WiFiClientTxQueue(queueSize));
+    if(!queue->valid()) {
+        log_e("Not enough memory to allocate send queue");
+        return false;
+    }
+    _txQueue = queue;
+    return true;
+}
+
+bool WiFiClient::getNonBlocking()
+{
+    return _txQueue != NULL;
+}
+
+size_t WiFiClient::_sendQueued()
+{
+    if(!_txQueue) {
+        return 0;
+    }
+    std::shared_ptr<WiFiClientTxQueue> queue = _txQueue;
+    struct iovec iov[2];
+    int count = queue->chunks(iov);
+    if(count && !_corked && _connected) {
+        int res = sendNow(fd(), iov, count, 0);
+        if(res < 0) {
+            stop();
+            return queue->pending();
+        }
+        queue->pop(res);
+    }
+    return queue->pending();
+}
+
+size_t WiFiClient::sendPending()
+{
+    if(!_txQueue) {
+        return 0;
+    }
+    std::shared_ptr<WiFiClientTxQueue> queue = _txQueue;
+    size_t pending = _sendQueued();
+    // only called here, never from inside a write, so the callback may write again
+    if(queue->onWritable && queue->drained()) {
+        queue->onWritable(*this);
+        pending = queue->pending();
+    }
+    return pending;
+}
+
+int WiFiClient::availableForWrite()
+{
+    if(!_txQueue) {
+        return 0;
+    }
+    _sendQueued();
+    return _txQueue ? _txQueue->room() : 0;
+}
+
+void WiFiClient::onWritable(WritableCallback cb, size_t lowWater)
+{
+    if(_txQueue) {
+        _txQueue->onWritable = cb;
+        _txQueue->lowWater = lowWater;
+    }
+}
+
+void WiFiClient::setCork(bool cork)
+{
+    if(_corked == cork) {
+        return;
+    }
+    _corked = cork;
+    if(!cork && _txQueue) {
+        sendPending();
+    }
+}
+
 int WiFiClient::read(uint8_t *buf, size_t size)
 {
     int res = -1;
@@ -505,6 +950,33 @@ int WiFiClient::available()
     return res;
 }
 
+size_t WiFiClient::peekAvailable()
+{
+    if(!_rxBuffer)
+    {
+        return 0;
+    }
+    size_t res = _rxBuffer->peekAvailable();
+    if(_rxBuffer->failed()) {
+        log_e("fail on fd %d, errno: %d, \"%s\"", fd(), errno, strerror(errno));
+        stop();
+        return 0;
+    }
+    return res;
+}
+
+const char * WiFiClient::peekBuffer()
+{
+    return _rxBuffer ? _rxBuffer->peekBuffer() : nullptr;
+}
+
+void WiFiClient::peekConsume(size_t consume)
+{
+    if (_rxBuffer) {
+        _rxBuffer->peekConsume(consume);
+    }
+}
+
 // Though flushing means to send all pending data,
 // seems that in Arduino it also means to clear RX
 void WiFiClient::flush() {
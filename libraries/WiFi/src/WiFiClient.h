@@ -24,9 +24,14 @@
 #include "Arduino.h"
 #include "Client.h"
 #include <memory>
+#include <functional>
+
+#define WIFI_CLIENT_DEF_TX_QUEUE_SIZE   (4096)
 
 class WiFiClientSocketHandle;
 class WiFiClientRxBuffer;
+class WiFiClientTxQueue;
+struct iovec;
 
 class ESPLwIPClient : public Client
 {
@@ -41,10 +46,18 @@ class WiFiClient : public ESPLwIPClient
 protected:
     std::shared_ptr<WiFiClientSocketHandle> clientSocketHandle;
     std::shared_ptr<WiFiClientRxBuffer> _rxBuffer;
+    std::shared_ptr<WiFiClientTxQueue> _txQueue;
     bool _connected;
+    bool _corked;
     int _timeout;
 
+    size_t _writevBlocking(const struct iovec *iov, int count, int flags);
+    size_t _writevQueued(const struct iovec *iov, int count);
+    size_t _sendQueued();
+
 public:
+    typedef std::function<void(WiFiClient &client)> WritableCallback;
+
     WiFiClient *next;
     WiFiClient();
     WiFiClient(int fd);
@@ -57,11 +70,23 @@ public:
     size_t write(const uint8_t *buf, size_t size);
     size_t write_P(PGM_P buf, size_t size);
     size_t write(Stream &stream);
+    // scatter/gather: all buffers go out in one send, e.g. a header and its body
+    virtual size_t writev(const struct iovec *iov, int count);
+    size_t write(const uint8_t *header, size_t headerSize, const uint8_t *body, size_t bodySize);
     int available();
     int read();
     int read(uint8_t *buf, size_t size);
     int peek();
     void flush();
+
+    // Stream peek buffer API over the receive buffer, used by StreamMatcher and Stream::find()
+    bool hasPeekBufferAPI() const override
+    {
+        return true;
+    }
+    size_t peekAvailable() override;
+    const char * peekBuffer() override;
+    void peekConsume(size_t consume) override;
     void stop();
     uint8_t connected();
 
@@ -94,6 +119,25 @@ public:
     int setNoDelay(bool nodelay);
     bool getNoDelay();
 
+    // The receive buffer of the current connection starts at minSize and doubles up to maxSize
+    // while data keeps arriving faster than it is read. Reads of at least the buffer size skip it.
+    void setRxBufferSize(size_t minSize, size_t maxSize, bool psram = false);
+
+    // Non-blocking writes for the current connection: what the socket does not take right
+    // away is queued, up to queueSize bytes, and write() returns how much was accepted.
+    // Call sendPending() from loop() to push the queue out. Turning it off sends what is
+    // still queued, blocking; if that fails the rest stays queued and false is returned.
+    virtual bool setNonBlocking(bool enable, size_t queueSize = WIFI_CLIENT_DEF_TX_QUEUE_SIZE);
+    bool getNonBlocking();
+    size_t sendPending();                       // sends what the socket takes now, returns bytes still queued
+    int availableForWrite();                    // room in the queue, 0 in blocking mode
+    // called from sendPending(), never from within write(), once no more than lowWater
+    // bytes are left queued; the callback may write again
+    void onWritable(WritableCallback cb, size_t lowWater = 0);
+    // while corked, queued writes are held back and go out together when uncorked;
+    // in blocking mode writes are sent with MSG_MORE, so lwIP sets no PSH until uncorked
+    void setCork(bool cork);
+
     IPAddress remoteIP() const;
     IPAddress remoteIP(int fd) const;
     uint16_t remotePort() const;
@@ -295,26 +295,20 @@ static void set_esp_netif_hostname(const char * name){
 	}
 }
 
-static xQueueHandle _arduino_event_queue;
-static TaskHandle_t _arduino_event_task_handle = NULL;
+// events run one at a time and in order, in the high lane of the shared workers
+static work_strand_t _arduino_event_strand;
+static bool _arduino_event_strand_ready = false;
 static EventGroupHandle_t _arduino_event_group = NULL;
 
-static void _arduino_event_task(void * arg){
-	arduino_event_t *data = NULL;
-    for (;;) {
-        if(xQueueReceive(_arduino_event_queue, &data, portMAX_DELAY) == pdTRUE){
-            WiFiGenericClass::_eventCallback(data);
-            free(data);
-            data = NULL;
-        }
-    }
-    vTaskDelete(NULL);
-    _arduino_event_task_handle = NULL;
+static void _arduino_event_run(void * arg){
+    arduino_event_t *data = (arduino_event_t*)arg;
+    WiFiGenericClass::_eventCallback(data);
+    free(data);
 }
 
 esp_err_t postArduinoEvent(arduino_event_t *data)
 {
-	if(data == NULL){
+	if(data == NULL || !_arduino_event_strand_ready){
         return ESP_FAIL;
 	}
 	arduino_event_t * event = (arduino_event_t*)malloc(sizeof(arduino_event_t));
@@ -323,8 +317,9 @@ esp_err_t postArduinoEvent(arduino_event_t *data)
         return ESP_FAIL;
 	}
 	memcpy(event, data, sizeof(arduino_event_t));
-    if (xQueueSend(_arduino_event_queue, &event, portMAX_DELAY) != pdPASS) {
+    if (!workStrandPost(&_arduino_event_strand, _arduino_event_run, event)) {
         log_e("Arduino Event Send Failed!");
+        free(event);
         return ESP_FAIL;
     }
     return ESP_OK;
@@ -560,12 +555,13 @@ static bool _start_network_event_task(){
         }
         xEventGroupSetBits(_arduino_event_group, WIFI_DNS_IDLE_BIT);
     }
-    if(!_arduino_event_queue){
-    	_arduino_event_queue = xQueueCreate(32, sizeof(arduino_event_t*));
-        if(!_arduino_event_queue){
-            log_e("Network Event Queue Create Failed!");
+    if(!_arduino_event_strand_ready){
+        if(!workQueueBegin()){
+            log_e("Network Event Task Start Failed!");
             return false;
         }
+        workStrandInit(&_arduino_event_strand, WORK_PRIORITY_HIGH);
+        _arduino_event_strand_ready = true;
     }
 
     esp_err_t err = esp_event_loop_create_default();
@@ -574,14 +570,6 @@ static bool _start_network_event_task(){
         return err;
     }
 
-    if(!_arduino_event_task_handle){
-        xTaskCreateUniversal(_arduino_event_task, "arduino_events", 4096, NULL, ESP_TASKD_EVENT_PRIO - 1, &_arduino_event_task_handle, ARDUINO_EVENT_RUNNING_CORE);
-        if(!_arduino_event_task_handle){
-            log_e("Network Event Task Start Failed!");
-            return false;
-        }
-    }
-
     if(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &_arduino_event_cb, NULL, NULL)){
         log_e("event_handler_instance_register for WIFI_EVENT Failed!");
         return false;
@@ -50,6 +50,13 @@ uint8_t WiFiUDP::begin(IPAddress address, uint16_t port){
     return 0;
   }
 
+  rx_buffer = new(std::nothrow) SpscRing<uint8_t>(1460);
+  if(!rx_buffer || !rx_buffer->valid()){
+    log_e("could not create rx buffer");
+    stop();
+    return 0;
+  }
+
   if ((udp_server=socket(AF_INET, SOCK_DGRAM, 0)) == -1){
     log_e("could not create socket: %d", errno);
     return 0;
@@ -105,7 +112,7 @@ void WiFiUDP::stop(){
   }
   tx_buffer_len = 0;
   if(rx_buffer){
-    cbuf *b = rx_buffer;
+    SpscRing<uint8_t> *b = rx_buffer;
     rx_buffer = NULL;
     delete b;
   }
@@ -205,16 +212,15 @@ size_t WiFiUDP::write(const uint8_t *buffer, size_t size){
 }
 
 int WiFiUDP::parsePacket(){
-  if(rx_buffer)
+  if(!rx_buffer || !rx_buffer->empty())
     return 0;
+  // the packet is received straight into the ring, it is empty so the whole of it is contiguous
+  rx_buffer->clear();
+  size_t room;
+  uint8_t *buf = rx_buffer->reserveWrite(&room);
   struct sockaddr_in si_other;
   int slen = sizeof(si_other) , len;
-  char *buf = (char *)malloc(1460);
-  if(!buf) {
-    return 0;
-  }
-  if ((len = recvfrom(udp_server, buf, 1460, MSG_DONTWAIT, (struct sockaddr *) &si_other, (socklen_t *)&slen)) == -1){
-    free(buf);
+  if ((len = recvfrom(udp_server, buf, (room < 1460) ? room : 1460, MSG_DONTWAIT, (struct sockaddr *) &si_other, (socklen_t *)&slen)) == -1){
     if(errno == EWOULDBLOCK){
       return 0;
     }
@@ -224,10 +230,8 @@ int WiFiUDP::parsePacket(){
   remote_ip = IPAddress(si_other.sin_addr.s_addr);
   remote_port = ntohs(si_other.sin_port);
   if (len > 0) {
-    rx_buffer = new(std::nothrow) cbuf(len);
-    rx_buffer->write(buf, len);
+    rx_buffer->commitWrite(len);
   }
-  free(buf);
   return len;
 }
 
@@ -237,13 +241,8 @@ int WiFiUDP::available(){
 }
 
 int WiFiUDP::read(){
-  if(!rx_buffer) return -1;
-  int out = rx_buffer->read();
-  if(!rx_buffer->available()){
-    cbuf *b = rx_buffer;
-    rx_buffer = 0;
-    delete b;
-  }
+  uint8_t out;
+  if(!rx_buffer || !rx_buffer->pop(out)) return -1;
   return out;
 }
 
@@ -253,25 +252,18 @@ int WiFiUDP::read(unsigned char* buffer, size_t len){
 
 int WiFiUDP::read(char* buffer, size_t len){
   if(!rx_buffer) return 0;
-  int out = rx_buffer->read(buffer, len);
-  if(!rx_buffer->available()){
-    cbuf *b = rx_buffer;
-    rx_buffer = 0;
-    delete b;
-  }
-  return out;
+  return rx_buffer->read((uint8_t *)buffer, len);
 }
 
 int WiFiUDP::peek(){
-  if(!rx_buffer) return -1;
-  return rx_buffer->peek();
+  uint8_t out;
+  if(!rx_buffer || !rx_buffer->peek(out)) return -1;
+  return out;
 }
 
 void WiFiUDP::flush(){
   if(!rx_buffer) return;
-  cbuf *b = rx_buffer;
-  rx_buffer = 0;
-  delete b;
+  rx_buffer->flush();
 }
 
 IPAddress WiFiUDP::remoteIP(){
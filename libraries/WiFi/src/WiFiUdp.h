@@ -37,7 +37,7 @@
 
 #include <Arduino.h>
 #include <Udp.h>
-#include <cbuf.h>
+#include <SpscRing.h>
 
 class WiFiUDP : public UDP {
 private:
@@ -48,7 +48,7 @@ private:
   uint16_t remote_port;
   char * tx_buffer;
   size_t tx_buffer_len;
-  cbuf * rx_buffer;
+  SpscRing<uint8_t> * rx_buffer;   // holds the packet being read, from begin() to stop()
 public:
   WiFiUDP();
   ~WiFiUDP();
@@ -184,6 +184,19 @@ size_t WiFiClientSecure::write(uint8_t data)
     return write(&data, 1);
 }
 
+size_t WiFiClientSecure::writev(const struct iovec *iov, int count)
+{
+    size_t written = 0;
+    for (int i = 0; i < count; i++) {
+        size_t res = write((const uint8_t *)iov[i].iov_base, iov[i].iov_len);
+        written += res;
+        if (res < iov[i].iov_len) {
+            break;
+        }
+    }
+    return written;
+}
+
 int WiFiClientSecure::read()
 {
     uint8_t data = -1;
@@ -59,10 +59,15 @@ public:
     int peek();
     size_t write(uint8_t data);
     size_t write(const uint8_t *buf, size_t size);
+    // records go out one buffer at a time, there is no send queue below TLS
+    size_t writev(const struct iovec *iov, int count) override;
+    bool setNonBlocking(bool enable, size_t /*queueSize*/ = WIFI_CLIENT_DEF_TX_QUEUE_SIZE) override { return !enable; }
     int available();
     int read();
     int read(uint8_t *buf, size_t size);
     void flush() {}
+    // decrypted data is not kept in WiFiClient receive buffer
+    bool hasPeekBufferAPI() const override { return false; }
     void stop();
     uint8_t connected();
     int lastError(char *buf, const size_t size);
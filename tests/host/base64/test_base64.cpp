@@ -0,0 +1,251 @@
+/*
+ * Host test of base64, Base64Encoder and Base64Decoder
+ *
+ *   test_base64 [bench]
+ *
+ * Checks the RFC 4648 vectors, then random buffers against libb64, which
+ * base64 used before it had its own tables: one shot, to String, and
+ * through the encoder and decoder in random chunks, into a Print with and
+ * without writeBuffer(). The decoder also gets line breaks, missing padding
+ * and corrupted text. "bench" compares the throughput with libb64.
+ */
+
+#include "Arduino.h"
+#include "StreamString.h"
+#include "base64.h"
+#include "libb64/cdecode.h"
+#include "libb64/cencode.h"
+
+#include <time.h>
+#include <random>
+#include <string>
+#include <vector>
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+    if(!(cond)) { \
+        failures++; \
+        printf("FAIL %s:%d: %s: ", __FILE__, __LINE__, #cond); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+    } \
+} while(0)
+
+static double seconds()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// a Print without writeBuffer(), so the encoder and decoder go through their stack buffer
+class Sink : public Print
+{
+public:
+    size_t write(uint8_t c) override
+    {
+        text.push_back(c);
+        return 1;
+    }
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        text.append((const char *)buffer, size);
+        return size;
+    }
+    using Print::write;
+
+    std::string text;
+};
+
+static std::string str(const String &s)
+{
+    return std::string(s.c_str(), s.length());
+}
+
+/*
+  Known answers
+*/
+
+static void testVectors()
+{
+    static const char *vectors[][2] = {
+        { "", "" },
+        { "f", "Zg==" },
+        { "fo", "Zm8=" },
+        { "foo", "Zm9v" },
+        { "foob", "Zm9vYg==" },
+        { "fooba", "Zm9vYmE=" },
+        { "foobar", "Zm9vYmFy" },
+    };
+    for(auto &v : vectors) {
+        size_t len = strlen(v[0]);
+        CHECK(str(base64::encode((const uint8_t *)v[0], len)) == v[1], "encode \"%s\"", v[0]);
+        CHECK(str(base64::decode(String(v[1]))) == v[0], "decode \"%s\"", v[1]);
+        CHECK(base64::encodedLength(len) == strlen(v[1]), "encodedLength(%zu)", len);
+    }
+
+    // not base64: bad length, misplaced padding, characters outside the alphabet
+    static const char *invalid[] = { "A", "A===", "AB=C", "ABC=D", "=AAA", "AB=", "ABC==", "Zm9v\r\n", "Zm-v" };
+    uint8_t out[16];
+    for(const char *text : invalid) {
+        CHECK(base64::decode(text, strlen(text), out) == -1, "accepted \"%s\"", text);
+    }
+
+    // the same through the decoder, which also skips line breaks and takes missing padding
+    static const char *streamed[] = { "Zm9vYg==", "Zm9vYg=\r\n=", "Zm9vYg", "Zm9vYmE=", "Zm9vYmE", "Zm9vYmFy" };
+    static const char *badStreams[] = { "Zm9vYg===", "Zm9vYmE==", "Zm9vYg=", "Zm9v=", "Zm9vY===", "Zm9vYg==Zm9v", "Zm9vY" };
+    for(const char *text : streamed) {
+        Sink sink;
+        Base64Decoder decoder(sink);
+        decoder.write(text);
+        CHECK(decoder.end() && !sink.text.compare(0, 4, "foob"), "decoder refused \"%s\"", text);
+    }
+    for(const char *text : badStreams) {
+        Sink sink;
+        Base64Decoder decoder(sink);
+        decoder.write(text);
+        CHECK(!decoder.end(), "decoder accepted \"%s\"", text);
+    }
+    printf("vectors ok\n");
+}
+
+/*
+  Random buffers against libb64
+*/
+
+static void testRandom()
+{
+    std::mt19937 rng(3);
+    for(int round = 0; round < 20000; round++) {
+        size_t n = rng() % (round < 1000 ? 40 : 5000);
+        std::vector<uint8_t> data(n);
+        for(auto &b : data) {
+            b = rng();
+        }
+        std::string bytes((const char *)data.data(), n);
+
+        std::vector<char> buf(base64_encode_expected_len(n) + 1);
+        std::string expected(buf.data(), base64_encode_chars((const char *)data.data(), n, buf.data()));
+
+        // encoding
+        std::vector<char> text(base64::encodedLength(n));
+        size_t length = base64::encode(data.data(), n, text.data());
+        CHECK(std::string(text.data(), length) == expected, "encode %zu bytes", n);
+        CHECK(str(base64::encode(data.data(), n)) == expected, "encode %zu bytes to String", n);
+
+        Sink sink;
+        StreamString stream;
+        Base64Encoder toSink(sink), toStream(stream);
+        for(size_t at = 0; at < n; ) {
+            size_t chunk = std::min<size_t>(1 + rng() % 700, n - at);
+            if(rng() % 5 == 0) {
+                for(size_t i = 0; i < chunk; i++) {
+                    toSink.write(data[at + i]);
+                    toStream.write(data[at + i]);
+                }
+            } else {
+                toSink.write(data.data() + at, chunk);
+                toStream.write(data.data() + at, chunk);
+            }
+            at += chunk;
+        }
+        CHECK(toSink.end() && sink.text == expected, "encoder to Print, %zu bytes", n);
+        CHECK(toStream.end() && str(stream) == expected, "encoder to StreamString, %zu bytes", n);
+
+        // decoding, with and without the padding
+        std::vector<uint8_t> back(base64::decodedLength(expected.size()) + 1);
+        int decoded = base64::decode(expected.data(), expected.size(), back.data());
+        CHECK(decoded == (int)n && std::string((char *)back.data(), n) == bytes, "decode %zu bytes", n);
+        std::string unpadded = expected.substr(0, expected.find('='));
+        decoded = base64::decode(unpadded.data(), unpadded.size(), back.data());
+        CHECK(decoded == (int)n && std::string((char *)back.data(), n) == bytes, "decode %zu bytes without padding", n);
+        CHECK(str(base64::decode(String(expected.c_str()))) == bytes, "decode %zu bytes to String", n);
+
+        // the decoder skips line breaks, as in PEM or MIME
+        std::string wrapped;
+        for(size_t i = 0; i < expected.size(); i++) {
+            wrapped += expected[i];
+            if(i % 76 == 75) {
+                wrapped += "\r\n";
+            }
+        }
+        Sink decodedSink;
+        StreamString decodedStream;
+        Base64Decoder fromSink(decodedSink), fromStream(decodedStream);
+        for(size_t at = 0; at < wrapped.size(); ) {
+            size_t chunk = std::min<size_t>(1 + rng() % 300, wrapped.size() - at);
+            fromSink.write((const uint8_t *)wrapped.data() + at, chunk);
+            fromStream.write((const uint8_t *)wrapped.data() + at, chunk);
+            at += chunk;
+        }
+        CHECK(fromSink.end() && decodedSink.text == bytes, "decoder to Print, %zu bytes", n);
+        CHECK(fromStream.end() && str(decodedStream) == bytes, "decoder to StreamString, %zu bytes", n);
+
+        // corrupted text is rejected by both
+        if(expected.size() > 4) {
+            std::string bad = expected;
+            bad[rng() % (expected.size() - 3)] = '*';
+            CHECK(base64::decode(bad.data(), bad.size(), back.data()) == -1, "corrupted %zu bytes", n);
+            Sink ignored;
+            Base64Decoder decoder(ignored);
+            decoder.write((const uint8_t *)bad.data(), bad.size());
+            CHECK(!decoder.end() && decoder.getWriteError(), "decoder took corrupted %zu bytes", n);
+        }
+    }
+    printf("random ok\n");
+}
+
+/*
+  Benchmark against libb64
+*/
+
+static void bench()
+{
+    const size_t size = 1 << 20;
+    const int rounds = 200;
+    std::vector<uint8_t> data(size);
+    for(size_t i = 0; i < size; i++) {
+        data[i] = i * 7;
+    }
+    std::vector<char> text(base64_encode_expected_len(size) + 1);
+    std::vector<uint8_t> back(size + 4);
+    size_t length = base64::encodedLength(size);
+
+    double start = seconds();
+    for(int i = 0; i < rounds; i++) {
+        base64_encode_chars((const char *)data.data(), size, text.data());
+    }
+    double libb64 = seconds() - start;
+    start = seconds();
+    for(int i = 0; i < rounds; i++) {
+        base64::encode(data.data(), size, text.data());
+    }
+    double table = seconds() - start;
+    printf("bench: encode 1 MiB  libb64 %6.0f MB/s  base64 %6.0f MB/s\n", rounds * size / libb64 / 1e6, rounds * size / table / 1e6);
+
+    start = seconds();
+    for(int i = 0; i < rounds; i++) {
+        base64_decode_chars(text.data(), length, (char *)back.data());
+    }
+    libb64 = seconds() - start;
+    start = seconds();
+    for(int i = 0; i < rounds; i++) {
+        base64::decode(text.data(), length, back.data());
+    }
+    table = seconds() - start;
+    printf("bench: decode 1 MiB  libb64 %6.0f MB/s  base64 %6.0f MB/s\n", rounds * size / libb64 / 1e6, rounds * size / table / 1e6);
+    CHECK(!memcmp(back.data(), data.data(), size), "round trip");
+}
+
+int main(int argc, char **argv)
+{
+    testVectors();
+    testRandom();
+    if(argc > 1 && !strcmp(argv[1], "bench")) {
+        bench();
+    }
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
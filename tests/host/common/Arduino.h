@@ -0,0 +1,21 @@
+/*
+ * The little of Arduino.h that the code under test needs on the host
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+#include "esp32-hal.h"
+#include "esp32-hal-log.h"
+
+typedef bool boolean;
+
+#ifdef __cplusplus
+#include "WString.h"
+#include "Stream.h"
+#endif
@@ -0,0 +1,17 @@
+/*
+ * Log macros of the core on the host
+ */
+#pragma once
+
+#include <stdio.h>
+
+// errors are expected by the tests that feed bad input, make LOG=1 shows them
+#ifdef HOST_TEST_LOG
+#define log_e(format, ...) fprintf(stderr, "[E] %s(): " format "\n", __FUNCTION__, ##__VA_ARGS__)
+#define log_w(format, ...) fprintf(stderr, "[W] %s(): " format "\n", __FUNCTION__, ##__VA_ARGS__)
+#else
+#define log_e(format, ...) do {} while(0)
+#define log_w(format, ...) do {} while(0)
+#endif
+#define log_d(format, ...) do {} while(0)
+#define log_v(format, ...) do {} while(0)
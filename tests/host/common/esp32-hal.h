@@ -0,0 +1,33 @@
+/*
+ * The little of esp32-hal.h that the core C code under test needs on the host
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp32-hal-log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// core is recorded in the task, tasks are not pinned on the host
+BaseType_t xTaskCreateUniversal(TaskFunction_t pxTaskCode,
+                        const char * const pcName,
+                        const uint32_t usStackDepth,
+                        void * const pvParameters,
+                        UBaseType_t uxPriority,
+                        TaskHandle_t * const pxCreatedTask,
+                        const BaseType_t xCoreID);
+
+void yield(void);
+unsigned long millis();
+void delay(uint32_t);
+
+#ifdef __cplusplus
+}
+#endif
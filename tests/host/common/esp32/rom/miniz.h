@@ -0,0 +1,127 @@
+/*
+ * tinfl on top of the host zlib
+ *
+ * The inflater in ROM is not available on the host, so this keeps its
+ * interface and its contract: without TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF
+ * the output goes to a TINFL_LZ_DICT_SIZE ring that the caller advances and
+ * wraps, each call continuing right where the last one stopped. Calls that
+ * break the contract fail with TINFL_STATUS_BAD_PARAM, and tinfl_host_wraps
+ * counts how often the caller went back to the start.
+ * zlib allocates from an arena inside the decompressor, so freeing that frees
+ * everything, as with the real one.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <zlib.h>
+
+typedef unsigned char mz_uint8;
+typedef uint32_t mz_uint32;
+
+enum {
+    TINFL_FLAG_PARSE_ZLIB_HEADER = 1,
+    TINFL_FLAG_HAS_MORE_INPUT = 2,
+    TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF = 4,
+    TINFL_FLAG_COMPUTE_ADLER32 = 8
+};
+
+#define TINFL_LZ_DICT_SIZE 32768
+
+typedef enum {
+    TINFL_STATUS_BAD_PARAM = -3,
+    TINFL_STATUS_ADLER32_MISMATCH = -2,
+    TINFL_STATUS_FAILED = -1,
+    TINFL_STATUS_DONE = 0,
+    TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+    TINFL_STATUS_HAS_MORE_OUTPUT = 2
+} tinfl_status;
+
+typedef struct {
+    int m_state;            // 0 before the first call, 1 inflating, 2 done
+    z_stream stream;
+    const mz_uint8 *end;    // where the previous call stopped writing
+    size_t used;
+    mz_uint8 arena[48 * 1024] __attribute__((aligned(16)));
+} tinfl_decompressor;
+
+#define tinfl_init(r) do { (r)->m_state = 0; } while(0)
+
+// defined by the test
+extern size_t tinfl_host_wraps;
+
+static inline voidpf tinfl_host_alloc(voidpf opaque, uInt items, uInt size)
+{
+    tinfl_decompressor *r = (tinfl_decompressor *)opaque;
+    size_t bytes = ((size_t)items * size + 15) & ~(size_t)15;
+    if(r->used + bytes > sizeof(r->arena)) {
+        return Z_NULL;
+    }
+    r->used += bytes;
+    return r->arena + r->used - bytes;
+}
+
+static inline void tinfl_host_free(voidpf opaque, voidpf address)
+{
+    (void)opaque;
+    (void)address;
+}
+
+static inline tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_next, size_t *pIn_buf_size,
+    mz_uint8 *pOut_buf_start, mz_uint8 *pOut_buf_next, size_t *pOut_buf_size, const mz_uint32 decomp_flags)
+{
+    if(!(decomp_flags & TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF)
+        && (pOut_buf_next < pOut_buf_start || !*pOut_buf_size
+            || pOut_buf_next + *pOut_buf_size > pOut_buf_start + TINFL_LZ_DICT_SIZE)) {
+        *pIn_buf_size = 0;
+        *pOut_buf_size = 0;
+        return TINFL_STATUS_BAD_PARAM;
+    }
+    if(r->m_state == 0) {
+        memset(&r->stream, 0, sizeof(r->stream));
+        r->stream.zalloc = tinfl_host_alloc;
+        r->stream.zfree = tinfl_host_free;
+        r->stream.opaque = r;
+        r->used = 0;
+        r->end = pOut_buf_next;
+        if(inflateInit2(&r->stream, (decomp_flags & TINFL_FLAG_PARSE_ZLIB_HEADER) ? 15 : -15) != Z_OK) {
+            return TINFL_STATUS_FAILED;
+        }
+        r->m_state = 1;
+    }
+    if(r->m_state == 2) {
+        *pIn_buf_size = 0;
+        *pOut_buf_size = 0;
+        return TINFL_STATUS_DONE;
+    }
+    if(!(decomp_flags & TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF) && pOut_buf_next != r->end) {
+        if(pOut_buf_next != pOut_buf_start || r->end != pOut_buf_start + TINFL_LZ_DICT_SIZE) {
+            *pIn_buf_size = 0;
+            *pOut_buf_size = 0;
+            return TINFL_STATUS_BAD_PARAM;
+        }
+        tinfl_host_wraps++;
+    }
+
+    r->stream.next_in = (Bytef *)pIn_buf_next;
+    r->stream.avail_in = *pIn_buf_size;
+    r->stream.next_out = pOut_buf_next;
+    r->stream.avail_out = *pOut_buf_size;
+    int status = inflate(&r->stream, Z_NO_FLUSH);
+    *pIn_buf_size -= r->stream.avail_in;
+    *pOut_buf_size -= r->stream.avail_out;
+    r->end = pOut_buf_next + *pOut_buf_size;
+
+    if(status == Z_STREAM_END) {
+        r->m_state = 2;
+        return TINFL_STATUS_DONE;
+    }
+    if(status != Z_OK && status != Z_BUF_ERROR) {
+        return TINFL_STATUS_FAILED;
+    }
+    if(!r->stream.avail_out) {
+        return TINFL_STATUS_HAS_MORE_OUTPUT;
+    }
+    return (decomp_flags & TINFL_FLAG_HAS_MORE_INPUT) ? TINFL_STATUS_NEEDS_MORE_INPUT : TINFL_STATUS_FAILED;
+}
@@ -0,0 +1,4 @@
+/*
+ * Included by stdlib_noniso.c, which needs nothing from it on the host
+ */
+#pragma once
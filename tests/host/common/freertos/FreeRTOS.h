@@ -0,0 +1,48 @@
+/*
+ * FreeRTOS on the host, just enough for the core code that only uses
+ * tasks, semaphores and critical sections. Tasks are pthreads, critical
+ * sections one global mutex per portMUX_TYPE, and "ISR context" is a flag
+ * the test sets on its own thread with hostSetIsrContext().
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE         0
+#define pdTRUE          1
+#define pdPASS          pdTRUE
+#define pdFAIL          pdFALSE
+#define portMAX_DELAY   ((TickType_t)0xFFFFFFFF)
+#define portTICK_PERIOD_MS 1
+
+// one core by default, like the ESP32-S2 and C3
+#ifndef portNUM_PROCESSORS
+#define portNUM_PROCESSORS 1
+#endif
+
+typedef pthread_mutex_t portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED PTHREAD_MUTEX_INITIALIZER
+
+#define portENTER_CRITICAL(mux)         pthread_mutex_lock(mux)
+#define portEXIT_CRITICAL(mux)          pthread_mutex_unlock(mux)
+#define portENTER_CRITICAL_SAFE(mux)    pthread_mutex_lock(mux)
+#define portEXIT_CRITICAL_SAFE(mux)     pthread_mutex_unlock(mux)
+#define portYIELD_FROM_ISR()            do {} while(0)
+
+BaseType_t xPortInIsrContext(void);
+void hostSetIsrContext(bool isr);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,34 @@
+/*
+ * FreeRTOS tasks on the host, see FreeRTOS.h
+ */
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*TaskFunction_t)(void * arg);
+
+// what the task was created with, priority follows vTaskPrioritySet()
+typedef struct host_task_s {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void * arg;
+    char name[16];
+    uint32_t stack_size;
+    volatile UBaseType_t priority;
+    BaseType_t core;
+} * TaskHandle_t;
+
+// NULL on threads that were not created as tasks
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t priority);
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+
+#ifdef __cplusplus
+}
+#endif
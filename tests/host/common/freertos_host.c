@@ -0,0 +1,198 @@
+/*
+ * FreeRTOS tasks and semaphores on pthreads, see freertos/FreeRTOS.h, and the
+ * time functions of esp32-hal.h
+ */
+
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "esp32-hal.h"
+#include "freertos/semphr.h"
+
+struct host_semaphore_s {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    UBaseType_t count;
+    UBaseType_t max;
+};
+
+static __thread bool s_in_isr;
+static __thread TaskHandle_t s_current;
+
+BaseType_t xPortInIsrContext(void)
+{
+    return s_in_isr;
+}
+
+void hostSetIsrContext(bool isr)
+{
+    s_in_isr = isr;
+}
+
+/*
+ * Tasks
+ */
+
+static void * taskMain(void * arg)
+{
+    TaskHandle_t task = (TaskHandle_t)arg;
+    s_current = task;
+    task->fn(task->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreateUniversal(TaskFunction_t pxTaskCode, const char * const pcName, const uint32_t usStackDepth,
+                                void * const pvParameters, UBaseType_t uxPriority, TaskHandle_t * const pxCreatedTask,
+                                const BaseType_t xCoreID)
+{
+    TaskHandle_t task = (TaskHandle_t)calloc(1, sizeof(*task));
+    if (!task) {
+        return pdFAIL;
+    }
+    task->fn = pxTaskCode;
+    task->arg = pvParameters;
+    strncpy(task->name, pcName, sizeof(task->name) - 1);
+    task->stack_size = usStackDepth;
+    task->priority = uxPriority;
+    task->core = xCoreID;
+    // tasks run until the process exits, like workers that are never deleted
+    if (pthread_create(&task->thread, NULL, taskMain, task)) {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    if (pxCreatedTask) {
+        *pxCreatedTask = task;
+    }
+    return pdPASS;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return s_current;
+}
+
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t priority)
+{
+    if (!task) {
+        task = s_current;
+    }
+    if (task) {
+        task->priority = priority;
+    }
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task)
+{
+    if (!task) {
+        task = s_current;
+    }
+    return task ? task->priority : 0;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    usleep(ticks * 1000);
+}
+
+/*
+ * Time, see esp32-hal.h
+ */
+
+unsigned long millis()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000UL + now.tv_nsec / 1000000;
+}
+
+void delay(uint32_t ms)
+{
+    usleep(ms * 1000);
+}
+
+void yield(void)
+{
+    sched_yield();
+}
+
+/*
+ * Semaphores
+ */
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+    SemaphoreHandle_t semaphore = (SemaphoreHandle_t)calloc(1, sizeof(*semaphore));
+    if (semaphore) {
+        pthread_mutex_init(&semaphore->mutex, NULL);
+        pthread_cond_init(&semaphore->cond, NULL);
+        semaphore->count = initial;
+        semaphore->max = max;
+    }
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    pthread_cond_destroy(&semaphore->cond);
+    pthread_mutex_destroy(&semaphore->mutex);
+    free(semaphore);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += ticks / 1000;
+    deadline.tv_nsec += (long)(ticks % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    BaseType_t taken = pdTRUE;
+    pthread_mutex_lock(&semaphore->mutex);
+    while (!semaphore->count) {
+        if (ticks == portMAX_DELAY) {
+            pthread_cond_wait(&semaphore->cond, &semaphore->mutex);
+        } else if (pthread_cond_timedwait(&semaphore->cond, &semaphore->mutex, &deadline) == ETIMEDOUT) {
+            taken = pdFALSE;
+            break;
+        }
+    }
+    if (taken) {
+        semaphore->count--;
+    }
+    pthread_mutex_unlock(&semaphore->mutex);
+    return taken;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    BaseType_t given = pdFALSE;
+    pthread_mutex_lock(&semaphore->mutex);
+    if (semaphore->count < semaphore->max) {
+        semaphore->count++;
+        given = pdTRUE;
+        pthread_cond_signal(&semaphore->cond);
+    }
+    pthread_mutex_unlock(&semaphore->mutex);
+    return given;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t * woken)
+{
+    if (woken) {
+        *woken = pdFALSE;
+    }
+    return xSemaphoreGive(semaphore);
+}
@@ -0,0 +1,15 @@
+/*
+ * The non standard parts of newlib that the core relies on and glibc lacks
+ */
+
+#include "stdlib_noniso.h"
+
+char* itoa(int val, char *s, int radix)
+{
+    return ltoa(val, s, radix);
+}
+
+char* utoa(unsigned int val, char *s, int radix)
+{
+    return ultoa(val, s, radix);
+}
@@ -0,0 +1,6 @@
+/*
+ * Host tests build the target independent code as if for the ESP32
+ */
+#pragma once
+
+#define CONFIG_IDF_TARGET_ESP32 1
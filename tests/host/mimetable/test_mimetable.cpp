@@ -0,0 +1,193 @@
+/*
+ * Host test of mime::getContentType and mime::registerType
+ *
+ *   test_mimetable [bench]
+ *
+ * Compares the sorted table lookup with the suffix scan over mimeTable that
+ * StaticRequestHandler used before, on random paths built from every known
+ * extension, unknown ones, dotted directories, hidden files and extensions
+ * too long to match. Paths in lowercase must get the same type as from the
+ * scan, other paths the type the scan gives for their lowercase form.
+ * Then checks registered types override, extend and stay sorted. "bench"
+ * times both lookups.
+ */
+
+#include "mimetable.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <random>
+#include <string>
+#include <vector>
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+    if(!(cond)) { \
+        failures++; \
+        printf("FAIL %s:%d: %s: ", __FILE__, __LINE__, #cond); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+    } \
+} while(0)
+
+static double seconds()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// what StaticRequestHandler::getContentType did before the sorted table
+static const char *suffixScan(const std::string &path)
+{
+    for(size_t i = 0; i < mime::maxType - 1; i++) {
+        size_t len = strlen(mime::mimeTable[i].endsWith);
+        if(path.size() >= len && !path.compare(path.size() - len, len, mime::mimeTable[i].endsWith)) {
+            return mime::mimeTable[i].mimeType;
+        }
+    }
+    return mime::mimeTable[mime::maxType - 1].mimeType;
+}
+
+static std::string lower(std::string s)
+{
+    for(auto &c : s) {
+        c = tolower((unsigned char)c);
+    }
+    return s;
+}
+
+static std::mt19937 rng(13);
+
+static std::string mixCase(std::string s)
+{
+    for(auto &c : s) {
+        if(rng() % 3 == 0) {
+            c = toupper((unsigned char)c);
+        }
+    }
+    return s;
+}
+
+static std::string randomPath()
+{
+    static const char *dirs[] = { "", "/", "/www/", "/v1.2/", "/a.b.c/", "/.hidden/", "/site.html/", "/img.png/x/" };
+    static const char *names[] = { "index", "logo", "a", "", ".", "archive.tar", "min.js", "file.", "x.y.z" };
+    static const char *unknown[] = { "webp", "wasm", "h", "tml", "xhtml", "jsx", "gzip", "woff3", "c", "averyveryverylongextension", "" };
+
+    std::string path = dirs[rng() % (sizeof(dirs) / sizeof(dirs[0]))];
+    path += names[rng() % (sizeof(names) / sizeof(names[0]))];
+    switch(rng() % 4) {
+    case 0:
+        break;
+    case 1:
+        path += "." + std::string(unknown[rng() % (sizeof(unknown) / sizeof(unknown[0]))]);
+        break;
+    default:
+        path += mime::mimeTable[rng() % (mime::maxType - 1)].endsWith;
+        break;
+    }
+    return (rng() % 2) ? mixCase(path) : path;
+}
+
+static void testLookup()
+{
+    for(int round = 0; round < 200000; round++) {
+        std::string path = randomPath();
+        const char *type = mime::getContentType(path.c_str());
+        const char *expected = suffixScan(lower(path));
+        CHECK(!strcmp(type, expected), "\"%s\" is %s, the scan of its lowercase form %s", path.c_str(), type, expected);
+        if(path == lower(path)) {
+            CHECK(!strcmp(type, suffixScan(path)), "\"%s\" differs from the scan", path.c_str());
+        }
+    }
+
+    // every built in type, and the cases the scan got wrong
+    for(size_t i = 0; i < mime::maxType - 1; i++) {
+        std::string path = std::string("/dir/file") + mime::mimeTable[i].endsWith;
+        CHECK(!strcmp(mime::getContentType(path.c_str()), mime::mimeTable[i].mimeType), "%s", path.c_str());
+    }
+    CHECK(!strcmp(mime::getContentType("/LOGO.JPG"), "image/jpeg"), "upper case extension");
+    CHECK(!strcmp(mime::getContentType("/Index.Html"), "text/html"), "mixed case extension");
+    CHECK(!strcmp(mime::getContentType("/v1.2/readme"), "application/octet-stream"), "dot in a directory");
+    CHECK(!strcmp(mime::getContentType("/site.css/"), "application/octet-stream"), "directory ending in an extension");
+    CHECK(!strcmp(mime::getContentType(""), "application/octet-stream"), "empty path");
+    printf("lookup ok\n");
+}
+
+static void testRegister()
+{
+    CHECK(!strcmp(mime::getContentType("/a.webp"), "application/octet-stream"), "webp before registerType");
+    CHECK(mime::registerType(".webp", "image/webp"), "register .webp");
+    CHECK(mime::registerType("WASM", "application/wasm"), "register WASM");
+    CHECK(mime::registerType("txt", "text/plain; charset=utf-8"), "override txt");
+    CHECK(mime::registerType("avif", "image/avif"), "register avif");
+    CHECK(mime::registerType(".webp", "image/webp2"), "replace webp");
+    CHECK(!mime::registerType(".", "x/y"), "empty extension");
+    CHECK(!mime::registerType("averyveryverylongextension", "x/y"), "extension too long");
+    CHECK(!mime::registerType(NULL, "x/y") && !mime::registerType("x", NULL), "null arguments");
+
+    CHECK(!strcmp(mime::getContentType("/A.WEBP"), "image/webp2"), "registered webp");
+    CHECK(!strcmp(mime::getContentType("/app.wasm"), "application/wasm"), "registered wasm");
+    CHECK(!strcmp(mime::getContentType("/readme.txt"), "text/plain; charset=utf-8"), "overridden txt");
+    CHECK(!strcmp(mime::getContentType("/x.avif"), "image/avif"), "registered avif");
+    CHECK(!strcmp(mime::getContentType("/x.css"), "text/css"), "built in css with registered types");
+    CHECK(!strcmp(mime::getContentType("/x.bmp"), "application/octet-stream"), "unknown with registered types");
+
+    // many more, in an order that inserts at both ends and in the middle
+    for(int i = 0; i < 200; i++) {
+        char extension[8], type[16];
+        snprintf(extension, sizeof(extension), "e%03d", (i * 37) % 200);
+        snprintf(type, sizeof(type), "x/%03d", (i * 37) % 200);
+        CHECK(mime::registerType(extension, type), "register %s", extension);
+    }
+    for(int i = 0; i < 200; i++) {
+        char path[16], type[16];
+        snprintf(path, sizeof(path), "/f.E%03d", i);
+        snprintf(type, sizeof(type), "x/%03d", i);
+        CHECK(!strcmp(mime::getContentType(path), type), "%s", path);
+    }
+    CHECK(!strcmp(mime::getContentType("/A.WEBP"), "image/webp2"), "webp after more types");
+    printf("register ok\n");
+}
+
+static void bench()
+{
+    std::vector<std::string> paths;
+    for(int i = 0; i < 1000; i++) {
+        paths.push_back(randomPath());
+    }
+    const int rounds = 1000;
+    size_t sink = 0;
+    double start = seconds();
+    for(int r = 0; r < rounds; r++) {
+        for(const auto &path : paths) {
+            sink += (size_t)suffixScan(path);
+        }
+    }
+    double scan = seconds() - start;
+    start = seconds();
+    for(int r = 0; r < rounds; r++) {
+        for(const auto &path : paths) {
+            sink += (size_t)mime::getContentType(path.c_str());
+        }
+    }
+    double table = seconds() - start;
+    printf("bench: suffix scan %.0f ns, sorted table %.0f ns per path (%zu)\n",
+           scan / rounds / paths.size() * 1e9, table / rounds / paths.size() * 1e9, sink & 1);
+}
+
+int main(int argc, char **argv)
+{
+    testLookup();
+    if(argc > 1 && !strcmp(argv[1], "bench")) {
+        bench();
+    }
+    testRegister();
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,406 @@
+/*
+ * Host test of the number formatting in numfmt.c and Print
+ *
+ *   test_numfmt [bench]
+ *
+ * Integers in every base are compared with snprintf, or a plain division
+ * loop for the bases printf has no conversion for. Fixed decimals must
+ * match the digit loop Print::printFloat used before, character for
+ * character, and be within one unit of the last digit of snprintf("%.*f").
+ * Shortest output must read back as the same double or float, have no more
+ * than 17 (9) significant digits, and use the exponent only outside
+ * 1e-6 .. 1e21; all but a few in a thousand must be as short as the
+ * shortest "%.*g" that reads back. Print is driven through a sink with
+ * and without writeBuffer(), including print(long double). "bench" times
+ * the conversions against snprintf.
+ */
+
+#include "Arduino.h"
+#include "numfmt.h"
+
+#include <float.h>
+#include <inttypes.h>
+#include <math.h>
+#include <time.h>
+#include <random>
+#include <string>
+#include <vector>
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+    if(!(cond)) { \
+        failures++; \
+        printf("FAIL %s:%d: %s: ", __FILE__, __LINE__, #cond); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+    } \
+} while(0)
+
+static double seconds()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static std::mt19937_64 rng(17);
+
+// values with every magnitude, not only large ones
+static uint64_t randomU64()
+{
+    return rng() >> (rng() % 64);
+}
+
+static double randomDouble()
+{
+    switch(rng() % 4) {
+    case 0: {
+        // any bit pattern, special values included
+        uint64_t bits = rng();
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        return d;
+    }
+    case 1:
+        return std::uniform_real_distribution<double>(-1e6, 1e6)(rng);
+    case 2:
+        // a few decimals, as in sensor readings
+        return (double)((int64_t)(rng() % 2000001) - 1000000) / std::pow(10.0, (double)(rng() % 5));
+    default:
+        return std::ldexp(std::uniform_real_distribution<double>(-1, 1)(rng), (int)(rng() % 200) - 100);
+    }
+}
+
+/*
+  Integers
+*/
+
+static std::string divisionLoop(uint64_t value, unsigned base)
+{
+    std::string s;
+    do {
+        s.insert(s.begin(), "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ"[value % base]);
+        value /= base;
+    } while(value);
+    return s;
+}
+
+static void testIntegers()
+{
+    char buf[NUMFMT_BASE_SIZE], ref[NUMFMT_BASE_SIZE];
+    static const uint64_t edges[] = { 0, 1, 9, 10, 99, 100, 4294967295ULL, 4294967296ULL, 9999999999ULL, 10000000000ULL, UINT64_MAX };
+    for(int round = 0; round < 500000; round++) {
+        uint64_t value = (round < (int)(sizeof(edges) / sizeof(edges[0]))) ? edges[round] : randomU64();
+
+        uint32_t small = (uint32_t)value;
+        size_t len = numfmt_u32(buf, small);
+        snprintf(ref, sizeof(ref), "%" PRIu32, small);
+        CHECK(len == strlen(ref) && !strcmp(buf, ref), "u32 %s gave %s", ref, buf);
+
+        len = numfmt_u64(buf, value);
+        snprintf(ref, sizeof(ref), "%" PRIu64, value);
+        CHECK(len == strlen(ref) && !strcmp(buf, ref), "u64 %s gave %s", ref, buf);
+
+        len = numfmt_base(buf, value, 16);
+        snprintf(ref, sizeof(ref), "%" PRIX64, value);
+        CHECK(len == strlen(ref) && !strcmp(buf, ref), "hex %s gave %s", ref, buf);
+        len = numfmt_base(buf, value, 8);
+        snprintf(ref, sizeof(ref), "%" PRIo64, value);
+        CHECK(len == strlen(ref) && !strcmp(buf, ref), "octal %s gave %s", ref, buf);
+
+        unsigned base = 2 + rng() % 35;
+        len = numfmt_base(buf, value, base);
+        std::string expected = divisionLoop(value, base);
+        CHECK(len == expected.size() && buf == expected, "%" PRIu64 " in base %u gave %s", value, base, buf);
+    }
+    numfmt_base(buf, 1234, 0);
+    CHECK(!strcmp(buf, "1234"), "base 0 gave %s", buf);
+    numfmt_base(buf, 1234, 1);
+    CHECK(!strcmp(buf, "1234"), "base 1 gave %s", buf);
+    printf("integers ok\n");
+}
+
+/*
+  Fixed decimals
+*/
+
+// Print::printFloat before numfmt, with a 32 bit unsigned long as on the target
+static std::string oldPrintFloat(double number, uint8_t digits)
+{
+    if(std::isnan(number)) {
+        return "nan";
+    }
+    if(std::isinf(number)) {
+        return "inf";
+    }
+    if(number > 4294967040.0 || number < -4294967040.0) {
+        return "ovf";
+    }
+    std::string s;
+    if(number < 0.0) {
+        s += '-';
+        number = -number;
+    }
+    double rounding = 0.5;
+    for(uint8_t i = 0; i < digits; ++i) {
+        rounding /= 10.0;
+    }
+    number += rounding;
+    uint32_t int_part = (uint32_t)number;
+    double remainder = number - (double)int_part;
+    s += std::to_string(int_part);
+    if(digits > 0) {
+        s += ".";
+    }
+    while(digits-- > 0) {
+        remainder *= 10.0;
+        int toPrint = int(remainder);
+        s += std::to_string(toPrint);
+        remainder -= toPrint;
+    }
+    return s;
+}
+
+static void testFixed()
+{
+    char buf[NUMFMT_FIXED_SIZE(UINT8_MAX)], ref[400];
+    for(int round = 0; round < 500000; round++) {
+        double value = randomDouble();
+        uint8_t digits = (round % 100) ? rng() % 8 : rng() % 256;
+        size_t len = numfmt_fixed(buf, value, digits);
+        std::string expected = oldPrintFloat(value, digits);
+        CHECK(len == expected.size() && buf == expected, "%.17g with %u digits gave %s, printFloat %s", value, digits, buf, expected.c_str());
+
+        if(std::isfinite(value) && fabs(value) <= 4294967040.0 && digits <= 9) {
+            snprintf(ref, sizeof(ref), "%.*f", digits, value);
+            double unit = std::pow(10.0, -digits);
+            double diff = fabs(strtod(buf, NULL) - strtod(ref, NULL));
+            CHECK(diff <= unit * 1.001 + fabs(value) * 4 * DBL_EPSILON, "%.17g with %u digits gave %s, snprintf %s", value, digits, buf, ref);
+        }
+    }
+    printf("fixed ok\n");
+}
+
+/*
+  Shortest
+*/
+
+static int significantDigits(const char *s)
+{
+    int count = 0;
+    bool leading = true;
+    for(; *s && *s != 'e'; s++) {
+        if(*s >= '1' && *s <= '9') {
+            leading = false;
+        }
+        if(*s >= '0' && *s <= '9' && !leading) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static int shortestPrecision(double value, bool single)
+{
+    char ref[64];
+    for(int precision = 1; precision < 17; precision++) {
+        snprintf(ref, sizeof(ref), "%.*g", precision, value);
+        if(single ? (strtof(ref, NULL) == (float)value) : (strtod(ref, NULL) == value)) {
+            return precision;
+        }
+    }
+    return 17;
+}
+
+static void checkShortest(double value, bool single, int &longer)
+{
+    char buf[NUMFMT_SHORTEST_SIZE];
+    size_t len = single ? numfmt_shortest_f(buf, (float)value) : numfmt_shortest(buf, value);
+    CHECK(len == strlen(buf) && len < NUMFMT_SHORTEST_SIZE, "%.17g gave %zu characters", value, len);
+    if(std::isnan(value)) {
+        CHECK(!strcmp(buf, "nan"), "nan gave %s", buf);
+        return;
+    }
+    if(std::isinf(value)) {
+        CHECK(!strcmp(buf, value < 0 ? "-inf" : "inf"), "%g gave %s", value, buf);
+        return;
+    }
+    bool back = single ? (strtof(buf, NULL) == (float)value) : (strtod(buf, NULL) == value);
+    CHECK(back && std::signbit(value) == (buf[0] == '-'), "%.17g%s gave %s", value, single ? "f" : "", buf);
+
+    double magnitude = fabs(value);
+    if(magnitude) {
+        // trailing zeros of large integers are padding, not digits
+        std::string mantissa(buf, strcspn(buf, "e"));
+        if(!strchr(mantissa.c_str(), '.')) {
+            mantissa.erase(mantissa.find_last_not_of('0') + 1);
+        }
+        int digits = significantDigits(mantissa.c_str());
+        int shortest = shortestPrecision(value, single);
+        // never more than it takes to tell any two values apart
+        CHECK(digits <= (single ? 9 : 17), "%.17g%s gave %d digits", value, single ? "f" : "", digits);
+        if(digits > shortest) {
+            longer++;
+        }
+        bool exponent = strchr(buf, 'e');
+        if(magnitude >= 1e-5 && magnitude < 1e20) {
+            CHECK(!exponent, "%.17g%s gave %s", value, single ? "f" : "", buf);
+        } else if(magnitude < 1e-7 || magnitude >= 1e22) {
+            CHECK(exponent, "%.17g%s gave %s", value, single ? "f" : "", buf);
+        }
+    }
+}
+
+static void testShortest()
+{
+    static const double edges[] = { 0.0, -0.0, 0.1, 0.3, 1.0 / 3, 5e-324, 2.2250738585072014e-308, DBL_MAX, 1e21, 1e-6, 1e-7,
+                                    123456789012345678.0, 9007199254740993.0, NAN, INFINITY, -INFINITY };
+    int longer = 0;
+    const int rounds = 300000;
+    for(int round = 0; round < rounds; round++) {
+        bool edge = round < (int)(sizeof(edges) / sizeof(edges[0]));
+        double value = edge ? edges[round] : randomDouble();
+        checkShortest(value, false, longer);
+        if(edge || fabs(value) <= FLT_MAX) {
+            checkShortest((float)value, true, longer);
+        }
+    }
+    // Grisu2 keeps clear of the ends of the rounding interval, so when the
+    // shortest string lies at or very near one of them it gives a longer one
+    CHECK(longer < rounds / 200, "%d of %d not shortest", longer, 2 * rounds);
+
+    char buf[NUMFMT_SHORTEST_SIZE];
+    numfmt_shortest_f(buf, 0.1f);
+    CHECK(!strcmp(buf, "0.1"), "0.1f gave %s", buf);
+    numfmt_shortest(buf, 1.5e-7);
+    CHECK(!strcmp(buf, "1.5e-7"), "1.5e-7 gave %s", buf);
+    numfmt_shortest(buf, 1e21);
+    CHECK(!strcmp(buf, "1e21"), "1e21 gave %s", buf);
+    numfmt_shortest(buf, -0.0);
+    CHECK(!strcmp(buf, "-0"), "-0.0 gave %s", buf);
+    printf("shortest ok (%d of %d longer than needed)\n", longer, 2 * rounds);
+}
+
+/*
+  Print
+*/
+
+// a Print that formats in place when buffered is set
+class Sink : public Print
+{
+public:
+    Sink(bool buffered) : _buffered(buffered) {}
+
+    size_t write(uint8_t c) override
+    {
+        text.push_back(c);
+        return 1;
+    }
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        text.append((const char *)buffer, size);
+        return size;
+    }
+    using Print::write;
+
+    char *writeBuffer(size_t size) override
+    {
+        if(!_buffered) {
+            return NULL;
+        }
+        _room.resize(size);
+        return &_room[0];
+    }
+    void writeCommit(size_t size) override
+    {
+        text.append(_room.data(), size);
+    }
+
+    std::string text;
+
+private:
+    bool _buffered;
+    std::string _room;
+};
+
+static void testPrint()
+{
+    for(bool buffered : { false, true }) {
+        Sink sink(buffered);
+        sink.print(-1234567890L);
+        sink.print(' ');
+        sink.print(0xBEEFu, HEX);
+        sink.print(' ');
+        sink.print(18446744073709551615ULL);
+        sink.print(' ');
+        sink.print(1.999, 2);
+        sink.print(' ');
+        sink.print(0.1f, -1);
+        sink.print(' ');
+        sink.print(0.1, -1);
+        sink.print(' ');
+        sink.print(2.5L);
+        sink.print(' ');
+        sink.print(1.0L / 3, -1);
+        sink.print(' ');
+        sink.println(3.26L, 1);
+        CHECK(sink.text == "-1234567890 BEEF 18446744073709551615 2.00 0.1 0.1 2.50 0.3333333333333333 3.3\r\n",
+              "%s sink printed \"%s\"", buffered ? "buffered" : "plain", sink.text.c_str());
+    }
+    printf("print ok\n");
+}
+
+/*
+  Benchmark against snprintf
+*/
+
+template<typename F>
+static double nsPer(int count, F f)
+{
+    double start = seconds();
+    for(int i = 0; i < count; i++) {
+        f(i);
+    }
+    return (seconds() - start) / count * 1e9;
+}
+
+static void bench()
+{
+    const int count = 1000000;
+    std::vector<uint32_t> ints(1024);
+    std::vector<double> doubles(1024);
+    for(size_t i = 0; i < ints.size(); i++) {
+        ints[i] = (uint32_t)randomU64();
+        doubles[i] = std::uniform_real_distribution<double>(-1000, 1000)(rng);
+    }
+    char buf[64];
+    size_t sink = 0;
+
+    double ours = nsPer(count, [&](int i) { sink += numfmt_u32(buf, ints[i & 1023]); });
+    double ref = nsPer(count, [&](int i) { sink += snprintf(buf, sizeof(buf), "%" PRIu32, ints[i & 1023]); });
+    printf("bench: u32          numfmt %5.1f ns  snprintf %5.1f ns\n", ours, ref);
+
+    ours = nsPer(count, [&](int i) { sink += numfmt_fixed(buf, doubles[i & 1023], 2); });
+    ref = nsPer(count, [&](int i) { sink += snprintf(buf, sizeof(buf), "%.2f", doubles[i & 1023]); });
+    double old = nsPer(count, [&](int i) { sink += oldPrintFloat(doubles[i & 1023], 2).size(); });
+    printf("bench: fixed 2      numfmt %5.1f ns  snprintf %5.1f ns  old printFloat digit loop %5.1f ns\n", ours, ref, old);
+
+    ours = nsPer(count, [&](int i) { sink += numfmt_shortest(buf, doubles[i & 1023]); });
+    ref = nsPer(count, [&](int i) { sink += snprintf(buf, sizeof(buf), "%.17g", doubles[i & 1023]); });
+    printf("bench: shortest     numfmt %5.1f ns  snprintf %%.17g %5.1f ns (%zu)\n", ours, ref, sink & 1);
+}
+
+int main(int argc, char **argv)
+{
+    testIntegers();
+    testFixed();
+    testShortest();
+    testPrint();
+    if(argc > 1 && !strcmp(argv[1], "bench")) {
+        bench();
+    }
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,424 @@
+/*
+ * Host test of the RMT pulse decoders in esp32-hal-rmt-decode.c
+ *
+ *   test_rmt_decode
+ *
+ * Builds symbol traces the way the RMT receiver stores them (pairs of level
+ * and duration in ticks, ended by a zero duration or a long idle) for NEC,
+ * RC5, DHT and 1-Wire, at two tick lengths and both receiver polarities.
+ * Every frame must decode as sent, also with the marks stretched and the
+ * spaces shortened as IR receivers do and with random jitter inside the
+ * tolerance. Glitches, pulses out of tolerance, bad checksums and truncated
+ * frames must be rejected, and NEC with jitter beyond the tolerance must
+ * never decode to a different frame.
+ */
+
+#include "esp32-hal-rmt-decode.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <random>
+#include <vector>
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+    if(!(cond)) { \
+        failures++; \
+        printf("FAIL %s:%d: %s: ", __FILE__, __LINE__, #cond); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+    } \
+} while(0)
+
+static std::mt19937 rng(11);
+
+/*
+  Traces
+*/
+
+// durations in microseconds, packed into RMT items at the given tick
+class Trace
+{
+public:
+    Trace(float tick_ns, bool markLevel, float markSkew = 0, float jitter = 0) :
+        tick(tick_ns), mark(markLevel), skew(markSkew), noise(jitter) {}
+
+    void add(bool isMark, float us)
+    {
+        if(isMark) {
+            us += skew;
+        } else {
+            us -= skew;
+        }
+        if(noise) {
+            us *= 1 + std::uniform_real_distribution<float>(-noise, noise)(rng);
+        }
+        push(isMark ? mark : !mark, std::min(32767.0f, us * 1000 / tick));
+    }
+
+    // what the receiver appends once the line stays idle
+    void end()
+    {
+        push(!mark, 0);
+    }
+
+    void push(bool level, uint32_t ticks)
+    {
+        if(half) {
+            items.back().level1 = level;
+            items.back().duration1 = ticks;
+        } else {
+            rmt_data_t item;
+            item.val = 0;
+            item.level0 = level;
+            item.duration0 = ticks;
+            items.push_back(item);
+        }
+        half = !half;
+    }
+
+    std::vector<rmt_data_t> items;
+    float tick;
+
+private:
+    bool mark;
+    float skew;
+    float noise;
+    bool half = false;
+};
+
+struct Variant {
+    float tick_ns;
+    bool markLevel;
+    float skew;
+};
+
+// 1 us and 0.5 us ticks, active low and active high receivers, and IR
+// receivers that stretch or shorten the marks by 60 us
+static const Variant variants[] = {
+    { 1000, false, 0 },
+    { 1000, true, 0 },
+    { 500, false, 0 },
+    { 1000, false, 60 },
+    { 500, true, -60 },
+};
+
+/*
+  NEC
+*/
+
+static Trace necTrace(const Variant &v, uint32_t code, float jitter)
+{
+    Trace t(v.tick_ns, v.markLevel, v.skew, jitter);
+    t.add(true, 9000);
+    t.add(false, 4500);
+    for(int i = 0; i < 32; i++) {
+        t.add(true, 560);
+        t.add(false, (code >> i) & 1 ? 1690 : 560);
+    }
+    t.add(true, 560);
+    t.end();
+    return t;
+}
+
+static uint32_t necCode(uint8_t address, uint8_t address_inv, uint8_t command)
+{
+    return address | (address_inv << 8) | (command << 16) | ((uint8_t)~command << 24);
+}
+
+static bool sameNec(const rmt_nec_frame_t &f, uint32_t code)
+{
+    return !f.repeat && f.address == (code & 0xFF) && f.address_inv == ((code >> 8) & 0xFF) && f.command == ((code >> 16) & 0xFF);
+}
+
+static void testNEC()
+{
+    for(const Variant &v : variants) {
+        for(int round = 0; round < 2000; round++) {
+            uint32_t code = necCode(rng(), rng(), rng());
+            rmt_nec_frame_t frame;
+
+            Trace t = necTrace(v, code, round ? 0.1f : 0);
+            CHECK(rmtDecodeNEC(t.items.data(), t.items.size(), t.tick, &frame) && sameNec(frame, code),
+                  "NEC %08X, tick %.0f, skew %.0f", code, v.tick_ns, v.skew);
+
+            // past the tolerance a bit may be lost but never read wrong
+            t = necTrace(v, code, 0.35f);
+            if(rmtDecodeNEC(t.items.data(), t.items.size(), t.tick, &frame)) {
+                CHECK(sameNec(frame, code), "noisy NEC %08X read as %02X %02X %02X", code, frame.address, frame.address_inv, frame.command);
+            }
+
+            // truncated anywhere, or cut short by an end marker
+            t = necTrace(v, code, 0);
+            size_t cut = 1 + rng() % (t.items.size() - 2);
+            CHECK(!rmtDecodeNEC(t.items.data(), cut, t.tick, &frame), "NEC truncated to %zu items", cut);
+            t.items[cut].duration1 = 0;
+            CHECK(!rmtDecodeNEC(t.items.data(), t.items.size(), t.tick, &frame), "NEC ended at item %zu", cut);
+
+            // a glitch splitting a space, and a flipped command bit
+            t = necTrace(v, code, 0);
+            size_t at = 1 + rng() % 32;
+            rmt_data_t &item = t.items[at];
+            uint32_t space = item.duration1;
+            item.duration1 = space / 3;
+            t.items.insert(t.items.begin() + at + 1, item);
+            t.items[at + 1].duration0 = 30 * 1000 / v.tick_ns;
+            t.items[at + 1].duration1 = space - space / 3;
+            CHECK(!rmtDecodeNEC(t.items.data(), t.items.size(), t.tick, &frame), "NEC with a glitch in bit %zu", at - 1);
+            t = necTrace(v, code ^ (1 << (16 + rng() % 8)), 0);
+            CHECK(!rmtDecodeNEC(t.items.data(), t.items.size(), t.tick, &frame), "NEC with a bad command check");
+        }
+
+        // repeat code, with and without the end marker in the same item
+        Trace repeat(v.tick_ns, v.markLevel, v.skew);
+        repeat.add(true, 9000);
+        repeat.add(false, 2250);
+        repeat.add(true, 560);
+        repeat.end();
+        rmt_nec_frame_t frame = { 1, 2, 3, false };
+        CHECK(rmtDecodeNEC(repeat.items.data(), repeat.items.size(), repeat.tick, &frame) && frame.repeat && frame.command == 3,
+              "NEC repeat, tick %.0f", v.tick_ns);
+        CHECK(!rmtDecodeNEC(repeat.items.data(), 1, repeat.tick, &frame), "NEC repeat without its final mark");
+    }
+
+    // extended NEC: the second address byte is not the inverse of the first
+    Trace t = necTrace(variants[0], necCode(0x04, 0xFB, 0x08), 0);
+    rmt_nec_frame_t frame;
+    CHECK(rmtDecodeNEC(t.items.data(), t.items.size(), t.tick, &frame) && frame.address == 0x04 && frame.address_inv == 0xFB, "NEC 04 FB 08");
+    t = necTrace(variants[0], necCode(0x34, 0x12, 0x5A), 0);
+    CHECK(rmtDecodeNEC(t.items.data(), t.items.size(), t.tick, &frame) && frame.address == 0x34 && frame.address_inv == 0x12, "extended NEC 1234 5A");
+    printf("nec ok\n");
+}
+
+/*
+  RC5
+*/
+
+// 14 bits: two start bits (the second is the inverted command bit 6 in RC5X), toggle, address, command
+static uint16_t rc5Bits(uint8_t address, uint8_t command, bool toggle)
+{
+    return (1 << 13) | ((!(command & 0x40)) << 12) | (toggle << 11) | ((address & 0x1F) << 6) | (command & 0x3F);
+}
+
+static Trace rc5Trace(const Variant &v, uint16_t bits, float jitter, bool idle)
+{
+    // Manchester halves, a 1 is space then mark; the first space is the idle line
+    std::vector<bool> halves;
+    for(int b = 13; b >= 0; b--) {
+        bool one = (bits >> b) & 1;
+        halves.push_back(!one);
+        halves.push_back(one);
+    }
+    halves.erase(halves.begin());
+    if(!halves.back()) {
+        halves.pop_back();
+    }
+
+    Trace t(v.tick_ns, v.markLevel, 0, jitter);
+    for(size_t i = 0; i < halves.size(); ) {
+        size_t n = 1;
+        while(i + n < halves.size() && halves[i + n] == halves[i]) {
+            n++;
+        }
+        t.add(halves[i], 889.0f * n);
+        i += n;
+    }
+    if(idle) {
+        t.add(false, 20000);
+    }
+    t.end();
+    return t;
+}
+
+static void testRC5()
+{
+    for(const Variant &v : variants) {
+        if(v.skew) {
+            continue;
+        }
+        for(int round = 0; round < 2000; round++) {
+            uint8_t address = rng() & 0x1F, command = rng() & 0x7F;
+            bool toggle = rng() & 1;
+            uint16_t bits = rc5Bits(address, command, toggle);
+            rmt_rc5_frame_t frame;
+
+            Trace t = rc5Trace(v, bits, round ? 0.2f : 0, round & 1);
+            CHECK(rmtDecodeRC5(t.items.data(), t.items.size(), t.tick, &frame)
+                  && frame.address == address && frame.command == command && frame.toggle == toggle,
+                  "RC5 %04X, tick %.0f, level %d", bits, v.tick_ns, v.markLevel);
+
+            // a half bit too short or too long for the tolerance
+            t = rc5Trace(v, bits, 0, false);
+            rmt_data_t &bad = t.items[rng() % (t.items.size() - 1)];
+            bad.duration0 = ((rng() & 1) ? 350 : 2300) * 1000 / v.tick_ns;
+            CHECK(!rmtDecodeRC5(t.items.data(), t.items.size(), t.tick, &frame), "RC5 %04X with a bad half bit", bits);
+
+            t = rc5Trace(v, bits, 0, false);
+            size_t cut = rng() % (t.items.size() - 1);
+            t.items[cut].duration1 = 0;
+            CHECK(!rmtDecodeRC5(t.items.data(), cut + 1, t.tick, &frame), "RC5 %04X ended at item %zu", bits, cut);
+
+            // a mark in the middle of a space is half a bit too many
+            t = rc5Trace(v, bits, 0, false);
+            for(rmt_data_t &item : t.items) {
+                if(item.duration1 > 1200 * 1000 / v.tick_ns) {
+                    uint32_t space = item.duration1;
+                    item.duration1 = space / 2;
+                    rmt_data_t glitch = item;
+                    glitch.duration0 = 150 * 1000 / v.tick_ns;
+                    glitch.level0 = item.level0;
+                    glitch.duration1 = space / 2;
+                    t.items.insert(t.items.begin() + (&item - t.items.data()) + 1, glitch);
+                    CHECK(!rmtDecodeRC5(t.items.data(), t.items.size(), t.tick, &frame), "RC5 %04X with a glitch", bits);
+                    break;
+                }
+            }
+        }
+    }
+    printf("rc5 ok\n");
+}
+
+/*
+  DHT
+*/
+
+static Trace dhtTrace(const uint8_t data[5], float jitter, bool handshake)
+{
+    // the line idles high; the sensor answers 80 us low, 80 us high, then
+    // each bit is 50 us low and 26 us (0) or 70 us (1) high
+    Trace t(1000, true, 0, jitter);
+    if(handshake) {
+        t.add(false, 80);
+        t.add(true, 80);
+    }
+    for(int bit = 0; bit < 40; bit++) {
+        t.add(false, 50);
+        t.add(true, (data[bit >> 3] & (0x80 >> (bit & 7))) ? 70 : 26);
+    }
+    t.add(false, 50);
+    t.end();
+    return t;
+}
+
+static void testDHT()
+{
+    for(int round = 0; round < 5000; round++) {
+        uint8_t data[5] = { (uint8_t)rng(), (uint8_t)rng(), (uint8_t)rng(), (uint8_t)rng(), 0 };
+        data[4] = data[0] + data[1] + data[2] + data[3];
+        rmt_dht_frame_t frame;
+
+        bool handshake = round & 1;
+        Trace t = dhtTrace(data, round ? 0.25f : 0, handshake);
+        CHECK(rmtDecodeDHT(t.items.data(), t.items.size(), t.tick, &frame) && !memcmp(frame.data, data, 5),
+              "DHT %02X%02X%02X%02X%02X", data[0], data[1], data[2], data[3], data[4]);
+
+        // missing bits at the end
+        t = dhtTrace(data, 0, false);
+        size_t cut = rng() % 40;
+        CHECK(!rmtDecodeDHT(t.items.data(), cut, t.tick, &frame), "DHT truncated to %zu items", cut);
+
+        // a bit read wrong breaks the checksum
+        uint8_t bad[5];
+        memcpy(bad, data, 5);
+        bad[rng() % 5] ^= 1 << (rng() % 8);
+        t = dhtTrace(bad, 0, handshake);
+        CHECK(!rmtDecodeDHT(t.items.data(), t.items.size(), t.tick, &frame), "DHT with a bad checksum");
+    }
+
+    // through rmtDecode, with no IR decoder taking it
+    uint8_t data[5] = { 0x02, 0x8C, 0x01, 0x5F, 0xEE };
+    Trace t = dhtTrace(data, 0, true);
+    rmt_frame_t frame;
+    CHECK(rmtDecode(t.items.data(), t.items.size(), t.tick, RMT_PROTO_ALL, &frame) == RMT_PROTO_DHT && !memcmp(frame.dht.data, data, 5), "rmtDecode DHT");
+    printf("dht ok\n");
+}
+
+/*
+  1-Wire
+*/
+
+static Trace oneWireTrace(const std::vector<bool> &bits, float jitter)
+{
+    // read slots of 70 us: the master pulls low for 2 us, a 1 lets the line
+    // go back up at once, a 0 is held low by the slave for about 30 us
+    Trace t(1000, false, 0, jitter);
+    for(bool bit : bits) {
+        float low = bit ? 6 : 35;
+        t.add(true, low);
+        t.add(false, 70 - low);
+    }
+    t.end();
+    return t;
+}
+
+static void testOneWire()
+{
+    for(int round = 0; round < 5000; round++) {
+        size_t n = 1 + rng() % 64;
+        std::vector<bool> bits(n);
+        for(size_t i = 0; i < n; i++) {
+            bits[i] = rng() & 1;
+        }
+        uint8_t out[9];
+
+        Trace t = oneWireTrace(bits, round ? 0.3f : 0);
+        size_t got = rmtDecodeOneWire(t.items.data(), t.items.size(), t.tick, out, 64);
+        CHECK(got == n, "1-Wire %zu bits decoded as %zu", n, got);
+        for(size_t i = 0; i < got && i < n; i++) {
+            CHECK(((out[i >> 3] >> (i & 7)) & 1) == bits[i], "1-Wire bit %zu of %zu", i, n);
+        }
+        if(got & 7) {
+            CHECK(!(out[got >> 3] >> (got & 7)), "1-Wire bits past %zu set", got);
+        }
+
+        // a truncated capture gives the bits it holds, max_bits is honoured
+        size_t cut = rng() % t.items.size();
+        got = rmtDecodeOneWire(t.items.data(), cut, t.tick, out, 64);
+        CHECK(got == cut, "1-Wire truncated to %zu items gave %zu bits", cut, got);
+        for(size_t i = 0; i < got; i++) {
+            CHECK(((out[i >> 3] >> (i & 7)) & 1) == bits[i], "truncated 1-Wire bit %zu", i);
+        }
+        size_t max = rng() % (n + 1);
+        CHECK(rmtDecodeOneWire(t.items.data(), t.items.size(), t.tick, out, max) == max, "1-Wire limited to %zu bits", max);
+
+        // a glitch inside a slot shows up as an extra bit
+        t = oneWireTrace(bits, 0);
+        size_t at = rng() % n;
+        rmt_data_t glitch = t.items[at];
+        t.items[at].duration1 = 1;
+        t.items.insert(t.items.begin() + at + 1, glitch);
+        CHECK(rmtDecodeOneWire(t.items.data(), t.items.size(), t.tick, out, 72) == n + 1, "1-Wire glitch in bit %zu", at);
+    }
+    printf("onewire ok\n");
+}
+
+/*
+  rmtDecode
+*/
+
+static void testDispatch()
+{
+    rmt_frame_t frame;
+    Trace nec = necTrace(variants[0], necCode(0x10, 0xEF, 0x42), 0);
+    Trace rc5 = rc5Trace(variants[0], rc5Bits(5, 0x35, true), 0, false);
+    CHECK(rmtDecode(nec.items.data(), nec.items.size(), nec.tick, RMT_PROTO_ALL, &frame) == RMT_PROTO_NEC && frame.nec.command == 0x42, "rmtDecode NEC");
+    CHECK(rmtDecode(rc5.items.data(), rc5.items.size(), rc5.tick, RMT_PROTO_ALL, &frame) == RMT_PROTO_RC5 && frame.rc5.command == 0x35, "rmtDecode RC5");
+    CHECK(rmtDecode(rc5.items.data(), rc5.items.size(), rc5.tick, RMT_PROTO_NEC, &frame) == RMT_PROTO_NONE, "RC5 taken as NEC");
+    CHECK(rmtDecode(nec.items.data(), nec.items.size(), nec.tick, RMT_PROTO_RC5, &frame) == RMT_PROTO_NONE, "NEC taken as RC5");
+    CHECK(rmtDecode(NULL, 0, nec.tick, RMT_PROTO_ALL, &frame) == RMT_PROTO_NONE, "empty capture");
+    CHECK(rmtDecode(nec.items.data(), nec.items.size(), 0, RMT_PROTO_ALL, &frame) == RMT_PROTO_NONE, "zero tick");
+    printf("dispatch ok\n");
+}
+
+int main()
+{
+    testNEC();
+    testRC5();
+    testDHT();
+    testOneWire();
+    testDispatch();
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,325 @@
+/*
+ * Host test of the SD sector cache and the sliced CRC16
+ *
+ *   test_sd_cache [bench]
+ *
+ * CRC16 is checked against a bitwise CRC16-CCITT over random lengths and
+ * alignments. The cache runs on a simulated card against a flat model of
+ * the disk: random mixes of single and multi sector reads and writes, some
+ * inside the write-back window and some outside, with flushes, window
+ * changes and failing transfers in between. Sectors outside the window must
+ * reach the card before the write returns. "bench" times CRC16 against the
+ * byte table loop it replaced, and counts card transfers for a FatFs like
+ * logging pattern with and without the cache.
+ */
+
+#include "sd_diskio_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <random>
+#include <vector>
+
+extern "C" {
+    unsigned short CRC16(const char* data, int length);
+    extern const unsigned short m_CRC16Table[8][256];
+}
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+    if(!(cond)) { \
+        failures++; \
+        printf("FAIL %s:%d: %s: ", __FILE__, __LINE__, #cond); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+    } \
+} while(0)
+
+static double seconds()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/*
+  CRC16
+*/
+
+static unsigned short crcBitwise(const uint8_t *data, size_t length)
+{
+    unsigned short crc = 0;
+    while(length--) {
+        crc ^= (unsigned short)(*data++) << 8;
+        for(int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+// the byte at a time loop CRC16 used before it was sliced
+static unsigned short crcBytewise(const uint8_t *data, size_t length)
+{
+    unsigned short crc = 0;
+    while(length--) {
+        crc = (crc << 8) ^ m_CRC16Table[0][((crc >> 8) ^ *data++) & 0x00FF];
+    }
+    return crc;
+}
+
+static void testCrc()
+{
+    static const char check[] = "123456789";
+    CHECK(CRC16(check, 9) == 0x31C3, "CRC16(\"123456789\") = %04X", CRC16(check, 9));
+
+    std::mt19937 rng(5);
+    std::vector<uint8_t> buffer(1100 + 8);
+    for(int round = 0; round < 20000; round++) {
+        size_t offset = rng() % 8;
+        size_t length = (round % 4) ? rng() % 1100 : 512;
+        for(size_t i = 0; i < length; i++) {
+            buffer[offset + i] = rng();
+        }
+        const uint8_t *data = buffer.data() + offset;
+        unsigned short expected = crcBitwise(data, length);
+        CHECK(CRC16((const char *)data, length) == expected, "%zu bytes at offset %zu", length, offset);
+    }
+    printf("crc ok\n");
+}
+
+/*
+  Cache on a simulated card
+*/
+
+struct Card {
+    Card(uint32_t sectors) : data(sectors * SD_CACHE_SECTOR_SIZE) {}
+
+    std::vector<uint8_t> data;
+    int reads = 0;
+    int writes = 0;
+    bool failing = false;
+};
+
+static bool cardTransfer(void *ctx, uint8_t *buffer, uint32_t sector, uint32_t count, bool write)
+{
+    Card *card = (Card *)ctx;
+    if(card->failing) {
+        return false;
+    }
+    uint8_t *at = card->data.data() + (size_t)sector * SD_CACHE_SECTOR_SIZE;
+    if(write) {
+        memcpy(at, buffer, count * SD_CACHE_SECTOR_SIZE);
+        card->writes++;
+    } else {
+        memcpy(buffer, at, count * SD_CACHE_SECTOR_SIZE);
+        card->reads++;
+    }
+    return true;
+}
+
+static void fill(std::mt19937 &rng, std::vector<uint8_t> &buffer)
+{
+    for(auto &b : buffer) {
+        b = rng();
+    }
+}
+
+static void testCoherence()
+{
+    const uint32_t sectors = 64;
+    std::mt19937 rng(7);
+
+    for(size_t size : { 1, 3, 8 }) {
+        Card card(sectors);
+        std::vector<uint8_t> model(card.data.size());
+        sd_sector_cache_t *cache = sd_cache_new(size, &cardTransfer, &card);
+        CHECK(cache, "sd_cache_new(%zu)", size);
+        if(!cache) {
+            continue;
+        }
+        uint32_t first = 0, count = 0;
+
+        for(int round = 0; round < 50000; round++) {
+            uint32_t sector = rng() % sectors;
+            uint32_t n = (rng() % 3) ? 1 : 1 + rng() % std::min<uint32_t>(8, sectors - sector);
+            std::vector<uint8_t> buffer(n * SD_CACHE_SECTOR_SIZE);
+            uint8_t *expected = model.data() + (size_t)sector * SD_CACHE_SECTOR_SIZE;
+            uint8_t *onCard = card.data.data() + (size_t)sector * SD_CACHE_SECTOR_SIZE;
+
+            switch(rng() % 16) {
+            case 0:
+                CHECK(sd_cache_flush(cache), "flush");
+                CHECK(card.data == model, "card differs after flush, cache of %zu", size);
+                break;
+            case 1:
+                first = rng() % sectors;
+                count = rng() % (sectors - first);
+                CHECK(sd_cache_set_writeback(cache, first, count), "set_writeback");
+                break;
+            case 2: {
+                // a failing card keeps the data in the cache until it is back
+                card.failing = true;
+                sd_cache_flush(cache);
+                fill(rng, buffer);
+                bool written = sd_cache_write(cache, buffer.data(), sector, n);
+                card.failing = false;
+                if(written) {
+                    memcpy(expected, buffer.data(), buffer.size());
+                }
+                break;
+            }
+            case 3:
+            case 4:
+            case 5:
+            case 6:
+            case 7:
+            case 8: {
+                fill(rng, buffer);
+                CHECK(sd_cache_write(cache, buffer.data(), sector, n), "write %u+%u", sector, n);
+                memcpy(expected, buffer.data(), buffer.size());
+                bool held = n == 1 && sector >= first && sector - first < count;
+                if(!held) {
+                    CHECK(!memcmp(onCard, expected, buffer.size()), "write %u+%u outside the window not on the card", sector, n);
+                }
+                break;
+            }
+            default:
+                CHECK(sd_cache_read(cache, buffer.data(), sector, n), "read %u+%u", sector, n);
+                CHECK(!memcmp(buffer.data(), expected, buffer.size()), "read %u+%u, cache of %zu", sector, n, size);
+                break;
+            }
+        }
+        CHECK(sd_cache_flush(cache), "final flush");
+        CHECK(card.data == model, "card differs at the end, cache of %zu", size);
+
+        // invalidate drops the window, so writes go through again
+        sd_cache_set_writeback(cache, 0, sectors);
+        sd_cache_invalidate(cache);
+        std::vector<uint8_t> buffer(SD_CACHE_SECTOR_SIZE, 0x5A);
+        sd_cache_write(cache, buffer.data(), 3, 1);
+        CHECK(!memcmp(card.data.data() + 3 * SD_CACHE_SECTOR_SIZE, buffer.data(), buffer.size()), "write held after invalidate");
+        sd_cache_free(cache);
+    }
+
+    // writes inside the window stay off the card until flush or eviction
+    Card card(sectors);
+    sd_sector_cache_t *cache = sd_cache_new(2, &cardTransfer, &card);
+    sd_cache_set_writeback(cache, 0, 8);
+    std::vector<uint8_t> buffer(SD_CACHE_SECTOR_SIZE, 0xA5);
+    for(int i = 0; i < 10; i++) {
+        sd_cache_write(cache, buffer.data(), 1, 1);
+    }
+    CHECK(card.writes == 0, "%d writes held in the window reached the card", card.writes);
+    sd_cache_write(cache, buffer.data(), 2, 1);
+    sd_cache_write(cache, buffer.data(), 3, 1);
+    CHECK(card.writes == 1 && card.data[SD_CACHE_SECTOR_SIZE] == 0xA5, "eviction wrote %d sectors", card.writes);
+    sd_cache_flush(cache);
+    CHECK(card.writes == 3, "flush wrote %d sectors", card.writes);
+    sd_cache_free(cache);
+    printf("coherence ok\n");
+}
+
+/*
+  Benchmark
+*/
+
+// A logger as FatFs drives it: appends in clusters of four sectors written
+// as one multi sector request, each followed by an update of the FAT sector
+// and, on sync, the directory sector and FSINFO
+static void logPattern(sd_sector_cache_t *cache, Card &card, int clusters)
+{
+    std::vector<uint8_t> data(4 * SD_CACHE_SECTOR_SIZE, 0x11);
+    uint8_t sector[SD_CACHE_SECTOR_SIZE];
+    const uint32_t fsinfo = 1, fat = 32, dir = 100, database = 100;
+    for(int i = 0; i < clusters; i++) {
+        uint32_t fatSector = fat + i / 128;
+        uint32_t at = database + 4 + i * 4;
+        if(cache) {
+            sd_cache_read(cache, sector, fatSector, 1);
+            sd_cache_write(cache, sector, fatSector, 1);
+            sd_cache_write(cache, data.data(), at, 4);
+        } else {
+            cardTransfer(&card, sector, fatSector, 1, false);
+            cardTransfer(&card, sector, fatSector, 1, true);
+            cardTransfer(&card, data.data(), at, 4, true);
+        }
+        if(i % 16 == 15) {
+            for(uint32_t s : { dir, fsinfo }) {
+                if(cache) {
+                    sd_cache_read(cache, sector, s, 1);
+                    sd_cache_write(cache, sector, s, 1);
+                } else {
+                    cardTransfer(&card, sector, s, 1, false);
+                    cardTransfer(&card, sector, s, 1, true);
+                }
+            }
+            if(cache) {
+                sd_cache_flush(cache);
+            }
+        }
+    }
+}
+
+static void bench()
+{
+    const size_t size = 1 << 20;
+    const int rounds = 100;
+    std::vector<uint8_t> data(size);
+    for(size_t i = 0; i < size; i++) {
+        data[i] = i * 13;
+    }
+    unsigned short sink = 0;
+    double start = seconds();
+    for(int i = 0; i < rounds; i++) {
+        for(size_t at = 0; at < size; at += 512) {
+            sink += crcBytewise(data.data() + at, 512);
+        }
+    }
+    double bytewise = seconds() - start;
+    start = seconds();
+    for(int i = 0; i < rounds; i++) {
+        for(size_t at = 0; at < size; at += 512) {
+            sink += CRC16((const char *)data.data() + at, 512);
+        }
+    }
+    double sliced = seconds() - start;
+    printf("bench: CRC16 over 512 byte sectors  byte table %5.0f MB/s  sliced %5.0f MB/s (%04X)\n",
+           rounds * size / bytewise / 1e6, rounds * size / sliced / 1e6, sink);
+
+    const int clusters = 4096;
+    Card direct(20000);
+    logPattern(NULL, direct, clusters);
+    Card cached(20000);
+    sd_sector_cache_t *cache = sd_cache_new(8, &cardTransfer, &cached);
+    sd_cache_set_writeback(cache, 0, 100);
+    logPattern(cache, cached, clusters);
+    sd_cache_free(cache);
+    printf("bench: log of %d clusters  card transfers without cache %d, with 8 sectors %d\n",
+           clusters, direct.reads + direct.writes, cached.reads + cached.writes);
+
+    Card card(64);
+    cache = sd_cache_new(8, &cardTransfer, &card);
+    uint8_t sector[SD_CACHE_SECTOR_SIZE];
+    const int hits = 2000000;
+    start = seconds();
+    for(int i = 0; i < hits; i++) {
+        sd_cache_read(cache, sector, i & 7, 1);
+    }
+    printf("bench: cached sector read %.0f ns\n", (seconds() - start) / hits * 1e9);
+    sd_cache_free(cache);
+}
+
+int main(int argc, char **argv)
+{
+    testCrc();
+    testCoherence();
+    if(argc > 1 && !strcmp(argv[1], "bench")) {
+        bench();
+    }
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
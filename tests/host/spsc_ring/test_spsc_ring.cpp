@@ -0,0 +1,304 @@
+/*
+ * Host test of SpscRing, the lock-free ring WiFiUDP receives into
+ *
+ *   test_spsc_ring [bench]
+ *
+ * Single threaded cases check capacity, wrapping and the in place spans,
+ * with and without the mirrored mapping. A producer and a consumer thread
+ * then move a counting byte stream through a small ring, mixing push/pop,
+ * write/read and the reserveWrite/peekContiguous spans. "bench" compares
+ * the ring with cbuf, which it replaced in WiFiUDP.
+ */
+
+#include "SpscRing.h"
+#include "cbuf.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <random>
+#include <thread>
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+    if(!(cond)) { \
+        failures++; \
+        printf("FAIL %s:%d: %s: ", __FILE__, __LINE__, #cond); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+    } \
+} while(0)
+
+static double seconds()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/*
+  Single thread
+*/
+
+static void testBasics()
+{
+    SpscRing<uint8_t> ring(1000);
+    CHECK(ring.valid() && ring.capacity() == 1024, "capacity %zu", ring.capacity());
+    CHECK(ring.empty() && ring.room() == 1024, "room %zu", ring.room());
+
+    // every slot can be used
+    for(int i = 0; i < 1024; i++) {
+        CHECK(ring.push(i), "push %d", i);
+    }
+    CHECK(ring.full() && !ring.push(0), "ring not full");
+    uint8_t b = 0;
+    CHECK(ring.peek(b) && b == 0 && ring.available() == 1024, "peek consumed");
+    CHECK(ring.remove(24) == 24 && ring.available() == 1000, "remove");
+    CHECK(ring.pop(b) && b == 24, "pop %u", b);
+
+    // bulk copies across the end of the storage
+    ring.flush();
+    CHECK(ring.empty(), "flush");
+    uint8_t src[300], dst[300];
+    for(int i = 0; i < 300; i++) {
+        src[i] = i * 7;
+    }
+    for(int round = 0; round < 20; round++) {
+        CHECK(ring.write(src, 300) == 300, "write round %d", round);
+        memset(dst, 0, sizeof(dst));
+        CHECK(ring.peek(dst, 300) == 300 && !memcmp(src, dst, 300), "peek round %d", round);
+        memset(dst, 0, sizeof(dst));
+        CHECK(ring.read(dst, 300) == 300 && !memcmp(src, dst, 300), "read round %d", round);
+    }
+    CHECK(ring.write(src, 300) + ring.write(src, 300) + ring.write(src, 300) + ring.write(src, 300) == 1024, "write past full");
+    uint8_t all[2000];
+    CHECK(ring.read(all, sizeof(all)) == 1024 && ring.empty(), "read past empty");
+
+    // without the mirror the spans end at the end of the storage
+    ring.clear();
+    CHECK(ring.write(src, 200) == 200 && ring.remove(200) == 200, "move to 200");
+    size_t count;
+    uint8_t *span = ring.reserveWrite(&count);
+    CHECK(span && count == 824, "write span %zu", count);
+    ring.commitWrite(count);
+    span = ring.reserveWrite(&count);
+    CHECK(count == 200, "write span after the wrap %zu", count);
+    const uint8_t *data = ring.peekContiguous(&count);
+    CHECK(data && count == 824, "read span %zu", count);
+    ring.commitRead(count);
+    CHECK(ring.empty(), "ring not empty");
+
+    // elements larger than a byte
+    struct Event {
+        uint32_t id;
+        uint16_t port;
+    };
+    SpscRing<Event> events(3);
+    CHECK(events.capacity() == 4, "capacity %zu", events.capacity());
+    Event in[4] = { { 1, 10 }, { 2, 20 }, { 3, 30 }, { 4, 40 } }, out[4];
+    CHECK(events.write(in, 4) == 4 && events.read(out, 4) == 4 && !memcmp(in, out, sizeof(in)), "events");
+    printf("basics ok\n");
+}
+
+static void testMirror()
+{
+    long page = sysconf(_SC_PAGESIZE);
+    SpscRing<uint8_t> ring(page, true);
+    CHECK(ring.valid() && ring.mirrored(), "no mirror for %ld bytes", page);
+    if(!ring.mirrored()) {
+        return;
+    }
+
+    // spans run past the end of the storage, into the second mapping
+    uint8_t src[512];
+    for(int i = 0; i < 512; i++) {
+        src[i] = i;
+    }
+    size_t count;
+    uint8_t *span = ring.reserveWrite(&count);
+    CHECK(count == (size_t)page, "write span %zu", count);
+    ring.commitWrite(page - 200);
+    ring.remove(page - 200);
+    span = ring.reserveWrite(&count);
+    CHECK(count == (size_t)page, "write span %zu from 200 before the end", count);
+    memcpy(span, src, 512);
+    ring.commitWrite(512);
+    const uint8_t *data = ring.peekContiguous(&count);
+    CHECK(count == 512 && !memcmp(data, src, 512), "read span %zu across the end", count);
+    uint8_t dst[512];
+    CHECK(ring.read(dst, 512) == 512 && !memcmp(dst, src, 512), "read across the end");
+
+    // a size that is not a whole number of pages gets a plain buffer
+    SpscRing<uint8_t> odd(page / 2, true);
+    CHECK(odd.valid() && !odd.mirrored(), "half a page mirrored");
+    printf("mirror ok\n");
+}
+
+/*
+  Two threads
+*/
+
+enum {
+    MODE_BYTES,     // push/pop
+    MODE_BULK,      // write/read
+    MODE_SPANS,     // reserveWrite/peekContiguous
+    MODE_MIXED      // any of them, picked at random each time
+};
+
+static bool threaded(SpscRing<uint8_t> &ring, size_t total, int mode)
+{
+    std::thread producer([&] {
+        std::mt19937 rng(1);
+        uint8_t buf[700];
+        size_t sent = 0;
+        while(sent < total) {
+            size_t before = sent;
+            int m = (mode == MODE_MIXED) ? rng() % 3 : mode;
+            size_t n = std::min<size_t>(1 + rng() % 600, total - sent);
+            if(m == MODE_BYTES) {
+                sent += ring.push((uint8_t)sent);
+            } else if(m == MODE_BULK) {
+                for(size_t i = 0; i < n; i++) {
+                    buf[i] = sent + i;
+                }
+                sent += ring.write(buf, n);
+            } else {
+                size_t count;
+                uint8_t *span = ring.reserveWrite(&count);
+                count = std::min(count, n);
+                for(size_t i = 0; i < count; i++) {
+                    span[i] = sent + i;
+                }
+                ring.commitWrite(count);
+                sent += count;
+            }
+            if(sent == before) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::mt19937 rng(2);
+    uint8_t buf[700];
+    size_t received = 0;
+    size_t errors = 0;
+    while(received < total) {
+        size_t before = received;
+        int m = (mode == MODE_MIXED) ? rng() % 3 : mode;
+        size_t n = 1 + rng() % 600;
+        if(m == MODE_BYTES) {
+            uint8_t b;
+            if(ring.pop(b)) {
+                errors += b != (uint8_t)received;
+                received++;
+            }
+        } else if(m == MODE_BULK) {
+            size_t count = ring.read(buf, n);
+            for(size_t i = 0; i < count; i++) {
+                errors += buf[i] != (uint8_t)(received + i);
+            }
+            received += count;
+        } else {
+            size_t count;
+            const uint8_t *span = ring.peekContiguous(&count);
+            count = std::min(count, n);
+            for(size_t i = 0; i < count; i++) {
+                errors += span[i] != (uint8_t)(received + i);
+            }
+            ring.commitRead(count);
+            received += count;
+        }
+        if(received == before) {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    return !errors && ring.empty();
+}
+
+static void testThreaded()
+{
+    static const char *names[] = { "bytes", "bulk", "spans", "mixed" };
+    for(int mirror = 0; mirror < 2; mirror++) {
+        SpscRing<uint8_t> ring(4096, mirror);
+        for(int mode = MODE_BYTES; mode <= MODE_MIXED; mode++) {
+            size_t total = (mode == MODE_BYTES) ? 2000000 : 40000000;
+            CHECK(threaded(ring, total, mode), "%s %s", mirror ? "mirrored" : "plain", names[mode]);
+        }
+    }
+    printf("threaded ok\n");
+}
+
+/*
+  Benchmark against cbuf
+*/
+
+static void bench()
+{
+    static char src[1460], dst[1460];
+    // a run time size, like a packet length, so the copies are not specialised for it
+    volatile size_t packet = sizeof(src);
+    size_t chunk = packet;
+    const size_t total = 1000000000;
+
+    // 1460 byte packets through 4 KiB, as WiFiUDP does
+    {
+        cbuf buf(4095);
+        double start = seconds();
+        for(size_t moved = 0; moved < total; ) {
+            buf.write(src, chunk);
+            moved += buf.read(dst, chunk);
+        }
+        printf("bench: cbuf      1460 byte write/read  %5.2f GB/s\n", total / (seconds() - start) / 1e9);
+    }
+    for(int mirror = 0; mirror < 2; mirror++) {
+        SpscRing<char> ring(4096, mirror);
+        double start = seconds();
+        for(size_t moved = 0; moved < total; ) {
+            ring.write(src, chunk);
+            moved += ring.read(dst, chunk);
+        }
+        printf("bench: %-9s 1460 byte write/read  %5.2f GB/s\n", mirror ? "mirrored" : "SpscRing", total / (seconds() - start) / 1e9);
+    }
+
+    // a byte at a time
+    const size_t bytes = 100000000;
+    long sum = 0;
+    {
+        cbuf buf(4095);
+        double start = seconds();
+        for(size_t i = 0; i < bytes; i++) {
+            buf.write((char)i);
+            sum += buf.read();
+        }
+        printf("bench: cbuf      byte write/read       %5.2f ns\n", (seconds() - start) * 1e9 / bytes);
+    }
+    {
+        SpscRing<char> ring(4096);
+        double start = seconds();
+        char b = 0;
+        for(size_t i = 0; i < bytes; i++) {
+            ring.push((char)i);
+            ring.pop(b);
+            sum += b;
+        }
+        printf("bench: SpscRing  byte push/pop         %5.2f ns\n", (seconds() - start) * 1e9 / bytes);
+    }
+    if(sum == 42) {
+        printf("\n");   // keeps the loops from being optimised away
+    }
+}
+
+int main(int argc, char **argv)
+{
+    testBasics();
+    testMirror();
+    testThreaded();
+    if(argc > 1 && !strcmp(argv[1], "bench")) {
+        bench();
+    }
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
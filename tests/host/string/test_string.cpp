@@ -0,0 +1,219 @@
+/*
+ * Host test of String::join and the geometric growth of String, built with
+ * WSTRING_ALLOC_STATS so heap operations can be counted
+ *
+ *   test_string [bench]
+ *
+ * Checks join() gives what concat() gives for every kind of argument,
+ * allocates once, and returns an invalid string for a null C string, and
+ * that appending a character at a time reallocates only a logarithmic
+ * number of times. "bench" counts heap operations and times building an
+ * HTTP status line and a digest auth string with operator+ chains, with
+ * reserve() and appends, and with join().
+ */
+
+#include "Arduino.h"
+
+#include <time.h>
+#include <string>
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+    if(!(cond)) { \
+        failures++; \
+        printf("FAIL %s:%d: %s: ", __FILE__, __LINE__, #cond); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+    } \
+} while(0)
+
+static double seconds()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static std::string str(const String &s)
+{
+    return std::string(s.c_str(), s.length());
+}
+
+// heap operations made by String since the last call
+static uint32_t heapOps()
+{
+    static uint32_t last;
+    String::AllocStats &stats = String::allocStats();
+    uint32_t total = stats.allocs + stats.reallocs;
+    uint32_t ops = total - last;
+    last = total;
+    return ops;
+}
+
+static void testJoin()
+{
+    String path("/index.html"), empty;
+    const char *host = "example.com";
+
+    String expected("GET ");
+    expected.concat(path);
+    expected.concat(" HTTP/1.1\r\nHost: ");
+    expected.concat(host);
+    expected.concat(':');
+    expected.concat(8080);
+    expected.concat("\r\n");
+    heapOps();
+    String joined = String::join("GET ", path, F(" HTTP/1.1\r\nHost: "), host, ':', 8080, "\r\n");
+    CHECK(heapOps() == 1, "join of %u chars did more than one heap operation", joined.length());
+    CHECK(str(joined) == str(expected), "\"%s\"", joined.c_str());
+
+    // every kind of number is formatted the way concat() does it
+    String numbers;
+    numbers.concat((unsigned char)200);
+    numbers.concat(-12345);
+    numbers.concat(4000000000u);
+    numbers.concat(-2147483647L);
+    numbers.concat(4294967295UL);
+    numbers.concat(-9223372036854775807LL);
+    numbers.concat(18446744073709551615ULL);
+    numbers.concat(3.14159f);
+    numbers.concat(-2.5);
+    numbers.concat(12345.678);
+    String joinedNumbers = String::join((unsigned char)200, -12345, 4000000000u, -2147483647L, 4294967295UL,
+                                        -9223372036854775807LL, 18446744073709551615ULL, 3.14159f, -2.5, 12345.678);
+    CHECK(str(joinedNumbers) == str(numbers), "\"%s\" instead of \"%s\"", joinedNumbers.c_str(), numbers.c_str());
+    // concat() would overflow its buffer here, join() cuts the number short
+    String huge = String::join(1e30, '!');
+    CHECK(huge.length() < 26 && huge.endsWith("!"), "\"%s\"", huge.c_str());
+
+    // short results stay in the SSO buffer, empty parts are fine
+    heapOps();
+    String small = String::join(empty, "ab", empty, 'c', "");
+    CHECK(str(small) == "abc" && heapOps() == 0, "\"%s\"", small.c_str());
+
+    // a null C string makes the result invalid, as with operator+
+    const char *null = NULL;
+    String invalid = String::join("a", null, "b");
+    CHECK(!invalid.c_str() || !invalid.length(), "join with a null string gave \"%s\"", invalid.c_str());
+
+    // strings built by join grow like any other
+    joined += joined;
+    CHECK(str(joined) == str(expected) + str(expected), "append to a joined string");
+    printf("join ok\n");
+}
+
+static void testGrowth()
+{
+    String s;
+    heapOps();
+    const unsigned int n = 60000;
+    std::string model;
+    for(unsigned int i = 0; i < n; i++) {
+        s += (char)('a' + i % 26);
+        model += (char)('a' + i % 26);
+    }
+    uint32_t ops = heapOps();
+    CHECK(str(s) == model, "%u appended characters", n);
+    // growing by half each time needs about log(n) / log(1.5) steps
+    CHECK(ops <= 30, "%u heap operations for %u appends", ops, n);
+
+    // up to the largest String, which then refuses to grow
+    unsigned int appended = n;
+    while(s.concat('x')) {
+        appended++;
+    }
+    ops = heapOps();
+    CHECK(s.length() == appended && appended >= 65500, "stopped at %u characters", appended);
+    CHECK(ops <= 2, "%u heap operations near the limit", ops);
+
+    // reserve() still gives exactly what is asked for
+    String r;
+    r.reserve(1000);
+    heapOps();
+    for(int i = 0; i < 1000; i++) {
+        r += 'x';
+    }
+    CHECK(heapOps() == 0, "appends within reserve() reallocated");
+    printf("growth ok\n");
+}
+
+/*
+  Benchmark
+*/
+
+static const String realm("Login Required"), nonce("0123456789abcdef0123456789abcdef"), uri("/api/v1/status");
+static const String reason("OK");
+
+static String statusChain(int code)
+{
+    return String(F("HTTP/1.")) + String(1) + ' ' + String(code) + ' ' + reason + "\r\n";
+}
+
+static String statusAppend(int code)
+{
+    String s;
+    s.reserve(9 + 12 + reason.length() + 3);
+    s += F("HTTP/1.");
+    s += 1;
+    s += ' ';
+    s += code;
+    s += ' ';
+    s += reason;
+    s += "\r\n";
+    return s;
+}
+
+static String statusJoin(int code)
+{
+    return String::join(F("HTTP/1."), (unsigned char)1, ' ', code, ' ', reason, "\r\n");
+}
+
+static String digestChain(const char *user)
+{
+    return String(F("Digest realm=\"")) + realm + String(F("\", qop=\"auth\", nonce=\"")) + nonce + String(F("\", user=\"")) + user + ':' + uri + String(F("\""));
+}
+
+static String digestJoin(const char *user)
+{
+    return String::join(F("Digest realm=\""), realm, F("\", qop=\"auth\", nonce=\""), nonce, F("\", user=\""), user, ':', uri, '"');
+}
+
+template<typename F, typename A>
+static void time(const char *name, F build, A arg)
+{
+    const int rounds = 200000;
+    size_t sink = 0;
+    heapOps();
+    uint32_t frees = String::allocStats().frees;
+    double start = seconds();
+    for(int i = 0; i < rounds; i++) {
+        sink += build(arg).length();
+    }
+    double elapsed = seconds() - start;
+    printf("bench: %-28s %5.1f heap ops %5.1f frees %6.0f ns (%zu)\n", name, (double)heapOps() / rounds,
+           (double)(String::allocStats().frees - frees) / rounds, elapsed / rounds * 1e9, sink / rounds);
+}
+
+static void bench()
+{
+    CHECK(str(statusChain(200)) == str(statusJoin(200)) && str(statusAppend(200)) == str(statusJoin(200)), "status lines differ");
+    CHECK(str(digestChain("admin")) == str(digestJoin("admin")), "digest strings differ");
+    time("status line, operator+", statusChain, 200);
+    time("status line, reserve+append", statusAppend, 200);
+    time("status line, join", statusJoin, 200);
+    time("digest, operator+", digestChain, "admin");
+    time("digest, join", digestJoin, "admin");
+}
+
+int main(int argc, char **argv)
+{
+    testJoin();
+    testGrowth();
+    if(argc > 1 && !strcmp(argv[1], "bench")) {
+        bench();
+    }
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,413 @@
+/*
+ * Host test of TickerWheel, the timer wheel behind Ticker
+ *
+ *   test_ticker_wheel [bench]
+ *
+ * The wheel is driven by a simulated clock: the arm callback records when
+ * the wheel wants to run next, and the test advances it to that time, or a
+ * little later like a timer that fires late. Hand written cases cover
+ * cascading through every level and the overflow list, cancel, re-arm and
+ * late periodic entries; a long random run checks every callback against
+ * a reference model. "bench" also prints the cost of a callback.
+ */
+
+#include "TickerWheel.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+    if(!(cond)) { \
+        failures++; \
+        printf("FAIL %s:%d: %s: ", __FILE__, __LINE__, #cond); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+    } \
+} while(0)
+
+#define LEVEL_US(level) (1ULL << ((level) * TICKER_WHEEL_BITS))
+#define WHEEL_SPAN_US   LEVEL_US(TICKER_WHEEL_LEVELS)
+
+/*
+  Simulated clock
+*/
+
+static uint64_t s_now;
+static uint64_t s_armed = UINT64_MAX;
+
+static void arm(uint64_t when)
+{
+    s_armed = when;
+}
+
+// Runs the wheel at every time it armed for, up to until, returns the advance() calls
+static size_t runUntil(TickerWheel &wheel, uint64_t until)
+{
+    size_t calls = 0;
+    while(s_armed <= until) {
+        s_now = s_armed > s_now ? s_armed : s_now;
+        s_armed = UINT64_MAX;
+        wheel.advance(s_now);
+        calls++;
+    }
+    s_now = until;
+    return calls;
+}
+
+/*
+  Hand written cases
+*/
+
+struct Fired {
+    std::vector<uint64_t> at;
+    std::vector<int> id;
+
+    TickerWheel::callback_t record(int which)
+    {
+        return [this, which] {
+            at.push_back(s_now);
+            id.push_back(which);
+        };
+    }
+};
+
+static void testCascade()
+{
+    s_now = 0;
+    s_armed = UINT64_MAX;
+    TickerWheel wheel(arm);
+
+    // deadlines on both sides of every level boundary, and in the overflow list
+    std::vector<uint64_t> delays;
+    for(int level = 1; level <= TICKER_WHEEL_LEVELS; level++) {
+        delays.push_back(LEVEL_US(level) - 1);
+        delays.push_back(LEVEL_US(level));
+        delays.push_back(LEVEL_US(level) + 1);
+    }
+    delays.push_back(WHEEL_SPAN_US * 3 + 12345);
+    delays.push_back(1);
+
+    std::vector<TickerWheel::Entry> entries(delays.size());
+    Fired fired;
+    for(size_t i = 0; i < delays.size(); i++) {
+        wheel.schedule(&entries[i], s_now, delays[i], 0, fired.record(i));
+    }
+    CHECK(s_armed <= 1, "armed at %llu, first deadline is 1", (unsigned long long)s_armed);
+
+    size_t calls = runUntil(wheel, WHEEL_SPAN_US * 4);
+    CHECK(fired.at.size() == delays.size(), "%zu of %zu fired", fired.at.size(), delays.size());
+    std::vector<uint64_t> sorted = delays;
+    std::sort(sorted.begin(), sorted.end());
+    for(size_t i = 0; i < fired.at.size() && i < sorted.size(); i++) {
+        CHECK(fired.at[i] == sorted[i], "#%zu fired at %llu, expected %llu", i,
+              (unsigned long long)fired.at[i], (unsigned long long)sorted[i]);
+        CHECK(fired.at[i] == delays[fired.id[i]], "entry %d fired at %llu", fired.id[i], (unsigned long long)fired.at[i]);
+    }
+    for(TickerWheel::Entry &e : entries) {
+        CHECK(!e.active() && e.fired() == 1, "entry still active or fired %u times", e.fired());
+    }
+    // a wake up per cascade step at most, not one per slot of idle time
+    CHECK(calls < delays.size() * TICKER_WHEEL_LEVELS * 2, "%zu advance() calls", calls);
+
+    uint64_t when;
+    CHECK(!wheel.nextExpiry(&when), "wheel not empty");
+    ticker_wheel_stats_t stats;
+    wheel.getStats(&stats);
+    CHECK(stats.fired == delays.size() && stats.maxLateUs == 0, "fired %u, max late %u", stats.fired, stats.maxLateUs);
+    printf("cascade ok, %zu deadlines in %zu wake ups\n", delays.size(), calls);
+}
+
+static void testCancel()
+{
+    s_now = 1000;
+    s_armed = UINT64_MAX;
+    TickerWheel wheel(arm);
+    TickerWheel::Entry near, far, overflow, other;
+    Fired fired;
+
+    wheel.schedule(&near, s_now, 10, 0, fired.record(0));
+    wheel.schedule(&far, s_now, LEVEL_US(4) + 7, 0, fired.record(1));
+    wheel.schedule(&overflow, s_now, WHEEL_SPAN_US + 7, 0, fired.record(2));
+    // at the deadline or earlier, to move the entry down a level
+    CHECK(s_armed <= 1010, "armed at %llu", (unsigned long long)s_armed);
+
+    // the wheel arms for the next entry once the first is cancelled
+    CHECK(wheel.cancel(&near), "near was active");
+    CHECK(!wheel.cancel(&near), "near cancelled twice");
+    CHECK(!near.active(), "near still active");
+    uint64_t when;
+    CHECK(wheel.nextExpiry(&when) && when > 1010 && when <= 1000 + LEVEL_US(4) + 7, "next at %llu", (unsigned long long)when);
+
+    CHECK(wheel.cancel(&far) && wheel.cancel(&overflow), "far entries were active");
+    CHECK(!wheel.nextExpiry(&when), "wheel not empty");
+    runUntil(wheel, WHEEL_SPAN_US * 2);
+    CHECK(fired.at.empty(), "%zu cancelled entries fired", fired.at.size());
+
+    // a callback cancels itself and another entry due later in the same batch
+    TickerWheel::Entry self;
+    int selfRuns = 0;
+    wheel.schedule(&self, s_now, 50, 5, [&] {
+        selfRuns++;
+        CHECK(wheel.cancel(&self), "self not active in its callback");
+        wheel.cancel(&other);
+    });
+    wheel.schedule(&other, s_now, 60, 0, fired.record(3));
+    s_now += 100;
+    s_armed = UINT64_MAX;
+    wheel.advance(s_now);
+    runUntil(wheel, s_now + 1000);
+    CHECK(selfRuns == 1, "self ran %d times", selfRuns);
+    CHECK(fired.at.empty(), "other ran after it was cancelled");
+    CHECK(!self.active() && !other.active(), "entries still active");
+    printf("cancel ok\n");
+}
+
+static void testRearm()
+{
+    s_now = 0;
+    s_armed = UINT64_MAX;
+    TickerWheel wheel(arm);
+    TickerWheel::Entry entry;
+    Fired fired;
+
+    // scheduling an active entry again replaces its deadline
+    wheel.schedule(&entry, s_now, LEVEL_US(3) * 5, 0, fired.record(0));
+    wheel.schedule(&entry, s_now, 100, 0, fired.record(1));
+    runUntil(wheel, LEVEL_US(3) * 10);
+    CHECK(fired.at.size() == 1 && fired.at[0] == 100 && fired.id[0] == 1, "%zu fired, first at %llu",
+          fired.at.size(), fired.at.empty() ? 0ULL : (unsigned long long)fired.at[0]);
+
+    // and so does the other way round, from near to far
+    fired = Fired();
+    uint64_t start = s_now;
+    wheel.schedule(&entry, s_now, 100, 0, fired.record(0));
+    wheel.schedule(&entry, s_now, LEVEL_US(3) * 5, 0, fired.record(1));
+    runUntil(wheel, s_now + LEVEL_US(3) * 10);
+    CHECK(fired.at.size() == 1 && fired.at[0] == start + LEVEL_US(3) * 5, "%zu fired", fired.at.size());
+
+    // a one shot entry re-arms itself from its callback, the new run waits for the next batch
+    fired = Fired();
+    start = s_now;
+    int runs = 0;
+    std::function<void()> again = [&] {
+        fired.at.push_back(s_now);
+        if(++runs < 4) {
+            wheel.schedule(&entry, s_now, runs == 1 ? 0 : LEVEL_US(runs), 0, again);
+        }
+    };
+    wheel.schedule(&entry, s_now, 10, 0, again);
+    while(s_armed != UINT64_MAX) {
+        s_now = s_armed > s_now ? s_armed : s_now;
+        s_armed = UINT64_MAX;
+        CHECK(wheel.advance(s_now) <= 1, "entry ran twice in one batch");
+    }
+    CHECK(runs == 4, "ran %d times", runs);
+    if(runs == 4) {
+        CHECK(fired.at[0] == start + 10 && fired.at[1] == fired.at[0] && fired.at[2] == fired.at[1] + LEVEL_US(2)
+              && fired.at[3] == fired.at[2] + LEVEL_US(3), "re-armed runs at the wrong times");
+    }
+
+    // a periodic entry changes its period from its callback
+    fired = Fired();
+    start = s_now;
+    wheel.schedule(&entry, s_now, 100, 100, [&] {
+        fired.at.push_back(s_now);
+        if(fired.at.size() == 3) {
+            wheel.schedule(&entry, s_now, 1000, 1000, [&] { fired.at.push_back(s_now); });
+        }
+    });
+    runUntil(wheel, start + 300 + 3500);
+    static const uint64_t expected[] = { 100, 200, 300, 1300, 2300, 3300 };
+    CHECK(fired.at.size() == 6, "fired %zu times", fired.at.size());
+    for(size_t i = 0; i < fired.at.size() && i < 6; i++) {
+        CHECK(fired.at[i] == start + expected[i], "#%zu at %llu", i, (unsigned long long)(fired.at[i] - start));
+    }
+    wheel.cancel(&entry);
+    printf("re-arm ok\n");
+}
+
+static void testLate()
+{
+    s_now = 0;
+    s_armed = UINT64_MAX;
+    TickerWheel wheel(arm);
+    TickerWheel::Entry entry;
+    Fired fired;
+
+    // the timer fires 250 us late: one run, two periods skipped, then back on the grid
+    wheel.schedule(&entry, s_now, 100, 100, fired.record(0));
+    s_now = 350;
+    wheel.advance(s_now);
+    CHECK(fired.at.size() == 1, "ran %zu times late", fired.at.size());
+    CHECK(entry.overruns() == 2 && entry.maxLateUs() == 250, "overruns %u, late %u", entry.overruns(), entry.maxLateUs());
+    CHECK(s_armed <= 400, "armed at %llu", (unsigned long long)s_armed);
+    runUntil(wheel, 600);
+    CHECK(fired.at.size() == 4 && fired.at[3] == 600, "ran %zu times", fired.at.size());
+
+    ticker_wheel_stats_t stats;
+    wheel.getStats(&stats);
+    CHECK(stats.overruns == 2 && stats.maxLateUs == 250 && stats.totalLateUs == 250, "stats overruns %u late %u total %llu",
+          stats.overruns, stats.maxLateUs, (unsigned long long)stats.totalLateUs);
+    wheel.resetStats();
+    wheel.getStats(&stats);
+    CHECK(stats.fired == 0 && stats.batches == 0, "stats not reset");
+    wheel.cancel(&entry);
+    printf("late ok\n");
+}
+
+/*
+  Random run against a reference model
+*/
+
+#define JOBS    300
+#define STEPS   200000
+
+struct Job {
+    TickerWheel::Entry entry;
+    bool on;
+    uint64_t expect;
+    uint64_t period;
+    uint32_t fires;
+};
+
+static void testRandom()
+{
+    std::mt19937_64 rng(1);
+    s_now = 0;
+    s_armed = UINT64_MAX;
+    TickerWheel wheel(arm);
+    std::vector<Job> jobs(JOBS);
+    uint64_t lastDeadline = 0;
+    long fired = 0, bad = 0;
+
+    auto schedule = [&](int i) {
+        Job &job = jobs[i];
+        uint64_t kind = rng() % 10;
+        uint64_t delay = kind < 3 ? rng() % 100 : kind < 6 ? rng() % 100000 : kind < 9 ? rng() % 100000000 : rng() % (1ULL << 40);
+        job.period = (rng() % 3) ? (kind < 3 ? 1 + rng() % 200 : 1 + rng() % 2000000) : 0;
+        job.expect = s_now + delay;
+        job.on = true;
+        wheel.schedule(&job.entry, s_now, delay, job.period, [&, i] {
+            Job &k = jobs[i];
+            fired++;
+            if(!k.on || k.expect > s_now || k.expect < lastDeadline) {
+                if(bad++ < 10) {
+                    printf("job %d ran at %llu, deadline %llu, on %d\n", i, (unsigned long long)s_now, (unsigned long long)k.expect, k.on);
+                }
+            }
+            lastDeadline = k.expect;
+            if(k.period) {
+                uint64_t next = k.expect + k.period;
+                if(next <= s_now) {
+                    next = k.expect + ((s_now - k.expect) / k.period + 1) * k.period;
+                }
+                k.expect = next;
+            } else {
+                k.on = false;
+            }
+            // now and then cancel itself or another job from the callback
+            uint64_t r = rng() % 1000;
+            if(r == 0) {
+                wheel.cancel(&k.entry);
+                k.on = false;
+            } else if(r == 1) {
+                int other = rng() % JOBS;
+                wheel.cancel(&jobs[other].entry);
+                jobs[other].on = false;
+            }
+        });
+    };
+
+    for(int i = 0; i < JOBS; i++) {
+        schedule(i);
+    }
+    long steps = 0;
+    while(steps < STEPS && !bad) {
+        uint64_t next = UINT64_MAX;
+        for(Job &job : jobs) {
+            if(job.on && job.expect < next) {
+                next = job.expect;
+            }
+        }
+        if(next == UINT64_MAX) {
+            for(int i = 0; i < JOBS; i++) {
+                schedule(i);
+            }
+            continue;
+        }
+        uint64_t when;
+        CHECK(wheel.nextExpiry(&when) && when <= next, "wheel next %llu after deadline %llu", (unsigned long long)when, (unsigned long long)next);
+        CHECK(s_armed <= next, "armed at %llu after deadline %llu", (unsigned long long)s_armed, (unsigned long long)next);
+
+        // the timer fires when armed, now and then late
+        s_now = s_armed > s_now ? s_armed : s_now;
+        if(rng() % 50 == 0) {
+            s_now += rng() % 5000;
+        }
+        s_armed = UINT64_MAX;
+        lastDeadline = 0;
+        wheel.advance(s_now);
+        for(int i = 0; i < JOBS; i++) {
+            if(jobs[i].on && jobs[i].expect <= s_now) {
+                if(bad++ < 10) {
+                    printf("job %d due at %llu did not run by %llu\n", i, (unsigned long long)jobs[i].expect, (unsigned long long)s_now);
+                }
+            }
+        }
+
+        if(rng() % 100 == 0) {
+            int i = rng() % JOBS;
+            if(rng() % 2) {
+                wheel.cancel(&jobs[i].entry);
+                jobs[i].on = false;
+            } else {
+                schedule(i);
+            }
+        }
+        steps++;
+    }
+    CHECK(bad == 0, "%ld wrong callbacks", bad);
+    ticker_wheel_stats_t stats;
+    wheel.getStats(&stats);
+    printf("random ok, %ld steps, %ld callbacks, %u overruns, largest batch %u\n", steps, fired, stats.overruns, stats.maxBatch);
+}
+
+static void bench()
+{
+    TickerWheel wheel;
+    std::vector<TickerWheel::Entry> entries(300);
+    long count = 0;
+    for(size_t i = 0; i < entries.size(); i++) {
+        wheel.schedule(&entries[i], 0, 1000 + i * 37, 1000 + i * 37, [&] { count++; });
+    }
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint64_t now = 0;
+    while(now < 60000000ULL && wheel.nextExpiry(&now)) {
+        wheel.advance(now);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    printf("bench: 300 periodic entries, %ld callbacks, %.0f ns each\n", count, seconds * 1e9 / count);
+}
+
+int main(int argc, char **argv)
+{
+    testCascade();
+    testCancel();
+    testRearm();
+    testLate();
+    testRandom();
+    if(argc > 1 && !strcmp(argv[1], "bench")) {
+        bench();
+    }
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,47 @@
+#!/usr/bin/env python
+#
+# Writes an old and a new firmware-like image for the UpdateDelta test:
+# code words with absolute addresses, data and small values, then the new
+# image inserts a block, relocates the addresses after it and changes a few
+# words, which is what a rebuilt sketch looks like to the patch tool.
+
+from __future__ import print_function
+
+import random
+import struct
+import sys
+
+CODE = 0x400D0000
+SIZE = 256 * 1024
+INSERT = 40 * 1024
+
+
+def main(directory):
+    rng = random.Random(1)
+    words = []
+    for _ in range(SIZE // 4):
+        r = rng.random()
+        if r < 0.25:
+            words.append(CODE + rng.randrange(0, 0x90000))
+        elif r < 0.7:
+            words.append(rng.getrandbits(32))
+        else:
+            words.append(rng.getrandbits(8))
+
+    new = []
+    for i, w in enumerate(words):
+        if i == INSERT // 4:
+            new += [rng.getrandbits(32) for _ in range(75)]
+        if CODE + INSERT < w < CODE + 0x90000:
+            w += 300
+        if rng.random() < 0.001:
+            w = rng.getrandbits(32)
+        new.append(w)
+
+    for name, data in (("old.bin", words), ("new.bin", new)):
+        with open(directory + "/" + name, "wb") as f:
+            f.write(b"".join(struct.pack("<I", w) for w in data))
+
+
+if __name__ == "__main__":
+    main(sys.argv[1])
@@ -0,0 +1,300 @@
+/*
+ * Host test of UpdateDelta, the patch applier HTTPUpdate runs on the device
+ *
+ *   test_update_delta <dir>
+ *
+ * <dir> holds old.bin and new.bin from make_images.py and the patches that
+ * tools/esp_delta.py created from them: patch.bin (zlib), plain.bin
+ * (--no-compress) and back.bin (new back to old). Every patch is fed in
+ * random chunk sizes down to single bytes, so control records and diff runs
+ * are split across write() calls and the inflate ring wraps many times.
+ * Hand made patches check that records reaching outside either image and
+ * broken bodies are refused.
+ */
+
+#include "UpdateDelta.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "esp32/rom/miniz.h"
+
+size_t tinfl_host_wraps;
+
+typedef std::vector<uint8_t> Bytes;
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+    if(!(cond)) { \
+        failures++; \
+        printf("FAIL %s:%d: %s: ", __FILE__, __LINE__, #cond); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+    } \
+} while(0)
+
+static Bytes readFile(const std::string &path)
+{
+    Bytes data;
+    FILE *f = fopen(path.c_str(), "rb");
+    if(!f) {
+        printf("cannot open %s\n", path.c_str());
+        exit(2);
+    }
+    uint8_t buf[4096];
+    size_t n;
+    while((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(f);
+    return data;
+}
+
+enum Chunking {
+    CHUNK_BYTES,        // one byte per write()
+    CHUNK_SMALL,        // 1 to 16
+    CHUNK_LARGE,        // 1 to 4096
+    CHUNK_WHOLE         // the whole body at once
+};
+
+struct Result {
+    bool begun;
+    bool ended;
+    uint8_t error;
+    bool readOutside;   // the applier asked for old data outside the image
+    Bytes out;
+};
+
+static Result apply(const Bytes &old, const Bytes &patch, Chunking chunking, uint32_t seed)
+{
+    Result result = { false, false, UPDATE_DELTA_ERROR_OK, false, Bytes() };
+    update_delta_header_t header;
+    if(patch.size() < sizeof(header)) {
+        return result;
+    }
+    memcpy(&header, patch.data(), sizeof(header));
+
+    UpdateDelta delta;
+    result.begun = delta.begin(header,
+        [&](uint32_t offset, uint8_t *buf, size_t len) {
+            if(offset > old.size() || len > old.size() - offset) {
+                result.readOutside = true;
+                return false;
+            }
+            memcpy(buf, old.data() + offset, len);
+            return true;
+        },
+        [&](const uint8_t *buf, size_t len) {
+            result.out.insert(result.out.end(), buf, buf + len);
+            return true;
+        });
+    if(!result.begun) {
+        result.error = delta.getError();
+        return result;
+    }
+
+    std::mt19937 rng(seed);
+    size_t pos = sizeof(header);
+    while(pos < patch.size()) {
+        size_t len = patch.size() - pos;
+        switch(chunking) {
+        case CHUNK_BYTES:
+            len = 1;
+            break;
+        case CHUNK_SMALL:
+            len = std::min<size_t>(len, 1 + rng() % 16);
+            break;
+        case CHUNK_LARGE:
+            len = std::min<size_t>(len, 1 + rng() % 4096);
+            break;
+        case CHUNK_WHOLE:
+            break;
+        }
+        size_t used = delta.write(patch.data() + pos, len);
+        pos += used;
+        if(used < len) {
+            break;
+        }
+    }
+    result.error = delta.getError();
+    result.ended = delta.end();
+    return result;
+}
+
+static const char *chunkingName(Chunking chunking)
+{
+    static const char *names[] = { "bytes", "small", "large", "whole" };
+    return names[chunking];
+}
+
+static void testPatch(const Bytes &old, const Bytes &expected, const Bytes &patch, const char *name, bool compressed)
+{
+    for(int c = CHUNK_BYTES; c <= CHUNK_WHOLE; c++) {
+        for(uint32_t seed = 1; seed <= (c == CHUNK_SMALL || c == CHUNK_LARGE ? 4 : 1); seed++) {
+            tinfl_host_wraps = 0;
+            Result r = apply(old, patch, (Chunking)c, seed);
+            CHECK(r.begun && r.ended && r.error == UPDATE_DELTA_ERROR_OK, "%s/%s: error %u", name, chunkingName((Chunking)c), r.error);
+            CHECK(!r.readOutside, "%s/%s", name, chunkingName((Chunking)c));
+            CHECK(r.out == expected, "%s/%s: %zu bytes out, %zu expected", name, chunkingName((Chunking)c), r.out.size(), expected.size());
+            if(compressed) {
+                CHECK(tinfl_host_wraps > 0, "%s/%s: inflate ring never wrapped", name, chunkingName((Chunking)c));
+            }
+        }
+    }
+    printf("%-10s %7zu bytes -> %7zu bytes ok\n", name, patch.size(), expected.size());
+}
+
+/*
+  Hand made patches
+*/
+
+struct Record {
+    uint32_t diff;
+    uint32_t extra;
+    int32_t seek;
+};
+
+static void putLE32(Bytes &out, uint32_t v)
+{
+    for(int i = 0; i < 4; i++) {
+        out.push_back(v >> (8 * i));
+    }
+}
+
+static Bytes makeBody(const std::vector<Record> &records)
+{
+    Bytes body;
+    for(const Record &r : records) {
+        putLE32(body, r.diff);
+        putLE32(body, r.extra);
+        putLE32(body, (uint32_t)r.seek);
+        // records that are refused anyway do not need all their bytes
+        body.insert(body.end(), std::min<uint32_t>(r.diff, 256), 0);    // new = old
+        body.insert(body.end(), std::min<uint32_t>(r.extra, 256), 0xA5);
+    }
+    return body;
+}
+
+static Bytes makePatch(uint32_t oldSize, uint32_t newSize, const Bytes &body, bool compress)
+{
+    update_delta_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, UPDATE_DELTA_MAGIC, sizeof(header.magic));
+    header.version = UPDATE_DELTA_VERSION;
+    header.flags = compress ? UPDATE_DELTA_FLAG_ZLIB : 0;
+    header.oldSize = oldSize;
+    header.newSize = newSize;
+
+    Bytes patch((const uint8_t *)&header, (const uint8_t *)&header + sizeof(header));
+    if(compress) {
+        size_t at = patch.size();
+        uLongf len = compressBound(body.size());
+        patch.resize(at + len);
+        compress2(patch.data() + at, &len, body.data(), body.size(), 9);
+        patch.resize(at + len);
+    } else {
+        patch.insert(patch.end(), body.begin(), body.end());
+    }
+    return patch;
+}
+
+static void expectRefused(const Bytes &old, const Bytes &patch, const char *name, uint8_t error)
+{
+    for(int c = CHUNK_BYTES; c <= CHUNK_WHOLE; c++) {
+        Result r = apply(old, patch, (Chunking)c, 1);
+        CHECK(!r.ended, "%s/%s: accepted", name, chunkingName((Chunking)c));
+        CHECK(!r.readOutside, "%s/%s", name, chunkingName((Chunking)c));
+        if(error != UPDATE_DELTA_ERROR_OK) {
+            CHECK(r.error == error, "%s/%s: error %u, expected %u", name, chunkingName((Chunking)c), r.error, error);
+        }
+    }
+}
+
+static void testHandMade()
+{
+    Bytes old(100);
+    for(size_t i = 0; i < old.size(); i++) {
+        old[i] = i;
+    }
+
+    // sanity: copy 60, insert 5, skip 20, copy the last 20
+    std::vector<Record> good = { { 60, 5, 20 }, { 20, 0, 0 } };
+    Bytes expected(old.begin(), old.begin() + 60);
+    expected.insert(expected.end(), 5, 0xA5);
+    expected.insert(expected.end(), old.begin() + 80, old.end());
+    for(int compress = 0; compress < 2; compress++) {
+        Bytes patch = makePatch(old.size(), expected.size(), makeBody(good), compress);
+        Result r = apply(old, patch, CHUNK_BYTES, 1);
+        CHECK(r.ended && r.out == expected, "hand made %s patch", compress ? "zlib" : "plain");
+    }
+
+    for(int compress = 0; compress < 2; compress++) {
+        uint8_t patchError = UPDATE_DELTA_ERROR_PATCH;
+        expectRefused(old, makePatch(100, 150, makeBody({ { 150, 0, 0 } }), compress), "diff past old end", patchError);
+        expectRefused(old, makePatch(100, 100, makeBody({ { 60, 0, 0 }, { 50, 0, 0 } }), compress), "second diff past old end", patchError);
+        expectRefused(old, makePatch(100, 100, makeBody({ { 50, 60, 0 } }), compress), "extra past new end", patchError);
+        expectRefused(old, makePatch(100, 100, makeBody({ { 10, 0, -20 }, { 90, 0, 0 } }), compress), "seek before old start", patchError);
+        expectRefused(old, makePatch(100, 100, makeBody({ { 10, 0, 200 }, { 90, 0, 0 } }), compress), "seek past old end", patchError);
+        expectRefused(old, makePatch(100, 100, makeBody({ { 0xFFFFFFF0, 0, 0 } }), compress), "huge diff", patchError);
+        expectRefused(old, makePatch(100, 100, makeBody({ { 50, 0xFFFFFFF0, 0 } }), compress), "huge extra", patchError);
+
+        Bytes trailing = makeBody({ { 100, 0, 0 } });
+        trailing.push_back(0);
+        expectRefused(old, makePatch(100, 100, trailing, compress), "trailing bytes", patchError);
+
+        Bytes truncated = makeBody({ { 100, 0, 0 } });
+        truncated.resize(truncated.size() - 7);
+        expectRefused(old, makePatch(100, 100, truncated, compress), "truncated body",
+            compress ? UPDATE_DELTA_ERROR_PATCH : UPDATE_DELTA_ERROR_OK);
+    }
+
+    // zlib data that is damaged, or cut before the end of its stream
+    Bytes patch = makePatch(100, 100, makeBody({ { 60, 5, 20 }, { 20, 15, 0 } }), true);
+    CHECK(apply(old, patch, CHUNK_WHOLE, 1).ended, "zlib patch to damage");
+    Bytes damaged = patch;
+    damaged[sizeof(update_delta_header_t) + 4] ^= 0x5A;
+    damaged[damaged.size() - 2] ^= 0x5A;
+    expectRefused(old, damaged, "damaged zlib", UPDATE_DELTA_ERROR_OK);
+    Bytes cut(patch.begin(), patch.end() - 6);
+    expectRefused(old, cut, "cut zlib", UPDATE_DELTA_ERROR_OK);
+    Bytes noChecksum(patch.begin(), patch.end() - 4);
+    expectRefused(old, noChecksum, "no zlib checksum", UPDATE_DELTA_ERROR_OK);
+
+    // headers this version does not know
+    Bytes bad = makePatch(100, 100, makeBody({ { 100, 0, 0 } }), false);
+    bad[0] = 'X';
+    expectRefused(old, bad, "bad magic", UPDATE_DELTA_ERROR_HEADER);
+    bad = makePatch(100, 100, makeBody({ { 100, 0, 0 } }), false);
+    bad[4] = UPDATE_DELTA_VERSION + 1;
+    expectRefused(old, bad, "bad version", UPDATE_DELTA_ERROR_HEADER);
+    bad = makePatch(100, 100, makeBody({ { 100, 0, 0 } }), false);
+    bad[5] = 0x80;
+    expectRefused(old, bad, "unknown flag", UPDATE_DELTA_ERROR_HEADER);
+    expectRefused(old, makePatch(100, 0, Bytes(), false), "empty new image", UPDATE_DELTA_ERROR_HEADER);
+
+    printf("hand made patches done\n");
+}
+
+int main(int argc, char **argv)
+{
+    if(argc != 2) {
+        printf("usage: %s <dir>\n", argv[0]);
+        return 2;
+    }
+    std::string dir = argv[1];
+    Bytes oldImage = readFile(dir + "/old.bin");
+    Bytes newImage = readFile(dir + "/new.bin");
+
+    testPatch(oldImage, newImage, readFile(dir + "/patch.bin"), "zlib", true);
+    testPatch(oldImage, newImage, readFile(dir + "/plain.bin"), "plain", false);
+    testPatch(newImage, oldImage, readFile(dir + "/back.bin"), "backwards", true);
+    testHandMade();
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,484 @@
+/*
+ * Host test of the shared work queue, esp32-hal-workqueue.c, on the
+ * pthread FreeRTOS in common/
+ *
+ *   test_workqueue [bench]
+ *
+ * Built three times: for one core with a single shared worker, where lane
+ * order and a blocked worker can be checked exactly, for two cores with the
+ * single worker pinned to core 1, as on the ESP32, and for two cores with
+ * two workers each, where items really run side by side. "bench" also
+ * prints the cost of a post and run.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "esp32-hal.h"
+#include "esp32-hal-workqueue.h"
+#include "freertos/semphr.h"
+
+#define SHARED_WORKERS ((WORK_QUEUE_ALL_CORES ? portNUM_PROCESSORS : 1) * WORK_QUEUE_WORKERS_PER_CORE)
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+    if(!(cond)) { \
+        failures++; \
+        printf("FAIL %s:%d: %s: ", __FILE__, __LINE__, #cond); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+    } \
+} while(0)
+
+// polls for up to 10 s, the workers run on their own threads
+template <typename F>
+static bool waitFor(F done)
+{
+    for(int i = 0; i < 10000; i++) {
+        if(done()) {
+            return true;
+        }
+        usleep(1000);
+    }
+    return done();
+}
+
+static double seconds()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static work_queue_stats_t stats()
+{
+    work_queue_stats_t s;
+    workQueueGetStats(&s);
+    return s;
+}
+
+/*
+  Holds up the workers it runs on until released, like an onPacket()
+  handler that blocks
+*/
+
+struct Gate {
+    SemaphoreHandle_t release;
+    std::atomic<int> holding;
+    std::atomic<int> onCore[portNUM_PROCESSORS + 1];   // held workers by core, [0] for any core
+
+    Gate() : release(xSemaphoreCreateCounting(64, 0)), holding(0), onCore() {}
+    ~Gate() { vSemaphoreDelete(release); }
+
+    static void run(void *arg)
+    {
+        Gate *gate = (Gate *)arg;
+        gate->onCore[xTaskGetCurrentTaskHandle()->core + 1]++;
+        gate->holding++;
+        xSemaphoreTake(gate->release, portMAX_DELAY);
+        gate->holding--;
+    }
+
+    // blocks count shared workers
+    bool close(int count)
+    {
+        for(int i = 0; i < count; i++) {
+            if(!workQueuePost(run, this, WORK_PRIORITY_HIGH)) {
+                return false;
+            }
+        }
+        return waitFor([&] { return holding == count; });
+    }
+
+    void open(int count)
+    {
+        for(int i = 0; i < count; i++) {
+            xSemaphoreGive(release);
+        }
+        waitFor([&] { return holding == 0; });
+    }
+};
+
+/*
+  The shared workers run on WORK_QUEUE_RUNNING_CORE, or on every core
+*/
+
+static void testPlacement()
+{
+    Gate gate;
+    CHECK(gate.close(SHARED_WORKERS), "shared workers not held");
+    if(WORK_QUEUE_ALL_CORES && portNUM_PROCESSORS > 1) {
+        for(int core = 0; core < portNUM_PROCESSORS; core++) {
+            CHECK(gate.onCore[core + 1] == WORK_QUEUE_WORKERS_PER_CORE, "%d workers on core %d", gate.onCore[core + 1].load(), core);
+        }
+    } else {
+        CHECK(gate.onCore[WORK_QUEUE_RUNNING_CORE + 1] == SHARED_WORKERS, "%d workers on core %d", gate.onCore[WORK_QUEUE_RUNNING_CORE + 1].load(), WORK_QUEUE_RUNNING_CORE);
+    }
+    gate.open(SHARED_WORKERS);
+    printf("placement ok\n");
+}
+
+/*
+  Lanes: highest first, each at its task priority. Needs the single worker.
+*/
+
+struct Ran {
+    std::atomic<int> count;
+    UBaseType_t priority[8];
+    int id[8];
+};
+
+struct Tagged {
+    Ran *ran;
+    int id;
+};
+
+static void record(void *arg)
+{
+    Tagged *t = (Tagged *)arg;
+    int n = t->ran->count.load();
+    t->ran->id[n] = t->id;
+    t->ran->priority[n] = uxTaskPriorityGet(NULL);
+    t->ran->count++;
+}
+
+static void testLanes()
+{
+    Gate gate;
+    CHECK(gate.close(1), "worker not held");
+    Ran ran;
+    ran.count = 0;
+    Tagged tags[] = { { &ran, WORK_PRIORITY_LOW }, { &ran, WORK_PRIORITY_NORMAL }, { &ran, WORK_PRIORITY_HIGH },
+                      { &ran, WORK_PRIORITY_LOW + 10 }, { &ran, WORK_PRIORITY_HIGH + 10 } };
+    for(Tagged &t : tags) {
+        workQueuePost(record, &t, (work_priority_t)(t.id % 10));
+    }
+    gate.open(1);
+    CHECK(waitFor([&] { return ran.count == 5; }), "ran %d of 5", ran.count.load());
+
+    static const int expected[] = { WORK_PRIORITY_HIGH, WORK_PRIORITY_HIGH + 10, WORK_PRIORITY_NORMAL,
+                                    WORK_PRIORITY_LOW, WORK_PRIORITY_LOW + 10 };
+    static const UBaseType_t taskPriority[] = { WORK_QUEUE_PRIORITY_LOW, WORK_QUEUE_PRIORITY_NORMAL, WORK_QUEUE_PRIORITY_HIGH };
+    for(int i = 0; i < 5; i++) {
+        CHECK(ran.id[i] == expected[i], "#%d ran %d, expected %d", i, ran.id[i], expected[i]);
+        CHECK(ran.priority[i] == taskPriority[ran.id[i] % 10], "#%d ran at priority %u", i, ran.priority[i]);
+    }
+    printf("lanes ok\n");
+}
+
+/*
+  A strand bound to its own worker keeps running while every shared worker
+  is blocked, on the core and at the priority it was created with
+*/
+
+struct EventLog {
+    std::atomic<int> count;
+    std::atomic<int> wrongTask;
+};
+
+static TaskHandle_t s_eventTask;
+
+static void eventRun(void *arg)
+{
+    EventLog *log = (EventLog *)arg;
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    if(!s_eventTask) {
+        s_eventTask = task;
+    }
+    if(!task || task != s_eventTask || strcmp(task->name, "arduino_events") || task->priority != 18 || task->core != 1) {
+        log->wrongTask++;
+    }
+    log->count++;
+}
+
+static void testOwnWorker()
+{
+    work_worker_t *worker = workWorkerCreate("arduino_events", 4096, 18, 1);
+    CHECK(worker, "worker not created");
+    if(!worker) {
+        return;
+    }
+    CHECK(stats().own_workers == 1, "%u own workers", stats().own_workers);
+
+    Gate gate;
+    CHECK(gate.close(SHARED_WORKERS), "shared workers not held");
+
+    EventLog log;
+    log.count = 0;
+    log.wrongTask = 0;
+    work_strand_t strand;
+    workStrandInit(&strand, WORK_PRIORITY_HIGH);
+    workStrandBind(&strand, worker);
+    for(int i = 0; i < 100; i++) {
+        CHECK(workStrandPost(&strand, eventRun, &log), "post %d", i);
+    }
+    CHECK(waitFor([&] { return log.count == 100; }), "%d of 100 events ran behind blocked shared workers", log.count.load());
+    CHECK(log.wrongTask == 0, "%d events ran on the wrong task", log.wrongTask.load());
+
+    // an owned item bound to the worker, like the AsyncUDP drain
+    std::atomic<int> runs(0);
+    work_item_t item;
+    workItemInit(&item, [](void *arg) { (*(std::atomic<int> *)arg)++; }, &runs, WORK_PRIORITY_NORMAL);
+    workItemBind(&item, worker);
+    CHECK(workQueueSubmit(&item), "bound item refused");
+    CHECK(waitFor([&] { return runs == 1 && !workItemPending(&item); }), "bound item ran %d times", runs.load());
+
+    gate.open(SHARED_WORKERS);
+    printf("own worker ok\n");
+}
+
+/*
+  Strands from several threads: each runs in order and never on two
+  workers at once, shared or bound
+*/
+
+#define STRANDS         4
+#define STRAND_POSTS    20000
+
+struct StrandCheck {
+    work_strand_t strand;
+    std::atomic<int> inside;
+    std::atomic<int> last;
+    int overlaps;
+    int disorders;
+};
+
+struct StrandPost {
+    StrandCheck *check;
+    int seq;
+};
+
+static void strandStep(void *arg)
+{
+    StrandPost *post = (StrandPost *)arg;
+    StrandCheck *check = post->check;
+    if(check->inside++) {
+        check->overlaps++;
+    }
+    if(post->seq != check->last + 1) {
+        check->disorders++;
+    }
+    check->last = post->seq;
+    check->inside--;
+}
+
+static void testStrands(work_worker_t *worker)
+{
+    static StrandCheck checks[STRANDS];
+    static StrandPost posts[STRANDS][STRAND_POSTS];
+    for(int s = 0; s < STRANDS; s++) {
+        checks[s].inside = 0;
+        checks[s].last = 0;
+        checks[s].overlaps = 0;
+        checks[s].disorders = 0;
+        workStrandInit(&checks[s].strand, (work_priority_t)(s % WORK_PRIORITY_MAX));
+        if(s == STRANDS - 1) {
+            workStrandBind(&checks[s].strand, worker);
+        }
+    }
+
+    std::vector<std::thread> posters;
+    for(int s = 0; s < STRANDS; s++) {
+        posters.emplace_back([s] {
+            for(int i = 0; i < STRAND_POSTS; i++) {
+                posts[s][i].check = &checks[s];
+                posts[s][i].seq = i + 1;
+                while(!workStrandPost(&checks[s].strand, strandStep, &posts[s][i])) {
+                    usleep(10);
+                }
+            }
+        });
+    }
+    for(std::thread &t : posters) {
+        t.join();
+    }
+    for(int s = 0; s < STRANDS; s++) {
+        StrandCheck &c = checks[s];
+        CHECK(waitFor([&] { return c.last == STRAND_POSTS; }), "strand %d ran %d of %d", s, c.last.load(), STRAND_POSTS);
+        CHECK(c.overlaps == 0, "strand %d overlapped %d times", s, c.overlaps);
+        CHECK(c.disorders == 0, "strand %d out of order %d times", s, c.disorders);
+    }
+    printf("strands ok\n");
+}
+
+/*
+  An owned item submitted over and over from several threads never runs
+  twice at once, and always runs once more after the last submit
+*/
+
+struct Owned {
+    work_item_t item;
+    std::atomic<int> inside;
+    std::atomic<int> overlaps;
+    std::atomic<int> runs;
+    std::atomic<int> latest;    // set before each submit
+    std::atomic<int> seen;      // latest as of the last run
+};
+
+static void ownedRun(void *arg)
+{
+    Owned *owned = (Owned *)arg;
+    if(owned->inside++) {
+        owned->overlaps++;
+    }
+    owned->seen = owned->latest.load();
+    owned->runs++;
+    for(volatile int i = 0; i < 100; i++) {
+    }
+    owned->inside--;
+}
+
+static void testOwnedItem()
+{
+    static Owned owned;
+    owned.inside = 0;
+    owned.overlaps = 0;
+    owned.runs = 0;
+    owned.latest = 0;
+    owned.seen = -1;
+    workItemInit(&owned.item, ownedRun, &owned, WORK_PRIORITY_NORMAL);
+
+    std::vector<std::thread> submitters;
+    for(int t = 0; t < 3; t++) {
+        submitters.emplace_back([t] {
+            for(int i = 0; i < 50000; i++) {
+                owned.latest = t * 50000 + i;
+                workQueueSubmit(&owned.item);
+            }
+        });
+    }
+    for(std::thread &t : submitters) {
+        t.join();
+    }
+    int latest = owned.latest;
+    CHECK(waitFor([&] { return !workItemPending(&owned.item); }), "item still pending");
+    CHECK(owned.overlaps == 0, "item ran %d times on two workers", owned.overlaps.load());
+    CHECK(owned.seen == latest, "last run saw %d, last submit was %d", owned.seen.load(), latest);
+    printf("owned item ok, %d submits ran %d times\n", 150000, owned.runs.load());
+}
+
+/*
+  The pool grows from the heap for tasks, shrinks back afterwards, and
+  never allocates in an ISR
+*/
+
+static void testPool()
+{
+    std::atomic<int> done(0);
+    work_fn_t count = [](void *arg) { (*(std::atomic<int> *)arg)++; };
+
+    Gate gate;
+    CHECK(gate.close(SHARED_WORKERS), "shared workers not held");
+    work_queue_stats_t before = stats();
+
+    const int burst = 4 * WORK_QUEUE_POOL_SIZE;
+    for(int i = 0; i < burst; i++) {
+        CHECK(workQueuePost(count, &done, WORK_PRIORITY_NORMAL), "task post %d", i);
+    }
+    CHECK(stats().pool_size >= burst, "pool did not grow: %u", stats().pool_size);
+    gate.open(SHARED_WORKERS);
+    CHECK(waitFor([&] { return done == burst; }), "ran %d of %d", done.load(), burst);
+    CHECK(waitFor([&] { return stats().pool_free == WORK_QUEUE_POOL_SIZE; }), "%u free", stats().pool_free);
+    CHECK(stats().pool_size == WORK_QUEUE_POOL_SIZE, "pool did not shrink back: %u", stats().pool_size);
+
+    // from an ISR only the preallocated items can be used
+    CHECK(gate.close(SHARED_WORKERS), "shared workers not held");
+    done = 0;
+    int free = stats().pool_free;
+    int posted = 0;
+    hostSetIsrContext(true);
+    for(int i = 0; i < free + 5; i++) {
+        posted += workQueuePost(count, &done, WORK_PRIORITY_LOW);
+    }
+    hostSetIsrContext(false);
+    CHECK(posted == free, "%d ISR posts accepted with %d free items", posted, free);
+    CHECK(stats().pool_size == WORK_QUEUE_POOL_SIZE, "pool grew in an ISR: %u", stats().pool_size);
+    CHECK(stats().failed == before.failed + 5, "%u failed posts counted, expected %u", stats().failed, before.failed + 5);
+    gate.open(SHARED_WORKERS);
+    CHECK(waitFor([&] { return done == posted; }), "ran %d of %d", done.load(), posted);
+    printf("pool ok\n");
+}
+
+/*
+  More queued items than the wake up semaphore can count all run
+*/
+
+static void testBacklog()
+{
+    std::atomic<int> done(0);
+    work_fn_t count = [](void *arg) { (*(std::atomic<int> *)arg)++; };
+
+    Gate gate;
+    CHECK(gate.close(SHARED_WORKERS), "shared workers not held");
+    const int backlog = 0x7FFF + 5000;
+    for(int i = 0; i < backlog; i++) {
+        CHECK(workQueuePost(count, &done, WORK_PRIORITY_NORMAL), "post %d", i);
+    }
+    gate.open(SHARED_WORKERS);
+    CHECK(waitFor([&] { return done == backlog; }), "ran %d of %d", done.load(), backlog);
+    CHECK(waitFor([&] { return stats().pool_size == WORK_QUEUE_POOL_SIZE; }), "pool at %u", stats().pool_size);
+    printf("backlog ok\n");
+}
+
+/*
+  Benchmark
+*/
+
+static void bench(work_worker_t *worker)
+{
+    const int n = 200000;
+    std::atomic<int> done(0);
+    work_fn_t count = [](void *arg) { (*(std::atomic<int> *)arg)++; };
+
+    double start = seconds();
+    for(int i = 0; i < n; i++) {
+        while(!workQueuePost(count, &done, WORK_PRIORITY_NORMAL)) {
+        }
+    }
+    CHECK(waitFor([&] { return done == n; }), "ran %d of %d", done.load(), n);
+    printf("bench: post and run       %6.0f ns\n", (seconds() - start) / n * 1e9);
+
+    work_strand_t strand;
+    for(int bound = 0; bound < 2; bound++) {
+        workStrandInit(&strand, WORK_PRIORITY_NORMAL);
+        workStrandBind(&strand, bound ? worker : NULL);
+        done = 0;
+        start = seconds();
+        for(int i = 0; i < n; i++) {
+            while(!workStrandPost(&strand, count, &done)) {
+            }
+        }
+        CHECK(waitFor([&] { return done == n; }), "ran %d of %d", done.load(), n);
+        printf("bench: strand, %-10s %6.0f ns\n", bound ? "own worker" : "shared", (seconds() - start) / n * 1e9);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    printf("%d core(s), %d shared worker(s)\n", portNUM_PROCESSORS, SHARED_WORKERS);
+    CHECK(workQueueBegin(), "work queue did not start");
+    CHECK(stats().workers == SHARED_WORKERS, "%u workers", stats().workers);
+
+    testPlacement();
+    if(SHARED_WORKERS == 1) {
+        testLanes();
+    }
+    testOwnWorker();
+    work_worker_t *worker = workWorkerCreate("strands", 4096, 5, -1);
+    testStrands(worker);
+    testOwnedItem();
+    testPool();
+    testBacklog();
+    if(argc > 1 && !strcmp(argv[1], "bench")) {
+        bench(worker);
+    }
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,188 @@
+#!/usr/bin/env python
+#
+# Creates and applies delta (binary diff) patches for HTTPUpdate
+#
+# The device advertises support with the "x-ESP32-delta" request header and
+# identifies its running image with "x-ESP32-sketch-md5". A server holding
+# that image can answer with a patch instead of the full binary:
+#
+#   python esp_delta.py create old.bin new.bin patch.bin
+#   python esp_delta.py apply old.bin patch.bin out.bin
+#
+# create always applies the patch it wrote and compares the result with the
+# new image before it returns, so a patch that was written is known to work.
+#
+# Patch layout (little endian), see libraries/Update/src/UpdateDelta.h:
+#   "EDLT", version, flags, reserved, old size, new size, old MD5, new MD5
+#   body of records (diff length, extra length, seek) + diff bytes + extra
+#   bytes, zlib compressed when flag 0x01 is set
+#
+# Matching is bsdiff like: exact matches of BLOCK bytes anchor a record, which
+# is then extended while the images stay similar. Code that only moved or had
+# addresses relocated becomes diff bytes that are mostly zero and compress well.
+
+from __future__ import print_function, division
+
+import argparse
+import hashlib
+import struct
+import sys
+import zlib
+
+MAGIC = b"EDLT"
+VERSION = 1
+FLAG_ZLIB = 0x01
+HEADER = struct.Struct("<4sBBHII16s16s")
+CONTROL = struct.Struct("<IIi")
+
+BLOCK = 16          # length of the exact matches that anchor a record
+FUZZ = 32           # how far a record keeps going past its last good stretch
+
+
+def _index(old):
+    index = {}
+    for pos in range(0, len(old) - BLOCK + 1, BLOCK):
+        index.setdefault(old[pos:pos + BLOCK], pos)
+    return index
+
+
+def _extend(old, new, opos, npos):
+    """ Length of the best approximate match of new[npos:] against old[opos:] """
+    limit = min(len(old) - opos, len(new) - npos)
+    score = best = length = 0
+    i = 0
+    while i < limit and score > best - FUZZ:
+        score += 1 if old[opos + i] == new[npos + i] else -1
+        i += 1
+        if score > best:
+            best = score
+            length = i
+    return length
+
+
+def _matches(old, new):
+    """ Yields (new position, old position, length) for each record anchor """
+    index = _index(old)
+    npos = 0
+    scan = 0
+    last = len(new) - BLOCK
+    while scan <= last:
+        opos = index.get(new[scan:scan + BLOCK])
+        if opos is None:
+            scan += 1
+            continue
+        # pull the match back over what the previous record left behind
+        start = scan
+        while start > npos and opos > 0 and new[start - 1] == old[opos - 1]:
+            start -= 1
+            opos -= 1
+        length = _extend(old, new, opos, start)
+        yield start, opos, length
+        npos = scan = start + length
+
+
+def diff(old, new):
+    """ Returns the uncompressed patch body turning old into new """
+    body = bytearray()
+    # record pending output: diff run at (dnew, dold, dlen), then extra up to the next anchor
+    dnew = dold = dlen = 0
+    for start, opos, length in _matches(old, new):
+        extra = start - (dnew + dlen)
+        body += CONTROL.pack(dlen, extra, opos - (dold + dlen))
+        body += bytes(bytearray((new[dnew + i] - old[dold + i]) & 0xFF for i in range(dlen)))
+        body += new[dnew + dlen:start]
+        dnew, dold, dlen = start, opos, length
+    extra = len(new) - (dnew + dlen)
+    body += CONTROL.pack(dlen, extra, 0)
+    body += bytes(bytearray((new[dnew + i] - old[dold + i]) & 0xFF for i in range(dlen)))
+    body += new[dnew + dlen:]
+    return bytes(body)
+
+
+def create(old, new, compress=True):
+    body = diff(old, new)
+    flags = 0
+    if compress:
+        body = zlib.compress(body, 9)
+        flags |= FLAG_ZLIB
+    header = HEADER.pack(MAGIC, VERSION, flags, 0, len(old), len(new),
+                         hashlib.md5(old).digest(), hashlib.md5(new).digest())
+    return header + body
+
+
+def apply(old, patch):
+    magic, version, flags, _, old_size, new_size, old_md5, new_md5 = HEADER.unpack_from(patch)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError("not a delta patch")
+    if old_size != len(old) or hashlib.md5(old).digest() != old_md5:
+        raise ValueError("patch was made for a different old image")
+    body = patch[HEADER.size:]
+    if flags & FLAG_ZLIB:
+        body = zlib.decompress(body)
+    new = bytearray()
+    pos = opos = 0
+    while len(new) < new_size:
+        dlen, elen, seek = CONTROL.unpack_from(body, pos)
+        pos += CONTROL.size
+        if len(new) + dlen + elen > new_size or opos + dlen > old_size:
+            raise ValueError("corrupt patch")
+        new += bytearray((body[pos + i] + old[opos + i]) & 0xFF for i in range(dlen))
+        pos += dlen
+        new += body[pos:pos + elen]
+        pos += elen
+        opos += dlen + seek
+        if opos < 0 or opos > old_size:
+            raise ValueError("corrupt patch")
+    new = bytes(new)
+    if hashlib.md5(new).digest() != new_md5:
+        raise ValueError("result does not match the new image MD5")
+    return new
+
+
+def _read(path):
+    with open(path, "rb") as f:
+        return f.read()
+
+
+def _write(path, data):
+    with open(path, "wb") as f:
+        f.write(data)
+
+
+def main(args):
+    parser = argparse.ArgumentParser(description="Create or apply delta patches for HTTPUpdate")
+    sub = parser.add_subparsers(dest="command")
+    p = sub.add_parser("create", help="create a patch turning OLD into NEW")
+    p.add_argument("old")
+    p.add_argument("new")
+    p.add_argument("patch")
+    p.add_argument("--no-compress", action="store_true", help="store the body uncompressed")
+    p = sub.add_parser("apply", help="apply PATCH to OLD")
+    p.add_argument("old")
+    p.add_argument("patch")
+    p.add_argument("out")
+    options = parser.parse_args(args)
+
+    if options.command == "create":
+        old = _read(options.old)
+        new = _read(options.new)
+        patch = create(old, new, not options.no_compress)
+        if apply(old, patch) != new:
+            print("Patch verification failed", file=sys.stderr)
+            return 1
+        _write(options.patch, patch)
+        print("%s: %d bytes, %.1f%% of %d" % (options.patch, len(patch), 100.0 * len(patch) / len(new), len(new)))
+    elif options.command == "apply":
+        try:
+            _write(options.out, apply(_read(options.old), _read(options.patch)))
+        except (ValueError, struct.error) as e:
+            print("Patch failed: %s" % e, file=sys.stderr)
+            return 1
+    else:
+        parser.print_help()
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
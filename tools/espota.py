@@ -27,6 +27,11 @@
 # 2016-01-03:
 # - Added more options to parser.
 #
+# Changes
+# 2022-10-19:
+# - Protocol 2: windowed upload with cumulative acks, resume after a dropped connection.
+#   Devices without it still answer a plain "OK" and get the chunked upload.
+#
 
 from __future__ import print_function
 import socket
@@ -42,6 +47,10 @@ FLASH = 0
 SPIFFS = 100
 AUTH = 200
 PROGRESS = False
+# Transfer protocol, see ArduinoOTA.h
+PROTOCOL = 2
+CHUNK_SIZE = 4096
+RESUME_TRIES = 3
 # update_progress() : Displays or updates a console progress bar
 ## Accepts a float between 0 and 1. Any int will be converted to a float.
 ## A value under 0 represents a 'halt'.
@@ -69,26 +78,8 @@ def update_progress(progress):
     sys.stderr.write('.')
     sys.stderr.flush()
 
-def serve(remoteAddr, localAddr, remotePort, localPort, password, filename, command = FLASH):
-  # Create a TCP/IP socket
-  sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
-  server_address = (localAddr, localPort)
-  logging.info('Starting on %s:%s', str(server_address[0]), str(server_address[1]))
-  try:
-    sock.bind(server_address)
-    sock.listen(1)
-  except:
-    logging.error("Listen Failed")
-    return 1
-
-  content_size = os.path.getsize(filename)
-  f = open(filename,'rb')
-  file_md5 = hashlib.md5(f.read()).hexdigest()
-  f.close()
-  logging.info('Upload size: %d', content_size)
-  message = '%d %d %d %s\n' % (command, localPort, content_size, file_md5)
-
-  # Wait for a connection
+def invite(remoteAddr, remotePort, password, filename, content_size, file_md5, message):
+  # Returns the answer of the ESP ("OK..."), or None
   inv_trys = 0
   data = ''
   msg = 'Sending invitation to %s ' % (remoteAddr)
@@ -105,7 +96,7 @@ def serve(remoteAddr, localAddr, remotePort, localPort, password, filename, comm
       sys.stderr.flush()
       sock2.close()
       logging.error('Host %s Not Found', remoteAddr)
-      return 1
+      return None
     sock2.settimeout(TIMEOUT)
     try:
       data = sock2.recv(37).decode()
@@ -118,8 +109,8 @@ def serve(remoteAddr, localAddr, remotePort, localPort, password, filename, comm
   sys.stderr.flush()
   if (inv_trys == 10):
     logging.error('No response from the ESP')
-    return 1
-  if (data != "OK"):
+    return None
+  if (not is_ok(data)):
     if(data.startswith('AUTH')):
       nonce = data.split()[1]
       cnonce_text = '%s%u%s%s' % (filename, content_size, file_md5, remoteAddr)
@@ -138,98 +129,194 @@ def serve(remoteAddr, localAddr, remotePort, localPort, password, filename, comm
         sys.stderr.write('FAIL\n')
         logging.error('No Answer to our Authentication')
         sock2.close()
-        return 1
-      if (data != "OK"):
+        return None
+      if (not is_ok(data)):
         sys.stderr.write('FAIL\n')
         logging.error('%s', data)
         sock2.close()
         sys.exit(1);
-        return 1
+        return None
       sys.stderr.write('OK\n')
     else:
       logging.error('Bad Answer: %s', data)
       sock2.close()
-      return 1
+      return None
   sock2.close()
+  return data
+# end invite
+
 
-  logging.info('Waiting for device...')
+def is_ok(data):
+  # "OK" from protocol 1 devices, "OK <protocol> <resume offset> <window>" from newer ones
+  return data == "OK" or data.startswith("OK ")
+
+
+def upload_chunked(connection, f, content_size):
+  # Protocol 1: every chunk waits for its ack
+  offset = 0
+  while True:
+    chunk = f.read(1024)
+    if not chunk: break
+    offset += len(chunk)
+    update_progress(offset/float(content_size))
+    connection.settimeout(10)
+    try:
+      connection.sendall(chunk)
+      res = connection.recv(10)
+      lastResponseContainedOK = 'OK' in res.decode()
+    except:
+      sys.stderr.write('\n')
+      logging.error('Error Uploading')
+      return 1
+
+  if lastResponseContainedOK:
+    logging.info('Success')
+    return 0
+
+  sys.stderr.write('\n')
+  logging.info('Waiting for result...')
   try:
-    sock.settimeout(10)
-    connection, client_address = sock.accept()
-    sock.settimeout(None)
-    connection.settimeout(None)
+    count = 0
+    while True:
+      count=count+1
+      connection.settimeout(60)
+      data = connection.recv(32).decode()
+      logging.info('Result: %s' ,data)
+
+      if "OK" in data:
+        logging.info('Success')
+        return 0;
+      if count == 5:
+        logging.error('Error response from device')
+        return 1
   except:
-    logging.error('No response from device')
-    sock.close()
+    logging.error('No Result!')
     return 1
+# end upload_chunked
+
+
+def upload_windowed(connection, f, content_size, offset, window):
+  # Protocol 2: keep up to window bytes in flight, the ESP acks the running total.
+  # Returns 0 or 1 when done, None if the connection dropped and the upload can be resumed.
+  f.seek(offset)
+  sent = offset
+  acked = offset
+  pending = b''
+  connection.settimeout(10)
   try:
-    f = open(filename, "rb")
-    if (PROGRESS):
-      update_progress(0)
-    else:
-      sys.stderr.write('Uploading')
-      sys.stderr.flush()
-    offset = 0
-    while True:
-      chunk = f.read(1024)
-      if not chunk: break
-      offset += len(chunk)
-      update_progress(offset/float(content_size))
-      connection.settimeout(10)
-      try:
+    while acked < content_size:
+      while sent < content_size and sent - acked < window:
+        chunk = f.read(min(CHUNK_SIZE, window - (sent - acked)))
+        if not chunk: break
         connection.sendall(chunk)
-        res = connection.recv(10)
-        lastResponseContainedOK = 'OK' in res.decode()
-      except:
-        sys.stderr.write('\n')
-        logging.error('Error Uploading')
-        connection.close()
-        f.close()
-        sock.close()
-        return 1
+        sent += len(chunk)
+      data = connection.recv(64)
+      if not data:
+        raise socket.error('connection closed')
+      lines = (pending + data).split(b'\n')
+      pending = lines.pop()
+      for line in lines:
+        line = line.strip()
+        if line.isdigit():
+          acked = max(acked, int(line))
+          update_progress(acked/float(content_size))
+        elif line:
+          sys.stderr.write('\n')
+          logging.error('%s', line.decode())
+          return 1
+  except (socket.error, socket.timeout):
+    sys.stderr.write('\n')
+    logging.warning('Connection lost at %d', acked)
+    return None
 
-    if lastResponseContainedOK:
-      logging.info('Success')
-      connection.close()
-      f.close()
+  sys.stderr.write('\n')
+  logging.info('Waiting for result...')
+  try:
+    connection.settimeout(60)
+    while True:
+      if b'OK' in pending:
+        logging.info('Success')
+        return 0
+      data = connection.recv(32)
+      if not data:
+        break
+      pending += data
+  except:
+    pass
+  logging.error('Error response from device: %s', pending.decode())
+  return 1
+# end upload_windowed
+
+
+def serve(remoteAddr, localAddr, remotePort, localPort, password, filename, command = FLASH):
+  # Create a TCP/IP socket
+  sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+  server_address = (localAddr, localPort)
+  logging.info('Starting on %s:%s', str(server_address[0]), str(server_address[1]))
+  try:
+    sock.bind(server_address)
+    sock.listen(1)
+  except:
+    logging.error("Listen Failed")
+    return 1
+
+  content_size = os.path.getsize(filename)
+  f = open(filename,'rb')
+  file_md5 = hashlib.md5(f.read()).hexdigest()
+  f.close()
+  logging.info('Upload size: %d', content_size)
+  # devices that only know protocol 1 stop reading at the first newline
+  message = '%d %d %d %s\nPROTO %d\n' % (command, localPort, content_size, file_md5, PROTOCOL)
+
+  resumes = 0
+  while True:
+    data = invite(remoteAddr, remotePort, password, filename, content_size, file_md5, message)
+    if data is None:
       sock.close()
-      return 0
+      return 1
+    fields = data.split()
+    protocol = 1
+    offset = 0
+    window = 0
+    if len(fields) >= 4 and int(fields[1]) >= 2:
+      protocol = 2
+      offset = int(fields[2])
+      window = int(fields[3])
+      logging.info('Protocol %d, offset %d, window %d', protocol, offset, window)
 
-    sys.stderr.write('\n')
-    logging.info('Waiting for result...')
+    logging.info('Waiting for device...')
     try:
-      count = 0
-      while True:
-        count=count+1
-        connection.settimeout(60)
-        data = connection.recv(32).decode()
-        logging.info('Result: %s' ,data)
-
-        if "OK" in data:
-          logging.info('Success')
-          connection.close()
-          f.close()
-          sock.close()
-          return 0;
-        if count == 5:
-          logging.error('Error response from device')
-          connection.close()
-          f.close()
-          sock.close()
-          return 1
-    except e:
-      logging.error('No Result!')
+      sock.settimeout(10)
+      connection, client_address = sock.accept()
+      sock.settimeout(None)
+      connection.settimeout(None)
+    except:
+      logging.error('No response from device')
+      sock.close()
+      return 1
+    f = open(filename, "rb")
+    try:
+      if (PROGRESS):
+        update_progress(offset/float(content_size))
+      else:
+        sys.stderr.write('Resuming' if offset else 'Uploading')
+        sys.stderr.flush()
+      if protocol == 1:
+        result = upload_chunked(connection, f, content_size)
+      else:
+        result = upload_windowed(connection, f, content_size, offset, window)
+    finally:
       connection.close()
       f.close()
+
+    if result is not None:
+      sock.close()
+      return result
+    if resumes == RESUME_TRIES:
+      logging.error('Error Uploading')
       sock.close()
       return 1
-
-  finally:
-    connection.close()
-    f.close()
-
-  sock.close()
-  return 1
+    resumes += 1
 # end serve
 
 